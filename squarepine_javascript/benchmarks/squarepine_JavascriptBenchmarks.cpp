@@ -0,0 +1,562 @@
+//==============================================================================
+/** A script that defines a run() function, which gets timed.
+
+    If the script also sets a global called bytesPerRun, that's taken to be the
+    amount of data each run processes, and the throughput gets reported.
+*/
+struct JavascriptBenchmarks::Workload
+{
+    /** */
+    enum class Mode
+    {
+        run,                /**< Times calling the script's run() function. */
+        parse,              /**< Times building the script's syntax tree, without running it. */
+        tokenise,           /**< Times splitting the script into tokens, without parsing it. */
+        juceJSONParse,      /**< Runs the script, and then times juce::JSON::parse() on the string in its payload global. */
+        juceJSONStringify   /**< Runs the script, and then times juce::JSON::toString() on the value of its data global. */
+    };
+
+    String name, script;
+    Mode mode = Mode::run;
+};
+
+namespace BenchmarkScripts
+{
+    static const char* const fib = R"(
+        function fib (n) { return n < 2 ? n : fib (n - 1) + fib (n - 2); }
+        function run() { return fib (20); }
+    )";
+
+    static const char* const arithmetic = R"(
+        function run()
+        {
+            var total = 0;
+
+            for (var i = 0; i < 10000; ++i)
+                total = (total + i * 3 - (i >> 1)) % 1000003;
+
+            return total;
+        }
+    )";
+
+    static const char* const properties = R"(
+        function run()
+        {
+            var points = [];
+
+            for (var i = 0; i < 1000; ++i)
+                points.push ({ x: i, y: i * 2, z: 0 });
+
+            var total = 0;
+
+            for (var j = 0; j < points.length; ++j)
+            {
+                var p = points[j];
+                p.z = p.x + p.y;
+                total += p.z;
+            }
+
+            return total;
+        }
+    )";
+
+    static const char* const stringAppend = R"(
+        function run()
+        {
+            var text = "";
+
+            for (var i = 0; i < 100000; ++i)
+                text += "abc";
+
+            return text.length;
+        }
+    )";
+
+    static const char* const stringMethods = R"(
+        var sentence = "The quick brown fox jumps over the lazy dog";
+
+        function run()
+        {
+            var total = 0;
+
+            for (var i = 0; i < 200; ++i)
+            {
+                var words = sentence.split (" ");
+                total += words.join ("-").length;
+                total += sentence.indexOf ("lazy");
+                total += sentence.substring (4, 9).toLowerCase().length;
+            }
+
+            return total;
+        }
+    )";
+
+    static const char* const arrayMethods = R"(
+        function run()
+        {
+            var values = [];
+
+            for (var i = 0; i < 2000; ++i)
+                values.push ((i * 7919) % 2003);
+
+            var evens = values.filter (function (v) { return v % 2 == 0; });
+            evens.sort (function (a, b) { return a - b; });
+            return evens.indexOf (1000) + values.join (",").length;
+        }
+    )";
+
+    static const char* const records = R"(
+        function makeRecords (count)
+        {
+            var list = [];
+
+            for (var i = 0; i < count; ++i)
+                list.push ({ id: i, name: "record " + i, score: i * 1.5, active: i % 3 == 0, tags: [ "a", "b", "c" ] });
+
+            return list;
+        }
+    )";
+
+    static const String jsonParse = String (records) + R"(
+        var payload = JSON.stringify (makeRecords (500));
+        var bytesPerRun = payload.length;
+
+        function run() { return JSON.parse (payload).length; }
+    )";
+
+    static const String jsonStringify = String (records) + R"(
+        var data = makeRecords (500);
+        var bytesPerRun = JSON.stringify (data).length;
+
+        function run() { return JSON.stringify (data).length; }
+    )";
+
+    static const char* const math = R"(
+        function run()
+        {
+            var total = 0;
+
+            for (var i = 0; i < 5000; ++i)
+                total += Math.sqrt (i) + Math.sin (i) + Math.floor (i / 3) + Math.max (i, 2500) + Math.abs (-i);
+
+            return total;
+        }
+    )";
+
+    static const char* const closures = R"(
+        function makeCounter()
+        {
+            var count = 0;
+            return function() { return ++count; };
+        }
+
+        function run()
+        {
+            var total = 0;
+
+            for (var i = 0; i < 200; ++i)
+            {
+                var counter = makeCounter();
+
+                for (var j = 0; j < 10; ++j)
+                    total += counter();
+            }
+
+            return total;
+        }
+    )";
+
+    static const char* const numberConversion = R"(
+        function run()
+        {
+            var total = 0;
+
+            for (var i = 0; i < 2000; ++i)
+            {
+                var text = "" + (i * 1.25);
+                total += parseFloat (text);
+                total += parseInt ("" + i);
+                total += (i / 7).toFixed (3).length;
+            }
+
+            return total;
+        }
+    )";
+
+    static const char* const dateParsing = R"(
+        var stamps = [];
+        var bytesPerRun = 0;
+
+        for (var i = 0; i < 1000; ++i)
+        {
+            stamps.push ("2024-03-" + (10 + i % 18) + "T12:" + (10 + i % 50) + ":56.789Z");
+            bytesPerRun += stamps[i].length;
+        }
+
+        function run()
+        {
+            var total = 0;
+
+            for (var i = 0; i < stamps.length; ++i)
+                total += Date.parse (stamps[i]);
+
+            return total;
+        }
+    )";
+
+    static const char* const dateParsingBatch = R"(
+        var stamps = [];
+        var bytesPerRun = 0;
+
+        for (var i = 0; i < 1000; ++i)
+        {
+            stamps.push ("2024-03-" + (10 + i % 18) + "T12:" + (10 + i % 50) + ":56.789Z");
+            bytesPerRun += stamps[i].length;
+        }
+
+        function run() { return Date.parseAll (stamps).length; }
+    )";
+
+    /** Every key is only referred to by its own value, so the collector has to
+        reclaim each entry along with its key, and the heap shouldn't grow from one
+        run to the next. If the values were treated as strong references, every
+        entry would be kept alive, and the peak heap size would keep on climbing.
+    */
+    static const char* const weakMapCycles = R"(
+        var cache = new WeakMap();
+
+        function run()
+        {
+            for (var i = 0; i < 2000; ++i)
+            {
+                var key = { id: i };
+                cache.set (key, { owner: key, payload: [ i, i + 1, i + 2 ] });
+            }
+
+            return cache.has ({}) ? 1 : 0;
+        }
+    )";
+
+    /** The sizes of the sources that the parser gets timed over. */
+    struct CorpusSize
+    {
+        const char* name;
+        int numBytes;
+    };
+
+    static const CorpusSize parserCorpusSizes[] =
+    {
+        { "Small",  4 * 1024 },
+        { "Medium", 256 * 1024 },
+        { "Large",  4 * 1024 * 1024 }
+    };
+}
+
+//==============================================================================
+const std::vector<JavascriptBenchmarks::Workload>& JavascriptBenchmarks::getWorkloads()
+{
+    static const std::vector<Workload> workloads = []
+    {
+        std::vector<Workload> list =
+        {
+            { "fib",                BenchmarkScripts::fib },
+            { "arithmetic",         BenchmarkScripts::arithmetic },
+            { "properties",         BenchmarkScripts::properties },
+            { "stringAppend",       BenchmarkScripts::stringAppend },
+            { "stringMethods",      BenchmarkScripts::stringMethods },
+            { "arrayMethods",       BenchmarkScripts::arrayMethods },
+            { "jsonParse",          BenchmarkScripts::jsonParse },
+            { "jsonStringify",      BenchmarkScripts::jsonStringify },
+            { "math",               BenchmarkScripts::math },
+            { "closures",           BenchmarkScripts::closures },
+            { "numberConversion",   BenchmarkScripts::numberConversion },
+            { "dateParsing",        BenchmarkScripts::dateParsing },
+            { "dateParsingBatch",   BenchmarkScripts::dateParsingBatch },
+            { "weakMapCycles",      BenchmarkScripts::weakMapCycles }
+        };
+
+        // The parser gets timed over sources of a few sizes, made of all the other workloads, which cover a fair mix of syntax.
+        const auto numScripts = list.size();
+
+        for (const auto& size : BenchmarkScripts::parserCorpusSizes)
+        {
+            MemoryOutputStream source;
+
+            while (source.getDataSize() < (size_t) size.numBytes)
+                for (size_t i = 0; i < numScripts; ++i)
+                    source << list[i].script << newLine;
+
+            list.push_back ({ String ("parse") + size.name, source.toString(), Workload::Mode::parse });
+        }
+
+        list.push_back ({ "tokeniseLarge", list.back().script, Workload::Mode::tokenise });
+
+        // The same payloads as jsonParse and jsonStringify, handled by juce::JSON, to compare their throughput with.
+        list.push_back ({ "jsonParseJUCE",      BenchmarkScripts::jsonParse,        Workload::Mode::juceJSONParse });
+        list.push_back ({ "jsonStringifyJUCE",  BenchmarkScripts::jsonStringify,    Workload::Mode::juceJSONStringify });
+        return list;
+    }();
+
+    return workloads;
+}
+
+StringArray JavascriptBenchmarks::getBenchmarkNames()
+{
+    StringArray names;
+
+    for (const auto& w : getWorkloads())
+        names.add (w.name);
+
+    return names;
+}
+
+//==============================================================================
+/** Splits some code into tokens, the way the parser sees it, without building anything. */
+static int64 countTokens (const String& code)
+{
+    TokenIterator tokens (code);
+    int64 numTokens = 0;
+
+    while (tokens.currentType != TokenTypes::eof)
+    {
+        tokens.skip();
+        ++numTokens;
+    }
+
+    return numTokens;
+}
+
+JavascriptBenchmarks::Measurement JavascriptBenchmarks::measure (const Workload& workload, const Options& options)
+{
+    Measurement measurement;
+    measurement.name = workload.name;
+
+    JavascriptEngine engine;
+    engine.maximumExecutionTime = RelativeTime::hours (1.0);
+
+    int64 bytesPerRun = 0, tokensPerRun = 0;
+    int64 numAllocations = 0;
+    std::function<Result()> runOnce;
+    ReferenceCountedObjectPtr<RootObject> parseRoot;
+
+    if (workload.mode == Workload::Mode::parse)
+    {
+        bytesPerRun = (int64) workload.script.getNumBytesAsUTF8();
+        tokensPerRun = countTokens (workload.script);
+
+        // Creating a root sets up all of the built-in classes, which would swamp the time spent parsing.
+        parseRoot = new RootObject();
+
+        runOnce = [&workload, &parseRoot]
+        {
+            const RootObject::ScopedActivation activation (*parseRoot);
+
+            try
+            {
+                ExpressionTreeBuilder tb (workload.script);
+                const std::unique_ptr<BlockStatement> tree (tb.parseStatementList());
+            }
+            catch (String& error)
+            {
+                return Result::fail (error);
+            }
+
+            return Result::ok();
+        };
+    }
+    else if (workload.mode == Workload::Mode::tokenise)
+    {
+        bytesPerRun = (int64) workload.script.getNumBytesAsUTF8();
+        tokensPerRun = countTokens (workload.script);
+
+        runOnce = [&workload]
+        {
+            try
+            {
+                countTokens (workload.script);
+            }
+            catch (String& error)
+            {
+                return Result::fail (error);
+            }
+
+            return Result::ok();
+        };
+    }
+    else
+    {
+        const auto setup = engine.execute (workload.script);
+
+        if (setup.failed())
+        {
+            measurement.error = setup.getErrorMessage();
+            return measurement;
+        }
+
+        bytesPerRun = (int64) engine.getRootObjectProperties()["bytesPerRun"];
+
+        if (workload.mode == Workload::Mode::juceJSONParse)
+        {
+            const auto payload = engine.getRootObjectProperties()["payload"].toString();
+
+            runOnce = [payload]
+            {
+                var parsed;
+                return JSON::parse (payload, parsed);
+            };
+        }
+        else if (workload.mode == Workload::Mode::juceJSONStringify)
+        {
+            const auto data = engine.getRootObjectProperties()["data"];
+
+            runOnce = [data]
+            {
+                JSON::toString (data, true);
+                return Result::ok();
+            };
+        }
+        else
+        {
+            runOnce = [&engine, &numAllocations]
+            {
+                static const Identifier runId ("run");
+                auto result = Result::ok();
+                engine.callFunction (runId, var::NativeFunctionArgs (var(), nullptr, 0), &result);
+
+               #if SP_JAVASCRIPT_ENABLE_INSTRUMENTATION
+                const auto& counters = engine.getInstrumentationCounters();
+                numAllocations += counters.objectAllocations + counters.arrayAllocations + counters.stringAllocations;
+               #else
+                ignoreUnused (numAllocations);
+               #endif
+
+                return result;
+            };
+        }
+    }
+
+    for (int i = 0; i < options.numWarmUpRuns; ++i)
+    {
+        const auto result = runOnce();
+
+        if (result.failed())
+        {
+            measurement.error = result.getErrorMessage();
+            return measurement;
+        }
+    }
+
+    numAllocations = 0;
+
+    const auto startTicks = Time::getHighResolutionTicks();
+    double seconds = 0.0;
+
+    do
+    {
+        const auto result = runOnce();
+
+        if (result.failed())
+        {
+            measurement.error = result.getErrorMessage();
+            return measurement;
+        }
+
+        ++measurement.numRuns;
+        seconds = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - startTicks);
+    }
+    while (seconds < options.minimumSecondsPerBenchmark);
+
+    measurement.nsPerRun = seconds * 1.0e9 / (double) measurement.numRuns;
+
+    if (workload.mode == Workload::Mode::run)
+        measurement.peakHeapBytes = engine.getPeakHeapBytes();
+
+    if (bytesPerRun > 0)
+        measurement.mbPerSecond = (double) bytesPerRun * (double) measurement.numRuns / (seconds * 1024.0 * 1024.0);
+
+    if (tokensPerRun > 0)
+        measurement.tokensPerSecond = (double) tokensPerRun * (double) measurement.numRuns / seconds;
+
+   #if SP_JAVASCRIPT_ENABLE_INSTRUMENTATION
+    measurement.allocationsPerRun = (double) numAllocations / (double) measurement.numRuns;
+   #endif
+
+    return measurement;
+}
+
+Array<JavascriptBenchmarks::Measurement> JavascriptBenchmarks::run()
+{
+    return run (Options());
+}
+
+Array<JavascriptBenchmarks::Measurement> JavascriptBenchmarks::run (const Options& options)
+{
+    Array<Measurement> results;
+
+    for (const auto& w : getWorkloads())
+        if (options.filter.isEmpty() || w.name.contains (options.filter))
+            results.add (measure (w, options));
+
+    return results;
+}
+
+Result JavascriptBenchmarks::writeParserCorpus (const File& directory)
+{
+    const auto result = directory.createDirectory();
+
+    if (result.failed())
+        return result;
+
+    for (const auto& w : getWorkloads())
+        if (w.mode == Workload::Mode::run
+            && ! directory.getChildFile (w.name + ".js").replaceWithText (w.script))
+            return Result::fail ("Couldn't write to " + directory.getFullPathName());
+
+    return Result::ok();
+}
+
+//==============================================================================
+var JavascriptBenchmarks::toVar (const Array<Measurement>& results)
+{
+    Array<var> list;
+
+    for (const auto& m : results)
+    {
+        DynamicObject::Ptr o (new DynamicObject());
+        o->setProperty ("name", m.name);
+
+        if (m.error.isNotEmpty())
+        {
+            o->setProperty ("error", m.error);
+        }
+        else
+        {
+            o->setProperty ("runs", m.numRuns);
+            o->setProperty ("nsPerRun", m.nsPerRun);
+
+            if (m.peakHeapBytes >= 0)
+                o->setProperty ("peakHeapBytes", m.peakHeapBytes);
+
+            if (m.mbPerSecond > 0.0)
+                o->setProperty ("mbPerSecond", m.mbPerSecond);
+
+            if (m.tokensPerSecond > 0.0)
+                o->setProperty ("tokensPerSecond", m.tokensPerSecond);
+
+            if (m.allocationsPerRun >= 0.0)
+                o->setProperty ("allocationsPerRun", m.allocationsPerRun);
+        }
+
+        list.add (o.get());
+    }
+
+    DynamicObject::Ptr result (new DynamicObject());
+    result->setProperty ("instrumented", SP_JAVASCRIPT_ENABLE_INSTRUMENTATION != 0);
+    result->setProperty ("benchmarks", list);
+    return result.get();
+}
+
+String JavascriptBenchmarks::toJSON (const Array<Measurement>& results)
+{
+    return JSON::toString (toVar (results));
+}
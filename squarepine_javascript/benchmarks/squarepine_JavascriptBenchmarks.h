@@ -0,0 +1,82 @@
+//==============================================================================
+/** Times the interpreter over a set of standard workloads, so that changes to it
+    can be compared from one run to the next.
+
+    Each workload gets a fresh JavascriptEngine, is warmed up, and is then run
+    repeatedly for at least the minimum time, giving the average time per run.
+    Workloads that chew through data, like JSON.parse(), also report their throughput.
+    JSON.parse() and JSON.stringify() are paired with juce::JSON working on the same
+    payloads, so that their throughput can be compared.
+
+    The parser and tokeniser are timed on their own too, over sources of a few sizes
+    up to several megabytes, giving their throughput in tokens and megabytes per second.
+
+    The results can be written out as JSON, so that they can be kept and diffed
+    by tools. Allocation counts are only included when the module is built with
+    SP_JAVASCRIPT_ENABLE_INSTRUMENTATION, since the counting skews the timings a little.
+
+    This is only compiled in when SP_JAVASCRIPT_ENABLE_BENCHMARKS is enabled,
+    and is meant to be driven by a small console app, eg:
+    @code
+        const auto results = JavascriptBenchmarks::run();
+        std::cout << JavascriptBenchmarks::toJSON (results) << std::endl;
+    @endcode
+*/
+class JavascriptBenchmarks final
+{
+public:
+    //==============================================================================
+    /** */
+    struct Options
+    {
+        /** The least amount of time to spend timing each workload. */
+        double minimumSecondsPerBenchmark = 0.5;
+        /** The number of untimed runs of each workload before it gets timed. */
+        int numWarmUpRuns = 3;
+        /** If not empty, only the workloads whose names contain this get run. */
+        String filter;
+    };
+
+    /** The measurements taken for a single workload. */
+    struct Measurement
+    {
+        String name;
+        int64 numRuns = 0;
+        double nsPerRun = 0.0;
+        double mbPerSecond = 0.0;           /**< Zero for workloads that don't process a known amount of data. */
+        double tokensPerSecond = 0.0;       /**< Zero for anything but the parser's workloads. */
+        double allocationsPerRun = -1.0;    /**< Negative when the module was built without instrumentation. */
+        int64 peakHeapBytes = -1;           /**< Negative for the parser's workloads, which don't run any scripts. */
+        String error;                       /**< Empty unless the workload failed, in which case nothing else was measured. */
+    };
+
+    //==============================================================================
+    /** @returns the names of all of the workloads. */
+    static StringArray getBenchmarkNames();
+
+    /** Runs every workload with the default options. */
+    static Array<Measurement> run();
+    /** Runs the workloads selected by the options. */
+    static Array<Measurement> run (const Options& options);
+
+    /** Writes each of the workloads' scripts to a file in the given directory,
+        eg: to seed the corpus of the parser's fuzz target.
+
+        @see SP_JAVASCRIPT_ENABLE_PARSER_FUZZER
+    */
+    static Result writeParserCorpus (const File& directory);
+
+    //==============================================================================
+    /** @returns the results as an object, ready to be written out as JSON. */
+    static var toVar (const Array<Measurement>& results);
+    /** @returns the results as JSON. */
+    static String toJSON (const Array<Measurement>& results);
+
+private:
+    //==============================================================================
+    struct Workload;
+    static const std::vector<Workload>& getWorkloads();
+    static Measurement measure (const Workload&, const Options&);
+
+    JUCE_DECLARE_NON_COPYABLE (JavascriptBenchmarks)
+};
@@ -0,0 +1,71 @@
+//==============================================================================
+/*  The parser's fuzz target, which libFuzzer calls with each input it comes up with.
+
+    Crashes, hangs and sanitiser errors get reported by libFuzzer itself. On top of that,
+    any input that's slow enough to time reliably gets parsed again with a copy of
+    itself appended. Twice the code should take about twice as long, so an input
+    whose parse time grows much faster than that gets flagged as a failure,
+    long before it would be big enough to trip libFuzzer's timeout.
+*/
+namespace ParserFuzzer
+{
+    /** Parse times shorter than this are too noisy to compare. */
+    static constexpr double minimumSecondsToCompare = 0.001;
+    /** How much longer than the original the doubled input is allowed to take. */
+    static constexpr double maximumGrowth = 3.0;
+
+    /** @returns the time it took to parse some code, in seconds. Syntax errors are expected, and ignored. */
+    static double timeParse (const String& code)
+    {
+        const auto startTicks = Time::getHighResolutionTicks();
+
+        try
+        {
+            ExpressionTreeBuilder tb (code);
+            const std::unique_ptr<BlockStatement> tree (tb.parseStatementList());
+        }
+        catch (String&)
+        {
+        }
+
+        return Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - startTicks);
+    }
+
+    /** The quickest of a few tries filters out most of the noise from the rest of the system. */
+    static double timeFastestParse (const String& code)
+    {
+        auto fastest = timeParse (code);
+
+        for (int i = 0; i < 2; ++i)
+            fastest = jmin (fastest, timeParse (code));
+
+        return fastest;
+    }
+
+    static int testOneInput (const uint8* data, size_t size)
+    {
+        if (! CharPointer_UTF8::isValidString ((const char*) data, (int) size))
+            return 0;
+
+        // Creating a root sets up all of the built-in classes, which would swamp the time spent parsing.
+        static ReferenceCountedObjectPtr<RootObject> root (new RootObject());
+        const RootObject::ScopedActivation activation (*root);
+
+        const auto code = String::fromUTF8 ((const char*) data, (int) size);
+
+        if (timeParse (code) < minimumSecondsToCompare)
+            return 0;
+
+        const auto seconds = timeFastestParse (code);
+        const auto doubledSeconds = timeFastestParse (code + newLine + code);
+
+        if (seconds >= minimumSecondsToCompare && doubledSeconds > seconds * maximumGrowth)
+        {
+            Logger::writeToLog ("Parse time grew from " + String (seconds * 1000.0, 3) + " ms to "
+                                + String (doubledSeconds * 1000.0, 3) + " ms when the input was doubled");
+            std::abort();
+        }
+
+        return 0;
+    }
+}
@@ -0,0 +1,142 @@
+//==============================================================================
+BoundClass::BoundClass (const Identifier& name) :
+    className (name),
+    prototype (new DynamicObject())
+{
+}
+
+BoundClass::~BoundClass()
+{
+}
+
+//==============================================================================
+void BoundClass::addMethod (const Identifier& name, var::NativeFunction function)
+{
+    prototype.getDynamicObject()->setMethod (name, std::move (function));
+}
+
+void BoundClass::addProperty (Property property)
+{
+    jassert (findProperty (property.name) == nullptr); // Be careful - the class already has this property!
+
+    properties.push_back (std::move (property));
+}
+
+const BoundClass::Property* BoundClass::findProperty (const Identifier& name) const noexcept
+{
+    for (const auto& p : properties)
+        if (p.name == name)
+            return &p;
+
+    return nullptr;
+}
+
+//==============================================================================
+bool BoundClass::getProperty (void* instance, const Identifier& name, var& result) const
+{
+    if (auto* p = findProperty (name))
+    {
+        result = p->get (instance);
+        return true;
+    }
+
+    if (auto* method = getScriptPrototype().getDynamicObject()->getProperties().getVarPointer (name))
+    {
+        result = *method;
+        return true;
+    }
+
+    return false;
+}
+
+const var& BoundClass::getScriptPrototype() const
+{
+    auto* root = RootObject::getCurrent();
+
+    if (root == nullptr)
+        return prototype;
+
+    auto& entry = root->boundPrototypes[this];
+
+    if (entry.boundClass == nullptr)
+    {
+        DynamicObject::Ptr copy (new ScriptObject());
+
+        for (const auto& method : prototype.getDynamicObject()->getProperties())
+            copy->setProperty (method.name, method.value);
+
+        entry.boundClass = const_cast<BoundClass*> (this);
+        entry.prototype = copy.get();
+    }
+
+    return entry.prototype;
+}
+
+bool BoundClass::setProperty (void* instance, const Identifier& name, const var& newValue) const
+{
+    auto* p = findProperty (name);
+
+    if (p == nullptr)
+        return false;
+
+    if (p->set == nullptr)
+        throw className.toString() + "." + name.toString() + " is read-only";
+
+    p->set (instance, newValue);
+    return true;
+}
+
+void* BoundClass::getInstanceForCall (const BoundClass* expectedClass, const Identifier& name,
+                                      const Identifier& methodName, const var& thisObject)
+{
+    if (auto* o = dynamic_cast<BoundObject*> (thisObject.getDynamicObject()))
+        if (&o->getBoundClass() == expectedClass)
+            return o->getInstance();
+
+    throw name.toString() + "." + methodName.toString() + "() was called on something that isn't a " + name.toString();
+}
+
+//==============================================================================
+BoundObject::BoundObject (BoundClass::Ptr c, void* i, bool owned) :
+    boundClass (std::move (c)),
+    instance (i),
+    isOwned (owned)
+{
+    jassert (boundClass != nullptr && instance != nullptr);
+}
+
+BoundObject::~BoundObject()
+{
+    if (isOwned)
+        boundClass->destroyInstance (instance);
+}
+
+var BoundObject::getBoundProperty (const Identifier& name) const
+{
+    var result;
+
+    if (boundClass->getProperty (instance, name, result))
+        return result;
+
+    return var::undefined();
+}
+
+bool BoundObject::setBoundProperty (const Identifier& name, const var& newValue)
+{
+    return boundClass->setProperty (instance, name, newValue);
+}
+
+const var& BoundObject::getProperty (const Identifier& name) const
+{
+    // This is how Scope::findFunctionCall() finds the methods: through the prototype, like any other object's.
+    if (name == getPrototypeIdentifier())
+        return boundClass->getScriptPrototype();
+
+    return ScriptObject::getProperty (name);
+}
+
+bool BoundObject::hasMethod (const Identifier& name) const
+{
+    return ScriptObject::hasMethod (name)
+        || boundClass->getScriptPrototype().getDynamicObject()->hasMethod (name);
+}
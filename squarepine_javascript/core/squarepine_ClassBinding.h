@@ -0,0 +1,273 @@
+//==============================================================================
+/** The methods and properties of a C++ class that gets handed to scripts,
+    which are shared by every object of that class.
+
+    This is the part of a ClassBinding that doesn't depend on the C++ type.
+
+    @see ClassBinding, BoundObject
+*/
+class BoundClass : public ReferenceCountedObject
+{
+public:
+    //==============================================================================
+    /** */
+    using Ptr = ReferenceCountedObjectPtr<BoundClass>;
+
+    /** */
+    ~BoundClass() override;
+
+    //==============================================================================
+    /** */
+    const Identifier& getClassName() const noexcept     { return className; }
+
+    /** The object that holds the class's methods.
+
+        Scripts never see this object itself: each engine gives its instances a copy of it
+        as their prototype, so that a script changing it only affects its own engine.
+    */
+    const var& getPrototype() const noexcept            { return prototype; }
+
+    /** @returns the running engine's copy of the prototype, making it the first time it's needed,
+                 or the class's own prototype if no engine is running on this thread.
+    */
+    const var& getScriptPrototype() const;
+
+    //==============================================================================
+    /** Looks up one of the class's properties, or failing that one of its methods, for an instance.
+
+        @returns true if there was a property or a method by that name.
+    */
+    bool getProperty (void* instance, const Identifier& name, var& result) const;
+
+    /** Sets one of the class's properties on an instance.
+
+        @returns true if there was a property by that name, or false if there wasn't,
+                 in which case the script can add a property of its own instead.
+                 Properties without a setter throw an error.
+    */
+    bool setProperty (void* instance, const Identifier& name, const var& newValue) const;
+
+protected:
+    //==============================================================================
+    /** */
+    explicit BoundClass (const Identifier& className);
+
+    /** A property with a getter, and a setter if it isn't read-only. */
+    struct Property
+    {
+        Identifier name;
+        std::function<var (void*)> get;
+        std::function<void (void*, const var&)> set;
+    };
+
+    /** */
+    void addMethod (const Identifier& name, var::NativeFunction function);
+    /** */
+    void addProperty (Property property);
+
+    /** Deletes an instance that was handed over to the script to own. */
+    virtual void destroyInstance (void* instance) const = 0;
+
+    /** @returns the instance that a method was called on, throwing an error if it isn't one of this class. */
+    static void* getInstanceForCall (const BoundClass* expectedClass, const Identifier& className,
+                                     const Identifier& methodName, const var& thisObject);
+
+private:
+    //==============================================================================
+    friend class BoundObject;
+
+    const Identifier className;
+    var prototype;
+    std::vector<Property> properties;
+
+    const Property* findProperty (const Identifier&) const noexcept;
+
+    //==============================================================================
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (BoundClass)
+};
+
+//==============================================================================
+/** An instance of a C++ class, as seen by scripts.
+
+    Apart from what every ScriptObject has, this is just a pointer to the instance
+    and one to its class: the methods and properties are all looked up in the class,
+    rather than being copied into each object. Being a ScriptObject, it can be used as
+    a WeakMap key, and the cycle collector can see any properties a script gives it.
+
+    @see ClassBinding
+*/
+class BoundObject final : public ScriptObject
+{
+public:
+    //==============================================================================
+    /** */
+    BoundObject (BoundClass::Ptr boundClass, void* instance, bool isOwned);
+    /** */
+    ~BoundObject() override;
+
+    //==============================================================================
+    /** */
+    const BoundClass& getBoundClass() const noexcept    { return *boundClass; }
+    /** */
+    void* getInstance() const noexcept                  { return instance; }
+
+    /** @returns the value of one of the class's properties or methods, or undefined if it doesn't have one by that name. */
+    var getBoundProperty (const Identifier& name) const;
+
+    /** @returns true if the class had a property by that name to set. */
+    bool setBoundProperty (const Identifier& name, const var& newValue);
+
+    //==============================================================================
+    /** @internal */
+    const var& getProperty (const Identifier& name) const override;
+    /** @internal */
+    bool hasMethod (const Identifier& name) const override;
+    /** There's only ever one script object for an instance, so cloning it just gives back the same object. */
+    DynamicObject::Ptr clone() override                 { return this; }
+
+private:
+    //==============================================================================
+    const BoundClass::Ptr boundClass;
+    void* const instance;
+    const bool isOwned;
+
+    //==============================================================================
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (BoundObject)
+};
+
+//==============================================================================
+/** Exposes a C++ class to scripts, with its methods and properties registered
+    once for the class rather than on every object.
+
+    Each object handed to a script is a BoundObject, which only points to the C++
+    instance and to this class. Its methods live in a prototype that all of the
+    instances in an engine share, and its properties are read and written through getters and
+    setters that are looked up here. Arguments and return values are converted with
+    NativeValue, just as they are for functions bound with NativeBinding.
+
+    @code
+        ClassBinding<Voice>::Ptr voiceClass (new ClassBinding<Voice> ("Voice"));
+
+        voiceClass->method ("noteOn", &Voice::noteOn)
+                   .property ("gain", &Voice::getGain, &Voice::setGain)
+                   .property ("isActive", &Voice::isActive);
+
+        engine.registerNativeObject ("voice", voiceClass->wrap (voice).getDynamicObject());
+    @endcode
+
+    A ClassBinding can be shared by any number of engines.
+*/
+template<typename ClassType>
+class ClassBinding final : public BoundClass
+{
+public:
+    //==============================================================================
+    /** */
+    using Ptr = ReferenceCountedObjectPtr<ClassBinding>;
+
+    /** */
+    explicit ClassBinding (const Identifier& name) : BoundClass (name) {}
+
+    //==============================================================================
+    /** Adds a method. */
+    template<typename ReturnType, typename... ArgumentTypes>
+    ClassBinding& method (const Identifier& name, ReturnType (ClassType::*function) (ArgumentTypes...))
+    {
+        addMethod (name, MethodInvoker<decltype (function), ReturnType, ArgumentTypes...> { this, getClassName(), name, function });
+        return *this;
+    }
+
+    /** Adds a const method. */
+    template<typename ReturnType, typename... ArgumentTypes>
+    ClassBinding& method (const Identifier& name, ReturnType (ClassType::*function) (ArgumentTypes...) const)
+    {
+        addMethod (name, MethodInvoker<decltype (function), ReturnType, ArgumentTypes...> { this, getClassName(), name, function });
+        return *this;
+    }
+
+    /** Adds a read-only property. */
+    template<typename ValueType>
+    ClassBinding& property (const Identifier& name, ValueType (ClassType::*getter)() const)
+    {
+        jassert (getter != nullptr);
+
+        addProperty ({ name,
+                       [getter] (void* instance) { return NativeValue<std::decay_t<ValueType>>::toVar ((static_cast<ClassType*> (instance)->*getter)()); },
+                       nullptr });
+        return *this;
+    }
+
+    /** Adds a property that scripts can set as well as read. */
+    template<typename ValueType, typename SetterArgumentType>
+    ClassBinding& property (const Identifier& name, ValueType (ClassType::*getter)() const, void (ClassType::*setter) (SetterArgumentType))
+    {
+        jassert (getter != nullptr && setter != nullptr);
+
+        addProperty ({ name,
+                       [getter] (void* instance) { return NativeValue<std::decay_t<ValueType>>::toVar ((static_cast<ClassType*> (instance)->*getter)()); },
+                       [setter] (void* instance, const var& v) { (static_cast<ClassType*> (instance)->*setter) (NativeValue<std::decay_t<SetterArgumentType>>::fromVar (v)); } });
+        return *this;
+    }
+
+    //==============================================================================
+    /** Wraps an instance that the host keeps ownership of, and which must outlive any use the scripts make of it. */
+    var wrap (ClassType& instance)                      { return new BoundObject (this, &instance, false); }
+
+    /** Wraps an instance, which gets deleted once the scripts and the host have let go of the object. */
+    var wrap (std::unique_ptr<ClassType> instance)      { return new BoundObject (this, instance.release(), true); }
+
+    /** @returns the instance that a var wraps, or nullptr if it isn't an instance of this class. */
+    ClassType* getInstance (const var& v) const noexcept
+    {
+        if (auto* o = dynamic_cast<BoundObject*> (v.getDynamicObject()))
+            if (&o->getBoundClass() == this)
+                return static_cast<ClassType*> (o->getInstance());
+
+        return nullptr;
+    }
+
+private:
+    //==============================================================================
+    template<typename FunctionType, typename ReturnType, typename... ArgumentTypes>
+    struct MethodInvoker
+    {
+        var operator() (const var::NativeFunctionArgs& args) const
+        {
+            auto& instance = *static_cast<ClassType*> (getInstanceForCall (owner, className, name, args.thisObject));
+            constexpr auto numNeeded = (int) sizeof... (ArgumentTypes);
+
+            if (args.numArguments < numNeeded)
+                NativeBinding::throwArgumentCountError (name, numNeeded, args.numArguments);
+
+            return call (instance, args.arguments, std::index_sequence_for<ArgumentTypes...>(), std::is_void<ReturnType>());
+        }
+
+        template<size_t... indexes>
+        var call (ClassType& instance, const var* arguments, std::index_sequence<indexes...>, std::false_type) const
+        {
+            ignoreUnused (arguments);
+            return NativeValue<std::decay_t<ReturnType>>::toVar ((instance.*function) (NativeValue<std::decay_t<ArgumentTypes>>::fromVar (arguments[indexes])...));
+        }
+
+        template<size_t... indexes>
+        var call (ClassType& instance, const var* arguments, std::index_sequence<indexes...>, std::true_type) const
+        {
+            ignoreUnused (arguments);
+            (instance.*function) (NativeValue<std::decay_t<ArgumentTypes>>::fromVar (arguments[indexes])...);
+            return var::undefined();
+        }
+
+        // Only compared against, since a script can hang on to a method after the class has gone.
+        const BoundClass* owner;
+        Identifier className, name;
+        FunctionType function;
+    };
+
+    void destroyInstance (void* instance) const override
+    {
+        delete static_cast<ClassType*> (instance);
+    }
+
+    //==============================================================================
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ClassBinding)
+};
@@ -5,19 +5,12 @@
 #define SP_JS_IDENTIFY_CLASS(className) \
     static Identifier getClassName() { static const Identifier i (className); return i; }
 
-//==============================================================================
-inline bool isNumber (const String& s)
-{
-    CodeDocument cd;
-    cd.replaceAllContent (s);
-
-    CodeDocument::Iterator iter (cd);
-    return CppTokeniserFunctions::parseNumber (iter) != CPlusPlusCodeTokeniser::tokenType_error;
-}
-
 //==============================================================================
 /** A simple helper class to allow debugging and testing of
     copied and pasted Javascript code from official examples online.
+
+    The messages are handed to the engine's ConsoleLog, which writes them out on
+    a background thread, so logging doesn't hold the script up.
 */
 struct ConsoleClass final : public JavascriptClass
 {
@@ -25,19 +18,36 @@ struct ConsoleClass final : public JavascriptClass
     {
         setMethod ("log", logMethod);
         setMethod ("print", logMethod);
+        setMethod ("debug", [] (Args a) { return write (ConsoleLog::Level::debug, a); });
+        setMethod ("info",  [] (Args a) { return write (ConsoleLog::Level::info, a); });
+        setMethod ("warn",  [] (Args a) { return write (ConsoleLog::Level::warn, a); });
+        setMethod ("error", [] (Args a) { return write (ConsoleLog::Level::error, a); });
     }
 
     SP_JS_IDENTIFY_CLASS ("console")
 
-    static var logMethod (Args a)
+    static var logMethod (Args a)   { return write (ConsoleLog::Level::log, a); }
+
+    static var write (ConsoleLog::Level level, Args a)
     {
+        auto* root = RootObject::getCurrent();
+
+        if (root == nullptr)
+            return var::undefined();
+
+        auto& log = root->getConsoleLog();
+
+        // Checked before anything gets converted to text, so that filtered-out messages cost next to nothing.
+        if (! log.isEnabled (level))
+            return var::undefined();
+
         MemoryOutputStream mo (1024);
 
         for (int i = 0; i < a.numArguments; ++i)
-            mo << a.arguments[i].toString() << newLine;
+            mo << NumberConversion::toScriptString (a.arguments[i]) << newLine;
 
         const auto result = mo.toString();
-        Logger::writeToLog (result);
+        log.write (level, result);
         return result;
     }
 
@@ -232,6 +242,7 @@ struct ArrayClass final : public JavascriptClass
 
     static var concat (Args a)
     {
+        SP_JS_COUNT (arrayAllocations);
         Array<var> result;
 
         if (auto* sourceArray = getThisArray (a))
@@ -358,6 +369,7 @@ struct ArrayClass final : public JavascriptClass
 
     static var filter (Args a)
     {
+        SP_JS_COUNT (arrayAllocations);
         Array<var> resultArray;
 
         if (auto* array = getThisArray (a))
@@ -541,9 +553,11 @@ struct ArrayClass final : public JavascriptClass
 
         if (auto* array = getThisArray (a))
             for (const auto& v : *array)
-                strings.add (v.toString());
+                strings.add (NumberConversion::toScriptString (v));
 
-        return strings.joinIntoString (getString (a, 0));
+        auto result = strings.joinIntoString (getString (a, 0));
+        allocateScriptMemory (result);
+        return result;
     }
 
     static var pop (Args a)
@@ -564,6 +578,8 @@ struct ArrayClass final : public JavascriptClass
     {
         if (auto* array = getThisArray (a))
         {
+            allocateScriptMemory ((int64) sizeof (var) * a.numArguments);
+
             for (int i = 0; i < a.numArguments; ++i)
                 array->add (a.arguments[i]);
 
@@ -624,6 +640,9 @@ struct ArrayClass final : public JavascriptClass
 
             array->removeRange (start, num);
 
+            SP_JS_COUNT (arrayAllocations);
+            allocateScriptMemory (getAllocationSize (itemsRemoved) + (int64) sizeof (var) * jmax (0, a.numArguments - 2));
+
             for (int i = 2; i < a.numArguments; ++i)
                 array->insert (start++, get (a, i));
 
@@ -637,6 +656,392 @@ private:
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ArrayClass)
 };
 
+//==============================================================================
+/**
+    https://developer.mozilla.org/en-US/docs/Web/JavaScript/Reference/Global_Objects/RegExp
+*/
+struct RegExpClass final : public JavascriptClass
+{
+    RegExpClass()
+    {
+        #define REGEXP_CLASS_METHODS(X) \
+            X (compile) X (exec) X (test) X (toSource) X (toString)
+
+        REGEXP_CLASS_METHODS (SP_JS_CREATE_METHOD)
+
+        #undef REGEXP_CLASS_METHODS
+    }
+
+    /** Creates an instance, which finds its methods in the root's RegExp class rather than having copies of its own. */
+    explicit RegExpClass (RegexProgram::Ptr p) :
+        program (std::move (p))
+    {
+        updateProperties();
+    }
+
+    SP_JS_IDENTIFY_CLASS ("RegExp")
+
+    static Identifier getLastIndexId()                  { static const Identifier i ("lastIndex"); return i; }
+    static RegExpClass* getThisRegExp (Args a)          { return dynamic_cast<RegExpClass*> (a.thisObject.getDynamicObject()); }
+    static String getPatternArgument (Args a, int index) { return get (a, index).isUndefined() || get (a, index).isVoid() ? String() : getString (a, index); }
+
+    /** @returns the argument if it's a compiled RegExp object, or nullptr if it isn't one. */
+    static RegExpClass* getRegExpArgument (Args a, int index)
+    {
+        if (auto* r = dynamic_cast<RegExpClass*> (get (a, index).getDynamicObject()))
+            if (r->program != nullptr)
+                return r;
+
+        return nullptr;
+    }
+
+    static var compile (Args a)
+    {
+        if (auto* r = getThisRegExp (a))
+        {
+            r->program = getCachedRegex (getPatternArgument (a, 0), isString (a, 1) ? getString (a, 1) : String());
+            r->updateProperties();
+        }
+
+        return a.thisObject;
+    }
+
+    static var exec (Args a)
+    {
+        if (auto* r = getThisRegExp (a))
+        {
+            if (r->program != nullptr)
+            {
+                const auto& subject = r->getSubject (getString (a, 0));
+                std::vector<int> captures ((size_t) r->program->getNumGroups() * 2);
+
+                if (r->execute (subject, captures.data()))
+                    return createMatchResult (*r->program, subject, captures.data());
+            }
+        }
+
+        return var();
+    }
+
+    static var test (Args a)
+    {
+        if (auto* r = getThisRegExp (a))
+        {
+            if (r->program != nullptr)
+            {
+                const auto& subject = r->getSubject (getString (a, 0));
+                std::vector<int> captures ((size_t) r->program->getNumGroups() * 2);
+                return r->execute (subject, captures.data());
+            }
+        }
+
+        return false;
+    }
+
+    static var toSource (Args a)    { return toString (a); }
+
+    static var toString (Args a)
+    {
+        if (auto* r = getThisRegExp (a))
+            if (r->program != nullptr)
+                return "/" + r->program->source + "/" + r->program->flags;
+
+        return "/(?:)/";
+    }
+
+    /** new RegExp (pattern, flags), where the pattern can also be another RegExp. */
+    static RegExpClass* construct (const Array<var>& vars)
+    {
+        const var::NativeFunctionArgs args (var(), vars.begin(), vars.size());
+
+        if (auto* other = getRegExpArgument (args, 0))
+        {
+            if (! isString (args, 1))
+                return new RegExpClass (other->program);
+
+            return new RegExpClass (getCachedRegex (other->program->source, getString (args, 1)));
+        }
+
+        return new RegExpClass (getCachedRegex (getPatternArgument (args, 0), isString (args, 1) ? getString (args, 1) : String()));
+    }
+
+    bool areSameValue (const var& v) override { return v.getObject() == this; }
+
+    //==============================================================================
+    /** Runs the expression, starting from lastIndex if it's global or sticky, and keeps lastIndex up to date. */
+    bool execute (const RegexSubject& subject, int* captures)
+    {
+        const auto usesLastIndex = program->global || program->sticky;
+        const auto start = usesLastIndex ? static_cast<int> (getProperty (getLastIndexId())) : 0;
+
+        if (program->match (subject, start, program->sticky, captures))
+        {
+            if (usesLastIndex)
+                setProperty (getLastIndexId(), captures[1]);
+
+            return true;
+        }
+
+        if (usesLastIndex)
+            setProperty (getLastIndexId(), 0);
+
+        return false;
+    }
+
+    /** @returns an array holding the whole match followed by each group, with undefined for groups that didn't take part. */
+    static var createMatchArray (const RegexProgram& p, const RegexSubject& subject, const int* captures)
+    {
+        Array<var> result;
+        result.ensureStorageAllocated (p.getNumGroups());
+
+        for (int i = 0; i < p.getNumGroups(); ++i)
+            result.add (captures[i * 2] >= 0 ? var (subject.substring (captures[i * 2], captures[i * 2 + 1]))
+                                             : var::undefined());
+
+        allocateScriptMemory (result);
+        return var (std::move (result));
+    }
+
+    /** @returns the match array that exec() and match() give back, which also has the index
+        that the match starts at, and the input that it was found in.
+    */
+    static var createMatchResult (const RegexProgram& p, const RegexSubject& subject, const int* captures)
+    {
+        auto result = createMatchArray (p, subject, captures);
+
+        if (auto* root = RootObject::getCurrent())
+        {
+            static const Identifier indexId ("index"), inputId ("input");
+            root->setArrayProperty (result, indexId, captures[0]);
+            root->setArrayProperty (result, inputId, subject.text);
+        }
+
+        return result;
+    }
+
+    /** Collects every match in the subject, either as plain strings or as match arrays. */
+    static Array<var> findAll (const RegexProgram& p, const RegexSubject& subject, bool wholeMatchesOnly)
+    {
+        std::vector<int> captures ((size_t) p.getNumGroups() * 2);
+        Array<var> results;
+
+        for (int start = 0; p.match (subject, start, p.sticky, captures.data());)
+        {
+            results.add (wholeMatchesOnly ? var (subject.substring (captures[0], captures[1]))
+                                          : createMatchResult (p, subject, captures.data()));
+
+            start = captures[1] > captures[0] ? captures[1] : captures[1] + 1;
+        }
+
+        allocateScriptMemory (results);
+        return results;
+    }
+
+    /** Replaces the first match, or all of them for a global expression, with either a replacement
+        string (which can refer to the match with $&, $1, $<name> etc.) or the result of calling a function.
+    */
+    static String replace (const RegexProgram& p, const RegexSubject& subject, const var& replacement)
+    {
+        const auto replacementIsFunction = isFunction (replacement) || replacement.isMethod();
+        const auto replacementText = replacementIsFunction ? String() : replacement.toString();
+
+        std::vector<int> captures ((size_t) p.getNumGroups() * 2);
+        MemoryOutputStream out;
+        int lastEnd = 0;
+
+        for (int start = 0; p.match (subject, start, p.sticky, captures.data());)
+        {
+            out << subject.substring (lastEnd, captures[0]);
+
+            if (replacementIsFunction)
+            {
+                auto args = createMatchArray (p, subject, captures.data());
+                args.append (captures[0]);
+                args.append (subject.text);
+
+                out << callScriptFunction (replacement, { var(), args.getArray()->begin(), args.size() }).toString();
+            }
+            else
+            {
+                expandReplacement (out, replacementText, p, subject, captures.data());
+            }
+
+            lastEnd = captures[1];
+            start = captures[1] > captures[0] ? captures[1] : captures[1] + 1;
+
+            if (! p.global)
+                break;
+        }
+
+        out << subject.substring (lastEnd, subject.length());
+
+        auto result = out.toString();
+        allocateScriptMemory (result);
+        return result;
+    }
+
+    static void expandReplacement (MemoryOutputStream& out, const String& replacement,
+                                   const RegexProgram& p, const RegexSubject& subject, const int* captures)
+    {
+        auto getGroup = [&] (int group)
+        {
+            return captures[group * 2] >= 0 ? subject.substring (captures[group * 2], captures[group * 2 + 1]) : String();
+        };
+
+        for (auto t = replacement.getCharPointer(); ! t.isEmpty();)
+        {
+            const auto c = t.getAndAdvance();
+
+            if (c != '$' || t.isEmpty())
+            {
+                out.appendUTF8Char (c);
+                continue;
+            }
+
+            const auto n = *t;
+
+            if (n == '$')                   { out.appendUTF8Char ('$'); ++t; }
+            else if (n == '&')              { out << getGroup (0); ++t; }
+            else if (n == '`')              { out << subject.substring (0, captures[0]); ++t; }
+            else if (n == '\'')             { out << subject.substring (captures[1], subject.length()); ++t; }
+            else if (CharacterFunctions::isDigit (n))
+            {
+                const auto first = (int) (n - '0');
+                const auto second = t[1];
+
+                if (CharacterFunctions::isDigit (second) && first * 10 + (int) (second - '0') < p.getNumGroups())
+                {
+                    out << getGroup (first * 10 + (int) (second - '0'));
+                    t += 2;
+                }
+                else if (first > 0 && first < p.getNumGroups())
+                {
+                    out << getGroup (first);
+                    ++t;
+                }
+                else
+                {
+                    out.appendUTF8Char ('$');
+                }
+            }
+            else if (n == '<')
+            {
+                const auto end = CharacterFunctions::find (t, (juce_wchar) '>');
+                const auto group = end.isEmpty() ? -1 : p.getGroupNames().indexOf (String (t + 1, end));
+
+                if (group > 0)
+                {
+                    out << getGroup (group);
+                    t = end + 1;
+                }
+                else
+                {
+                    out.appendUTF8Char ('$');
+                }
+            }
+            else
+            {
+                out.appendUTF8Char ('$');
+            }
+        }
+    }
+
+    /** Splits the subject around the matches, including any captured groups in the results. */
+    static Array<var> split (const RegexProgram& p, const RegexSubject& subject, int limit)
+    {
+        std::vector<int> captures ((size_t) p.getNumGroups() * 2);
+        Array<var> results;
+        const auto size = subject.length();
+
+        if (limit == 0)
+            return results;
+
+        if (size == 0)
+        {
+            if (! p.match (subject, 0, true, captures.data()))
+                results.add (subject.text);
+
+            return results;
+        }
+
+        auto isFull = [&] { return limit > 0 && results.size() >= limit; };
+        int lastEnd = 0;
+
+        for (int start = 0; start < size && p.match (subject, start, false, captures.data());)
+        {
+            if (captures[0] >= size)
+                break;
+
+            // An empty match right where the last piece ended can't split anything.
+            if (captures[1] == lastEnd)
+            {
+                start = captures[0] + 1;
+                continue;
+            }
+
+            results.add (subject.substring (lastEnd, captures[0]));
+
+            for (int i = 1; i < p.getNumGroups() && ! isFull(); ++i)
+                results.add (captures[i * 2] >= 0 ? var (subject.substring (captures[i * 2], captures[i * 2 + 1]))
+                                                  : var::undefined());
+
+            if (isFull())
+                return results;
+
+            lastEnd = start = captures[1];
+        }
+
+        results.add (subject.substring (lastEnd, size));
+        allocateScriptMemory (results);
+        return results;
+    }
+
+    /** @returns the subject to match a string against, reusing the last one if it's the same string.
+
+        Walking through the matches of a global or sticky expression calls exec() or test()
+        again and again with the same string, which would otherwise be copied out to
+        code points every time. Holding on to the string keeps its buffer from being
+        reused or appended to in place, so comparing the buffers is enough.
+    */
+    const RegexSubject& getSubject (const String& s)
+    {
+        if (lastSubject == nullptr || lastSubject->text.getCharPointer() != s.getCharPointer())
+            lastSubject = std::make_unique<RegexSubject> (s);
+
+        return *lastSubject;
+    }
+
+    RegexProgram::Ptr program;
+
+private:
+    std::unique_ptr<RegexSubject> lastSubject;
+
+    void updateProperties()
+    {
+        if (program == nullptr)
+            return;
+
+        setProperty ("source",          program->source);
+        setProperty ("flags",           program->flags);
+        setProperty ("global",          program->global);
+        setProperty ("ignoreCase",      program->ignoreCase);
+        setProperty ("multiline",       program->multiline);
+        setProperty ("dotAll",          program->dotAll);
+        setProperty ("unicode",         program->unicode);
+        setProperty ("sticky",          program->sticky);
+        setProperty (getLastIndexId(),  0);
+    }
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (RegExpClass)
+};
+
+var RegexLiteral::getResult (const Scope&) const
+{
+    SP_JS_COUNT_NODE (RegexLiteral);
+
+    return new RegExpClass (program);
+}
+
 //==============================================================================
 /**
     https://developer.mozilla.org/en-US/docs/Web/JavaScript/Reference/Global_Objects/String
@@ -649,6 +1054,7 @@ struct StringClass final : public JavascriptClass
             X (charAt)      X (charCodeAt)      X (codePointAt)     X (concat) \
             X (endsWith)    X (fromCharCode)    X (fromCodePoint)   X (includes) \
             X (indexOf)     X (lastIndexOf)     X (localeCompare)   X (match) \
+            X (matchAll) \
             X (normalize)   X (padEnd)          X (padStart)        X (quote) \
             X (raw)         X (repeat)          X (replace)         X (search) \
             X (slice)       X (split)           X (startsWith)      X (substr) \
@@ -671,24 +1077,20 @@ struct StringClass final : public JavascriptClass
     static var padEnd (Args a)              { ignoreUnused (a); jassertfalse; return var(); } //TODO
     static var padStart (Args a)            { ignoreUnused (a); jassertfalse; return var(); } //TODO
     static var raw (Args a)                 { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var search (Args a)              { ignoreUnused (a); jassertfalse; return var(); } //TODO
     static var slice (Args a)               { ignoreUnused (a); jassertfalse; return var(); } //TODO
     static var substr (Args a)              { ignoreUnused (a); jassertfalse; return var(); } //TODO
     static var valueOf (Args a)             { ignoreUnused (a); jassertfalse; return var(); } //TODO
 
     static var charAt (Args a)              { int p = getInt (a, 0); return getThisString (a).substring (p, p + 1); }
     static var charCodeAt (Args a)          { return (int) getThisString (a)[getInt (a, 0)]; }
-    static var concat (Args a)              { return getThisString (a) + getString (a, 0); }
+    static var concat (Args a)              { auto s = getThisString (a) + getString (a, 0); allocateScriptMemory (s); return s; }
     static var endsWith (Args a)            { return getThisString (a).endsWith (getString (a, 0)); }
     static var fromCharCode (Args a)        { return String::charToString (static_cast<juce_wchar> (getInt (a, 0))); }
     static var includes (Args a)            { return getThisString (a).substring (getInt (a, 1)).contains (getString (a, 0)); }
     static var indexOf (Args a)             { return getThisString (a).indexOf (getString (a, 0)); }
     static var lastIndexOf (Args a)         { return getThisString (a).lastIndexOf (getString (a, 0)); }
     static var localeCompare (Args a)       { return getThisString (a).compare (getString (a, 0)); }
-    static var match (Args a)               { std::regex r (getString (a, 0).trim().toStdString()); return std::regex_match (getThisString (a).toStdString(), r); }
     static var quote (Args a)               { return getThisString (a).quoted(); }
-    static var repeat (Args a)              { return String::repeatedString (getString (a, 0), getInt (a, 1)); }
-    static var replace (Args a)             { return getThisString (a).replace (getString (a, 0), getString (a, 1)); }
     static var startsWith (Args a)          { return getThisString (a).startsWith (getString (a, 0)); }
     static var substring (Args a)           { return getThisString (a).substring (getInt (a, 0), getInt (a, 1)); }
     static var toLocaleLowerCase (Args a)   { return getThisString (a).toLowerCase(); }
@@ -700,8 +1102,98 @@ struct StringClass final : public JavascriptClass
     static var trimLeft (Args a)            { return getThisString (a).trimStart(); }
     static var trimRight (Args a)           { return getThisString (a).trimEnd(); }
 
+    static var repeat (Args a)
+    {
+        const auto s = getThisString (a);
+        auto count = getDouble (a, 0);
+
+        // Like JS, a NaN counts as zero and anything else is truncated, but this has to be
+        // checked before any of the casts below, which are undefined for a NaN or an infinity.
+        count = std::isnan (count) ? 0.0 : std::trunc (count);
+
+        if (! std::isfinite (count) || count < 0.0 || count > (double) std::numeric_limits<int>::max())
+            throw String ("RangeError: Invalid count value: ") + NumberConversion::toString (count);
+
+        if (s.isEmpty() || count < 1.0)
+            return String();
+
+        SP_JS_COUNT (stringAllocations);
+        allocateScriptMemory ((int64) sizeof (String) + (int64) s.getNumBytesAsUTF8() * (int64) count);
+
+        return String::repeatedString (s, (int) count);
+    }
+
+    //==============================================================================
+    /** @returns the RegExp argument's expression, or compiles the argument as a pattern. */
+    static RegexProgram::Ptr getRegex (Args a, int index, const String& flags = {})
+    {
+        if (auto* r = RegExpClass::getRegExpArgument (a, index))
+            return r->program;
+
+        return getCachedRegex (RegExpClass::getPatternArgument (a, index), flags);
+    }
+
+    static var match (Args a)
+    {
+        const RegexSubject subject (getThisString (a));
+        auto* regExp = RegExpClass::getRegExpArgument (a, 0);
+        const auto program = getRegex (a, 0);
+
+        if (program->global)
+        {
+            if (regExp != nullptr)
+                regExp->setProperty (RegExpClass::getLastIndexId(), 0);
+
+            auto matches = RegExpClass::findAll (*program, subject, true);
+            return matches.isEmpty() ? var() : var (std::move (matches));
+        }
+
+        std::vector<int> captures ((size_t) program->getNumGroups() * 2);
+
+        const auto found = regExp != nullptr ? regExp->execute (subject, captures.data())
+                                             : program->match (subject, 0, false, captures.data());
+
+        return found ? RegExpClass::createMatchResult (*program, subject, captures.data()) : var();
+    }
+
+    static var matchAll (Args a)
+    {
+        const auto program = getRegex (a, 0, "g");
+
+        if (! program->global)
+            throw String ("String.prototype.matchAll called with a non-global RegExp argument");
+
+        return RegExpClass::findAll (*program, RegexSubject (getThisString (a)), false);
+    }
+
+    static var replace (Args a)
+    {
+        if (auto* regExp = RegExpClass::getRegExpArgument (a, 0))
+        {
+            if (regExp->program->global)
+                regExp->setProperty (RegExpClass::getLastIndexId(), 0);
+
+            return RegExpClass::replace (*regExp->program, RegexSubject (getThisString (a)), get (a, 1));
+        }
+
+        return getThisString (a).replace (getString (a, 0), getString (a, 1));
+    }
+
+    static var search (Args a)
+    {
+        const auto program = getRegex (a, 0);
+        const RegexSubject subject (getThisString (a));
+        std::vector<int> captures ((size_t) program->getNumGroups() * 2);
+
+        return program->match (subject, 0, program->sticky, captures.data()) ? captures[0] : -1;
+    }
+
     static var split (Args a)
     {
+        if (auto* regExp = RegExpClass::getRegExpArgument (a, 0))
+            return RegExpClass::split (*regExp->program, RegexSubject (getThisString (a)),
+                                       a.numArguments > 1 && ! get (a, 1).isUndefined() ? getInt (a, 1) : -1);
+
         auto str = a.thisObject.toString();
         auto sep = getString (a, 0);
         StringArray strings;
@@ -712,6 +1204,9 @@ struct StringClass final : public JavascriptClass
             for (auto pos = str.getCharPointer(); ! pos.isEmpty(); ++pos)
                 strings.add (String::charToString (*pos));
 
+        SP_JS_COUNT (arrayAllocations);
+        allocateScriptMemory ((int64) sizeof (var) * strings.size());
+
         var array;
 
         for (const auto& s : strings)
@@ -730,97 +1225,222 @@ private:
 */
 struct DateClass final : public JavascriptClass
 {
-    DateClass (const Time& v = Time::getCurrentTime()) :
-        value (v)
+    DateClass()
     {
         #define DATE_CLASS_METHODS(X) \
-            X (UTC) X (now) X (parse)
+            X (UTC) X (now) X (parse) \
+            X (getDate) X (getDay) X (getFullYear) X (getHours) X (getMilliseconds) X (getMinutes) \
+            X (getMonth) X (getSeconds) X (getTime) X (getTimezoneOffset) X (getYear) \
+            X (getUTCDate) X (getUTCDay) X (getUTCFullYear) X (getUTCHours) X (getUTCMilliseconds) \
+            X (getUTCMinutes) X (getUTCMonth) X (getUTCSeconds) \
+            X (setDate) X (setFullYear) X (setHours) X (setMilliseconds) X (setMinutes) \
+            X (setMonth) X (setSeconds) X (setTime) X (setYear) \
+            X (setUTCDate) X (setUTCFullYear) X (setUTCHours) X (setUTCMilliseconds) \
+            X (setUTCMinutes) X (setUTCMonth) X (setUTCSeconds) \
+            X (toDateString) X (toGMTString) X (toISOString) X (toJSON) X (toLocaleDateString) \
+            X (toLocaleFormat) X (toLocaleString) X (toLocaleTimeString) X (toSource) \
+            X (toString) X (toTimeString) X (toUTCString) X (valueOf)
 
         DATE_CLASS_METHODS (SP_JS_CREATE_METHOD)
 
         #undef DATE_CLASS_METHODS
+
+        //NB: This is non-standard.
+        setMethod ("parseAll", parseAll);
     }
 
-    SP_JS_IDENTIFY_CLASS ("Date")
+    /** Creates a Date instance. Instances don't carry any methods of their own:
+        Scope::findFunctionCall() looks them up in the root Date class instead.
+    */
+    explicit DateClass (double millisecondsSinceEpoch) :
+        value (timeClip (millisecondsSinceEpoch))
+    {
+    }
 
-    //statics...
-    static var UTC (Args)                   { return Time::getCurrentTime().toMilliseconds(); }
-    static var now (Args a)                 { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var parse (Args a)               { return Time::fromISO8601 (getString (a, 0)).toMilliseconds(); }
-
-    //methods...
-    static var getDate (Args a)             { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var getFullYear (Args a)         { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var getHours (Args a)            { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var getMilliseconds (Args a)     { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var getMinutes (Args a)          { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var getMonth (Args a)            { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var getSeconds (Args a)          { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var getTime (Args a)             { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var getTimezoneOffset (Args a)   { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var getUTCDate (Args a)          { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var getUTCDay (Args a)           { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var getUTCFullYear (Args a)      { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var getUTCHours (Args a)         { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var getUTCMilliseconds (Args a)  { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var getUTCMinutes (Args a)       { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var getUTCMonth (Args a)         { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var getUTCSeconds (Args a)       { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var getYear (Args a)             { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var setDate (Args a)             { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var setFullYear (Args a)         { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var setHours (Args a)            { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var setMilliseconds (Args a)     { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var setMinutes (Args a)          { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var setMonth (Args a)            { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var setSeconds (Args a)          { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var setTime (Args a)             { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var setUTCDate (Args a)          { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var setUTCFullYear (Args a)      { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var setUTCHours (Args a)         { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var setUTCMilliseconds (Args a)  { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var setUTCMinutes (Args a)       { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var setUTCMonth (Args a)         { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var setUTCSeconds (Args a)       { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var setYear (Args a)             { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var toDateString (Args a)        { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var toGMTString (Args a)         { ignoreUnused (a); jassertfalse; return var(); } //TODO
-
-    static var toISOString (Args a)         { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var toJSON (Args a)              { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var toLocaleDateString (Args a)  { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var toLocaleFormat (Args a)      { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var toLocaleString (Args a)      { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var toLocaleTimeString (Args a)  { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var toSource (Args a)            { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var toString (Args a)            { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var toTimeString (Args a)        { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var toUTCString (Args a)         { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var valueOf (Args a)             { ignoreUnused (a); jassertfalse; return var(); } //TODO
+    SP_JS_IDENTIFY_CLASS ("Date")
 
-    static DateClass* construct (const Array<var>& vars)
+    //==============================================================================
+    static var UTC (Args a)
     {
-        if (vars.size() == 1)
-        {
-            const auto& v = vars.getReference (0);
+        if (a.numArguments == 0)
+            return std::numeric_limits<double>::quiet_NaN();
 
-            if (v.isString())
-            {
-                const auto s = v.toString();
-                Time t;
+        double fields[] = { 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 0.0 };
 
-                if (RFC2422TimeParser::parseString (t, s).wasOk()
-                    || ISO8601TimeParser::parseString (t, s).wasOk())
-                    return new DateClass (t);
-            }
+        for (int i = 0; i < numElementsInArray (fields) && i < a.numArguments; ++i)
+            fields[i] = getDouble (a, i);
 
-            return nullptr;
-        }
-        else if (vars.size() > 1)
+        return timeClip (makeDate (makeDay (toFullYear (fields[0]), fields[1], fields[2]),
+                                   makeTime (fields[3], fields[4], fields[5], fields[6])));
+    }
+
+    static var now (Args)                   { return (double) Time::currentTimeMillis(); }
+    static var parse (Args a)               { return parseDateString (getString (a, 0)); }
+
+    /** Date.parseAll (strings)
+
+        Parses a whole array of timestamps in one go, giving back an array
+        of their times in milliseconds, with NaN for any that couldn't be parsed.
+    */
+    static var parseAll (Args a)
+    {
+        const auto* source = get (a, 0).getArray();
+
+        if (source == nullptr)
+            throw String ("Date.parseAll needs an array of strings");
+
+        StringArray timeStrings;
+        timeStrings.ensureStorageAllocated (source->size());
+
+        for (const auto& v : *source)
+            timeStrings.add (v.isString() ? v.toString() : String());
+
+        Array<double> times;
+        ISO8601TimeParser::parseStrings (timeStrings, times);
+
+        SP_JS_COUNT (arrayAllocations);
+        allocateScriptMemory ((int64) sizeof (var) * times.size());
+
+        Array<var> results;
+        results.ensureStorageAllocated (times.size());
+
+        for (auto t : times)
+            results.add (t);
+
+        return var (std::move (results));
+    }
+
+    //==============================================================================
+    static var getDate (Args a)             { return getField (a, true, &Fields::date); }
+    static var getDay (Args a)              { return getField (a, true, &Fields::weekDay); }
+    static var getFullYear (Args a)         { return getField (a, true, &Fields::year); }
+    static var getHours (Args a)            { return getField (a, true, &Fields::hours); }
+    static var getMilliseconds (Args a)     { return getField (a, true, &Fields::milliseconds); }
+    static var getMinutes (Args a)          { return getField (a, true, &Fields::minutes); }
+    static var getMonth (Args a)            { return getField (a, true, &Fields::month); }
+    static var getSeconds (Args a)          { return getField (a, true, &Fields::seconds); }
+    static var getUTCDate (Args a)          { return getField (a, false, &Fields::date); }
+    static var getUTCDay (Args a)           { return getField (a, false, &Fields::weekDay); }
+    static var getUTCFullYear (Args a)      { return getField (a, false, &Fields::year); }
+    static var getUTCHours (Args a)         { return getField (a, false, &Fields::hours); }
+    static var getUTCMilliseconds (Args a)  { return getField (a, false, &Fields::milliseconds); }
+    static var getUTCMinutes (Args a)       { return getField (a, false, &Fields::minutes); }
+    static var getUTCMonth (Args a)         { return getField (a, false, &Fields::month); }
+    static var getUTCSeconds (Args a)       { return getField (a, false, &Fields::seconds); }
+    static var getTime (Args a)             { return getThisDate (a).value; }
+    static var valueOf (Args a)             { return getThisDate (a).value; }
+
+    static var getYear (Args a)
+    {
+        const auto year = getField (a, true, &Fields::year);
+        return year.isInt() ? var (static_cast<int> (year) - 1900) : year;
+    }
+
+    static var getTimezoneOffset (Args a)
+    {
+        const auto t = getThisDate (a).value;
+
+        if (std::isnan (t))
+            return t;
+
+        return NumberConversion::toVar ((t - toLocalTime (t)) / 60000.0);
+    }
+
+    //==============================================================================
+    static var setDate (Args a)             { return setFields (a, true, dateField, 1); }
+    static var setFullYear (Args a)         { return setFields (a, true, yearField, 3); }
+    static var setHours (Args a)            { return setFields (a, true, hoursField, 4); }
+    static var setMilliseconds (Args a)     { return setFields (a, true, millisecondsField, 1); }
+    static var setMinutes (Args a)          { return setFields (a, true, minutesField, 3); }
+    static var setMonth (Args a)            { return setFields (a, true, monthField, 2); }
+    static var setSeconds (Args a)          { return setFields (a, true, secondsField, 2); }
+    static var setUTCDate (Args a)          { return setFields (a, false, dateField, 1); }
+    static var setUTCFullYear (Args a)      { return setFields (a, false, yearField, 3); }
+    static var setUTCHours (Args a)         { return setFields (a, false, hoursField, 4); }
+    static var setUTCMilliseconds (Args a)  { return setFields (a, false, millisecondsField, 1); }
+    static var setUTCMinutes (Args a)       { return setFields (a, false, minutesField, 3); }
+    static var setUTCMonth (Args a)         { return setFields (a, false, monthField, 2); }
+    static var setUTCSeconds (Args a)       { return setFields (a, false, secondsField, 2); }
+
+    static var setTime (Args a)
+    {
+        auto& d = getThisDate (a);
+        d.value = timeClip (a.numArguments > 0 ? getDouble (a, 0) : std::numeric_limits<double>::quiet_NaN());
+        return d.value;
+    }
+
+    static var setYear (Args a)
+    {
+        const var yearArg (toFullYear (a.numArguments > 0 ? getDouble (a, 0) : std::numeric_limits<double>::quiet_NaN()));
+        return setFields (var::NativeFunctionArgs (a.thisObject, &yearArg, 1), true, yearField, 1);
+    }
+
+    //==============================================================================
+    static var toISOString (Args a)
+    {
+        const auto t = getThisDate (a).value;
+
+        if (std::isnan (t))
+            throw String ("Invalid time value");
+
+        return ISO8601TimeParser::toString ((int64) t);
+    }
+
+    static var toJSON (Args a)
+    {
+        const auto t = getThisDate (a).value;
+        return std::isnan (t) ? var() : var (ISO8601TimeParser::toString ((int64) t));
+    }
+
+    static var toString (Args a)            { return formatDate (a, [] (double t) { return getDateString (t) + " " + getTimeString (t); }); }
+    static var toDateString (Args a)        { return formatDate (a, getDateString); }
+    static var toTimeString (Args a)        { return formatDate (a, getTimeString); }
+    static var toUTCString (Args a)         { return formatDate (a, getUTCString); }
+    static var toGMTString (Args a)         { return formatDate (a, getUTCString); }
+    static var toLocaleString (Args a)      { return formatDate (a, [] (double t) { return getLocaleDateString (t) + ", " + getLocaleTimeString (t); }); }
+    static var toLocaleDateString (Args a)  { return formatDate (a, getLocaleDateString); }
+    static var toLocaleTimeString (Args a)  { return formatDate (a, getLocaleTimeString); }
+    static var toSource (Args a)            { return "(new Date(" + NumberConversion::toString (getThisDate (a).value) + "))"; }
+
+    static var toLocaleFormat (Args a)
+    {
+        return formatDate (a, [&a] (double t) { return Time ((int64) t).formatted (getString (a, 0)); });
+    }
+
+    //==============================================================================
+    void writeAsJSON (OutputStream& out, int, bool, int) override
+    {
+        if (std::isnan (value))
+            out << "null";
+        else
+            out << '"' << ISO8601TimeParser::toString ((int64) value) << '"';
+    }
+
+    static DateClass* construct (const Array<var>& vars)
+    {
+        if (vars.isEmpty())
+            return new DateClass ((double) Time::currentTimeMillis());
+
+        if (vars.size() == 1)
         {
+            const auto& v = vars.getReference (0);
+
+            if (auto* other = dynamic_cast<DateClass*> (v.getDynamicObject()))
+                return new DateClass (other->value);
+
+            if (v.isString())
+                return new DateClass (parseDateString (v.toString()));
+
+            return new DateClass (static_cast<double> (v));
         }
 
-        return new DateClass();
+        double fields[] = { 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 0.0 };
+
+        for (int i = 0; i < numElementsInArray (fields) && i < vars.size(); ++i)
+            fields[i] = static_cast<double> (vars.getReference (i));
+
+        return new DateClass (toUTC (makeDate (makeDay (toFullYear (fields[0]), fields[1], fields[2]),
+                                               makeTime (fields[3], fields[4], fields[5], fields[6]))));
     }
 
     bool areSameValue (const var& v) override
@@ -832,7 +1452,252 @@ struct DateClass final : public JavascriptClass
     }
 
 private:
-    Time value { Time::getCurrentTime() };
+    //==============================================================================
+    double value = std::numeric_limits<double>::quiet_NaN();
+
+    static constexpr double msPerDay = 86400000.0;
+    static constexpr double maxTimeValue = 8.64e15;
+
+    enum
+    {
+        yearField = 0,
+        monthField,
+        dateField,
+        hoursField,
+        minutesField,
+        secondsField,
+        millisecondsField,
+        numFields
+    };
+
+    /** The calendar fields of a time value, with the month going from 0 to 11 like JS does. */
+    struct Fields
+    {
+        int year = 1970, month = 0, date = 1,
+            hours = 0, minutes = 0, seconds = 0, milliseconds = 0,
+            weekDay = 4;
+    };
+
+    //==============================================================================
+    static DateClass& getThisDate (Args a)
+    {
+        if (auto* d = dynamic_cast<DateClass*> (a.thisObject.getDynamicObject()))
+            return *d;
+
+        throw String ("this is not a Date object.");
+    }
+
+    static double timeClip (double t) noexcept
+    {
+        if (! std::isfinite (t) || std::abs (t) > maxTimeValue)
+            return std::numeric_limits<double>::quiet_NaN();
+
+        return std::trunc (t) + 0.0;
+    }
+
+    static double toLocalTime (double t)
+    {
+        return t + (double) LocalTimeOffsetCache::getInstance().getOffset ((int64) t);
+    }
+
+    static double toUTC (double localTime)
+    {
+        if (! std::isfinite (localTime) || std::abs (localTime) > maxTimeValue + msPerDay)
+            return std::numeric_limits<double>::quiet_NaN();
+
+        return (double) LocalTimeOffsetCache::getInstance().toUTC ((int64) localTime);
+    }
+
+    /** Two digit years are taken to be in the 1900s, as the Date constructor and Date.UTC() do. */
+    static double toFullYear (double year) noexcept
+    {
+        if (std::isfinite (year) && std::trunc (year) >= 0.0 && std::trunc (year) <= 99.0)
+            return 1900.0 + std::trunc (year);
+
+        return year;
+    }
+
+    static double makeTime (double hours, double minutes, double seconds, double milliseconds) noexcept
+    {
+        if (! (std::isfinite (hours) && std::isfinite (minutes) && std::isfinite (seconds) && std::isfinite (milliseconds)))
+            return std::numeric_limits<double>::quiet_NaN();
+
+        return std::trunc (hours) * 3600000.0 + std::trunc (minutes) * 60000.0
+             + std::trunc (seconds) * 1000.0 + std::trunc (milliseconds);
+    }
+
+    static double makeDay (double year, double month, double date) noexcept
+    {
+        if (! (std::isfinite (year) && std::isfinite (month) && std::isfinite (date)))
+            return std::numeric_limits<double>::quiet_NaN();
+
+        year = std::trunc (year) + std::floor (std::trunc (month) / 12.0);
+        month = std::fmod (std::trunc (month), 12.0);
+
+        if (month < 0.0)
+            month += 12.0;
+
+        // Anything further out than this can't make a valid time value.
+        if (std::abs (year) > 400000.0)
+            return std::numeric_limits<double>::quiet_NaN();
+
+        return (double) daysFromCivil ((int64) year, (int) month + 1, 1) + std::trunc (date) - 1.0;
+    }
+
+    static double makeDate (double day, double time) noexcept
+    {
+        return day * msPerDay + time;
+    }
+
+    static Fields getFields (double t) noexcept
+    {
+        const auto ms = (int64) t;
+        const auto days = floorDivide (ms, 86400000);
+        const auto msInDay = (int) (ms - days * 86400000);
+
+        Fields f;
+        civilFromDays (days, f.year, f.month, f.date);
+        f.month -= 1;
+        f.hours = msInDay / 3600000;
+        f.minutes = (msInDay / 60000) % 60;
+        f.seconds = (msInDay / 1000) % 60;
+        f.milliseconds = msInDay % 1000;
+        f.weekDay = (int) ((days + 4) - floorDivide (days + 4, 7) * 7); // 1970-01-01 was a Thursday
+        return f;
+    }
+
+    static var getField (Args a, bool isLocal, int Fields::* field)
+    {
+        const auto t = getThisDate (a).value;
+
+        if (std::isnan (t))
+            return t;
+
+        return getFields (isLocal ? toLocalTime (t) : t).*field;
+    }
+
+    /** Replaces up to maxNumFields consecutive calendar fields, starting at firstField,
+        with the arguments passed in, the way the Date setters do.
+    */
+    static var setFields (Args a, bool isLocal, int firstField, int maxNumFields)
+    {
+        auto& d = getThisDate (a);
+        auto t = d.value;
+
+        if (std::isnan (t))
+        {
+            // Only setting the year can bring an invalid date back to life.
+            if (firstField != yearField)
+                return t;
+
+            t = 0.0;
+        }
+        else if (isLocal)
+        {
+            t = toLocalTime (t);
+        }
+
+        if (a.numArguments == 0)
+        {
+            d.value = std::numeric_limits<double>::quiet_NaN();
+            return d.value;
+        }
+
+        const auto f = getFields (t);
+        double fields[numFields] = { (double) f.year, (double) f.month, (double) f.date,
+                                     (double) f.hours, (double) f.minutes, (double) f.seconds,
+                                     (double) f.milliseconds };
+
+        for (int i = 0; i < maxNumFields && i < a.numArguments; ++i)
+            fields[firstField + i] = getDouble (a, i);
+
+        t = makeDate (makeDay (fields[yearField], fields[monthField], fields[dateField]),
+                      makeTime (fields[hoursField], fields[minutesField], fields[secondsField], fields[millisecondsField]));
+
+        d.value = timeClip (isLocal ? toUTC (t) : t);
+        return d.value;
+    }
+
+    static double parseDateString (const String& s)
+    {
+        int64 ms = 0;
+
+        if (ISO8601TimeParser::parseString (ms, s).wasOk()
+            || RFC2422TimeParser::parseString (ms, s).wasOk())
+            return (double) ms;
+
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+
+    //==============================================================================
+    template<typename FormatterType>
+    static String formatDate (Args a, FormatterType&& formatter)
+    {
+        const auto t = getThisDate (a).value;
+        return std::isnan (t) ? String ("Invalid Date") : formatter (t);
+    }
+
+    static String getYearString (int year)
+    {
+        return (year < 0 ? "-" : "") + String (std::abs (year)).paddedLeft ('0', 4);
+    }
+
+    static String getClockString (const Fields& f)
+    {
+        return String (f.hours).paddedLeft ('0', 2)
+             + ":" + String (f.minutes).paddedLeft ('0', 2)
+             + ":" + String (f.seconds).paddedLeft ('0', 2);
+    }
+
+    /** eg: Tue Oct 20 2026 */
+    static String getDateString (double t)
+    {
+        const auto f = getFields (toLocalTime (t));
+
+        return String (shortDayNames[f.weekDay]) + " " + shortMonthNames[f.month]
+             + " " + String (f.date).paddedLeft ('0', 2) + " " + getYearString (f.year);
+    }
+
+    /** eg: 14:03:00 GMT+0200 */
+    static String getTimeString (double t)
+    {
+        const auto local = toLocalTime (t);
+        const auto offsetMinutes = (int) ((local - t) / 60000.0);
+
+        return getClockString (getFields (local))
+             + " GMT" + (offsetMinutes < 0 ? "-" : "+")
+             + String (std::abs (offsetMinutes) / 60).paddedLeft ('0', 2)
+             + String (std::abs (offsetMinutes) % 60).paddedLeft ('0', 2);
+    }
+
+    /** eg: Tue, 20 Oct 2026 12:03:00 GMT */
+    static String getUTCString (double t)
+    {
+        const auto f = getFields (t);
+
+        return String (shortDayNames[f.weekDay]) + ", " + String (f.date).paddedLeft ('0', 2)
+             + " " + shortMonthNames[f.month] + " " + getYearString (f.year)
+             + " " + getClockString (f) + " GMT";
+    }
+
+    /** eg: 10/20/2026 */
+    static String getLocaleDateString (double t)
+    {
+        const auto f = getFields (toLocalTime (t));
+        return String (f.month + 1) + "/" + String (f.date) + "/" + String (f.year);
+    }
+
+    /** eg: 2:03:00 PM */
+    static String getLocaleTimeString (double t)
+    {
+        const auto f = getFields (toLocalTime (t));
+        const auto hours = f.hours % 12 == 0 ? 12 : f.hours % 12;
+
+        return String (hours)
+             + ":" + String (f.minutes).paddedLeft ('0', 2)
+             + ":" + String (f.seconds).paddedLeft ('0', 2)
+             + (f.hours < 12 ? " AM" : " PM");
+    }
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (DateClass)
 };
@@ -1013,12 +1878,130 @@ struct JSONClass final : public JavascriptClass
     {
         setMethod ("parse", parse);
         setMethod ("stringify", stringify);
+
+        //NB: This is non-standard.
+        setMethod ("parseStream", parseStream);
     }
 
     SP_JS_IDENTIFY_CLASS ("JSON")
 
-    static var parse (Args a)       { return JSON::parse (get (a, 0)); }
-    static var stringify (Args a)   { return JSON::toString (get (a, 0)); }
+    static var parse (Args a)
+    {
+        const auto text = getString (a, 0);
+        auto result = ScriptJSONParser (text.toRawUTF8(), text.getNumBytesAsUTF8()).parseDocument();
+
+        const auto reviver = get (a, 1);
+
+        if (isFunction (reviver) || reviver.isMethod())
+            return revive (reviver, var (new ScriptObject()), String(), result);
+
+        return result;
+    }
+
+    static var stringify (Args a)
+    {
+        MemoryOutputStream out (1024);
+        ScriptJSONWriter writer (out, getIndent (get (a, 2)));
+        setReplacer (writer, get (a, 1));
+
+        if (! writer.write (get (a, 0)))
+            return var::undefined();
+
+        const auto result = out.toUTF8();
+        allocateScriptMemory (result);
+        return result;
+    }
+
+    /** JSON.parseStream (source, callback)
+
+        Parses either a top-level array or a sequence of whitespace separated values
+        (eg: newline-delimited JSON), calling callback (record, index) with each one
+        as soon as it's been read, rather than building the whole lot up in memory.
+        The callback can return false to stop early.
+
+        @returns the number of records that were handed to the callback.
+    */
+    static var parseStream (Args a)
+    {
+        const auto source = getString (a, 0);
+        const auto callback = get (a, 1);
+
+        if (! (isFunction (callback) || callback.isMethod()))
+            throw String ("JSON.parseStream needs a callback function");
+
+        MemoryInputStream input (source.toRawUTF8(), source.getNumBytesAsUTF8(), false);
+        JSONRecordReader reader (input);
+        var record;
+
+        while (reader.readNext (record))
+        {
+            const var args[] = { record, reader.getNumRecordsRead() - 1 };
+            record = var();
+
+            const auto result = callScriptFunction (callback, var::NativeFunctionArgs (var(), args, 2));
+
+            if (result.isBool() && ! static_cast<bool> (result))
+                break;
+        }
+
+        return reader.getNumRecordsRead();
+    }
+
+    /** Works out the indentation text from the space argument of JSON.stringify(). */
+    static String getIndent (const var& space)
+    {
+        if (isNumeric (space))
+            return String::repeatedString (" ", jlimit (0, 10, static_cast<int> (space)));
+
+        if (space.isString())
+            return space.toString().substring (0, 10);
+
+        return {};
+    }
+
+    static void setReplacer (ScriptJSONWriter& writer, const var& replacer)
+    {
+        if (isFunction (replacer) || replacer.isMethod())
+        {
+            writer.replacer = replacer;
+        }
+        else if (auto* names = replacer.getArray())
+        {
+            for (const auto& name : *names)
+                if ((name.isString() || isNumeric (name)) && name.toString().isNotEmpty())
+                    writer.propertyList.addIfNotAlreadyThere (name.toString());
+        }
+    }
+
+    /** Passes every value of a freshly parsed document through the reviver, from the inside out. */
+    static var revive (const var& reviver, const var& holder, const var& key, const var& value)
+    {
+        if (auto* array = value.getArray())
+        {
+            for (int i = 0; i < array->size(); ++i)
+                array->set (i, revive (reviver, value, i, array->getUnchecked (i)));
+        }
+        else if (auto* o = value.getDynamicObject())
+        {
+            Array<Identifier> names;
+
+            for (const auto& property : o->getProperties())
+                names.add (property.name);
+
+            for (const auto& name : names)
+            {
+                const auto newValue = revive (reviver, value, name.toString(), o->getProperty (name));
+
+                if (newValue.isUndefined())
+                    o->removeProperty (name);
+                else
+                    o->setProperty (name, newValue);
+            }
+        }
+
+        const var args[] = { key.toString(), value };
+        return callScriptFunction (reviver, var::NativeFunctionArgs (holder, args, 2));
+    }
 
 private:
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (JSONClass)
@@ -1046,7 +2029,6 @@ struct SymbolClass final : public JavascriptClass
     static var match (Args a)               { ignoreUnused (a); jassertfalse; return var(); } //TODO
     static var matchAll (Args a)            { ignoreUnused (a); jassertfalse; return var(); } //TODO
     static var replace (Args a)             { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var search (Args a)              { ignoreUnused (a); jassertfalse; return var(); } //TODO
     static var split (Args a)               { ignoreUnused (a); jassertfalse; return var(); } //TODO
     static var species (Args a)             { ignoreUnused (a); jassertfalse; return var(); } //TODO
     static var toPrimitive (Args a)         { ignoreUnused (a); jassertfalse; return var(); } //TODO
@@ -1057,28 +2039,6 @@ private:
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SymbolClass)
 };
 
-//==============================================================================
-/**
-    https://developer.mozilla.org/en-US/docs/Web/JavaScript/Reference/Global_Objects/RegExp
-*/
-struct RegExpClass final : public JavascriptClass
-{
-    RegExpClass()
-    {
-    }
-
-    SP_JS_IDENTIFY_CLASS ("RegExp")
-
-    static var compile (Args a)     { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var exec (Args a)        { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var test (Args a)        { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var toSource (Args a)    { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var toString (Args a)    { ignoreUnused (a); jassertfalse; return var(); } //TODO
-
-private:
-    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (RegExpClass)
-};
-
 //==============================================================================
 /**
     https://developer.mozilla.org/en-US/docs/Web/JavaScript/Guide/Numbers_and_dates
@@ -1112,24 +2072,40 @@ struct NumberClass final : public JavascriptClass
         setProperty ("MIN_VALUE",           std::numeric_limits<double>::min());
         setProperty ("MAX_VALUE",           std::numeric_limits<double>::max());
 
-        setMethod ("toString",             [&] (Args) { return var (value).toString(); });
+        setMethod ("toString",              toString);
+        setMethod ("toFixed",               toFixed);
+        setMethod ("valueOf",               valueOf);
     }
 
     SP_JS_IDENTIFY_CLASS ("Number")
 
-    static var parseInt (Args a)
+    static var parseInt (Args a)        { return NumberConversion::toVar (NumberConversion::parseInt (getString (a, 0), getInt (a, 1))); }
+    static var parseFloat (Args a)      { return NumberConversion::toVar (NumberConversion::parseFloat (getString (a, 0))); }
+    static var valueOf (Args a)         { return NumberConversion::toVar (getThisNumber (a)); }
+    static var toFixed (Args a)         { return NumberConversion::toFixed (getThisNumber (a), getInt (a, 0)); }
+
+    static var toString (Args a)
     {
-        auto s = getString (a, 0).trim();
+        const auto radix = a.numArguments > 0 ? getInt (a, 0) : 10;
 
-        return s[0] == '0' ? (s[1] == 'x' ? s.substring (2).getHexValue64() : getOctalValue (s))
-                           : s.getLargeIntValue();
+        if (radix < 2 || radix > 36)
+            throw String ("toString() radix must be between 2 and 36");
+
+        return NumberConversion::toString (getThisNumber (a), radix);
     }
 
-    static var parseFloat (Args a)      { return getDouble (a, 0); }
+    /** Numbers get their methods looked up here too, so this can either be a number or a Number object. */
+    static double getThisNumber (Args a)
+    {
+        if (auto* nc = dynamic_cast<NumberClass*> (a.thisObject.getObject()))
+            return nc->value;
+
+        return static_cast<double> (a.thisObject);
+    }
     static var isNaN (Args a)           { return std::isnan (getDouble (a, 0)); }
     static var isFinite (Args a)        { return std::isfinite (getDouble (a, 0)); }
 
-    void writeAsJSON (OutputStream& out, int, bool, int) override { out << value; }
+    void writeAsJSON (OutputStream& out, int, bool, int) override { out << NumberConversion::toString (value); }
 
     static NumberClass* construct (const Array<var>& vars)
     {
@@ -1139,14 +2115,7 @@ struct NumberClass final : public JavascriptClass
         {
             const auto& v = vars.getReference (0);
 
-            if (v.isString())
-            {
-                const auto s = v.toString();
-                if (isNumber (s))
-                    nc->value = s.getDoubleValue();
-                else
-                    nc->value = std::numeric_limits<double>::quiet_NaN();
-            }
+            if (v.isString())       { nc->value = NumberConversion::stringToNumber (v.toString()); }
             else if (v.isInt())     { nc->value = (double) static_cast<int> (v); }
             else if (v.isInt64())   { nc->value = (double) static_cast<int64> (v); }
             else if (v.isDouble())  { nc->value = static_cast<double> (v); }
@@ -1161,14 +2130,7 @@ struct NumberClass final : public JavascriptClass
         if (v.isInt())          { return value == (double) static_cast<int> (v); }
         else if (v.isInt64())   { return value == (double) static_cast<int64> (v); }
         else if (v.isDouble())  { return value == static_cast<double> (v); }
-        else if (v.isString())
-        {
-            const auto s = v.toString();
-            if (isNumber (s))
-                return value == s.getDoubleValue();
-
-            return false;
-        }
+        else if (v.isString())  { return value == NumberConversion::stringToNumber (v.toString()); }
 
         if (auto* other = dynamic_cast<NumberClass*> (v.getDynamicObject()))
             return value == other->value;
@@ -1387,34 +2349,236 @@ private:
 };
 
 //==============================================================================
-/**
-    https://developer.mozilla.org/en-US/docs/Web/JavaScript/Reference/Global_Objects/WeakMap
+/** Maps script objects to values without keeping the objects alive.
+
+    Entries are keyed on the object's address and validated through a WeakReference,
+    so a dead key can never be mistaken for a new object that happens to be allocated
+    at the same address. Dead entries are swept out whenever the heap is collected, and
+    whenever the table has doubled in size since the last sweep, which keeps its footprint
+    proportional to the number of keys that are actually alive.
 */
-struct WeakMapClass final : public JavascriptClass
+class WeakKeyTable final
 {
-    WeakMapClass()
+public:
+    WeakKeyTable() = default;
+
+    /** @returns the value stored against the key, or nullptr if there isn't one. */
+    const var* find (const ScriptObject* key)
     {
-        #define WEAKMAP_CLASS_METHODS(X) \
-            X (delete) X (clear) X (get) X (has) X (set)
+        const auto iter = entries.find (key);
 
-        #define CREATE_WEAKMAP_METHOD(methodName) \
-                setMethod (JUCE_STRINGIFY (methodName), WeakMap_ ## methodName);
+        if (iter == entries.end())
+            return nullptr;
 
-        WEAKMAP_CLASS_METHODS (CREATE_WEAKMAP_METHOD)
+        if (iter->second.key.get() == nullptr)
+        {
+            entries.erase (iter);
+            return nullptr;
+        }
 
-        #undef WEAKMAP_CLASS_METHODS
-        #undef CREATE_WEAKMAP_METHOD
+        return &iter->second.value;
     }
 
-    SP_JS_IDENTIFY_CLASS ("WeakMap")
+    void set (ScriptObject* key, const var& value)
+    {
+        jassert (key != nullptr);
 
-    static var WeakMap_delete (Args a)  { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var WeakMap_clear (Args a)   { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var WeakMap_get (Args a)     { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var WeakMap_has (Args a)     { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var WeakMap_set (Args a)     { ignoreUnused (a); jassertfalse; return var(); } //TODO
+        auto& entry = entries[key];
+        entry.key = key; // NB: This also revives a slot left behind by a dead object at the same address.
+        entry.value = value;
+
+        if (entries.size() >= sweepThreshold)
+            sweep();
+    }
+
+    /** @returns true if a live entry was removed. */
+    bool remove (const ScriptObject* key)
+    {
+        const auto iter = entries.find (key);
+
+        if (iter == entries.end())
+            return false;
+
+        const auto wasAlive = iter->second.key.get() != nullptr;
+        entries.erase (iter);
+        return wasAlive;
+    }
+
+    void clear()
+    {
+        entries.clear();
+        sweepThreshold = (size_t) minimumSweepThreshold;
+    }
+
+    /** Visits the values of the entries whose keys are alive, and that the visitor wants to follow. */
+    void visitValues (ScriptObject::ReferenceVisitor& visitor)
+    {
+        for (const auto& entry : entries)
+            if (auto* key = entry.second.key.get())
+                if (visitor.shouldVisitValueOf (*key))
+                    visitor.visit (entry.second.value);
+    }
+
+    /** Removes the entries whose keys have been deleted, moving their values into an array. */
+    void sweep (Array<var>& releasedValues)
+    {
+        for (auto iter = entries.begin(); iter != entries.end();)
+        {
+            if (iter->second.key.get() == nullptr)
+            {
+                releasedValues.add (std::move (iter->second.value));
+                iter = entries.erase (iter);
+            }
+            else
+            {
+                ++iter;
+            }
+        }
+
+        sweepThreshold = jmax ((size_t) minimumSweepThreshold, entries.size() * 2);
+    }
+
+private:
+    struct Entry
+    {
+        WeakReference<ScriptObject> key;
+        var value;
+    };
+
+    enum { minimumSweepThreshold = 16 };
+
+    std::unordered_map<const ScriptObject*, Entry> entries;
+    size_t sweepThreshold = (size_t) minimumSweepThreshold;
+
+    void sweep()
+    {
+        Array<var> releasedValues;
+        sweep (releasedValues);
+    }
+
+    JUCE_DECLARE_NON_COPYABLE (WeakKeyTable)
+};
+
+/** @returns the argument as a script object that can be held weakly, or throws if it isn't one. */
+static ScriptObject* getWeakKey (Args a, int index, const char* collectionName)
+{
+    if (auto* key = dynamic_cast<ScriptObject*> (get (a, index).getDynamicObject()))
+        return key;
+
+    throw String ("Invalid value used in ") + collectionName;
+}
+
+//==============================================================================
+/**
+    https://developer.mozilla.org/en-US/docs/Web/JavaScript/Reference/Global_Objects/WeakMap
+*/
+struct WeakMapClass final : public JavascriptClass
+{
+    WeakMapClass()
+    {
+        #define WEAKMAP_CLASS_METHODS(X) \
+            X (delete) X (clear) X (get) X (has) X (set)
+
+        #define CREATE_WEAKMAP_METHOD(methodName) \
+                setMethod (JUCE_STRINGIFY (methodName), WeakMap_ ## methodName);
+
+        WEAKMAP_CLASS_METHODS (CREATE_WEAKMAP_METHOD)
+
+        #undef WEAKMAP_CLASS_METHODS
+        #undef CREATE_WEAKMAP_METHOD
+    }
+
+    SP_JS_IDENTIFY_CLASS ("WeakMap")
+
+    static WeakMapClass* getThisMap (Args a)    { return dynamic_cast<WeakMapClass*> (a.thisObject.getDynamicObject()); }
+    static const ScriptObject* getKey (Args a)  { return dynamic_cast<ScriptObject*> (get (a, 0).getDynamicObject()); }
+
+    static var WeakMap_delete (Args a)
+    {
+        if (auto* map = getThisMap (a))
+            return map->table.remove (getKey (a));
+
+        return false;
+    }
+
+    static var WeakMap_clear (Args a)
+    {
+        if (auto* map = getThisMap (a))
+            map->table.clear();
+
+        return var::undefined();
+    }
+
+    static var WeakMap_get (Args a)
+    {
+        if (auto* map = getThisMap (a))
+            if (auto* value = map->table.find (getKey (a)))
+                return *value;
+
+        return var::undefined();
+    }
+
+    static var WeakMap_has (Args a)
+    {
+        if (auto* map = getThisMap (a))
+            return map->table.find (getKey (a)) != nullptr;
+
+        return false;
+    }
+
+    static var WeakMap_set (Args a)
+    {
+        if (auto* map = getThisMap (a))
+            map->table.set (getWeakKey (a, 0, "weak map key"), get (a, 1));
+
+        return a.thisObject;
+    }
+
+    /** Optionally takes an array of [key, value] pairs to start with. */
+    static WeakMapClass* construct (const Array<var>& vars)
+    {
+        std::unique_ptr<WeakMapClass> map (new WeakMapClass());
+
+        if (vars.size() > 0)
+        {
+            if (auto* pairs = vars.getReference (0).getArray())
+            {
+                for (const auto& pair : *pairs)
+                {
+                    if (auto* keyAndValue = pair.getArray())
+                    {
+                        const var::NativeFunctionArgs args (var(), keyAndValue->begin(), keyAndValue->size());
+                        map->table.set (getWeakKey (args, 0, "weak map key"), get (args, 1));
+                    }
+                }
+            }
+        }
+
+        return map.release();
+    }
+
+    bool areSameValue (const var& v) override { return v.getObject() == this; }
+
+    void visitReferences (ReferenceVisitor& visitor) override
+    {
+        JavascriptClass::visitReferences (visitor);
+        table.visitValues (visitor);
+    }
+
+    void clearReferences() override
+    {
+        JavascriptClass::clearReferences();
+        table.clear();
+    }
+
+    void removeDeadWeakReferences (Array<var>& releasedValues) override
+    {
+        table.sweep (releasedValues);
+    }
+
+private:
+    WeakKeyTable table;
 
-private:
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (WeakMapClass)
 };
 
@@ -1440,12 +2604,82 @@ struct WeakSetClass final : public JavascriptClass
 
     SP_JS_IDENTIFY_CLASS ("WeakSet")
 
-    static var WeakSet_add (Args a)     { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var WeakSet_clear (Args a)   { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var WeakSet_delete (Args a)  { ignoreUnused (a); jassertfalse; return var(); } //TODO
-    static var WeakSet_has (Args a)     { ignoreUnused (a); jassertfalse; return var(); } //TODO
+    static WeakSetClass* getThisSet (Args a)    { return dynamic_cast<WeakSetClass*> (a.thisObject.getDynamicObject()); }
+    static const ScriptObject* getKey (Args a)  { return dynamic_cast<ScriptObject*> (get (a, 0).getDynamicObject()); }
+
+    static var WeakSet_add (Args a)
+    {
+        if (auto* set = getThisSet (a))
+            set->table.set (getWeakKey (a, 0, "weak set"), true);
+
+        return a.thisObject;
+    }
+
+    static var WeakSet_clear (Args a)
+    {
+        if (auto* set = getThisSet (a))
+            set->table.clear();
+
+        return var::undefined();
+    }
+
+    static var WeakSet_delete (Args a)
+    {
+        if (auto* set = getThisSet (a))
+            return set->table.remove (getKey (a));
+
+        return false;
+    }
+
+    static var WeakSet_has (Args a)
+    {
+        if (auto* set = getThisSet (a))
+            return set->table.find (getKey (a)) != nullptr;
+
+        return false;
+    }
+
+    /** Optionally takes an array of objects to start with. */
+    static WeakSetClass* construct (const Array<var>& vars)
+    {
+        std::unique_ptr<WeakSetClass> set (new WeakSetClass());
+
+        if (vars.size() > 0)
+        {
+            if (auto* values = vars.getReference (0).getArray())
+            {
+                const var::NativeFunctionArgs args (var(), values->begin(), values->size());
+
+                for (int i = 0; i < values->size(); ++i)
+                    set->table.set (getWeakKey (args, i, "weak set"), true);
+            }
+        }
+
+        return set.release();
+    }
+
+    bool areSameValue (const var& v) override { return v.getObject() == this; }
+
+    void visitReferences (ReferenceVisitor& visitor) override
+    {
+        JavascriptClass::visitReferences (visitor);
+        table.visitValues (visitor);
+    }
+
+    void clearReferences() override
+    {
+        JavascriptClass::clearReferences();
+        table.clear();
+    }
+
+    void removeDeadWeakReferences (Array<var>& releasedValues) override
+    {
+        table.sweep (releasedValues);
+    }
 
 private:
+    WeakKeyTable table;
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (WeakSetClass)
 };
 
@@ -1551,101 +2785,1144 @@ private:
 };
 
 //==============================================================================
-var Scope::findFunctionCall (const CodeLocation& location, const var& targetObject, const Identifier& functionName) const
+/**
+    https://developer.mozilla.org/en-US/docs/Web/JavaScript/Reference/Global_Objects/Promise
+
+    Whatever reacts to a promise being settled, be it a handler given to then() or an
+    async function awaiting it, gets run as a microtask on the engine's event loop.
+    Instances don't carry any methods of their own: Scope::findFunctionCall() looks
+    them up in the root Promise class instead.
+*/
+struct PromiseClass final : public JavascriptClass
 {
-    if (auto* o = targetObject.getDynamicObject())
+    enum class State
     {
-        if (auto* prop = getPropertyPointer (*o, functionName))
-            return *prop;
+        pending,
+        fulfilled,
+        rejected
+    };
 
-        for (auto* p = o->getProperty (getPrototypeIdentifier()).getDynamicObject();
-             p != nullptr;
-             p = p->getProperty (getPrototypeIdentifier()).getDynamicObject())
-        {
-            if (auto* prop = getPropertyPointer (*p, functionName))
-                return *prop;
-        }
+    PromiseClass()
+    {
+        #define PROMISE_CLASS_METHODS(X) \
+            X (all) X (allSettled) X (any) X (race) X (reject) X (resolve) \
+            X (then) X (catch) X (finally)
 
-        // if there's a class with an overridden DynamicObject::hasMethod, this avoids an error
-        if (o->hasMethod (functionName))
-            return {};
-    }
+        #define CREATE_PROMISE_METHOD(methodName) \
+                setMethod (JUCE_STRINGIFY (methodName), Promise_ ## methodName);
 
-    if (targetObject.isString())
-        if (auto* m = findRootClassProperty (StringClass::getClassName(), functionName))
-            return *m;
+        PROMISE_CLASS_METHODS (CREATE_PROMISE_METHOD)
 
-    if (targetObject.isArray())
-        if (auto* m = findRootClassProperty (ArrayClass::getClassName(), functionName))
-            return *m;
+        #undef PROMISE_CLASS_METHODS
+        #undef CREATE_PROMISE_METHOD
+    }
 
-    if (auto* m = findRootClassProperty (ObjectClass::getClassName(), functionName))
-        return *m;
+    /** Creates a Promise instance. */
+    explicit PromiseClass (State initialState, const var& initialResult = {}) :
+        state (initialState),
+        result (initialResult)
+    {
+    }
 
-    location.throwError ("Unknown function '" + functionName.toString() + "'");
-    return {};
-}
+    SP_JS_IDENTIFY_CLASS ("Promise")
 
-//==============================================================================
-var NewOperator::getResult (const Scope& s) const
-{
-    const auto classOrFunc = object->getResult (s);
-    const bool isFunc = isFunction (classOrFunc);
+    //==============================================================================
+    /** What to do once a promise has been settled. */
+    struct Reaction
+    {
+        var onFulfilled, onRejected;    // If the one that's needed isn't a function, the result is passed straight on to the derived promise.
+        var derived;                    // The promise that then() handed back, which is settled with whatever the handler returns.
+        var frame;                      // An async function awaiting the promise, which gets resumed instead.
+    };
 
-    if (! (isFunc || classOrFunc.getDynamicObject() != nullptr))
-        return var::undefined();
+    static PromiseClass* getPromise (const var& v) noexcept     { return dynamic_cast<PromiseClass*> (v.getDynamicObject()); }
+    static bool isCallable (const var& v) noexcept              { return isFunction (v) || v.isMethod(); }
+    static var create()                                         { return new PromiseClass (State::pending); }
 
-    if (isFunc)
+    /** Gives back the value if it's already a promise, or else a promise resolved with it, in the same way as Promise.resolve(). */
+    static var toPromise (const var& value)
     {
-        auto* newObject = new DynamicObject();
-        invokeFunction (s, classOrFunc, newObject);
-        return newObject;
+        if (getPromise (value) != nullptr)
+            return value;
+
+        auto promise = create();
+        resolve (promise, value);
+        return promise;
     }
 
-    if (classId.isValid())
+    /** Resolves a promise with a value. If the value is another promise or a thenable,
+        the promise follows it rather than being fulfilled straight away.
+    */
+    static void resolve (const var& promiseVar, const var& value)
     {
-        Array<var> argVars;
+        auto* promise = getPromise (promiseVar);
 
-        for (auto* a : arguments)
-            argVars.add (a->getResult (s));
+        if (promise == nullptr || promise->state != State::pending)
+            return;
 
-        if (classId == JSONClass::getClassName()
-            || classId == MathClass::getClassName())
+        if (value.getObject() == promise)
         {
-            location.throwError (String ("XYZ is not constructable!")
-                                    .replace ("XYZ", classId.getCharPointer(), true));
-            return var::undefined();
+            reject (promiseVar, "TypeError: Chaining cycle detected for promise");
+            return;
         }
 
-        DynamicObject* newObject = nullptr;
-
-        if (classId == BooleanClass::getClassName())
-        {
-            newObject = BooleanClass::construct (argVars);
-        }
-        else if (classId == NumberClass::getClassName())
+        if (auto* other = getPromise (value))
         {
-            newObject = NumberClass::construct (argVars);
+            other->addReaction ({ {}, {}, promiseVar, {} });
+            return;
         }
-        else if (classId == DateClass::getClassName())
+
+        if (auto* o = value.getDynamicObject())
         {
-            newObject = DateClass::construct (argVars);
+            static const Identifier thenId ("then");
+            const auto then = o->getProperty (thenId);
+
+            if (isCallable (then))
+            {
+                queueTask (runThenableJob, { promiseVar, value, then });
+                return;
+            }
         }
+
+        promise->settle (State::fulfilled, value);
+    }
+
+    static void reject (const var& promiseVar, const var& reason)
+    {
+        if (auto* promise = getPromise (promiseVar))
+            promise->settle (State::rejected, reason);
+    }
+
+    /** Adds something to be done once the promise is settled, queueing it straight away if it already has been. */
+    void addReaction (Reaction reaction)
+    {
+        if (state == State::pending)
+            reactions.push_back (std::move (reaction));
         else
+            queueReaction (reaction);
+    }
+
+    //==============================================================================
+    static var Promise_resolve (Args a)     { return toPromise (get (a, 0)); }
+    static var Promise_reject (Args a)      { return new PromiseClass (State::rejected, get (a, 0)); }
+    static var Promise_all (Args a)         { return combine (a, CombinationType::all); }
+    static var Promise_allSettled (Args a)  { return combine (a, CombinationType::allSettled); }
+    static var Promise_any (Args a)         { return combine (a, CombinationType::any); }
+
+    static var Promise_race (Args a)
+    {
+        auto derived = create();
+
+        for (const auto& item : getItems (a))
+            getPromise (toPromise (item))->addReaction ({ {}, {}, derived, {} });
+
+        return derived;
+    }
+
+    static var Promise_then (Args a)
+    {
+        auto& promise = getThisPromise (a);
+        auto derived = create();
+        promise.addReaction ({ get (a, 0), get (a, 1), derived, {} });
+        return derived;
+    }
+
+    static var Promise_catch (Args a)
+    {
+        const var handlers[] = { var::undefined(), get (a, 0) };
+        return Promise_then (var::NativeFunctionArgs (a.thisObject, handlers, numElementsInArray (handlers)));
+    }
+
+    static var Promise_finally (Args a)
+    {
+        const auto onFinally = get (a, 0);
+
+        if (! isCallable (onFinally))
+            return Promise_then (var::NativeFunctionArgs (a.thisObject, nullptr, 0));
+
+        auto& promise = getThisPromise (a);
+        auto derived = create();
+        promise.addReaction ({ createFinallyHandler (onFinally, false), createFinallyHandler (onFinally, true), derived, {} });
+        return derived;
+    }
+
+    //==============================================================================
+    /** Runs the executor straight away, handing it the functions that settle the new promise. */
+    static PromiseClass* construct (const Array<var>& vars)
+    {
+        const auto executor = vars[0];
+
+        if (! isCallable (executor))
+            throw String ("Promise resolver is not a function");
+
+        var promise (new PromiseClass (State::pending));
+        var functions[2];
+        createResolvingFunctions (promise, functions);
+
+        try
         {
-            newObject = new DynamicObject();
-            jassertfalse; // No idea what kind of class this is supposed to be! @todo perhaps?
+            callScriptFunction (executor, var::NativeFunctionArgs (var(), functions, 2));
         }
-
-        if (newObject != nullptr)
+        catch (String& error)
         {
-            newObject->setProperty (getPrototypeIdentifier(), classOrFunc);
-            return newObject;
+            const var reason (error);
+            callScriptFunction (functions[1], var::NativeFunctionArgs (var(), &reason, 1));
         }
 
-        location.throwError (String ("Failed to create class of type: \"XYZ\".")
-                                .replace ("XYZ", classId.getCharPointer(), true));
+        // Hands the promise back without letting go of it, as the caller will be the one to keep hold of it.
+        auto* newPromise = getPromise (promise);
+        newPromise->incReferenceCount();
+        promise = var();
+        newPromise->decReferenceCountWithoutDeleting();
+        return newPromise;
     }
 
-    return var::undefined();
+    bool areSameValue (const var& v) override { return v.getObject() == this; }
+
+    void visitReferences (ReferenceVisitor& visitor) override
+    {
+        JavascriptClass::visitReferences (visitor);
+        visitor.visit (result);
+
+        for (const auto& reaction : reactions)
+        {
+            visitor.visit (reaction.onFulfilled);
+            visitor.visit (reaction.onRejected);
+            visitor.visit (reaction.derived);
+            visitor.visit (reaction.frame);
+        }
+    }
+
+    void clearReferences() override
+    {
+        JavascriptClass::clearReferences();
+        result = var();
+        reactions.clear();
+    }
+
+    State state = State::pending;
+    var result;
+
+private:
+    //==============================================================================
+    std::vector<Reaction> reactions;
+
+    static PromiseClass& getThisPromise (Args a)
+    {
+        if (auto* promise = getPromise (a.thisObject))
+            return *promise;
+
+        throw String ("this is not a Promise object.");
+    }
+
+    static void queueTask (var (*function) (Args), Array<var> arguments)
+    {
+        if (auto* root = RootObject::getCurrent())
+            root->eventLoop.queueMicrotask ({ var (var::NativeFunction (function)), std::move (arguments) });
+    }
+
+    void queueReaction (const Reaction& reaction)
+    {
+        queueTask (runReaction, { var (this), reaction.onFulfilled, reaction.onRejected, reaction.derived, reaction.frame });
+    }
+
+    void settle (State newState, const var& value)
+    {
+        if (state != State::pending)
+            return;
+
+        state = newState;
+        result = value;
+
+        const auto reactionsToRun = std::move (reactions);
+        reactions.clear();
+
+        for (const auto& reaction : reactionsToRun)
+            queueReaction (reaction);
+    }
+
+    /** The microtask for a reaction: arguments are the settled promise, followed by the fields of the Reaction. */
+    static var runReaction (Args a)
+    {
+        const auto* source = getPromise (get (a, 0));
+
+        if (source == nullptr)
+            return var::undefined();
+
+        const auto isRejected = source->state == State::rejected;
+        const auto value = source->result;
+
+        if (auto* frame = dynamic_cast<ResumableFrame*> (get (a, 4).getObject()))
+        {
+            frame->resume (value, isRejected);
+            return var::undefined();
+        }
+
+        const auto handler = get (a, isRejected ? 2 : 1);
+        const auto derived = get (a, 3);
+
+        if (! isCallable (handler))
+        {
+            if (isRejected)
+                reject (derived, value);
+            else
+                resolve (derived, value);
+
+            return var::undefined();
+        }
+
+        var handlerResult;
+
+        try
+        {
+            handlerResult = callScriptFunction (handler, var::NativeFunctionArgs (var(), &value, 1));
+        }
+        catch (String& error)
+        {
+            reject (derived, error);
+            return var::undefined();
+        }
+
+        resolve (derived, handlerResult);
+        return var::undefined();
+    }
+
+    /** The microtask that calls a thenable's then(), to find out what a promise resolved with it should follow. */
+    static var runThenableJob (Args a)
+    {
+        var functions[2];
+        createResolvingFunctions (get (a, 0), functions);
+
+        try
+        {
+            callScriptFunction (get (a, 2), var::NativeFunctionArgs (get (a, 1), functions, 2));
+        }
+        catch (String& error)
+        {
+            const var reason (error);
+            callScriptFunction (functions[1], var::NativeFunctionArgs (var(), &reason, 1));
+        }
+
+        return var::undefined();
+    }
+
+    /** Makes the resolve and reject functions for an executor or a thenable, of which only the first call has any effect. */
+    static void createResolvingFunctions (const var& promise, var* functions)
+    {
+        auto alreadyResolved = std::make_shared<bool> (false);
+
+        functions[0] = var (var::NativeFunction ([promise, alreadyResolved] (Args a) -> var
+        {
+            if (! std::exchange (*alreadyResolved, true))
+                resolve (promise, get (a, 0));
+
+            return var::undefined();
+        }));
+
+        functions[1] = var (var::NativeFunction ([promise, alreadyResolved] (Args a) -> var
+        {
+            if (! std::exchange (*alreadyResolved, true))
+                reject (promise, get (a, 0));
+
+            return var::undefined();
+        }));
+    }
+
+    /** Calls the callback given to finally(), and then passes on the original result,
+        once any promise that the callback returned has been fulfilled.
+    */
+    static var createFinallyHandler (const var& onFinally, bool isRejection)
+    {
+        return var (var::NativeFunction ([onFinally, isRejection] (Args a) -> var
+        {
+            const auto value = get (a, 0);
+            const auto callbackResult = callScriptFunction (onFinally, var::NativeFunctionArgs (var(), nullptr, 0));
+            const auto originalResult = isRejection ? var (new PromiseClass (State::rejected, value)) : value;
+
+            auto* callbackPromise = getPromise (callbackResult);
+
+            if (callbackPromise == nullptr)
+                return originalResult;
+
+            auto derived = create();
+            const auto passOn = var (var::NativeFunction ([originalResult] (Args) { return originalResult; }));
+            callbackPromise->addReaction ({ passOn, {}, derived, {} });
+            return derived;
+        }));
+    }
+
+    //==============================================================================
+    enum class CombinationType
+    {
+        all,
+        allSettled,
+        any
+    };
+
+    /** Keeps track of the promises that Promise.all() and the like are waiting on. */
+    struct Combination
+    {
+        var derived, results;
+        int numRemaining = 0;
+    };
+
+    static const Array<var>& getItems (Args a)
+    {
+        if (auto* items = get (a, 0).getArray())
+            return *items;
+
+        throw String ("Promise combinators need an array of promises or values");
+    }
+
+    static var combine (Args a, CombinationType type)
+    {
+        const auto& items = getItems (a);
+
+        auto combination = std::make_shared<Combination>();
+        combination->derived = create();
+        combination->numRemaining = items.size();
+
+        Array<var> results;
+        results.resize (items.size());
+        combination->results = var (std::move (results));
+
+        if (items.isEmpty())
+        {
+            if (type == CombinationType::any)
+                reject (combination->derived, "AggregateError: All promises were rejected");
+            else
+                resolve (combination->derived, combination->results);
+        }
+
+        for (int i = 0; i < items.size(); ++i)
+            getPromise (toPromise (items.getReference (i)))
+                ->addReaction ({ createCombinationHandler (combination, i, type, false),
+                                 createCombinationHandler (combination, i, type, true),
+                                 {}, {} });
+
+        return combination->derived;
+    }
+
+    static var createCombinationHandler (std::shared_ptr<Combination> combination, int index, CombinationType type, bool isRejection)
+    {
+        return var (var::NativeFunction ([combination, index, type, isRejection] (Args a) -> var
+        {
+            const auto value = get (a, 0);
+            auto& c = *combination;
+
+            // A rejection settles Promise.all() straight away, as does a fulfilment for Promise.any().
+            if (type == CombinationType::all && isRejection)
+            {
+                reject (c.derived, value);
+                return var::undefined();
+            }
+
+            if (type == CombinationType::any && ! isRejection)
+            {
+                resolve (c.derived, value);
+                return var::undefined();
+            }
+
+            if (type == CombinationType::allSettled)
+            {
+                DynamicObject::Ptr outcome (new ScriptObject());
+                outcome->setProperty ("status", isRejection ? "rejected" : "fulfilled");
+                outcome->setProperty (isRejection ? "reason" : "value", value);
+                c.results.getArray()->set (index, outcome.get());
+            }
+            else
+            {
+                c.results.getArray()->set (index, value);
+            }
+
+            if (--c.numRemaining == 0)
+            {
+                if (type == CombinationType::any)
+                    reject (c.derived, "AggregateError: All promises were rejected");
+                else
+                    resolve (c.derived, c.results);
+            }
+
+            return var::undefined();
+        }));
+    }
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PromiseClass)
+};
+
+//==============================================================================
+/**
+    https://developer.mozilla.org/en-US/docs/Web/JavaScript/Reference/Global_Objects/Generator
+
+    A generator holds the frame of its call to the generator function, which gets
+    run up to the next yield each time the generator is resumed. Like promises,
+    instances get their methods from the root Generator class.
+*/
+struct GeneratorClass final : public JavascriptClass
+{
+    GeneratorClass()
+    {
+        #define GENERATOR_CLASS_METHODS(X) \
+            X (next) X (return) X (throw)
+
+        #define CREATE_GENERATOR_METHOD(methodName) \
+                setMethod (JUCE_STRINGIFY (methodName), Generator_ ## methodName);
+
+        GENERATOR_CLASS_METHODS (CREATE_GENERATOR_METHOD)
+
+        #undef GENERATOR_CLASS_METHODS
+        #undef CREATE_GENERATOR_METHOD
+    }
+
+    /** Creates a generator for a call to a generator function. */
+    explicit GeneratorClass (const var& resumableFrame) :
+        frame (resumableFrame)
+    {
+    }
+
+    SP_JS_IDENTIFY_CLASS ("Generator")
+
+    //==============================================================================
+    static GeneratorClass* getGenerator (const var& v) noexcept
+    {
+        auto* g = dynamic_cast<GeneratorClass*> (v.getDynamicObject());
+        return g != nullptr && ! g->frame.isVoid() ? g : nullptr;
+    }
+
+    /** Runs the generator up to its next yield.
+
+        @param value        What the yield that the generator is suspended at should give back,
+                            or throw if isThrow is set.
+        @param isThrow      If true, the value gets thrown at the point where the generator is suspended.
+        @param result       Set to the value that was yielded, or that the function returned.
+        @returns true if the generator yielded, or false if it has finished.
+    */
+    bool resume (const var& value, bool isThrow, var& result)
+    {
+        if (isFinished)
+        {
+            if (isThrow)
+                throw NumberConversion::toScriptString (value);
+
+            result = var::undefined();
+            return false;
+        }
+
+        if (isRunning)
+            throw String ("Generator is already running");
+
+        auto* resumableFrame = dynamic_cast<ResumableFrame*> (frame.getObject());
+
+        // A generator that hasn't started yet has no yield to throw at, so it just finishes.
+        if (isThrow && ! hasStarted)
+        {
+            finish();
+            throw NumberConversion::toScriptString (value);
+        }
+
+        const ScopedValueSetter<bool> runningSetter (isRunning, true);
+        hasStarted = true;
+        resumableFrame->setResumeValue (value, isThrow);
+
+        try
+        {
+            if (resumableFrame->run (result))
+            {
+                finish();
+                return false;
+            }
+        }
+        catch (String&)
+        {
+            finish();
+            throw;
+        }
+
+        result = resumableFrame->takeYieldedValue();
+        return true;
+    }
+
+    /** Finishes the generator early, the way return() does, which is passed on to
+        whatever a yield* that it's suspended at is delegating to.
+    */
+    void close()
+    {
+        var delegate;
+
+        if (auto* resumableFrame = dynamic_cast<ResumableFrame*> (frame.getObject()))
+            if (! isRunning)
+                delegate = resumableFrame->delegate;
+
+        finish();
+
+        if (! delegate.isVoid())
+            ForEachLoop::closeIterator (delegate);
+    }
+
+    /** Finishes the generator without running any more of it, letting go of its frame. */
+    void finish()
+    {
+        isFinished = true;
+
+        if (auto* resumableFrame = dynamic_cast<ResumableFrame*> (frame.getObject()))
+            if (! isRunning)
+                resumableFrame->clearReferences();
+    }
+
+    //==============================================================================
+    static var Generator_next (Args a)      { return step (a, get (a, 0), false); }
+    static var Generator_throw (Args a)     { return step (a, get (a, 0), true); }
+
+    static var Generator_return (Args a)
+    {
+        auto& generator = getThisGenerator (a);
+
+        if (generator.isRunning)
+            throw String ("Generator is already running");
+
+        generator.close();
+        return createResult (get (a, 0), true);
+    }
+
+    //==============================================================================
+    bool areSameValue (const var& v) override { return v.getObject() == this; }
+
+    void visitReferences (ReferenceVisitor& visitor) override
+    {
+        JavascriptClass::visitReferences (visitor);
+        visitor.visit (frame);
+    }
+
+    void clearReferences() override
+    {
+        JavascriptClass::clearReferences();
+        frame = var();
+        isFinished = true;
+    }
+
+private:
+    //==============================================================================
+    var frame;
+    bool hasStarted = false, isRunning = false, isFinished = false;
+
+    static GeneratorClass& getThisGenerator (Args a)
+    {
+        if (auto* generator = getGenerator (a.thisObject))
+            return *generator;
+
+        throw String ("this is not a Generator object.");
+    }
+
+    static var createResult (const var& value, bool done)
+    {
+        static const Identifier valueId ("value"), doneId ("done");
+
+        DynamicObject::Ptr result (new ScriptObject());
+        result->setProperty (valueId, value);
+        result->setProperty (doneId, done);
+        return result.get();
+    }
+
+    static var step (Args a, const var& value, bool isThrow)
+    {
+        var result;
+        const auto yielded = getThisGenerator (a).resume (value, isThrow, result);
+        return createResult (result, ! yielded);
+    }
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (GeneratorClass)
+};
+
+//==============================================================================
+var Scope::findFunctionCall (const CodeLocation& location, const var& targetObject, const Identifier& functionName) const
+{
+    if (auto* o = targetObject.getDynamicObject())
+    {
+        if (auto* prop = getPropertyPointer (*o, functionName))
+            return *prop;
+
+        for (auto* p = o->getProperty (getPrototypeIdentifier()).getDynamicObject();
+             p != nullptr;
+             p = p->getProperty (getPrototypeIdentifier()).getDynamicObject())
+        {
+            if (auto* prop = getPropertyPointer (*p, functionName))
+                return *prop;
+        }
+
+        // if there's a class with an overridden DynamicObject::hasMethod, this avoids an error
+        if (o->hasMethod (functionName))
+            return {};
+    }
+
+    if (dynamic_cast<DateClass*> (targetObject.getDynamicObject()) != nullptr)
+        if (auto* m = findRootClassProperty (DateClass::getClassName(), functionName))
+            return *m;
+
+    if (PromiseClass::getPromise (targetObject) != nullptr)
+        if (auto* m = findRootClassProperty (PromiseClass::getClassName(), functionName))
+            return *m;
+
+    if (dynamic_cast<GeneratorClass*> (targetObject.getDynamicObject()) != nullptr)
+        if (auto* m = findRootClassProperty (GeneratorClass::getClassName(), functionName))
+            return *m;
+
+    if (dynamic_cast<RegExpClass*> (targetObject.getDynamicObject()) != nullptr)
+        if (auto* m = findRootClassProperty (RegExpClass::getClassName(), functionName))
+            return *m;
+
+    if (targetObject.isString())
+        if (auto* m = findRootClassProperty (StringClass::getClassName(), functionName))
+            return *m;
+
+    if (targetObject.isArray())
+        if (auto* m = findRootClassProperty (ArrayClass::getClassName(), functionName))
+            return *m;
+
+    if (isNumeric (targetObject) && ! targetObject.isBool())
+        if (auto* m = findRootClassProperty (NumberClass::getClassName(), functionName))
+            return *m;
+
+    if (auto* m = findRootClassProperty (ObjectClass::getClassName(), functionName))
+        return *m;
+
+    location.throwError ("Unknown function '" + functionName.toString() + "'");
+    return {};
+}
+
+//==============================================================================
+var NewOperator::getResult (const Scope& s) const
+{
+    SP_JS_COUNT_NODE (NewOperator);
+
+    ResumePoint resume (s, *this);
+    const auto classOrFunc = resume.evaluate (0, *object);
+    const bool isFunc = isFunction (classOrFunc);
+
+    if (! (isFunc || classOrFunc.getDynamicObject() != nullptr))
+        return var::undefined();
+
+    if (isFunc)
+    {
+        var newObject (new ScriptObject());
+        invokeFunction (s, resume, classOrFunc, newObject);
+        return newObject;
+    }
+
+    if (classId.isValid())
+    {
+        Array<var> argVars;
+
+        for (int i = 0; i < arguments.size(); ++i)
+            argVars.add (resume.evaluate (i + 1, *arguments.getUnchecked (i)));
+
+        if (classId == JSONClass::getClassName()
+            || classId == MathClass::getClassName())
+        {
+            location.throwError (String ("XYZ is not constructable!")
+                                    .replace ("XYZ", classId.getCharPointer(), true));
+            return var::undefined();
+        }
+
+        DynamicObject* newObject = nullptr;
+
+        if (classId == BooleanClass::getClassName())
+        {
+            newObject = BooleanClass::construct (argVars);
+        }
+        else if (classId == NumberClass::getClassName())
+        {
+            newObject = NumberClass::construct (argVars);
+        }
+        else if (classId == DateClass::getClassName())
+        {
+            newObject = DateClass::construct (argVars);
+        }
+        else if (classId == RegExpClass::getClassName())
+        {
+            newObject = RegExpClass::construct (argVars);
+        }
+        else if (classId == PromiseClass::getClassName())
+        {
+            newObject = PromiseClass::construct (argVars);
+        }
+        else if (classId == WeakMapClass::getClassName())
+        {
+            newObject = WeakMapClass::construct (argVars);
+        }
+        else if (classId == WeakSetClass::getClassName())
+        {
+            newObject = WeakSetClass::construct (argVars);
+        }
+        else
+        {
+            newObject = new ScriptObject();
+            jassertfalse; // No idea what kind of class this is supposed to be! @todo perhaps?
+        }
+
+        if (newObject != nullptr)
+        {
+            newObject->setProperty (getPrototypeIdentifier(), classOrFunc);
+            return newObject;
+        }
+
+        location.throwError (String ("Failed to create class of type: \"XYZ\".")
+                                .replace ("XYZ", classId.getCharPointer(), true));
+    }
+
+    return var::undefined();
+}
+
+//==============================================================================
+bool ResumableFrame::run (var& returnValue)
+{
+    auto* fo = dynamic_cast<FunctionObject*> (function.getObject());
+
+    if (fo == nullptr)
+    {
+        jassertfalse; // The function has already finished!
+        return true;
+    }
+
+    OwnedArray<Scope> scopes;
+    scopes.add (new Scope (nullptr, &root, &root));
+
+    for (const auto& o : callerScopes)
+        scopes.add (new Scope (scopes.getLast(), &root, o.getDynamicObject()));
+
+    // Once the call is over, there's no need to hang on to its scopes any more.
+    const auto finish = [&]
+    {
+        scopes.clear();
+        savedStates.clear();
+        callerScopes.clear();
+        functionRoot = function = var();
+    };
+
+    try
+    {
+        fo->body->perform (Scope (scopes.getLast(), &root, functionRoot.getDynamicObject(), this), &returnValue);
+    }
+    catch (const SuspendExecution&)
+    {
+        return false;
+    }
+    catch (String&)
+    {
+        finish();
+        throw;
+    }
+
+    finish();
+    return true;
+}
+
+void ResumableFrame::runAsync()
+{
+    var returnValue;
+
+    try
+    {
+        // If it's been suspended, the await that did so will resume it once its promise is settled.
+        if (! run (returnValue))
+            return;
+    }
+    catch (String& error)
+    {
+        PromiseClass::reject (promise, error);
+        return;
+    }
+
+    PromiseClass::resolve (promise, returnValue);
+}
+
+var FunctionObject::invokeAsync (const Scope& s, const var::NativeFunctionArgs& args) const
+{
+    ReferenceCountedObjectPtr<ResumableFrame> frame (new ResumableFrame (var (const_cast<FunctionObject*> (this)), s,
+                                                                          var (createFunctionRoot (args).get())));
+    frame->promise = PromiseClass::create();
+    frame->runAsync();
+    return frame->promise;
+}
+
+var FunctionObject::invokeGenerator (const Scope& s, const var::NativeFunctionArgs& args) const
+{
+    var frame (new ResumableFrame (var (const_cast<FunctionObject*> (this)), s, var (createFunctionRoot (args).get())));
+    return new GeneratorClass (frame);
+}
+
+var AwaitExpression::getResult (const Scope& s) const
+{
+    SP_JS_COUNT_NODE (AwaitExpression);
+
+    if (s.frame == nullptr)
+        location.throwError ("await is only valid inside async functions");
+
+    ResumePoint resume (s, *this);
+
+    if (resume.getResumedStep() == 1)
+        return s.frame->takeResumeValue();
+
+    const auto promise = PromiseClass::toPromise (resume.evaluate (0, *operand));
+    PromiseClass::getPromise (promise)->addReaction ({ {}, {}, {}, var (s.frame) });
+
+    // Even when the promise has already been settled, the function waits for its reaction to come round as a microtask.
+    s.frame->save (*this, 1, {});
+    throw SuspendExecution();
+}
+
+var YieldExpression::getResult (const Scope& s) const
+{
+    SP_JS_COUNT_NODE (YieldExpression);
+
+    if (s.frame == nullptr)
+        location.throwError ("yield is only valid inside generator functions");
+
+    ResumePoint resume (s, *this);
+
+    if (! isDelegating)
+    {
+        if (resume.getResumedStep() == 1)
+            return s.frame->takeResumeValue();
+
+        s.frame->setYieldedValue (resume.evaluate (0, *operand));
+        s.frame->save (*this, 1, {});
+        throw SuspendExecution();
+    }
+
+    const auto source = resume.evaluate (0, *operand);
+    ForEachLoop::Position position;
+    var value;
+    auto isThrow = false;
+
+    if (resume.getResumedStep() == 1)
+    {
+        position.index = resume.values[1];
+        position.byteOffset = resume.values[2];
+        s.frame->delegate = var();
+        value = s.frame->takeResumeValue (isThrow);
+    }
+    else if (! ForEachLoop::canIterate (source, false))
+    {
+        location.throwError ("yield* needs something iterable");
+    }
+
+    var item;
+
+    if (! resumeDelegate (source, position, value, isThrow, item))
+        return item;
+
+    s.frame->delegate = source;
+    s.frame->setYieldedValue (item);
+    s.frame->save (*this, 1, { source, var (position.index), var (position.byteOffset) });
+    throw SuspendExecution();
+}
+
+bool YieldExpression::resumeDelegate (const var& source, ForEachLoop::Position& position,
+                                      const var& value, bool isThrow, var& item)
+{
+    if (auto* generator = GeneratorClass::getGenerator (source))
+        return generator->resume (value, isThrow, item);
+
+    auto* o = source.getDynamicObject();
+
+    // Arrays, strings and binary data have nowhere to pass a value on to, and nothing to catch a throw() with.
+    if (o == nullptr)
+    {
+        if (isThrow)
+            throw NumberConversion::toScriptString (value);
+
+        item = var::undefined();
+        return ForEachLoop::getNextItem (source, false, position, item);
+    }
+
+    static const Identifier nextId ("next"), throwId ("throw"), doneId ("done"), valueId ("value");
+    const auto method = o->getProperty (isThrow ? throwId : nextId);
+
+    if (isThrow && ! PromiseClass::isCallable (method))
+    {
+        ForEachLoop::closeIterator (source);
+        throw String ("The iterator that yield* is delegating to has no throw() method");
+    }
+
+    const auto result = callScriptFunction (method, var::NativeFunctionArgs (source, &value, 1));
+
+    if (auto* r = result.getDynamicObject())
+    {
+        item = r->getProperty (valueId);
+        return ! r->getProperty (doneId);
+    }
+
+    throw String ("Iterator result " + NumberConversion::toScriptString (result) + " is not an object");
+}
+
+//==============================================================================
+Statement::ResultCode ForEachLoop::perform (const Scope& s, var* returnedValue) const
+{
+    SP_JS_COUNT_NODE (ForEachLoop);
+
+    ResumePoint resume (s, *this);
+    const auto collection = resume.evaluate (0, *source);
+
+    // When carrying on part-way through the body, the item it was running for has already been fetched.
+    auto resumingBody = resume.getResumedStep() == 1;
+    Position position;
+
+    if (resumingBody)
+    {
+        position.index = resume.values[1];
+        position.byteOffset = resume.values[2];
+    }
+
+    if (! resumingBody && ! canIterate (collection, iteratesKeys))
+        location.throwError (NumberConversion::toScriptString (collection).quoted() + " is not iterable");
+
+    for (;;)
+    {
+        if (! resumingBody)
+        {
+            var item;
+
+            if (! getNextItem (collection, iteratesKeys, position, item))
+                break;
+
+            if (declaresVariable)
+                s.scope->setProperty (variable->name, item);
+            else
+                variable->assign (s, item);
+
+            body->markCovered();
+        }
+
+        resumingBody = false;
+        s.checkTimeOut (location);
+
+        if (s.frame != nullptr)
+        {
+            resume.values.resize (3);
+            resume.values.setUnchecked (1, position.index);
+            resume.values.setUnchecked (2, position.byteOffset);
+        }
+
+        const auto r = resume.run (1, [&] { return body->perform (s, returnedValue); });
+
+        if (r == ResultCode::returnWasHit || r == ResultCode::breakWasHit)
+        {
+            if (! iteratesKeys)
+                closeIterator (collection);
+
+            return r == ResultCode::returnWasHit ? r : ResultCode::ok;
+        }
+    }
+
+    return ResultCode::ok;
+}
+
+bool ForEachLoop::canIterate (const var& iterable, bool keys)
+{
+    if (keys || iterable.isArray() || iterable.isString() || iterable.isBinaryData())
+        return true;
+
+    if (GeneratorClass::getGenerator (iterable) != nullptr)
+        return true;
+
+    static const Identifier nextId ("next");
+
+    if (auto* o = iterable.getDynamicObject())
+        return PromiseClass::isCallable (o->getProperty (nextId));
+
+    return false;
+}
+
+bool ForEachLoop::getNextItem (const var& iterable, bool keys, Position& position, var& item)
+{
+    if (auto* array = iterable.getArray())
+    {
+        // The length is checked every time, as the loop's body is free to change it.
+        if (position.index >= array->size())
+            return false;
+
+        item = keys ? var (String (position.index)) : array->getReference (position.index);
+        ++position.index;
+        return true;
+    }
+
+    if (iterable.isString())
+    {
+        // Carries on from the byte offset of the next character, and counts the keys as it goes.
+        const auto text = iterable.toString();
+        auto c = CharPointer_UTF8 (text.toRawUTF8() + position.byteOffset);
+
+        if (c.isEmpty())
+            return false;
+
+        item = keys ? var (String (position.index)) : var (String::charToString (*c));
+        ++c;
+        position.byteOffset = (int) (c.getAddress() - text.toRawUTF8());
+        ++position.index;
+        return true;
+    }
+
+    if (auto* block = iterable.getBinaryData())
+    {
+        if (position.index >= (int) block->getSize())
+            return false;
+
+        item = keys ? var (String (position.index)) : var ((int) static_cast<const uint8*> (block->getData())[position.index]);
+        ++position.index;
+        return true;
+    }
+
+    if (keys)
+    {
+        auto* o = iterable.getDynamicObject();
+
+        if (o == nullptr || position.index >= o->getProperties().size())
+            return false;
+
+        item = o->getProperties().getName (position.index).toString();
+        ++position.index;
+        return true;
+    }
+
+    if (auto* generator = GeneratorClass::getGenerator (iterable))
+        return generator->resume ({}, false, item);
+
+    static const Identifier nextId ("next"), doneId ("done"), valueId ("value");
+
+    if (auto* o = iterable.getDynamicObject())
+    {
+        const auto result = callScriptFunction (o->getProperty (nextId), var::NativeFunctionArgs (iterable, nullptr, 0));
+
+        if (auto* r = result.getDynamicObject())
+        {
+            if (r->getProperty (doneId))
+                return false;
+
+            item = r->getProperty (valueId);
+            return true;
+        }
+
+        throw String ("Iterator result " + NumberConversion::toScriptString (result) + " is not an object");
+    }
+
+    return false;
+}
+
+void ForEachLoop::closeIterator (const var& iterable)
+{
+    if (auto* generator = GeneratorClass::getGenerator (iterable))
+    {
+        generator->close();
+        return;
+    }
+
+    static const Identifier returnId ("return");
+
+    if (auto* o = iterable.getDynamicObject())
+    {
+        const auto returnMethod = o->getProperty (returnId);
+
+        if (PromiseClass::isCallable (returnMethod))
+            callScriptFunction (returnMethod, var::NativeFunctionArgs (iterable, nullptr, 0));
+    }
 }
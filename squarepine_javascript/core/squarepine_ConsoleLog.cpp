@@ -0,0 +1,194 @@
+//==============================================================================
+class ConsoleLog::Writer final : public Thread
+{
+public:
+    Writer (ConsoleLog& l) :
+        Thread ("Javascript Console"),
+        log (l)
+    {
+    }
+
+    void run() override
+    {
+        std::vector<Record> batch;
+
+        while (! threadShouldExit())
+        {
+            log.dataReady.wait (flushIntervalMs);
+            log.drain (batch);
+        }
+    }
+
+    // How long messages can sit in the buffer before being written, when there aren't enough of them to wake the writer.
+    enum { flushIntervalMs = 50 };
+
+private:
+    ConsoleLog& log;
+
+    JUCE_DECLARE_NON_COPYABLE (Writer)
+};
+
+//==============================================================================
+ConsoleLog::ConsoleLog (int capacity, OverflowPolicy policy, Sink s) :
+    mask ((uint32) nextPowerOfTwo (jmax (2, capacity)) - 1),
+    overflowPolicy (policy),
+    sink (s != nullptr ? std::move (s) : Sink (writeToLogger))
+{
+    slots.reset (new Slot[mask + 1]);
+
+    for (uint32 i = 0; i <= mask; ++i)
+        slots[i].sequence.store (i, std::memory_order_relaxed);
+
+    writer.reset (new Writer (*this));
+    writer->startThread();
+}
+
+ConsoleLog::~ConsoleLog()
+{
+    writer->signalThreadShouldExit();
+    dataReady.signal();
+    writer->stopThread (10000);
+
+    // Anything written after the thread's last look at the buffer still gets out.
+    std::vector<Record> batch;
+    drain (batch);
+}
+
+//==============================================================================
+/*  The ring buffer is a bounded queue along the lines of Dmitry Vyukov's: each slot's
+    sequence number says whether it's free for the writer whose turn it is, or holds a
+    message that's ready to be read. Writers claim a slot by bumping writePosition with
+    a compare-and-swap, and only the background thread ever reads.
+*/
+bool ConsoleLog::push (Record& record)
+{
+    auto position = writePosition.load (std::memory_order_relaxed);
+
+    for (;;)
+    {
+        auto& slot = slots[position & mask];
+        const auto difference = (int32) (slot.sequence.load (std::memory_order_acquire) - position);
+
+        if (difference == 0)
+        {
+            if (writePosition.compare_exchange_weak (position, position + 1, std::memory_order_relaxed))
+            {
+                slot.record = std::move (record);
+                slot.sequence.store (position + 1, std::memory_order_release);
+                return true;
+            }
+        }
+        else if (difference < 0)
+        {
+            return false; // The reader hasn't got this far round yet, so the buffer is full.
+        }
+        else
+        {
+            position = writePosition.load (std::memory_order_relaxed);
+        }
+    }
+}
+
+bool ConsoleLog::pop (Record& record)
+{
+    const auto position = readPosition.load (std::memory_order_relaxed);
+    auto& slot = slots[position & mask];
+
+    if ((int32) (slot.sequence.load (std::memory_order_acquire) - (position + 1)) < 0)
+        return false;
+
+    record = std::move (slot.record);
+    slot.record = {};
+    slot.sequence.store (position + mask + 1, std::memory_order_release);
+    readPosition.store (position + 1, std::memory_order_release);
+    return true;
+}
+
+void ConsoleLog::drain (std::vector<Record>& batch)
+{
+    enum { maximumBatchSize = 256 };
+
+    for (;;)
+    {
+        batch.clear();
+        Record record;
+
+        while (batch.size() < (size_t) maximumBatchSize && pop (record))
+            batch.push_back (std::move (record));
+
+        const auto dropped = numDropped.load();
+
+        if (dropped != numDroppedReported)
+        {
+            batch.push_back ({ Level::warn, String (dropped - numDroppedReported) + " console messages were dropped" });
+            numDroppedReported = dropped;
+        }
+
+        if (batch.empty())
+            return;
+
+        sink (batch.data(), (int) batch.size());
+
+        flushedPosition.store (readPosition.load());
+        dataFlushed.signal();
+    }
+}
+
+//==============================================================================
+bool ConsoleLog::write (Level level, String message)
+{
+    if (! isEnabled (level))
+        return false;
+
+    Record record { level, std::move (message) };
+
+    while (! push (record))
+    {
+        // If the sink itself logs something, waiting for room would mean waiting forever.
+        if (overflowPolicy == OverflowPolicy::dropMessage
+            || Thread::getCurrentThreadId() == writer->getThreadId())
+        {
+            ++numDropped;
+            return false;
+        }
+
+        dataReady.signal();
+        dataFlushed.wait (1);
+    }
+
+    // Only wake the writer when there's a fair amount to do, or something that shouldn't be kept waiting:
+    // otherwise it'll pick the message up on its next round.
+    const auto numWaiting = writePosition.load (std::memory_order_relaxed) - readPosition.load (std::memory_order_relaxed);
+
+    if (level >= Level::warn || numWaiting > (mask + 1) / 4)
+        dataReady.signal();
+
+    return true;
+}
+
+void ConsoleLog::flush()
+{
+    const auto target = writePosition.load();
+
+    while ((int32) (flushedPosition.load() - target) < 0 && writer->isThreadRunning())
+    {
+        dataReady.signal();
+        dataFlushed.wait (Writer::flushIntervalMs);
+    }
+}
+
+void ConsoleLog::writeToLogger (const Record* records, int numRecords)
+{
+    MemoryOutputStream mo (1024);
+
+    for (int i = 0; i < numRecords; ++i)
+        mo << records[i].message;
+
+    // The logger puts a new line after the batch, so the last message's own one isn't needed.
+    auto text = mo.toString();
+
+    if (text.endsWith (newLine))
+        text = text.dropLastCharacters ((int) strlen (newLine));
+
+    Logger::writeToLog (text);
+}
@@ -0,0 +1,117 @@
+//==============================================================================
+/** Where the messages that scripts write with console.log() and friends end up.
+
+    Writing to a log usually means taking a lock and doing some I/O, which isn't
+    something a script's thread should be held up by. So instead, each message is
+    pushed onto a lock-free ring buffer, and a background thread drains the buffer
+    and hands the messages over to the sink in batches.
+
+    Any number of threads can write to the same log, so a host with several engines
+    can have them all share one with JavascriptEngine::setConsoleLog().
+
+    Messages below the minimum level are thrown away before their arguments are
+    even converted to text, so leaving debug logging in a script costs next to nothing.
+*/
+class ConsoleLog final : public ReferenceCountedObject
+{
+public:
+    //==============================================================================
+    /** */
+    using Ptr = ReferenceCountedObjectPtr<ConsoleLog>;
+
+    /** The level of a message, which depends on the console method that wrote it. */
+    enum class Level
+    {
+        debug = 0,
+        log,
+        info,
+        warn,
+        error
+    };
+
+    /** What to do with a message when the ring buffer is full. */
+    enum class OverflowPolicy
+    {
+        dropMessage,    /**< The message is thrown away, and the sink is told how many were lost once there's room again. */
+        waitForRoom     /**< The thread writing the message waits for the background thread to catch up. */
+    };
+
+    /** */
+    struct Record
+    {
+        Level level = Level::log;
+        String message;
+    };
+
+    /** Gets handed each batch of messages, on the background thread. */
+    using Sink = std::function<void (const Record* records, int numRecords)>;
+
+    //==============================================================================
+    /** Creates a log, and starts its background thread.
+
+        @param capacity         The number of messages the ring buffer holds,
+                                which gets rounded up to a power of two.
+        @param overflowPolicy   What to do when the ring buffer fills up.
+        @param sink             Where the messages go. If this is empty, they're
+                                written to the current juce::Logger.
+    */
+    explicit ConsoleLog (int capacity = 4096,
+                         OverflowPolicy overflowPolicy = OverflowPolicy::dropMessage,
+                         Sink sink = {});
+
+    /** Writes out whatever messages are still waiting, and stops the background thread. */
+    ~ConsoleLog() override;
+
+    //==============================================================================
+    /** Messages below this level are dropped without being written. The default is Level::debug. */
+    void setMinimumLevel (Level newLevel) noexcept              { minimumLevel = (int) newLevel; }
+    /** */
+    Level getMinimumLevel() const noexcept                      { return (Level) minimumLevel.load(); }
+    /** */
+    bool isEnabled (Level level) const noexcept                 { return (int) level >= minimumLevel.load (std::memory_order_relaxed); }
+
+    //==============================================================================
+    /** Queues a message to be written. This can be called from any thread.
+
+        @returns false if the message was dropped.
+    */
+    bool write (Level level, String message);
+
+    /** Blocks until every message that was written before this call has been handed to the sink. */
+    void flush();
+
+    /** @returns the number of messages that have been dropped because the ring buffer was full. */
+    int64 getNumDropped() const noexcept                        { return numDropped.load(); }
+
+    /** The sink used when none is given, which writes each batch to the current juce::Logger in one go. */
+    static void writeToLogger (const Record* records, int numRecords);
+
+private:
+    //==============================================================================
+    class Writer;
+
+    struct Slot
+    {
+        std::atomic<uint32> sequence { 0 };
+        Record record;
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    const uint32 mask;
+    const OverflowPolicy overflowPolicy;
+    const Sink sink;
+
+    std::atomic<uint32> writePosition { 0 }, readPosition { 0 }, flushedPosition { 0 };
+    std::atomic<int> minimumLevel { (int) Level::debug };
+    std::atomic<int64> numDropped { 0 };
+    WaitableEvent dataReady, dataFlushed;
+    std::unique_ptr<Writer> writer;
+    int64 numDroppedReported = 0;
+
+    bool push (Record&);
+    bool pop (Record&);
+    void drain (std::vector<Record>& batch);
+
+    //==============================================================================
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ConsoleLog)
+};
@@ -0,0 +1,227 @@
+//==============================================================================
+int LatencyHistogram::getBucketIndex (int64 nanoseconds) noexcept
+{
+    const auto value = (uint64) jlimit ((int64) 0, ((int64) 1 << maximumMagnitude) - 1, nanoseconds);
+
+    if (value < (uint64) numSubBuckets)
+        return (int) value;
+
+    const auto highestBit = (value >> 32) != 0 ? 32 + findHighestSetBit ((uint32) (value >> 32))
+                                               : findHighestSetBit ((uint32) value);
+    const auto shift = highestBit - subBucketBits;
+
+    return ((shift + 1) << subBucketBits) | (int) ((value >> shift) & (numSubBuckets - 1));
+}
+
+int64 LatencyHistogram::getBucketUpperBound (int index) noexcept
+{
+    if (index < numSubBuckets)
+        return index;
+
+    const auto shift = (index >> subBucketBits) - 1;
+    const auto lowest = (int64) (numSubBuckets + (index & (numSubBuckets - 1))) << shift;
+    return lowest + ((int64) 1 << shift) - 1;
+}
+
+void LatencyHistogram::record (int64 nanoseconds) noexcept
+{
+    counts[getBucketIndex (nanoseconds)].fetch_add (1, std::memory_order_relaxed);
+    totalNanoseconds.fetch_add (nanoseconds, std::memory_order_relaxed);
+
+    auto maximum = maximumNanoseconds.load (std::memory_order_relaxed);
+
+    while (nanoseconds > maximum
+           && ! maximumNanoseconds.compare_exchange_weak (maximum, nanoseconds, std::memory_order_relaxed))
+    {
+    }
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::createSnapshot() const
+{
+    Snapshot snapshot;
+    snapshot.counts.resize ((size_t) numBuckets);
+
+    // Adding up the buckets, rather than keeping a separate total, keeps the percentiles consistent with the counts.
+    for (int i = 0; i < numBuckets; ++i)
+    {
+        const auto count = counts[i].load (std::memory_order_relaxed);
+        snapshot.counts[(size_t) i] = count;
+        snapshot.numValues += count;
+    }
+
+    snapshot.totalNanoseconds = totalNanoseconds.load (std::memory_order_relaxed);
+    snapshot.maximumNanoseconds = maximumNanoseconds.load (std::memory_order_relaxed);
+    return snapshot;
+}
+
+int64 LatencyHistogram::Snapshot::getValueAtPercentile (double percentile) const noexcept
+{
+    if (numValues <= 0)
+        return 0;
+
+    const auto target = jmax ((int64) 1, (int64) std::ceil (jlimit (0.0, 100.0, percentile) / 100.0 * (double) numValues));
+    int64 total = 0;
+
+    for (size_t i = 0; i < counts.size(); ++i)
+    {
+        total += counts[i];
+
+        if (total >= target)
+            return jmin (getBucketUpperBound ((int) i), maximumNanoseconds);
+    }
+
+    return maximumNanoseconds;
+}
+
+//==============================================================================
+EngineMetrics::~EngineMetrics()
+{
+    for (auto* e = firstEntry.load(); e != nullptr;)
+    {
+        std::unique_ptr<Entry> entry (e);
+        e = e->next;
+    }
+}
+
+EngineMetrics::Entry& EngineMetrics::getEntry (const char* kind, const String& name)
+{
+    const auto key = String (kind) + ":" + name;
+    const auto iter = entriesByKey.find (key);
+
+    if (iter != entriesByKey.end())
+        return *iter->second;
+
+    if (numNamedEntries >= maximumNumNamedEntries)
+    {
+        // Each kind of call gets one of these, which don't count towards the limit.
+        const auto otherKey = String (kind) + ":other";
+        const auto otherIter = entriesByKey.find (otherKey);
+
+        if (otherIter != entriesByKey.end())
+            return *otherIter->second;
+
+        return addEntry (otherKey, kind, "other");
+    }
+
+    ++numNamedEntries;
+    return addEntry (key, kind, name);
+}
+
+EngineMetrics::Entry& EngineMetrics::addEntry (const String& key, const char* kind, const String& name)
+{
+    auto* entry = new Entry();
+    entry->kind = kind;
+    entry->name = name;
+    entry->next = firstEntry.load (std::memory_order_relaxed);
+
+    // Only the engine's thread adds entries, so there's nothing to race against apart from the readers.
+    firstEntry.store (entry, std::memory_order_release);
+    entriesByKey[key] = entry;
+    return *entry;
+}
+
+void EngineMetrics::record (const char* kind, const String& name, int64 nanoseconds, Outcome outcome)
+{
+    getEntry (kind, name).latency.record (nanoseconds);
+
+    switch (outcome)
+    {
+        case Outcome::succeeded:    numSucceeded.fetch_add (1, std::memory_order_relaxed); break;
+        case Outcome::failed:       numFailed.fetch_add (1, std::memory_order_relaxed); break;
+        case Outcome::timedOut:     numTimedOut.fetch_add (1, std::memory_order_relaxed); break;
+        case Outcome::interrupted:  numInterrupted.fetch_add (1, std::memory_order_relaxed); break;
+        default:                    jassertfalse; break;
+    }
+}
+
+EngineMetrics::Snapshot EngineMetrics::createSnapshot() const
+{
+    Snapshot snapshot;
+
+    for (auto* e = firstEntry.load (std::memory_order_acquire); e != nullptr; e = e->next)
+        snapshot.entries.push_back ({ e->kind, e->name, e->latency.createSnapshot() });
+
+    snapshot.numSucceeded = numSucceeded.load (std::memory_order_relaxed);
+    snapshot.numFailed = numFailed.load (std::memory_order_relaxed);
+    snapshot.numTimedOut = numTimedOut.load (std::memory_order_relaxed);
+    snapshot.numInterrupted = numInterrupted.load (std::memory_order_relaxed);
+    return snapshot;
+}
+
+//==============================================================================
+namespace MetricsHelpers
+{
+    static String escapeLabel (const String& value)
+    {
+        return value.replace ("\\", "\\\\").replace ("\"", "\\\"").replace ("\n", "\\n");
+    }
+
+    static String toSeconds (int64 nanoseconds)
+    {
+        return String ((double) nanoseconds / 1.0e9, 9);
+    }
+
+    static const double percentiles[] = { 50.0, 99.0, 99.9 };
+    static const char* const quantileNames[] = { "0.5", "0.99", "0.999" };
+}
+
+String EngineMetrics::Snapshot::toPrometheusText (const String& prefix) const
+{
+    using namespace MetricsHelpers;
+
+    MemoryOutputStream mo;
+    const auto latencyName = prefix + "_call_duration_seconds";
+
+    mo << "# HELP " << latencyName << " How long calls into the engine took." << exportLineEnd
+       << "# TYPE " << latencyName << " summary" << exportLineEnd;
+
+    for (const auto& entry : entries)
+    {
+        const auto labels = "kind=\"" + escapeLabel (entry.kind) + "\",name=\"" + escapeLabel (entry.name) + "\"";
+
+        for (int i = 0; i < numElementsInArray (percentiles); ++i)
+            mo << latencyName << "{" << labels << ",quantile=\"" << quantileNames[i] << "\"} "
+               << toSeconds (entry.latency.getValueAtPercentile (percentiles[i])) << exportLineEnd;
+
+        mo << latencyName << "_sum{" << labels << "} " << toSeconds (entry.latency.totalNanoseconds) << exportLineEnd
+           << latencyName << "_count{" << labels << "} " << String (entry.latency.numValues) << exportLineEnd;
+    }
+
+    const auto callsName = prefix + "_calls_total";
+
+    mo << "# HELP " << callsName << " Calls into the engine, by how they turned out." << exportLineEnd
+       << "# TYPE " << callsName << " counter" << exportLineEnd
+       << callsName << "{outcome=\"succeeded\"} " << String (numSucceeded) << exportLineEnd
+       << callsName << "{outcome=\"failed\"} " << String (numFailed) << exportLineEnd
+       << callsName << "{outcome=\"timed_out\"} " << String (numTimedOut) << exportLineEnd
+       << callsName << "{outcome=\"interrupted\"} " << String (numInterrupted) << exportLineEnd;
+
+    return mo.toString();
+}
+
+var EngineMetrics::Snapshot::toVar() const
+{
+    Array<var> list;
+
+    for (const auto& entry : entries)
+    {
+        DynamicObject::Ptr o (new DynamicObject());
+        o->setProperty ("kind", entry.kind);
+        o->setProperty ("name", entry.name);
+        o->setProperty ("count", entry.latency.numValues);
+        o->setProperty ("meanNs", entry.latency.getMeanNanoseconds());
+        o->setProperty ("p50Ns", entry.latency.getValueAtPercentile (50.0));
+        o->setProperty ("p99Ns", entry.latency.getValueAtPercentile (99.0));
+        o->setProperty ("p999Ns", entry.latency.getValueAtPercentile (99.9));
+        o->setProperty ("maxNs", entry.latency.maximumNanoseconds);
+        list.add (o.get());
+    }
+
+    DynamicObject::Ptr result (new DynamicObject());
+    result->setProperty ("calls", list);
+    result->setProperty ("succeeded", numSucceeded);
+    result->setProperty ("failed", numFailed);
+    result->setProperty ("timedOut", numTimedOut);
+    result->setProperty ("interrupted", numInterrupted);
+    return result.get();
+}
@@ -0,0 +1,169 @@
+//==============================================================================
+/** A histogram of latencies in nanoseconds, along the lines of an HDR histogram.
+
+    Values are bucketed by their magnitude, and each power of two is split into
+    32 sub-buckets, so every percentile comes out within about 3% of the real
+    value, from a nanosecond up to about 18 minutes. Anything longer than that is
+    counted as the longest value the histogram can hold.
+
+    Recording a value is a handful of relaxed atomic increments, so a histogram
+    can be read from any other thread while it's being recorded into.
+*/
+class LatencyHistogram final
+{
+public:
+    /** */
+    LatencyHistogram() = default;
+
+    //==============================================================================
+    /** Adds a value. This can be called from any thread. */
+    void record (int64 nanoseconds) noexcept;
+
+    //==============================================================================
+    /** A copy of a histogram's counts, taken at some point in time. */
+    struct Snapshot
+    {
+        std::vector<int64> counts;
+        int64 numValues = 0;
+        int64 totalNanoseconds = 0;
+        int64 maximumNanoseconds = 0;
+
+        /** @returns the value that the given percentage of values are at or below, eg: 99.9 for the p999. */
+        int64 getValueAtPercentile (double percentile) const noexcept;
+
+        /** */
+        double getMeanNanoseconds() const noexcept { return numValues > 0 ? (double) totalNanoseconds / (double) numValues : 0.0; }
+    };
+
+    /** Copies out the counts, without holding up anything that's recording at the same time.
+
+        Since values can be recorded while this is going on, the snapshot might
+        include some of the counts of a value being recorded but not others.
+    */
+    Snapshot createSnapshot() const;
+
+    //==============================================================================
+    /** @returns the index of the bucket that a value goes in. */
+    static int getBucketIndex (int64 nanoseconds) noexcept;
+
+    /** @returns the highest value that goes into a bucket. */
+    static int64 getBucketUpperBound (int index) noexcept;
+
+    enum
+    {
+        subBucketBits = 5,
+        numSubBuckets = 1 << subBucketBits,
+        maximumMagnitude = 40,
+        numBuckets = (maximumMagnitude - subBucketBits + 1) * numSubBuckets
+    };
+
+private:
+    //==============================================================================
+    std::atomic<int64> counts[numBuckets] = {};
+    std::atomic<int64> totalNanoseconds { 0 }, maximumNanoseconds { 0 };
+
+    //==============================================================================
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (LatencyHistogram)
+};
+
+//==============================================================================
+/** Latency histograms and outcome counters for the calls that a host makes into an engine.
+
+    Each distinct script passed to JavascriptEngine::execute() or JavascriptEngine::evaluate(),
+    and each function called with JavascriptEngine::callFunction(), gets a histogram of its own.
+    Scripts are told apart by a hash of their code. So that a host that runs lots of one-off
+    scripts doesn't grow this forever, only the first 256 of them get their own histogram,
+    and any after that are counted together under the name "other".
+
+    The engine records into this on its own thread, while any other thread can read it at the
+    same time without taking a lock, so it can be scraped regularly without pausing the scripts.
+
+    @see JavascriptEngine::setMetricsEnabled
+*/
+class EngineMetrics final : public ReferenceCountedObject
+{
+public:
+    //==============================================================================
+    /** */
+    using Ptr = ReferenceCountedObjectPtr<EngineMetrics>;
+
+    /** */
+    EngineMetrics() = default;
+    /** */
+    ~EngineMetrics() override;
+
+    //==============================================================================
+    /** How a call into the engine turned out. */
+    enum class Outcome
+    {
+        succeeded,
+        failed,         /**< The script threw an error, or there was a syntax error. */
+        timedOut,       /**< The script ran for longer than JavascriptEngine::maximumExecutionTime. */
+        interrupted     /**< JavascriptEngine::stop() was called while the script was running. */
+    };
+
+    /** Records the latency and the outcome of a call into the engine.
+
+        This must only be called on the engine's thread.
+
+        @param kind             The kind of call, eg: "execute" or "callFunction".
+        @param name             What was called: a script's hash, or a function's name.
+        @param nanoseconds      How long the call took.
+        @param outcome          How it turned out.
+    */
+    void record (const char* kind, const String& name, int64 nanoseconds, Outcome outcome);
+
+    //==============================================================================
+    /** A copy of the measurements of one kind of call. */
+    struct EntrySnapshot
+    {
+        String kind, name;
+        LatencyHistogram::Snapshot latency;
+    };
+
+    /** A copy of all of the measurements, taken at some point in time. */
+    struct Snapshot
+    {
+        std::vector<EntrySnapshot> entries;
+        int64 numSucceeded = 0, numFailed = 0, numTimedOut = 0, numInterrupted = 0;
+
+        /** @returns the measurements in the Prometheus text exposition format.
+
+            The latencies are written out as summaries with p50, p99 and p999 quantiles,
+            and the outcomes as counters.
+
+            @param prefix   Goes at the start of each metric's name.
+        */
+        String toPrometheusText (const String& prefix = "sp_javascript") const;
+
+        /** @returns the measurements as an object, ready to be written out as JSON. */
+        var toVar() const;
+    };
+
+    /** Copies out all of the measurements. This can be called from any thread. */
+    Snapshot createSnapshot() const;
+
+private:
+    //==============================================================================
+    struct Entry
+    {
+        String kind, name;
+        LatencyHistogram latency;
+        Entry* next = nullptr;
+    };
+
+    // New entries are pushed onto the front of this list, and are never removed, so readers can walk it without a lock.
+    std::atomic<Entry*> firstEntry { nullptr };
+    // Only ever touched on the engine's thread.
+    std::map<String, Entry*> entriesByKey;
+    std::atomic<int64> numSucceeded { 0 }, numFailed { 0 }, numTimedOut { 0 }, numInterrupted { 0 };
+    int numNamedEntries = 0;
+
+    enum { maximumNumNamedEntries = 256 };
+
+    Entry& getEntry (const char* kind, const String& name);
+    Entry& addEntry (const String& key, const char* kind, const String& name);
+
+    //==============================================================================
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (EngineMetrics)
+};
@@ -0,0 +1,437 @@
+EventLoop::EventLoop() :
+    wheelTime (getCurrentTime()),
+    mailbox (new Mailbox())
+{
+    mailbox->loop = this;
+}
+
+EventLoop::~EventLoop()
+{
+    const ScopedLock sl (mailbox->lock);
+    mailbox->loop = nullptr;
+}
+
+//==============================================================================
+int EventLoop::getLevel (int slot) noexcept
+{
+    return slot < firstLevelSize ? 0 : 1 + (slot - firstLevelSize) / levelSize;
+}
+
+int EventLoop::getLevelShift (int level) noexcept
+{
+    return level == 0 ? 0 : firstLevelBits + (level - 1) * levelBits;
+}
+
+int EventLoop::getSlot (int level, int64 time) noexcept
+{
+    if (level == 0)
+        return (int) (time & (firstLevelSize - 1));
+
+    return firstLevelSize + (level - 1) * levelSize
+         + (int) ((time >> getLevelShift (level)) & (levelSize - 1));
+}
+
+//==============================================================================
+void EventLoop::append (int slot, int nodeIndex) noexcept
+{
+    auto& s = slots[slot];
+    auto& node = nodes[(size_t) nodeIndex];
+
+    node.slot = slot;
+    node.previous = s.tail;
+    node.next = -1;
+
+    if (s.tail >= 0)
+        nodes[(size_t) s.tail].next = nodeIndex;
+    else
+        s.head = nodeIndex;
+
+    s.tail = nodeIndex;
+    ++levelCounts[getLevel (slot)];
+    ++numScheduled;
+}
+
+void EventLoop::unlink (int nodeIndex) noexcept
+{
+    auto& node = nodes[(size_t) nodeIndex];
+    auto& s = slots[node.slot];
+
+    if (node.previous >= 0) nodes[(size_t) node.previous].next = node.next;
+    else                    s.head = node.next;
+
+    if (node.next >= 0)     nodes[(size_t) node.next].previous = node.previous;
+    else                    s.tail = node.previous;
+
+    --levelCounts[getLevel (node.slot)];
+    --numScheduled;
+    node.previous = node.next = -1;
+    node.slot = noSlot;
+}
+
+int EventLoop::takeSlot (int slot) noexcept
+{
+    auto& s = slots[slot];
+    const auto head = s.head;
+
+    for (auto i = head; i >= 0; i = nodes[(size_t) i].next)
+    {
+        nodes[(size_t) i].slot = noSlot;
+        --levelCounts[getLevel (slot)];
+        --numScheduled;
+    }
+
+    s.head = s.tail = -1;
+    return head;
+}
+
+void EventLoop::schedule (int nodeIndex)
+{
+    const auto expiry = jmax (nodes[(size_t) nodeIndex].expiry, wheelTime);
+    const auto delta = expiry - wheelTime;
+
+    if (delta < firstLevelSize)
+    {
+        append (getSlot (0, expiry), nodeIndex);
+        return;
+    }
+
+    int level = 1;
+
+    while (level < numLevels - 1 && delta >= ((int64) 1 << getLevelShift (level + 1)))
+        ++level;
+
+    // Anything out of the wheel's reach waits in the top level, and gets looked at again when that slot comes round.
+    const auto reach = ((int64) 1 << getLevelShift (numLevels)) - 1;
+    append (getSlot (level, jmin (expiry, wheelTime + reach)), nodeIndex);
+}
+
+void EventLoop::cascade (int level)
+{
+    for (auto i = takeSlot (getSlot (level, wheelTime)); i >= 0;)
+    {
+        const auto next = nodes[(size_t) i].next;
+        schedule (i);
+        i = next;
+    }
+}
+
+void EventLoop::advanceTo (int64 now)
+{
+    while (wheelTime <= now)
+    {
+        if (numScheduled == 0)
+        {
+            wheelTime = now + 1;
+            break;
+        }
+
+        // When a level comes round to its start, the next slot of the level above gets spread out over the ones below.
+        for (int level = 1; level < numLevels; ++level)
+        {
+            if ((wheelTime & (((int64) 1 << getLevelShift (level)) - 1)) != 0)
+                break;
+
+            cascade (level);
+        }
+
+        for (auto i = takeSlot (getSlot (0, wheelTime)); i >= 0;)
+        {
+            auto& node = nodes[(size_t) i];
+            const auto next = node.next;
+
+            node.slot = dueSlot;
+            node.previous = node.next = -1;
+            dueTimers.push_back ({ i, node.generation });
+            i = next;
+        }
+
+        ++wheelTime;
+
+        // Skip over the stretches where nothing could possibly happen, rather than going a millisecond at a time.
+        int numEmptyLevels = 0;
+
+        while (numEmptyLevels < numLevels - 1 && levelCounts[numEmptyLevels] == 0)
+            ++numEmptyLevels;
+
+        if (numEmptyLevels > 0)
+        {
+            const auto span = (int64) 1 << getLevelShift (numEmptyLevels);
+            wheelTime = jmin ((wheelTime + span - 1) & ~(span - 1), now + 1);
+        }
+    }
+}
+
+void EventLoop::release (int nodeIndex)
+{
+    auto& node = nodes[(size_t) nodeIndex];
+
+    if (node.slot >= 0)
+        unlink (nodeIndex);
+
+    node.task = {};
+    node.slot = noSlot;
+    ++node.generation;
+    --numTimers;
+    freeNodes.push_back (nodeIndex);
+}
+
+//==============================================================================
+int64 EventLoop::addTimer (Task task, double delayMs, bool repeats)
+{
+    int index = 0;
+
+    if (! freeNodes.empty())
+    {
+        index = freeNodes.back();
+        freeNodes.pop_back();
+    }
+    else
+    {
+        if (nodes.size() >= (size_t) maximumNumTimers)
+            throw String ("Too many timers are pending");
+
+        index = (int) nodes.size();
+        nodes.emplace_back();
+    }
+
+    const auto delay = std::isfinite (delayMs) && delayMs > 0.0
+                        ? (int64) jmin (delayMs, (double) std::numeric_limits<int32>::max())
+                        : (int64) 0;
+
+    const auto now = getCurrentTime();
+
+    // With nothing in the wheel, there's no need to make it catch up with the time before adding to it.
+    if (numScheduled == 0)
+        wheelTime = jmax (wheelTime, now);
+
+    auto& node = nodes[(size_t) index];
+    node.task = std::move (task);
+    node.expiry = now + delay;
+    node.interval = repeats ? jmax ((int64) 1, delay) : -1;
+
+    ++numTimers;
+    schedule (index);
+
+    return (node.generation << timerIndexBits) | (int64) (index + 1);
+}
+
+void EventLoop::cancelTimer (int64 timerId)
+{
+    const auto index = (int) (timerId & maximumNumTimers) - 1;
+
+    if (isPositiveAndBelow (index, (int) nodes.size())
+        && nodes[(size_t) index].generation == (timerId >> timerIndexBits)
+        && nodes[(size_t) index].slot != noSlot)
+        release (index);
+}
+
+bool EventLoop::getNextDueTimer (int64 now, Task& result)
+{
+    advanceTo (now);
+
+    while (! dueTimers.empty())
+    {
+        const auto due = dueTimers.front();
+        dueTimers.pop_front();
+
+        auto& node = nodes[(size_t) due.index];
+
+        // This one was cancelled after it became due.
+        if (node.generation != due.generation || node.slot != dueSlot)
+            continue;
+
+        if (node.interval < 0)
+        {
+            result = std::move (node.task);
+            release (due.index);
+            return true;
+        }
+
+        result = node.task;
+
+        // Intervals that were missed altogether are dropped, rather than being fired in a burst.
+        node.expiry += node.interval;
+
+        if (node.expiry <= now)
+            node.expiry = now + node.interval;
+
+        node.slot = noSlot;
+        schedule (due.index);
+        return true;
+    }
+
+    return false;
+}
+
+int64 EventLoop::getTimeUntilNextTimer (int64 now) const noexcept
+{
+    if (! dueTimers.empty())
+        return 0;
+
+    if (numScheduled == 0)
+        return -1;
+
+    auto next = std::numeric_limits<int64>::max();
+
+    if (levelCounts[0] > 0)
+    {
+        for (auto time = wheelTime;; ++time)
+        {
+            if (slots[getSlot (0, time)].head >= 0)
+            {
+                next = time;
+                break;
+            }
+        }
+    }
+
+    // Timers in the levels above can't be due any sooner than the next time the lowest of them cascades.
+    for (int level = 1; level < numLevels; ++level)
+    {
+        if (levelCounts[level] > 0)
+        {
+            const auto span = (int64) 1 << getLevelShift (level);
+            next = jmin (next, (wheelTime + span - 1) & ~(span - 1));
+            break;
+        }
+    }
+
+    return jmax ((int64) 0, next - now);
+}
+
+//==============================================================================
+void EventLoop::queueMicrotask (Task task)
+{
+    microtasks.push_back (std::move (task));
+}
+
+bool EventLoop::getNextMicrotask (Task& result)
+{
+    if (microtasks.empty())
+        return false;
+
+    result = std::move (microtasks.front());
+    microtasks.pop_front();
+    return true;
+}
+
+//==============================================================================
+void EventLoop::Mailbox::post (Completion completion)
+{
+    const ScopedLock sl (lock);
+
+    // The engine has gone, so there's nobody left to tell.
+    if (loop == nullptr)
+        return;
+
+    completions.push_back (std::move (completion));
+    loop->wakeUp();
+}
+
+int64 EventLoop::addPendingPromise (const var& promise)
+{
+    const auto id = nextPromiseId++;
+    pendingPromises[id] = promise;
+    return id;
+}
+
+var EventLoop::getPendingPromise (int64 id) const
+{
+    const auto iter = pendingPromises.find (id);
+    return iter != pendingPromises.end() ? iter->second : var();
+}
+
+bool EventLoop::takeNextCompletion (var& promise, var& value, bool& isRejected)
+{
+    for (;;)
+    {
+        Completion completion;
+
+        {
+            const ScopedLock sl (mailbox->lock);
+
+            if (mailbox->completions.empty())
+                return false;
+
+            completion = std::move (mailbox->completions.front());
+            mailbox->completions.pop_front();
+        }
+
+        const auto iter = pendingPromises.find (completion.id);
+
+        // This one was dropped by clear() while its completion was on the way.
+        if (iter == pendingPromises.end())
+            continue;
+
+        promise = std::move (iter->second);
+        pendingPromises.erase (iter);
+        value = std::move (completion.value);
+        isRejected = completion.isRejected;
+        return true;
+    }
+}
+
+//==============================================================================
+void EventLoop::clear()
+{
+    // Dropping the tasks can run destructors that want to touch the loop, so they're moved out of it first.
+    auto oldNodes = std::move (nodes);
+    auto oldMicrotasks = std::move (microtasks);
+    auto oldPendingPromises = std::move (pendingPromises);
+
+    nodes.clear();
+    freeNodes.clear();
+    dueTimers.clear();
+    microtasks.clear();
+    pendingPromises.clear();
+
+    {
+        const ScopedLock sl (mailbox->lock);
+        mailbox->completions.clear();
+    }
+
+    for (auto& s : slots)
+        s = {};
+
+    for (auto& count : levelCounts)
+        count = 0;
+
+    numTimers = numScheduled = 0;
+}
+
+//==============================================================================
+PendingPromise::PendingPromise()
+{
+    auto* root = RootObject::getCurrent();
+
+    if (root == nullptr)
+        throw String ("A PendingPromise can only be created while a script is running");
+
+    mailbox = root->eventLoop.getMailbox();
+    id = root->eventLoop.addPendingPromise (PromiseClass::create());
+}
+
+PendingPromise::~PendingPromise()
+{
+    if (! settled)
+        settle ("The pending promise was deleted without being settled", true);
+}
+
+var PendingPromise::getPromise() const
+{
+    const ScopedLock sl (mailbox->lock);
+
+    if (mailbox->loop != nullptr)
+        return mailbox->loop->getPendingPromise (id);
+
+    return {};
+}
+
+void PendingPromise::resolve (const var& value)    { settle (value, false); }
+void PendingPromise::reject (const var& reason)    { settle (reason, true); }
+
+void PendingPromise::settle (const var& value, bool isRejected)
+{
+    if (! settled.exchange (true))
+        mailbox->post ({ id, value, isRejected });
+}
@@ -0,0 +1,281 @@
+//==============================================================================
+/** Schedules the deferred work of an engine: the timers that scripts set up
+    with setTimeout() and setInterval(), and the queue of microtasks that get
+    run after each task.
+
+    Timers are kept in a hierarchical timing wheel, so adding or cancelling one
+    costs the same however many others are pending. The first level of the wheel
+    has a slot for each millisecond of the next 256, and each level above it covers
+    64 times the span of the one below. Whenever a level comes round to the start,
+    the next slot of the level above is emptied out and its timers are spread over
+    the levels below, so each timer only gets moved a handful of times before it fires.
+    Timers that are further away than the wheel reaches (about 49 days) wait in
+    its top level until they come into range.
+
+    None of this needs a message thread: the host gives the engine a chance to run
+    its tasks with JavascriptEngine::runPendingTasks() or JavascriptEngine::runEventLoop().
+
+    It also keeps hold of the promises that the host has handed out with PendingPromise,
+    until they get settled.
+
+    Like the rest of the engine, this isn't thread-safe, apart from wakeUp(), requestStop()
+    and the Mailbox that PendingPromise objects post to.
+*/
+class EventLoop final
+{
+public:
+    /** */
+    EventLoop();
+    /** */
+    ~EventLoop();
+
+    //==============================================================================
+    /** A piece of work for the engine: a function to call, along with its arguments.
+
+        The function can also be a string of code to execute, which
+        is what setTimeout() does when it's given one.
+    */
+    struct Task
+    {
+        var function;
+        Array<var> arguments;
+    };
+
+    //==============================================================================
+    /** Adds a timer, returning an ID that can be passed to cancelTimer().
+
+        @param task         What to run once the timer fires.
+        @param delayMs      How long to wait, in milliseconds. Anything that
+                            isn't a positive number is taken to be 0.
+        @param repeats      If true, the timer keeps firing at this interval until it's cancelled.
+    */
+    int64 addTimer (Task task, double delayMs, bool repeats);
+
+    /** Cancels a timer. This does nothing if the timer has already fired or been cancelled. */
+    void cancelTimer (int64 timerId);
+
+    /** @returns the number of timers that are waiting to fire. */
+    int getNumTimers() const noexcept { return numTimers; }
+
+    /** Finds the next timer that was due by a given time.
+
+        One-off timers are removed, and repeating ones get rescheduled.
+
+        @returns false if there aren't any more timers due.
+    */
+    bool getNextDueTimer (int64 now, Task& result);
+
+    /** @returns the number of milliseconds until the next timer could be due, or -1 if there aren't any.
+
+        For timers that are a long way off, this can come back early:
+        that just means having a look for due timers to no avail.
+    */
+    int64 getTimeUntilNextTimer (int64 now) const noexcept;
+
+    //==============================================================================
+    /** Adds a task to the back of the microtask queue. */
+    void queueMicrotask (Task task);
+
+    /** Takes the task at the front of the microtask queue, returning false if it's empty. */
+    bool getNextMicrotask (Task& result);
+
+    /** @returns true if there are any microtasks waiting to be run. */
+    bool hasMicrotasks() const noexcept { return ! microtasks.empty(); }
+
+    //==============================================================================
+    /** @returns the time that the timers are measured against, in milliseconds.
+        This is a monotonic clock, so it doesn't jump about when the system's clock gets changed.
+    */
+    static int64 getCurrentTime() noexcept { return (int64) Time::getMillisecondCounterHiRes(); }
+
+    /** Blocks until either the timeout elapses or wakeUp() gets called. */
+    void wait (int timeoutMs)                   { wakeUpEvent.wait (timeoutMs); }
+
+    /** Interrupts a call to wait(). This can be called from any thread. */
+    void wakeUp() noexcept                      { wakeUpEvent.signal(); }
+
+    /** Asks a running event loop to return as soon as it can. This can be called from any thread. */
+    void requestStop() noexcept                 { stopRequested = true; wakeUp(); }
+    /** */
+    bool isStopRequested() const noexcept       { return stopRequested; }
+    /** */
+    void resetStopRequest() noexcept            { stopRequested = false; }
+
+    //==============================================================================
+    /** A promise that the host has settled, waiting to be picked up by the engine's thread. */
+    struct Completion
+    {
+        int64 id = 0;
+        var value;
+        bool isRejected = false;
+    };
+
+    /** Where PendingPromise objects post their results to. They keep hold of this
+        rather than the loop itself, so that they can safely outlive the engine.
+    */
+    struct Mailbox final : public ReferenceCountedObject
+    {
+        /** Hands a completion over to the loop, and wakes it up. This can be called from any thread. */
+        void post (Completion completion);
+
+        CriticalSection lock;
+        std::deque<Completion> completions;
+        EventLoop* loop = nullptr;
+    };
+
+    /** */
+    ReferenceCountedObjectPtr<Mailbox> getMailbox() const noexcept { return mailbox; }
+
+    /** Keeps hold of a promise that the host is going to settle, returning the ID to post its completion with. */
+    int64 addPendingPromise (const var& promise);
+
+    /** @returns a promise that was added with addPendingPromise(), if it hasn't been settled yet. */
+    var getPendingPromise (int64 id) const;
+
+    /** @returns the number of promises that the host has yet to settle. */
+    int getNumPendingPromises() const noexcept { return (int) pendingPromises.size(); }
+
+    /** Takes the next completion that has been posted, along with the promise it's for.
+
+        @returns false if there aren't any more.
+    */
+    bool takeNextCompletion (var& promise, var& value, bool& isRejected);
+
+    //==============================================================================
+    /** Drops every timer, microtask and pending promise. */
+    void clear();
+
+private:
+    //==============================================================================
+    enum
+    {
+        firstLevelBits      = 8,
+        levelBits           = 6,
+        numLevels           = 5,
+        firstLevelSize      = 1 << firstLevelBits,
+        levelSize           = 1 << levelBits,
+        numSlots            = firstLevelSize + (numLevels - 1) * levelSize,
+        timerIndexBits      = 20,
+        maximumNumTimers    = (1 << timerIndexBits) - 1,
+        noSlot              = -1,
+        dueSlot             = -2
+    };
+
+    struct TimerNode
+    {
+        Task task;
+        int64 expiry = 0, interval = -1;
+        int64 generation = 1;
+        int previous = -1, next = -1, slot = noSlot;
+    };
+
+    struct Slot
+    {
+        int head = -1, tail = -1;
+    };
+
+    struct DueTimer
+    {
+        int index;
+        int64 generation;
+    };
+
+    std::vector<TimerNode> nodes;
+    std::vector<int> freeNodes;
+    Slot slots[numSlots];
+    int levelCounts[numLevels] = {};
+    std::deque<DueTimer> dueTimers;
+    std::deque<Task> microtasks;
+    int64 wheelTime = 0;
+    int numTimers = 0, numScheduled = 0;
+    WaitableEvent wakeUpEvent;
+    std::atomic<bool> stopRequested { false };
+    ReferenceCountedObjectPtr<Mailbox> mailbox;
+    std::unordered_map<int64, var> pendingPromises;
+    int64 nextPromiseId = 1;
+
+    //==============================================================================
+    static int getLevel (int slot) noexcept;
+    static int getLevelShift (int level) noexcept;
+    static int getSlot (int level, int64 time) noexcept;
+
+    void schedule (int nodeIndex);
+    void append (int slot, int nodeIndex) noexcept;
+    void unlink (int nodeIndex) noexcept;
+    int takeSlot (int slot) noexcept;
+    void cascade (int level);
+    void advanceTo (int64 now);
+    void release (int nodeIndex);
+
+    //==============================================================================
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (EventLoop)
+};
+
+//==============================================================================
+/** A promise that a native function hands back to a script, and that gets settled
+    later on, from whichever thread the work ends up being done on.
+
+    This is how a native function can kick off something slow without holding up the
+    engine: the script carries on with its other work, and the code awaiting the promise
+    resumes when the engine next runs its tasks after the promise has been settled.
+
+    @code
+        static var loadPreset (const var::NativeFunctionArgs& args)
+        {
+            PendingPromise::Ptr pending (new PendingPromise());
+            const auto name = args.arguments[0].toString();
+
+            Thread::launch ([pending, name]
+            {
+                const auto file = getPresetFolder().getChildFile (name);
+
+                if (file.existsAsFile())
+                    pending->resolve (file.loadFileAsString());
+                else
+                    pending->reject ("No such preset: " + name);
+            });
+
+            return pending->getPromise();
+        }
+    @endcode
+
+    The value that it's settled with is handed over to the engine's thread, so it should
+    be something like a number or a string, rather than an object that belongs to the engine.
+
+    If it gets deleted without having been settled, the promise is rejected.
+*/
+class PendingPromise final : public ReferenceCountedObject
+{
+public:
+    /** */
+    using Ptr = ReferenceCountedObjectPtr<PendingPromise>;
+
+    /** Creates a promise belonging to the engine that's running on this thread,
+        so this has to be called from within one of its native functions.
+    */
+    PendingPromise();
+
+    /** Rejects the promise if it hasn't been settled yet. */
+    ~PendingPromise() override;
+
+    /** @returns the promise to hand to the script. This must only be called on the engine's thread. */
+    var getPromise() const;
+
+    /** Fulfils the promise. This can be called from any thread, and only the first call to this or reject() has any effect. */
+    void resolve (const var& value);
+
+    /** Rejects the promise. This can be called from any thread, and only the first call to this or resolve() has any effect. */
+    void reject (const var& reason);
+
+    /** */
+    bool isSettled() const noexcept { return settled; }
+
+private:
+    ReferenceCountedObjectPtr<EventLoop::Mailbox> mailbox;
+    int64 id = 0;
+    std::atomic<bool> settled { false };
+
+    void settle (const var& value, bool isRejected);
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PendingPromise)
+};
@@ -0,0 +1,97 @@
+//==============================================================================
+/** Counts of the work the interpreter did while running a script.
+
+    Unlike timings, these come out the same from one run to the next, which makes
+    them handy for capacity planning and for spotting a change that makes a script
+    do more work than it used to.
+
+    The counting is only compiled in when the module is built with
+    SP_JAVASCRIPT_ENABLE_INSTRUMENTATION set to 1. Otherwise, the counters
+    always read zero, and the interpreter doesn't spend a single instruction on them.
+
+    @see JavascriptEngine::getInstrumentationCounters
+*/
+struct InstrumentationCounters final
+{
+    /** Every kind of statement and expression that gets counted. */
+    #define SP_JS_INSTRUMENTED_NODE_TYPES(X) \
+        X (BlockStatement) X (IfStatement) X (VarStatement) X (LoopStatement) X (ForEachLoop) \
+        X (ReturnStatement) X (BreakStatement) X (ContinueStatement) X (LiteralValue) X (RegexLiteral) \
+        X (UnqualifiedName) X (DotOperator) X (ArraySubscript) X (BinaryOperator) X (LogicalAndOp) \
+        X (LogicalOrOp) X (TypeEqualsOp) X (TypeNotEqualsOp) X (ConditionalOp) X (Assignment) \
+        X (SelfAssignment) X (AppendAssignment) X (PostAssignment) X (FunctionCall) X (NewOperator) \
+        X (ObjectDeclaration) X (ArrayDeclaration) X (AwaitExpression) X (YieldExpression)
+
+    /** */
+    enum NodeType
+    {
+       #define SP_JS_DECLARE_NODE_TYPE(name) name,
+        SP_JS_INSTRUMENTED_NODE_TYPES (SP_JS_DECLARE_NODE_TYPE)
+       #undef SP_JS_DECLARE_NODE_TYPE
+        numNodeTypes
+    };
+
+    /** @returns the name of one of the NodeType values. */
+    static const char* getNodeTypeName (int type) noexcept
+    {
+        static const char* const names[] =
+        {
+           #define SP_JS_DECLARE_NODE_TYPE_NAME(name) #name,
+            SP_JS_INSTRUMENTED_NODE_TYPES (SP_JS_DECLARE_NODE_TYPE_NAME)
+           #undef SP_JS_DECLARE_NODE_TYPE_NAME
+        };
+
+        return isPositiveAndBelow (type, (int) numNodeTypes) ? names[type] : "";
+    }
+
+    //==============================================================================
+    /** The number of times each kind of statement was performed, or expression evaluated. */
+    int64 nodeEvaluations[numNodeTypes] = {};
+
+    int64 scriptCalls = 0;          /**< Calls to functions written in script. */
+    int64 nativeCalls = 0;          /**< Calls to native functions, including the built-in classes' methods. */
+    int64 objectAllocations = 0;    /**< Objects created, including arrays' and functions' wrappers, closures' scopes and class instances. */
+    int64 arrayAllocations = 0;     /**< Arrays created by array literals and by the methods and operators that return a new one. */
+    int64 stringAllocations = 0;    /**< Strings built by concatenation and by the methods that return a new one. */
+    int64 propertyLookups = 0;      /**< Properties looked up on an object, including each step of a variable's search through its scopes. */
+
+    //==============================================================================
+    /** @returns the total number of statements performed and expressions evaluated. */
+    int64 getTotalNodeEvaluations() const noexcept
+    {
+        int64 total = 0;
+
+        for (auto count : nodeEvaluations)
+            total += count;
+
+        return total;
+    }
+
+    /** @returns the total number of function calls. */
+    int64 getTotalCalls() const noexcept        { return scriptCalls + nativeCalls; }
+
+    /** Sets every counter back to zero. */
+    void reset() noexcept                       { *this = {}; }
+
+    /** @returns the counters as an object, ready to be written out as JSON.
+        Node types that were never evaluated are left out.
+    */
+    var toVar() const
+    {
+        DynamicObject::Ptr nodes (new DynamicObject());
+
+        for (int i = 0; i < numNodeTypes; ++i)
+            if (nodeEvaluations[i] > 0)
+                nodes->setProperty (getNodeTypeName (i), nodeEvaluations[i]);
+
+        DynamicObject::Ptr result (new DynamicObject());
+        result->setProperty ("nodeEvaluations", nodes.get());
+        result->setProperty ("scriptCalls", scriptCalls);
+        result->setProperty ("nativeCalls", nativeCalls);
+        result->setProperty ("objectAllocations", objectAllocations);
+        result->setProperty ("arrayAllocations", arrayAllocations);
+        result->setProperty ("stringAllocations", stringAllocations);
+        result->setProperty ("propertyLookups", propertyLookups);
+        return result.get();
+    }
+};
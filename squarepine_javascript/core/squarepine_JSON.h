@@ -0,0 +1,1082 @@
+//==============================================================================
+/** Word-at-a-time helpers for scanning JSON text.
+
+    These look at eight bytes at once using plain integer arithmetic, so they're
+    portable and don't depend on any particular instruction set. Each one returns
+    a non-zero mask if any byte in the word is of interest. A borrow can flag a byte
+    next to a real match, so a flagged word should be re-checked one byte at a time.
+*/
+struct JSONWords final
+{
+    static constexpr uint64 ones = 0x0101010101010101ULL;
+    static constexpr uint64 highBits = 0x8080808080808080ULL;
+
+    static uint64 load (const char* source) noexcept
+    {
+        uint64 word;
+        memcpy (&word, source, sizeof (word));
+        return word;
+    }
+
+    static uint64 findByte (uint64 word, uint8 byte) noexcept
+    {
+        const auto x = word ^ (ones * byte);
+        return (x - ones) & ~x & highBits;
+    }
+
+    static uint64 findBytesBelow (uint64 word, uint8 limit) noexcept
+    {
+        return (word - ones * limit) & ~word & highBits;
+    }
+
+    /** Finds the bytes that interrupt a plain run of string text: quotes, backslashes and control characters. */
+    static uint64 findStringSpecials (uint64 word) noexcept
+    {
+        return findByte (word, '"') | findByte (word, '\\') | findBytesBelow (word, 0x20);
+    }
+};
+
+//==============================================================================
+/** Parses JSON text straight into script values.
+
+    Objects are built as ScriptObjects so that they behave exactly like the ones
+    a script creates itself. Plain runs of string text are skipped over eight bytes
+    at a time, and object keys go through a small cache keyed on their raw bytes,
+    so the repeated keys of large documents don't keep going back to the global
+    identifier pool.
+
+    The memory used gets charged to the running engine's heap as the parse goes along.
+*/
+class ScriptJSONParser final
+{
+public:
+    /** Creates a parser for some UTF-8 text, which needs to outlive the parser. */
+    ScriptJSONParser (const char* data, size_t numBytes) noexcept :
+        start (data),
+        p (data),
+        end (data + numBytes)
+    {
+    }
+
+    /** Parses a complete document, throwing an error message if it isn't valid JSON. */
+    var parseDocument()
+    {
+        auto result = parseValue (0);
+        skipWhitespace();
+
+        if (p < end)
+            throwError ("Unexpected text after the end of the JSON");
+
+        chargePendingBytes();
+        return result;
+    }
+
+    /** The deepest that arrays and objects can be nested. */
+    enum { maximumDepth = 512 };
+
+private:
+    //==============================================================================
+    struct StringBytes
+    {
+        const char* data;
+        size_t size;
+        bool isASCII;
+    };
+
+    struct CachedKey
+    {
+        std::string bytes;
+        Identifier key;
+    };
+
+    enum { keyCacheSize = 256 };
+
+    const char* const start;
+    const char* p;
+    const char* const end;
+    std::string escapedText;
+    std::vector<CachedKey> keyCache;
+    int64 pendingBytes = 0;
+
+    //==============================================================================
+    void throwError (const String& message) const
+    {
+        int line = 1, column = 1;
+
+        for (auto* i = start; i < p; ++i)
+        {
+            ++column;
+
+            if (*i == '\n')
+            {
+                column = 1;
+                ++line;
+            }
+        }
+
+        throw "JSON line " + String (line) + ", column " + String (column) + " : " + message;
+    }
+
+    void charge (int64 numBytes)
+    {
+        pendingBytes += numBytes;
+
+        if (pendingBytes >= 65536)
+            chargePendingBytes();
+    }
+
+    void chargePendingBytes()
+    {
+        allocateScriptMemory (pendingBytes);
+        pendingBytes = 0;
+    }
+
+    static bool isDigit (char c) noexcept { return c >= '0' && c <= '9'; }
+
+    void skipWhitespace() noexcept
+    {
+        while (p < end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t'))
+            ++p;
+    }
+
+    void throwUnexpectedCharacter() const
+    {
+        if (p >= end)
+            throwError ("Unexpected end of input");
+
+        throwError ("Unexpected character '" + String::charToString ((juce_wchar) (uint8) *p) + "'");
+    }
+
+    void expect (char c)
+    {
+        if (p >= end || *p != c)
+            throwUnexpectedCharacter();
+
+        ++p;
+    }
+
+    void expectWord (const char* word, size_t length)
+    {
+        if ((size_t) (end - p) < length || memcmp (p, word, length) != 0)
+            throwUnexpectedCharacter();
+
+        p += length;
+    }
+
+    //==============================================================================
+    var parseValue (int depth)
+    {
+        skipWhitespace();
+
+        if (p < end)
+        {
+            switch (*p)
+            {
+                case '{':   return parseObject (depth + 1);
+                case '[':   return parseArray (depth + 1);
+                case '"':   return parseString();
+                case 't':   expectWord ("true", 4);  return true;
+                case 'f':   expectWord ("false", 5); return false;
+                case 'n':   expectWord ("null", 4);  return {};
+                default:    break;
+            }
+
+            if (*p == '-' || isDigit (*p))
+                return parseNumber();
+        }
+
+        throwUnexpectedCharacter();
+        return {};
+    }
+
+    var parseObject (int depth)
+    {
+        if (depth > maximumDepth)
+            throwError ("The JSON is nested too deeply");
+
+        ++p;
+
+        auto* object = new ScriptObject();
+        var result (object);
+        auto& properties = object->getProperties();
+
+        skipWhitespace();
+
+        if (p < end && *p == '}')
+        {
+            ++p;
+            return result;
+        }
+
+        for (;;)
+        {
+            skipWhitespace();
+
+            if (p >= end || *p != '"')
+                throwUnexpectedCharacter();
+
+            const auto key = getKey (parseStringBytes());
+
+            skipWhitespace();
+            expect (':');
+            properties.set (key, parseValue (depth));
+            charge ((int64) sizeof (NamedValueSet::NamedValue));
+
+            skipWhitespace();
+
+            if (p < end && *p == ',')
+            {
+                ++p;
+                continue;
+            }
+
+            expect ('}');
+            return result;
+        }
+    }
+
+    var parseArray (int depth)
+    {
+        if (depth > maximumDepth)
+            throwError ("The JSON is nested too deeply");
+
+        ++p;
+
+        Array<var> elements;
+        skipWhitespace();
+
+        if (p < end && *p == ']')
+        {
+            ++p;
+        }
+        else
+        {
+            for (;;)
+            {
+                elements.add (parseValue (depth));
+                skipWhitespace();
+
+                if (p < end && *p == ',')
+                {
+                    ++p;
+                    continue;
+                }
+
+                expect (']');
+                break;
+            }
+        }
+
+        SP_JS_COUNT (arrayAllocations);
+        charge (getAllocationSize (elements));
+        return var (std::move (elements));
+    }
+
+    //==============================================================================
+    var parseString()
+    {
+        const auto bytes = parseStringBytes();
+        charge ((int64) (sizeof (String) * 2 + bytes.size + 1));
+        return makeString (bytes);
+    }
+
+    /** Reads a string, returning its unescaped bytes.
+
+        If the string has no escape sequences (which is the usual case),
+        the bytes are left where they are in the source text.
+    */
+    StringBytes parseStringBytes()
+    {
+        ++p;
+
+        auto* runStart = p;
+        uint64 seenBits = 0;
+        bool isEscaped = false;
+
+        for (;;)
+        {
+            while (end - p >= 8)
+            {
+                const auto word = JSONWords::load (p);
+
+                if (JSONWords::findStringSpecials (word) != 0)
+                    break;
+
+                seenBits |= word;
+                p += 8;
+            }
+
+            if (p >= end)
+                throwError ("Unterminated string");
+
+            const auto c = (uint8) *p;
+
+            if (c == '"')
+            {
+                const auto* runEnd = p++;
+                const auto isASCII = (seenBits & JSONWords::highBits) == 0;
+
+                if (! isEscaped)
+                    return { runStart, (size_t) (runEnd - runStart), isASCII };
+
+                escapedText.append (runStart, runEnd);
+                return { escapedText.data(), escapedText.size(), isASCII };
+            }
+
+            if (c == '\\')
+            {
+                if (! isEscaped)
+                    escapedText.clear();
+
+                isEscaped = true;
+                escapedText.append (runStart, p);
+                ++p;
+
+                if (parseEscapeSequence())
+                    seenBits |= 0x80;
+
+                runStart = p;
+                continue;
+            }
+
+            if (c < 0x20)
+                throwError ("Strings can't contain control characters");
+
+            seenBits |= c;
+            ++p;
+        }
+    }
+
+    /** Appends an escaped character to the unescaped text, returning true if it wasn't ASCII. */
+    bool parseEscapeSequence()
+    {
+        if (p >= end)
+            throwError ("Unterminated string");
+
+        const auto c = *p++;
+
+        switch (c)
+        {
+            case '"':
+            case '\\':
+            case '/':   escapedText += c; return false;
+            case 'b':   escapedText += '\b'; return false;
+            case 'f':   escapedText += '\f'; return false;
+            case 'n':   escapedText += '\n'; return false;
+            case 'r':   escapedText += '\r'; return false;
+            case 't':   escapedText += '\t'; return false;
+            case 'u':   break;
+
+            default:
+                --p;
+                throwError ("Invalid escape sequence");
+                break;
+        }
+
+        auto codePoint = parseHexQuad();
+
+        if (codePoint >= 0xd800 && codePoint < 0xdc00
+            && end - p >= 6 && p[0] == '\\' && p[1] == 'u')
+        {
+            const auto* lowSurrogateStart = p;
+            p += 2;
+            const auto low = parseHexQuad();
+
+            if (low >= 0xdc00 && low < 0xe000)
+                codePoint = 0x10000 + ((codePoint - 0xd800) << 10) + (low - 0xdc00);
+            else
+                p = lowSurrogateStart;
+        }
+
+        // A lone surrogate can't be represented in UTF-8.
+        if (codePoint >= 0xd800 && codePoint < 0xe000)
+            codePoint = 0xfffd;
+
+        appendUTF8 (codePoint);
+        return codePoint >= 0x80;
+    }
+
+    uint32 parseHexQuad()
+    {
+        if (end - p < 4)
+            throwError ("Invalid unicode escape sequence");
+
+        uint32 value = 0;
+
+        for (int i = 0; i < 4; ++i)
+        {
+            const auto digit = CharacterFunctions::getHexDigitValue ((juce_wchar) (uint8) *p);
+
+            if (digit < 0)
+                throwError ("Invalid unicode escape sequence");
+
+            value = (value << 4) | (uint32) digit;
+            ++p;
+        }
+
+        return value;
+    }
+
+    void appendUTF8 (uint32 codePoint)
+    {
+        if (codePoint < 0x80)
+        {
+            escapedText += (char) codePoint;
+        }
+        else if (codePoint < 0x800)
+        {
+            escapedText += (char) (0xc0 | (codePoint >> 6));
+            escapedText += (char) (0x80 | (codePoint & 0x3f));
+        }
+        else if (codePoint < 0x10000)
+        {
+            escapedText += (char) (0xe0 | (codePoint >> 12));
+            escapedText += (char) (0x80 | ((codePoint >> 6) & 0x3f));
+            escapedText += (char) (0x80 | (codePoint & 0x3f));
+        }
+        else
+        {
+            escapedText += (char) (0xf0 | (codePoint >> 18));
+            escapedText += (char) (0x80 | ((codePoint >> 12) & 0x3f));
+            escapedText += (char) (0x80 | ((codePoint >> 6) & 0x3f));
+            escapedText += (char) (0x80 | (codePoint & 0x3f));
+        }
+    }
+
+    String makeString (const StringBytes& bytes) const
+    {
+        if (bytes.size == 0)
+            return {};
+
+        if (! bytes.isASCII && ! CharPointer_UTF8::isValidString (bytes.data, (int) bytes.size))
+            throwError ("Strings must be valid UTF-8");
+
+        return String (CharPointer_UTF8 (bytes.data), CharPointer_UTF8 (bytes.data + bytes.size));
+    }
+
+    Identifier getKey (const StringBytes& bytes)
+    {
+        // An Identifier can't be made from an empty string, but a null one works just as well as a property name.
+        if (bytes.size == 0)
+            return {};
+
+        if (keyCache.empty())
+            keyCache.resize (keyCacheSize);
+
+        uint32 hash = 2166136261u;
+
+        for (size_t i = 0; i < bytes.size; ++i)
+            hash = (hash ^ (uint8) bytes.data[i]) * 16777619u;
+
+        auto& cached = keyCache[hash & (keyCacheSize - 1)];
+
+        if (cached.bytes.size() != bytes.size
+            || memcmp (cached.bytes.data(), bytes.data, bytes.size) != 0)
+        {
+            cached.key = Identifier (makeString (bytes));
+            cached.bytes.assign (bytes.data, bytes.size);
+        }
+
+        return cached.key;
+    }
+
+    //==============================================================================
+    var parseNumber()
+    {
+        const auto* numberStart = p;
+        const auto isNegative = *p == '-';
+
+        if (isNegative)
+            ++p;
+
+        if (p >= end || ! isDigit (*p))
+            throwError ("Invalid number");
+
+        uint64 mantissa = 0;
+        int numDigits = 0;
+
+        if (*p == '0')
+        {
+            ++p;
+
+            if (p < end && isDigit (*p))
+                throwError ("Numbers can't have leading zeros");
+        }
+        else
+        {
+            for (; p < end && isDigit (*p); ++p, ++numDigits)
+                mantissa = mantissa * 10 + (uint64) (*p - '0');
+        }
+
+        auto isInteger = true;
+
+        if (p < end && *p == '.')
+        {
+            isInteger = false;
+            skipDigits();
+        }
+
+        if (p < end && (*p == 'e' || *p == 'E'))
+        {
+            isInteger = false;
+
+            if (end - p > 1 && (p[1] == '+' || p[1] == '-'))
+                ++p;
+
+            skipDigits();
+        }
+
+        if (isInteger && numDigits <= 18)
+        {
+            if (mantissa == 0)
+                return isNegative ? var (-0.0) : var (0);
+
+            const auto value = isNegative ? -(int64) mantissa : (int64) mantissa;
+
+            if (value >= std::numeric_limits<int>::min() && value <= std::numeric_limits<int>::max())
+                return (int) value;
+
+            return value;
+        }
+
+        return parseDouble (numberStart, p);
+    }
+
+    /** Skips the character before some digits, then the digits, of which there must be at least one. */
+    void skipDigits()
+    {
+        ++p;
+
+        if (p >= end || ! isDigit (*p))
+            throwError ("Invalid number");
+
+        while (p < end && isDigit (*p))
+            ++p;
+    }
+
+    static double parseDouble (const char* numberStart, const char* numberEnd) noexcept
+    {
+        auto result = 0.0;
+        NumberConversion::parseDecimal (numberStart, numberEnd, result);
+        return result;
+    }
+
+    JUCE_DECLARE_NON_COPYABLE (ScriptJSONParser)
+};
+
+//==============================================================================
+/** Writes script values as JSON, following the rules of JSON.stringify().
+
+    The text is written to the stream as it's produced, so nothing but the stream
+    itself grows with the size of the result. Plain runs of string text are found
+    eight bytes at a time and copied across in one go.
+*/
+class ScriptJSONWriter final
+{
+public:
+    /** Creates a writer.
+
+        @param destination  Where to write the JSON to.
+        @param indentToUse  The text to indent each level with (only the first 10
+                            characters of which are used). If this is empty,
+                            everything gets written on a single line.
+    */
+    ScriptJSONWriter (OutputStream& destination, const String& indentToUse = {}) :
+        out (destination),
+        indent (indentToUse.substring (0, 10))
+    {
+    }
+
+    /** If this is set to a function, it gets called as replacer (key, value) for
+        every value, with the value's parent as its this object, and whatever it
+        returns gets written instead.
+    */
+    var replacer;
+
+    /** If this isn't empty, only these properties of objects get written, in this order. */
+    Array<Identifier> propertyList;
+
+    /** Writes a value, returning false if there wasn't anything to write
+        (ie: because the value was undefined or a function).
+    */
+    bool write (const var& value)
+    {
+        const auto holder = replacer.isVoid() ? var() : var (new ScriptObject());
+        const auto v = prepareValue (holder, String(), value);
+
+        if (isSkipped (v))
+            return false;
+
+        writeValue (v, 0);
+        return true;
+    }
+
+private:
+    //==============================================================================
+    OutputStream& out;
+    const String indent;
+    Array<const void*> stack;
+
+    //==============================================================================
+    static bool isSkipped (const var& v)
+    {
+        return v.isUndefined() || v.isMethod() || isFunction (v);
+    }
+
+    /** Applies any toJSON() method and the replacer to a value that's about to be written. */
+    var prepareValue (const var& holder, const var& key, const var& value)
+    {
+        auto result = value;
+
+        if (auto* o = value.getDynamicObject())
+        {
+            static const Identifier toJSONId ("toJSON");
+
+            if (auto* toJSON = getPropertyPointer (*o, toJSONId))
+            {
+                if (isFunction (*toJSON) || toJSON->isMethod())
+                {
+                    const var keyString (key.toString());
+                    result = callScriptFunction (*toJSON, var::NativeFunctionArgs (value, &keyString, 1));
+                }
+            }
+        }
+
+        if (! replacer.isVoid())
+        {
+            const var args[] = { key.toString(), result };
+            result = callScriptFunction (replacer, var::NativeFunctionArgs (holder, args, 2));
+        }
+
+        return result;
+    }
+
+    void writeValue (const var& v, int depth)
+    {
+        if (v.isVoid())                         writeText ("null", 4);
+        else if (v.isBool())                    static_cast<bool> (v) ? writeText ("true", 4) : writeText ("false", 5);
+        else if (v.isInt() || v.isInt64())      writeInteger (static_cast<int64> (v));
+        else if (v.isDouble())                  writeDouble (static_cast<double> (v));
+        else if (v.isString())                  writeString (v.toString());
+        else if (auto* array = v.getArray())    writeArray (*array, v, depth);
+        else if (auto* o = v.getDynamicObject()) writeObject (*o, v, depth);
+        else if (v.isBinaryData())              writeString (v.toString());
+        else                                    writeText ("null", 4);
+    }
+
+    void writeText (const char* text, size_t numBytes)
+    {
+        out.write (text, numBytes);
+    }
+
+    void writeInteger (int64 value)
+    {
+        char buffer[24];
+        auto* const bufferEnd = buffer + numElementsInArray (buffer);
+        auto* t = bufferEnd;
+        auto n = value < 0 ? (uint64) 0 - (uint64) value : (uint64) value;
+
+        do
+        {
+            *--t = (char) ('0' + (n % 10));
+            n /= 10;
+        }
+        while (n != 0);
+
+        if (value < 0)
+            *--t = '-';
+
+        writeText (t, (size_t) (bufferEnd - t));
+    }
+
+    void writeDouble (double value)
+    {
+        if (! std::isfinite (value))
+        {
+            writeText ("null", 4);
+        }
+        else if (value == std::floor (value) && std::abs (value) < 9007199254740992.0)
+        {
+            writeInteger ((int64) value);
+        }
+        else
+        {
+            char buffer[NumberConversion::maximumFormattedLength];
+            writeText (buffer, (size_t) NumberConversion::formatDouble (value, buffer));
+        }
+    }
+
+    void writeString (const String& s)
+    {
+        const auto* t = s.toRawUTF8();
+        const auto* const textEnd = t + s.getNumBytesAsUTF8();
+        auto* runStart = t;
+
+        out.writeByte ('"');
+
+        for (;;)
+        {
+            while (textEnd - t >= 8 && JSONWords::findStringSpecials (JSONWords::load (t)) == 0)
+                t += 8;
+
+            if (t >= textEnd)
+                break;
+
+            const auto c = (uint8) *t;
+
+            if (c != '"' && c != '\\' && c >= 0x20)
+            {
+                ++t;
+                continue;
+            }
+
+            writeText (runStart, (size_t) (t - runStart));
+            writeEscapedCharacter (c);
+            runStart = ++t;
+        }
+
+        writeText (runStart, (size_t) (textEnd - runStart));
+        out.writeByte ('"');
+    }
+
+    void writeEscapedCharacter (uint8 c)
+    {
+        switch (c)
+        {
+            case '"':   writeText ("\\\"", 2); break;
+            case '\\':  writeText ("\\\\", 2); break;
+            case '\b':  writeText ("\\b", 2); break;
+            case '\f':  writeText ("\\f", 2); break;
+            case '\n':  writeText ("\\n", 2); break;
+            case '\r':  writeText ("\\r", 2); break;
+            case '\t':  writeText ("\\t", 2); break;
+
+            default:
+            {
+                const char escaped[] = { '\\', 'u', '0', '0', "0123456789abcdef"[c >> 4], "0123456789abcdef"[c & 15] };
+                writeText (escaped, sizeof (escaped));
+                break;
+            }
+        }
+    }
+
+    void writeNewLine (int depth)
+    {
+        if (indent.isEmpty())
+            return;
+
+        out.writeByte ('\n');
+
+        for (int i = 0; i < depth; ++i)
+            out << indent;
+    }
+
+    void pushContainer (const void* container)
+    {
+        if (stack.contains (container))
+            throw String ("Converting circular structure to JSON");
+
+        stack.add (container);
+    }
+
+    void writeArray (const Array<var>& array, const var& holder, int depth)
+    {
+        pushContainer (&array);
+        out.writeByte ('[');
+
+        for (int i = 0; i < array.size(); ++i)
+        {
+            if (i > 0)
+                out.writeByte (',');
+
+            writeNewLine (depth + 1);
+
+            const auto v = prepareValue (holder, i, array[i]);
+
+            if (isSkipped (v))
+                writeText ("null", 4);
+            else
+                writeValue (v, depth + 1);
+        }
+
+        if (! array.isEmpty())
+            writeNewLine (depth);
+
+        out.writeByte (']');
+        stack.removeLast();
+    }
+
+    void writeObject (DynamicObject& o, const var& holder, int depth)
+    {
+        // Classes like Boolean know how to write themselves.
+        if (dynamic_cast<JavascriptClass*> (&o) != nullptr)
+        {
+            o.writeAsJSON (out, depth, indent.isEmpty(), 15);
+            return;
+        }
+
+        pushContainer (&o);
+        out.writeByte ('{');
+
+        auto isEmpty = true;
+
+        const auto writeMember = [&] (const Identifier& name, const var& member)
+        {
+            const auto v = prepareValue (holder, name.toString(), member);
+
+            if (isSkipped (v))
+                return;
+
+            if (! isEmpty)
+                out.writeByte (',');
+
+            isEmpty = false;
+            writeNewLine (depth + 1);
+            writeString (name.toString());
+            out.writeByte (':');
+
+            if (indent.isNotEmpty())
+                out.writeByte (' ');
+
+            writeValue (v, depth + 1);
+        };
+
+        // The properties are looked up by index each time around, since a
+        // replacer or toJSON() method might add or remove some along the way.
+        const auto& properties = o.getProperties();
+
+        if (propertyList.isEmpty())
+        {
+            for (int i = 0; i < properties.size(); ++i)
+                writeMember (properties.getName (i), var (properties.getValueAt (i)));
+        }
+        else
+        {
+            for (const auto& name : propertyList)
+                if (auto* member = properties.getVarPointer (name))
+                    writeMember (name, var (*member));
+        }
+
+        if (! isEmpty)
+            writeNewLine (depth);
+
+        out.writeByte ('}');
+        stack.removeLast();
+    }
+
+    JUCE_DECLARE_NON_COPYABLE (ScriptJSONWriter)
+};
+
+//==============================================================================
+/** Reads a stream of JSON records one at a time.
+
+    The stream can either hold a single top-level array, whose elements are the
+    records, or a sequence of values separated by whitespace (eg: newline-delimited
+    JSON). Either way, only the text of the record being read is kept in memory,
+    so streams of any length can be processed in a fixed amount of space.
+*/
+class JSONRecordReader final
+{
+public:
+    /** Creates a reader, which will read from the stream's current position. */
+    explicit JSONRecordReader (InputStream& source) noexcept :
+        input (source)
+    {
+    }
+
+    /** Reads the next record, returning false once there are none left.
+        If the text isn't valid JSON, an error message is thrown.
+    */
+    bool readNext (var& record)
+    {
+        if (isFinished)
+            return false;
+
+        discardConsumedText();
+
+        if (! hasStarted)
+        {
+            hasStarted = true;
+            skipWhitespace();
+
+            if (isAvailable (position) && buffer[position] == '[')
+            {
+                isArray = true;
+                ++position;
+            }
+        }
+
+        skipWhitespace();
+
+        if (isArray)
+        {
+            if (! isAvailable (position))
+                throw String ("JSON stream : Unterminated array");
+
+            if (buffer[position] == ']')
+            {
+                ++position;
+                finish();
+                return false;
+            }
+
+            if (numRecordsRead > 0)
+            {
+                if (buffer[position] != ',')
+                    throw String ("JSON stream : Expected ',' or ']' after record ") + String (numRecordsRead);
+
+                ++position;
+                skipWhitespace();
+            }
+        }
+        else if (! isAvailable (position))
+        {
+            isFinished = true;
+            return false;
+        }
+
+        const auto recordEnd = findRecordEnd();
+        record = ScriptJSONParser (buffer.data() + position, recordEnd - position).parseDocument();
+        position = recordEnd;
+        ++numRecordsRead;
+        return true;
+    }
+
+    /** @returns the number of records that have been read so far. */
+    int getNumRecordsRead() const noexcept { return numRecordsRead; }
+
+private:
+    //==============================================================================
+    enum { chunkSize = 65536 };
+
+    InputStream& input;
+    std::string buffer;
+    size_t position = 0;
+    int numRecordsRead = 0;
+    bool hasStarted = false, isArray = false, isFinished = false;
+
+    //==============================================================================
+    /** Makes sure the byte at an index has been read, returning false if the stream ends first. */
+    bool isAvailable (size_t index)
+    {
+        while (index >= buffer.size())
+        {
+            const auto oldSize = buffer.size();
+            buffer.resize (oldSize + chunkSize);
+
+            const auto numRead = input.read (&buffer[oldSize], chunkSize);
+            buffer.resize (oldSize + (size_t) jmax (0, numRead));
+
+            if (numRead <= 0)
+                return false;
+        }
+
+        return true;
+    }
+
+    /** Drops the text of the records that have been read, once they make up at least half of the buffer.
+
+        Waiting until then means that each byte gets moved down the buffer at most once on
+        average, rather than the unread text being shifted along after every record.
+    */
+    void discardConsumedText()
+    {
+        if (position == 0 || position < buffer.size() / 2)
+            return;
+
+        buffer.erase (0, position);
+        position = 0;
+    }
+
+    static bool isWhitespace (char c) noexcept { return c == ' ' || c == '\n' || c == '\r' || c == '\t'; }
+
+    void skipWhitespace()
+    {
+        while (isAvailable (position) && isWhitespace (buffer[position]))
+            ++position;
+    }
+
+    void finish()
+    {
+        isFinished = true;
+        skipWhitespace();
+
+        if (isAvailable (position))
+            throw String ("JSON stream : Unexpected text after the end of the array");
+    }
+
+    /** Finds the end of the record that starts at the current position, reading more of the stream as needed.
+
+        This only tracks strings and brackets, which is enough to know where
+        the record stops: checking the rest is left to the parser.
+    */
+    size_t findRecordEnd()
+    {
+        auto i = position;
+        const auto first = buffer[i];
+
+        if (first != '{' && first != '[' && first != '"')
+        {
+            while (isAvailable (i) && ! isWhitespace (buffer[i]) && buffer[i] != ',' && buffer[i] != ']')
+                ++i;
+
+            return i;
+        }
+
+        int depth = 0;
+
+        for (;;)
+        {
+            if (! isAvailable (i))
+                throw String ("JSON stream : Unexpected end of input in record ") + String (numRecordsRead + 1);
+
+            const auto c = buffer[i++];
+
+            if (c == '"')
+            {
+                i = findStringEnd (i);
+
+                if (depth == 0)
+                    return i;
+            }
+            else if (c == '{' || c == '[')
+            {
+                ++depth;
+            }
+            else if ((c == '}' || c == ']') && --depth == 0)
+            {
+                return i;
+            }
+        }
+    }
+
+    /** Returns the index just after the closing quote of a string whose text starts at an index. */
+    size_t findStringEnd (size_t i)
+    {
+        for (;;)
+        {
+            while (i + 8 <= buffer.size())
+            {
+                const auto word = JSONWords::load (buffer.data() + i);
+
+                if ((JSONWords::findByte (word, '"') | JSONWords::findByte (word, '\\')) != 0)
+                    break;
+
+                i += 8;
+            }
+
+            if (! isAvailable (i))
+                throw String ("JSON stream : Unterminated string in record ") + String (numRecordsRead + 1);
+
+            const auto c = buffer[i++];
+
+            if (c == '"')
+                return i;
+
+            if (c == '\\')
+                ++i;
+        }
+    }
+
+    JUCE_DECLARE_NON_COPYABLE (JSONRecordReader)
+};
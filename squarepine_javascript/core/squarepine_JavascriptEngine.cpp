@@ -3,20 +3,184 @@ JavascriptEngine::JavascriptEngine() :
 {
 }
 
+JavascriptEngine::~JavascriptEngine()
+{
+    // The root namespace refers to itself via globalThis, so it needs
+    // some help letting go of everything that was created by the scripts.
+    const RootObject::ScopedActivation activation (*root);
+    root->eventLoop.clear();
+    root->clear();
+    root->heap.collect();
+}
+
 //==============================================================================
 const NamedValueSet& JavascriptEngine::getRootObjectProperties() const noexcept
 {
     return root->getProperties();
 }
 
-void JavascriptEngine::prepareTimeout() const noexcept
+ConsoleLog& JavascriptEngine::getConsoleLog()
+{
+    return root->getConsoleLog();
+}
+
+void JavascriptEngine::setConsoleLog (ConsoleLog::Ptr newLog)
+{
+    root->setConsoleLog (std::move (newLog));
+}
+
+//==============================================================================
+void JavascriptEngine::startProfiling (int intervalMs)
+{
+    jassert (RootObject::getCurrent() != root.get()); // The shadow call stack can't be swapped out from under a running script!
+    root->profiler.reset (new ScriptProfiler (intervalMs));
+}
+
+ScriptProfile JavascriptEngine::stopProfiling()
+{
+    jassert (RootObject::getCurrent() != root.get()); // The shadow call stack can't be swapped out from under a running script!
+
+    if (root->profiler == nullptr)
+        return {};
+
+    const auto profile = root->profiler->createProfile();
+    root->profiler.reset();
+    return profile;
+}
+
+bool JavascriptEngine::isProfiling() const noexcept
+{
+    return root->profiler != nullptr;
+}
+
+const InstrumentationCounters& JavascriptEngine::getInstrumentationCounters() const noexcept
+{
+    return root->counters;
+}
+
+//==============================================================================
+/** Times a call into the engine, and records how it went once it's over, if the metrics are switched on. */
+class JavascriptEngine::MetricsScope final
+{
+public:
+    MetricsScope (const JavascriptEngine& e, const char* k, String n) noexcept :
+        engine (e),
+        kind (k),
+        name (std::move (n)),
+        startTicks (e.metrics != nullptr ? Time::getHighResolutionTicks() : 0)
+    {
+    }
+
+    ~MetricsScope()
+    {
+        if (engine.metrics != nullptr)
+        {
+            const auto seconds = Time::highResolutionTicksToSeconds (Time::getHighResolutionTicks() - startTicks);
+            engine.metrics->record (kind, name, (int64) (seconds * 1.0e9), getOutcome());
+        }
+    }
+
+    /** Scripts are told apart by a hash of their code, which is only worth working out if it's going to be used. */
+    static String getScriptName (const JavascriptEngine& e, const String& code)
+    {
+        return e.metrics != nullptr ? String::toHexString (code.hashCode64()) : String();
+    }
+
+    void setFailed() noexcept { failed = true; }
+
+private:
+    const JavascriptEngine& engine;
+    const char* const kind;
+    const String name;
+    const int64 startTicks;
+    bool failed = false;
+
+    EngineMetrics::Outcome getOutcome() const
+    {
+        if (! failed)
+            return EngineMetrics::Outcome::succeeded;
+
+        // stop() clears the timeout, which is how the interpreter tells the two apart too.
+        if (engine.root->timeout == Time())
+            return EngineMetrics::Outcome::interrupted;
+
+        if (Time::getCurrentTime() >= engine.root->timeout)
+            return EngineMetrics::Outcome::timedOut;
+
+        return EngineMetrics::Outcome::failed;
+    }
+
+    JUCE_DECLARE_NON_COPYABLE (MetricsScope)
+};
+
+void JavascriptEngine::setMetricsEnabled (bool shouldBeEnabled)
+{
+    jassert (RootObject::getCurrent() != root.get()); // The metrics can't be swapped out from under a running script!
+    metrics = shouldBeEnabled ? new EngineMetrics() : nullptr;
+}
+
+EngineMetrics::Ptr JavascriptEngine::getMetrics() const noexcept
+{
+    return metrics;
+}
+
+//==============================================================================
+void JavascriptEngine::setTracer (ScriptTracer::Ptr newTracer)
+{
+    jassert (RootObject::getCurrent() != root.get()); // A call's begin and end events need to go to the same tracer!
+    root->tracer = std::move (newTracer);
+}
+
+ScriptTracer::Ptr JavascriptEngine::getTracer() const noexcept
+{
+    return root->tracer;
+}
+
+//==============================================================================
+void JavascriptEngine::setCoverageEnabled (bool shouldBeEnabled)
+{
+    jassert (RootObject::getCurrent() != root.get()); // The coverage can't be swapped out from under a running script!
+    root->coverage = shouldBeEnabled ? new ScriptCoverage() : nullptr;
+}
+
+ScriptCoverage::Ptr JavascriptEngine::getCoverage() const noexcept
+{
+    return root->coverage;
+}
+
+//==============================================================================
+void JavascriptEngine::prepareForExecution() const noexcept
 {
     root->timeout = Time::getCurrentTime() + maximumExecutionTime;
+    root->heap.setCollectionThreshold (garbageCollectionThreshold);
+    root->heap.setMaximumNumBytes (maximumHeapBytes);
+}
+
+int JavascriptEngine::collectGarbage()
+{
+    const RootObject::ScopedActivation activation (*root);
+    return root->heap.collect();
+}
+
+const ScriptHeap::Statistics& JavascriptEngine::getGarbageCollectionStatistics() const noexcept
+{
+    return root->heap.getStatistics();
+}
+
+int64 JavascriptEngine::getHeapBytesInUse() const noexcept
+{
+    return root->heap.getNumBytesInUse();
+}
+
+int64 JavascriptEngine::getPeakHeapBytes() const noexcept
+{
+    return root->heap.getPeakNumBytes();
 }
 
 void JavascriptEngine::stop() noexcept
 {
     root->timeout = {};
+    root->eventLoop.requestStop();
 }
 
 //==============================================================================
@@ -44,13 +208,19 @@ void JavascriptEngine::deregisterNativeObject (const Identifier& name)
 //==============================================================================
 Result JavascriptEngine::execute (const String& code)
 {
+    MetricsScope metricsScope (*this, "execute", MetricsScope::getScriptName (*this, code));
+
     try
     {
-        prepareTimeout();
+        const RootObject::ScopedActivation activation (*root);
+        prepareForExecution();
+        root->counters.reset();
         root->execute (code);
+        runMicrotasks();
     }
     catch (String& error)
     {
+        metricsScope.setFailed();
         return Result::fail (error);
     }
 
@@ -59,17 +229,25 @@ Result JavascriptEngine::execute (const String& code)
 
 var JavascriptEngine::evaluate (const String& code, Result* result)
 {
-    prepareTimeout();
+    MetricsScope metricsScope (*this, "evaluate", MetricsScope::getScriptName (*this, code));
+
+    const RootObject::ScopedActivation activation (*root);
+    prepareForExecution();
+    root->counters.reset();
 
     if (result != nullptr)
         *result = Result::ok();
 
     try
     {
-        return root->evaluate (code);
+        const auto value = root->evaluate (code);
+        runMicrotasks();
+        return value;
     }
     catch (String& error)
     {
+        metricsScope.setFailed();
+
         if (result != nullptr)
             *result = Result::fail (error);
     }
@@ -80,9 +258,13 @@ var JavascriptEngine::evaluate (const String& code, Result* result)
 //==============================================================================
 var JavascriptEngine::callFunction (const Identifier& function, const var::NativeFunctionArgs& args, Result* result)
 {
+    MetricsScope metricsScope (*this, "callFunction", function.toString());
+
     auto returnVal = var::undefined();
 
-    prepareTimeout();
+    const RootObject::ScopedActivation activation (*root);
+    prepareForExecution();
+    root->counters.reset();
 
     if (result != nullptr)
         *result = Result::ok();
@@ -90,9 +272,12 @@ var JavascriptEngine::callFunction (const Identifier& function, const var::Nativ
     try
     {
         Scope ({}, *root, *root).findAndInvokeMethod (function, args, returnVal);
+        runMicrotasks();
     }
     catch (String& error)
     {
+        metricsScope.setFailed();
+
         if (result != nullptr)
             *result = Result::fail (error);
     }
@@ -103,9 +288,13 @@ var JavascriptEngine::callFunction (const Identifier& function, const var::Nativ
 var JavascriptEngine::callFunctionObject (DynamicObject* objectScope, const var& functionObject,
                                           const var::NativeFunctionArgs& args, Result* result)
 {
+    MetricsScope metricsScope (*this, "callFunctionObject", {});
+
     auto returnVal = var::undefined();
 
-    prepareTimeout();
+    const RootObject::ScopedActivation activation (*root);
+    prepareForExecution();
+    root->counters.reset();
 
     if (result != nullptr)
         *result = Result::ok();
@@ -116,12 +305,291 @@ var JavascriptEngine::callFunctionObject (DynamicObject* objectScope, const var&
 
         Scope (&rootScope, *root, DynamicObject::Ptr (objectScope))
             .invokeMethod (functionObject, args, returnVal);
+
+        runMicrotasks();
     }
     catch (String& error)
     {
+        metricsScope.setFailed();
+
         if (result != nullptr)
             *result = Result::fail (error);
     }
 
     return returnVal;
 }
+
+//==============================================================================
+JavascriptEngine::FunctionHandle JavascriptEngine::resolveFunction (const Identifier& functionName) const
+{
+    const auto names = StringArray::fromTokens (functionName.toString(), ".", {});
+    FunctionHandle handle;
+    DynamicObject* object = root.get();
+
+    for (int i = 0; i < names.size(); ++i)
+    {
+        if (names[i].isEmpty())
+            return {};
+
+        auto* v = getPropertyPointer (*object, names[i]);
+
+        if (v == nullptr)
+            return {};
+
+        if (i == names.size() - 1)
+        {
+            if (! (isFunction (*v) || v->isMethod()))
+                return {};
+
+            handle.name = functionName;
+            handle.function = *v;
+            handle.engine = this;
+            return handle;
+        }
+
+        object = v->getDynamicObject();
+
+        if (object == nullptr)
+            return {};
+
+        handle.scopeObjects.add (*v);
+    }
+
+    return {};
+}
+
+Result JavascriptEngine::callFunctionBatch (const FunctionHandle& function, const var* arguments,
+                                            int numArgumentsPerCall, var* results, int numCalls)
+{
+    jassert (function.engine == nullptr || function.engine == this); // The handle has to come from this engine's resolveFunction()!
+    jassert (numArgumentsPerCall >= 0 && numCalls >= 0);
+    jassert (numArgumentsPerCall == 0 || arguments != nullptr);
+    jassert (numCalls == 0 || results != nullptr);
+
+    if (! function.isValid())
+        return Result::fail ("Unknown function '" + function.getName().toString() + "'");
+
+    MetricsScope metricsScope (*this, "callFunctionBatch", function.getName().toString());
+
+    const RootObject::ScopedActivation activation (*root);
+    prepareForExecution();
+    root->counters.reset();
+
+    // The scopes, the 'this' object and the kind of function are all the same for every call, so they're only set up once.
+    OwnedArray<Scope> scopes;
+    scopes.add (new Scope ({}, *root, *root));
+
+    for (const auto& o : function.scopeObjects)
+        scopes.add (new Scope (scopes.getLast(), *root, o.getDynamicObject()));
+
+    const auto& scope = *scopes.getLast();
+    const var thisObject (scope.scope.get());
+    auto* functionObject = dynamic_cast<FunctionObject*> (function.function.getObject());
+    const auto nativeFunction = functionObject == nullptr ? function.function.getNativeFunction() : var::NativeFunction();
+    auto* boundFunction = NativeBinding::getFunction (nativeFunction);
+    const auto reusesFunctionRoot = functionObject != nullptr && ! (functionObject->isAsync || functionObject->isGenerator);
+    DynamicObject::Ptr functionRoot;
+    const auto functionLocation = functionObject != nullptr ? functionObject->body->location : CodeLocation (function.getName().toString());
+
+    int i = 0;
+
+    try
+    {
+        // Every call has the same number of arguments, so a bound function only needs them counting once.
+        if (boundFunction != nullptr && numCalls > 0)
+            boundFunction->checkArgumentCount (numArgumentsPerCall);
+
+        for (; i < numCalls; ++i)
+        {
+            const var::NativeFunctionArgs args (thisObject, arguments + (size_t) i * (size_t) numArgumentsPerCall, numArgumentsPerCall);
+            const CallHooks hooks (scope, function.getName(), functionLocation, functionObject == nullptr);
+
+            if (reusesFunctionRoot)
+            {
+                functionObject->rebindFunctionRoot (functionRoot, args);
+                results[i] = functionObject->invokeWithRoot (scope, functionRoot);
+            }
+            else if (boundFunction != nullptr)
+            {
+                results[i] = boundFunction->call (args.arguments);
+            }
+            else
+            {
+                results[i] = functionObject != nullptr ? functionObject->invoke (scope, args) : nativeFunction (args);
+            }
+        }
+
+        runMicrotasks();
+    }
+    catch (String& error)
+    {
+        metricsScope.setFailed();
+
+        if (i < numCalls)
+            return Result::fail ("Call " + String (i + 1) + " of " + String (numCalls) + ": " + error);
+
+        return Result::fail (error);
+    }
+
+    return Result::ok();
+}
+
+Result JavascriptEngine::writeAsJSON (OutputStream& output, const var& value, const String& indent)
+{
+    const RootObject::ScopedActivation activation (*root);
+    prepareForExecution();
+
+    try
+    {
+        ScriptJSONWriter (output, indent).write (value);
+    }
+    catch (String& error)
+    {
+        return Result::fail (error);
+    }
+
+    return Result::ok();
+}
+
+Result JavascriptEngine::parseJSONStream (InputStream& input, std::function<bool (const var&)> callback)
+{
+    jassert (callback != nullptr);
+
+    const RootObject::ScopedActivation activation (*root);
+    prepareForExecution();
+
+    try
+    {
+        JSONRecordReader reader (input);
+        var record;
+
+        while (reader.readNext (record))
+        {
+            const auto shouldContinue = callback (record);
+            record = var();
+            root->heap.collectIfNeeded();
+
+            if (! shouldContinue)
+                break;
+        }
+    }
+    catch (String& error)
+    {
+        return Result::fail (error);
+    }
+
+    return Result::ok();
+}
+
+//==============================================================================
+void JavascriptEngine::runTask (const EventLoop::Task& task)
+{
+    if (task.function.isString())
+        root->execute (task.function.toString());
+    else
+        callScriptFunction (task.function, var::NativeFunctionArgs (var (root.get()), task.arguments.begin(), task.arguments.size()));
+}
+
+void JavascriptEngine::settleHostPromises()
+{
+    var promise, value;
+    bool isRejected = false;
+
+    while (root->eventLoop.takeNextCompletion (promise, value, isRejected))
+    {
+        if (isRejected)
+            PromiseClass::reject (promise, value);
+        else
+            PromiseClass::resolve (promise, value);
+    }
+}
+
+void JavascriptEngine::runMicrotasks()
+{
+    EventLoop::Task task;
+
+    while (root->eventLoop.getNextMicrotask (task))
+    {
+        runTask (task);
+        task = {};
+    }
+}
+
+bool JavascriptEngine::hasPendingTasks() const noexcept
+{
+    return root->eventLoop.getNumTimers() > 0
+        || root->eventLoop.hasMicrotasks()
+        || root->eventLoop.getNumPendingPromises() > 0;
+}
+
+Result JavascriptEngine::runPendingTasks (Time deadline)
+{
+    const RootObject::ScopedActivation activation (*root);
+    auto& eventLoop = root->eventLoop;
+
+    // Only the timers that were due when this started get run, so that a
+    // timer which keeps setting up another one with no delay can't hog the call.
+    const auto now = EventLoop::getCurrentTime();
+
+    try
+    {
+        prepareForExecution();
+        root->counters.reset();
+        settleHostPromises();
+        runMicrotasks();
+
+        EventLoop::Task task;
+
+        while ((deadline == Time() || Time::getCurrentTime() < deadline)
+               && eventLoop.getNextDueTimer (now, task))
+        {
+            prepareForExecution();
+            runTask (task);
+            task = {};
+
+            runMicrotasks();
+            root->heap.collectIfNeeded();
+        }
+    }
+    catch (String& error)
+    {
+        return Result::fail (error);
+    }
+
+    return Result::ok();
+}
+
+Result JavascriptEngine::runEventLoop (Time deadline)
+{
+    auto& eventLoop = root->eventLoop;
+    eventLoop.resetStopRequest();
+
+    while (! eventLoop.isStopRequested())
+    {
+        const auto result = runPendingTasks (deadline);
+
+        if (result.failed())
+            return result;
+
+        if (! hasPendingTasks())
+            break;
+
+        auto waitMs = eventLoop.getTimeUntilNextTimer (EventLoop::getCurrentTime());
+
+        if (deadline != Time())
+        {
+            const auto msUntilDeadline = deadline.toMilliseconds() - Time::currentTimeMillis();
+
+            if (msUntilDeadline <= 0)
+                break;
+
+            waitMs = waitMs < 0 ? msUntilDeadline : jmin (waitMs, msUntilDeadline);
+        }
+
+        // With no timers to wait for, only a promise being settled by the host can wake it up.
+        if (waitMs != 0)
+            eventLoop.wait (waitMs < 0 ? -1 : (int) jmin (waitMs, (int64) std::numeric_limits<int>::max()));
+    }
+
+    return Result::ok();
+}
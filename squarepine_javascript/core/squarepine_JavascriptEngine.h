@@ -15,6 +15,9 @@ public:
     */
     JavascriptEngine();
 
+    /** Destructor. */
+    ~JavascriptEngine();
+
     //==============================================================================
     /** Attempts to parse and run a block of javascript code.
 
@@ -56,6 +59,132 @@ public:
                             const var::NativeFunctionArgs& args,
                             Result* errorMessage = nullptr);
 
+    //==============================================================================
+    /** A function that's been looked up once, so that it can be called over and over
+        without being searched for each time.
+
+        The handle holds on to the function it found, so if a script replaces the
+        function afterwards, the handle carries on calling the old one.
+
+        @see resolveFunction, callFunctionBatch
+    */
+    class FunctionHandle final
+    {
+    public:
+        /** Creates a handle that doesn't refer to any function. */
+        FunctionHandle() = default;
+
+        /** @returns true if the function was found. */
+        bool isValid() const noexcept                   { return ! function.isVoid(); }
+
+        /** @returns the name that the function was resolved from. */
+        const Identifier& getName() const noexcept      { return name; }
+
+    private:
+        friend class JavascriptEngine;
+
+        Identifier name;
+        var function;
+        Array<var> scopeObjects; // The objects between the root namespace and the function, outermost first.
+        const void* engine = nullptr;
+    };
+
+    /** Looks up a function, either a script function or a native one, so that it can be
+        called with callFunctionBatch().
+
+        Unlike callFunction(), this doesn't search every object under the root namespace:
+        a function that's inside an object is found by its path, eg: "scoring.evaluate".
+
+        @returns the function's handle, which isn't valid if there was no function by that name.
+    */
+    FunctionHandle resolveFunction (const Identifier& functionName) const;
+
+    /** Calls a function once for each of a batch of argument lists, eg: to score a batch of records.
+
+        Setting up a call to the engine only happens once for the whole batch, rather than
+        for each call, so maximumExecutionTime applies to the batch as a whole. The function
+        is called with the object it was found in as its 'this', and any promise callbacks
+        that the calls leave behind get run after the last one.
+
+        A script function's calls share one function scope between them, which is cleared
+        and given the next call's arguments each time, as long as nothing from an earlier
+        call (eg: a closure) is still holding on to it. A native function bound with
+        bind() has its argument count checked once, and is then called directly.
+
+        @param function             A function found by this engine's resolveFunction().
+        @param arguments            The arguments of all of the calls, one call's after another.
+        @param numArgumentsPerCall  The number of arguments that each call takes from the arguments array.
+        @param results              Where the calls' return values go. This needs room for numCalls values.
+        @param numCalls             The number of calls to make.
+
+        @returns an error if any of the calls failed, in which case the calls after it aren't made,
+                 but the results of the ones before it have been set.
+    */
+    Result callFunctionBatch (const FunctionHandle& function,
+                              const var* arguments,
+                              int numArgumentsPerCall,
+                              var* results,
+                              int numCalls);
+
+    /** Writes a value to a stream as JSON, in the same way as the scripts' JSON.stringify().
+
+        Unlike JSON::toString(), the text is written out as it's produced, so this is the
+        one to use for large values. Any toJSON() methods are called, which is why this
+        can fail, and also why it needs to be called on the thread that runs the engine.
+
+        @param output   Where to write the JSON to.
+        @param value    The value to write. If it's undefined or a function, nothing gets written.
+        @param indent   The text to indent each level with. If this is empty,
+                        everything gets written on a single line.
+    */
+    Result writeAsJSON (OutputStream& output, const var& value, const String& indent = {});
+
+    /** Reads JSON records from a stream one at a time, in the same way as the scripts' JSON.parseStream().
+
+        The stream can either hold a single top-level array, whose elements are the
+        records, or a sequence of values separated by whitespace (eg: newline-delimited
+        JSON). Each record is handed over as soon as it's been parsed, so only one of
+        them needs to be in memory at a time.
+
+        The records are built as script objects, so this needs to be called on the thread
+        that runs the engine, and they can be passed straight on to the scripts.
+
+        @param input        The stream to read from.
+        @param callback     Called with each record. Return false to stop reading.
+    */
+    Result parseJSONStream (InputStream& input, std::function<bool (const var& record)> callback);
+
+    //==============================================================================
+    /** Runs any timers that have come due, along with the microtasks that get queued along the way.
+
+        Scripts can set up timers with setTimeout() and setInterval(), and queue microtasks
+        with queueMicrotask(). None of these need a message thread, but the host has to give
+        the engine a chance to run them, either by calling this every so often or with runEventLoop().
+
+        Each task gets the full maximumExecutionTime to itself.
+
+        @param deadline     If this is set, no more tasks are started once it's passed,
+                            and whatever is left over waits for the next call.
+        @returns an error if one of the tasks failed, in which case
+                 the tasks after it are left for the next call.
+    */
+    Result runPendingTasks (Time deadline = {});
+
+    /** Keeps running tasks as they come due, sleeping in between them, until there aren't
+        any left, the deadline passes, or stop() gets called.
+
+        This is meant to be called on a thread that's dedicated to running the engine.
+
+        @param deadline     If this is set, the loop returns once it's passed,
+                            even if there are timers still waiting.
+    */
+    Result runEventLoop (Time deadline = {});
+
+    /** @returns true if there are any timers or microtasks waiting to be run,
+        or any promises that the host has yet to settle.
+    */
+    bool hasPendingTasks() const noexcept;
+
     //==============================================================================
     /** Adds a native object to the root namespace.
 
@@ -69,6 +198,21 @@ public:
     /** Adds a method to the root namespace. */
     void registerMethod (const Identifier& methodName, var::NativeFunction function);
 
+    /** Adds a C++ function to the root namespace, with the conversions of its arguments
+        and return value to and from vars generated at compile time, eg:
+
+        @code
+            engine.bind ("distance", &distance); // for double distance (double, double)
+        @endcode
+
+        @see NativeBinding, NativeValue
+    */
+    template<typename FunctionType>
+    void bind (const Identifier& methodName, FunctionType function)
+    {
+        registerMethod (methodName, NativeBinding::create (methodName, function));
+    }
+
     /** Removes a native object from the root namespace. */
     void deregisterNativeObject (const Identifier& objectName);
 
@@ -80,19 +224,149 @@ public:
     */
     RelativeTime maximumExecutionTime = { RelativeTime::minutes (1.0) };
 
+    /** The number of script objects that can be allocated before the engine
+        looks for (and reclaims) objects that are only kept alive by reference cycles.
+
+        Set this to zero or less to turn automatic collection off,
+        in which case you can still call collectGarbage() yourself.
+    */
+    int garbageCollectionThreshold = 10000;
+
+    /** The maximum number of bytes the scripts are allowed to use.
+
+        Once a script tries to go over this limit, whatever it was
+        doing is aborted and the execution fails with an error.
+
+        The default value of zero means there's no limit.
+    */
+    int64 maximumHeapBytes = 0;
+
+    //==============================================================================
+    /** Immediately reclaims any script objects that are only being kept alive by
+        reference cycles, returning the number of objects that were reclaimed.
+    */
+    int collectGarbage();
+
+    /** Returns some statistics about the garbage collector's activity so far. */
+    const ScriptHeap::Statistics& getGarbageCollectionStatistics() const noexcept;
+
+    /** Returns an estimate of the number of bytes the scripts are currently using.
+
+        This errs on the high side, since memory being released is only noticed
+        when the heap gets collected.
+    */
+    int64 getHeapBytesInUse() const noexcept;
+
+    /** Returns the highest number of bytes the scripts have been estimated to use. */
+    int64 getPeakHeapBytes() const noexcept;
+
+    //==============================================================================
+    /** Starts sampling where the scripts spend their time, replacing anything recorded so far.
+
+        @param intervalMs   How often to take a sample, in milliseconds.
+        @see stopProfiling
+    */
+    void startProfiling (int intervalMs = 1);
+
+    /** Stops sampling, and returns the hot spots that were found.
+
+        This mustn't be called while the engine is running a script, eg: from one of its native functions.
+    */
+    ScriptProfile stopProfiling();
+
+    /** */
+    bool isProfiling() const noexcept;
+
+    //==============================================================================
+    /** @returns the work done by the most recent call to execute(), evaluate(),
+        callFunction(), callFunctionObject(), callFunctionBatch() or runPendingTasks().
+
+        The counters are only kept when the module is built with
+        SP_JAVASCRIPT_ENABLE_INSTRUMENTATION enabled, and are all zero otherwise.
+    */
+    const InstrumentationCounters& getInstrumentationCounters() const noexcept;
+
+    //==============================================================================
+    /** Starts or stops recording latency histograms and outcome counts
+        for the calls to execute(), evaluate(), callFunction() and callFunctionObject().
+
+        Switching this on again starts a fresh set of metrics.
+        This mustn't be called while the engine is running a script.
+
+        @see getMetrics
+    */
+    void setMetricsEnabled (bool shouldBeEnabled);
+
+    /** @returns the metrics being recorded, or nullptr if they're switched off.
+
+        The metrics can be held on to and snapshotted from any thread,
+        eg: to be scraped regularly, without holding up the engine.
+    */
+    EngineMetrics::Ptr getMetrics() const noexcept;
+
     //==============================================================================
-    /** When called from another thread, causes the interpreter to time-out as soon as possible */
+    /** Sets a tracer to record the parsing, regular expression compiling and
+        function calls that this engine does. A tracer can be shared with other engines.
+
+        Passing nullptr switches tracing off, which leaves a single null check at each call.
+        This mustn't be called while the engine is running a script.
+    */
+    void setTracer (ScriptTracer::Ptr newTracer);
+
+    /** @returns the tracer that's recording this engine, if any. */
+    ScriptTracer::Ptr getTracer() const noexcept;
+
+    //==============================================================================
+    /** Starts or stops counting the runs of each statement and branch of the code
+        that this engine parses from here on, to find the code that never runs.
+
+        Code that's already been parsed, like the functions of a script that was
+        executed beforehand, isn't counted. Switching this on again starts a fresh
+        set of counts. This mustn't be called while the engine is running a script.
+
+        @see getCoverage
+    */
+    void setCoverageEnabled (bool shouldBeEnabled);
+
+    /** @returns the coverage being collected, or nullptr if it's switched off.
+
+        The coverage can be held on to and snapshotted from any thread,
+        eg: to export it regularly from a long-running process.
+    */
+    ScriptCoverage::Ptr getCoverage() const noexcept;
+
+    //==============================================================================
+    /** When called from another thread, causes the interpreter to time-out as soon as possible,
+        and any call to runEventLoop() to return.
+    */
     void stop() noexcept;
 
     /** Provides access to the set of properties of the root namespace object. */
     const NamedValueSet& getRootObjectProperties() const noexcept;
 
+    //==============================================================================
+    /** @returns the log that console.log() and friends write to.
+
+        Unless one has been set, each engine creates its own the first time
+        the console gets used, along with the thread that writes it out.
+    */
+    ConsoleLog& getConsoleLog();
+
+    /** Sets the log for the console to write to, which can be shared with other engines. */
+    void setConsoleLog (ConsoleLog::Ptr newLog);
+
 private:
     //==============================================================================
     ReferenceCountedObjectPtr<RootObject> root;
+    EngineMetrics::Ptr metrics;
 
     //==============================================================================
-    void prepareTimeout() const noexcept;
+    class MetricsScope;
+
+    void prepareForExecution() const noexcept;
+    void runTask (const EventLoop::Task&);
+    void settleHostPromises();
+    void runMicrotasks();
 
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (JavascriptEngine)
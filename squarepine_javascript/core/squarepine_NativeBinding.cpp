@@ -0,0 +1,23 @@
+//==============================================================================
+var NativeValue<int64>::toVar (int64 i)
+{
+    return NumberConversion::toVar ((double) i);
+}
+
+var NativeValue<double>::toVar (double d)
+{
+    // Whole numbers go back as ints, as they would from a script, so that === still works on them.
+    return NumberConversion::toVar (d);
+}
+
+String NativeValue<String>::fromVar (const var& v)
+{
+    return NumberConversion::toScriptString (v);
+}
+
+//==============================================================================
+void NativeBinding::throwArgumentCountError (const Identifier& name, int numNeeded, int numGiven)
+{
+    throw name.toString() + "() needs " + String (numNeeded) + (numNeeded == 1 ? " argument" : " arguments")
+          + ", but was given " + String (numGiven);
+}
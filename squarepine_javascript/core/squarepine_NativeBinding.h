@@ -0,0 +1,202 @@
+//==============================================================================
+/** Converts between a var and one of the C++ types that a bound native function
+    can take or return.
+
+    Specialisations are provided for the arithmetic types, String and var itself.
+    A host can add its own for any other types that its functions use, by
+    providing the same two static functions.
+
+    @see NativeBinding
+*/
+template<typename Type>
+struct NativeValue;
+
+template<>
+struct NativeValue<bool>
+{
+    static bool fromVar (const var& v)              { return static_cast<bool> (v); }
+    static var toVar (bool b)                       { return b; }
+};
+
+template<>
+struct NativeValue<int>
+{
+    static int fromVar (const var& v)               { return static_cast<int> (v); }
+    static var toVar (int i)                        { return i; }
+};
+
+template<>
+struct NativeValue<int64>
+{
+    static int64 fromVar (const var& v)             { return static_cast<int64> (v); }
+    static var toVar (int64 i);
+};
+
+template<>
+struct NativeValue<double>
+{
+    static double fromVar (const var& v)            { return static_cast<double> (v); }
+    static var toVar (double d);
+};
+
+template<>
+struct NativeValue<float>
+{
+    static float fromVar (const var& v)             { return static_cast<float> (v); }
+    static var toVar (float f)                      { return NativeValue<double>::toVar ((double) f); }
+};
+
+template<>
+struct NativeValue<String>
+{
+    static String fromVar (const var& v);
+    static var toVar (const String& s)              { return s; }
+};
+
+template<>
+struct NativeValue<var>
+{
+    static const var& fromVar (const var& v)        { return v; }
+    static var toVar (const var& v)                 { return v; }
+};
+
+//==============================================================================
+/** Turns an ordinary C++ function into a native function that scripts can call,
+    with the conversions of its arguments and return value generated at compile time.
+
+    Rather than taking var::NativeFunctionArgs and unpicking each argument by hand,
+    a bound function takes and returns plain C++ types, eg:
+
+    @code
+        static double distance (double x, double y) { return std::sqrt (x * x + y * y); }
+
+        engine.bind ("distance", &distance);
+    @endcode
+
+    The number of arguments is worked out from the function's signature when it's bound.
+    Being called with too few arguments throws an error, while any extra ones are ignored,
+    as they would be by a script function.
+
+    A bound function is registered as an ordinary var::NativeFunction, so that it can be
+    passed around and called from anywhere a native function can. When the interpreter
+    calls one, though, it bypasses the std::function: the argument count is checked the
+    first time a call site reaches the function, and after that each call goes straight
+    to the generated code, which converts the evaluated arguments to their C++ types
+    with NativeValue, without them being packed into a var::NativeFunctionArgs.
+
+    A function pointer is called directly. Anything else, like a lambda that captures
+    something, can be bound by wrapping it in a std::function.
+
+    @see JavascriptEngine::bind, NativeValue
+*/
+struct NativeBinding final
+{
+    //==============================================================================
+    /** A bound C++ function, which knows how many arguments it needs. */
+    struct Function : public ReferenceCountedObject
+    {
+        /** */
+        using Ptr = ReferenceCountedObjectPtr<Function>;
+
+        /** */
+        Function (const Identifier& functionName, int numArgumentsNeeded) noexcept :
+            name (functionName),
+            numArguments (numArgumentsNeeded)
+        {
+        }
+
+        /** Throws an error if a call doesn't give the function enough arguments. */
+        void checkArgumentCount (int numGiven) const
+        {
+            if (numGiven < numArguments)
+                throwArgumentCountError (name, numArguments, numGiven);
+        }
+
+        /** Calls the function, converting its arguments and its result.
+
+            There must be at least numArguments arguments, which is up to the caller to check.
+        */
+        virtual var call (const var* arguments) const = 0;
+
+        const Identifier name;
+        const int numArguments;
+    };
+
+    /** The native function that a bound function is registered as, which checks the argument count on every call. */
+    struct Callable
+    {
+        var operator() (const var::NativeFunctionArgs& args) const
+        {
+            function->checkArgumentCount (args.numArguments);
+            return function->call (args.arguments);
+        }
+
+        Function::Ptr function;
+    };
+
+    //==============================================================================
+    /** @returns a native function that calls a C++ function. */
+    template<typename ReturnType, typename... ArgumentTypes>
+    static var::NativeFunction create (const Identifier& name, ReturnType (*function) (ArgumentTypes...))
+    {
+        jassert (function != nullptr);
+        return Callable { new Invoker<ReturnType (*) (ArgumentTypes...), ReturnType, ArgumentTypes...> (name, function) };
+    }
+
+    /** @returns a native function that calls a std::function. */
+    template<typename ReturnType, typename... ArgumentTypes>
+    static var::NativeFunction create (const Identifier& name, std::function<ReturnType (ArgumentTypes...)> function)
+    {
+        jassert (function != nullptr);
+        return Callable { new Invoker<std::function<ReturnType (ArgumentTypes...)>, ReturnType, ArgumentTypes...> (name, std::move (function)) };
+    }
+
+    /** @returns the bound function that a native function calls, or nullptr if it wasn't created by NativeBinding. */
+    static Function* getFunction (const var::NativeFunction& nativeFunction) noexcept
+    {
+        if (auto* callable = nativeFunction.target<Callable>())
+            return callable->function.get();
+
+        return nullptr;
+    }
+
+    /** Throws the error for a bound function being called with too few arguments. */
+    [[noreturn]] static void throwArgumentCountError (const Identifier& name, int numNeeded, int numGiven);
+
+private:
+    //==============================================================================
+    template<typename FunctionType, typename ReturnType, typename... ArgumentTypes>
+    struct Invoker final : public Function
+    {
+        Invoker (const Identifier& functionName, FunctionType f) :
+            Function (functionName, (int) sizeof... (ArgumentTypes)),
+            function (std::move (f))
+        {
+        }
+
+        var call (const var* arguments) const override
+        {
+            return call (arguments, std::index_sequence_for<ArgumentTypes...>(), std::is_void<ReturnType>());
+        }
+
+        template<size_t... indexes>
+        var call (const var* arguments, std::index_sequence<indexes...>, std::false_type) const
+        {
+            ignoreUnused (arguments);
+            return NativeValue<std::decay_t<ReturnType>>::toVar (function (NativeValue<std::decay_t<ArgumentTypes>>::fromVar (arguments[indexes])...));
+        }
+
+        template<size_t... indexes>
+        var call (const var* arguments, std::index_sequence<indexes...>, std::true_type) const
+        {
+            ignoreUnused (arguments);
+            function (NativeValue<std::decay_t<ArgumentTypes>>::fromVar (arguments[indexes])...);
+            return var::undefined();
+        }
+
+        FunctionType function;
+    };
+
+    //==============================================================================
+    NativeBinding() = delete;
+};
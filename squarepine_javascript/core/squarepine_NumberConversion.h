@@ -0,0 +1,800 @@
+//==============================================================================
+/** Conversions between numbers and text, following the ECMAScript rules.
+
+    None of this depends on the C locale. Doubles are written with Grisu2, which
+    always gives digits that read back as the same value, and nearly always the
+    fewest such digits: for a small fraction of values it gives one digit more
+    than the shortest, which ECMAScript's Number.prototype.toString() would not.
+    Decimal text is read with Clinger's fast path, which is exact whenever the
+    digits and the power of ten both fit in a double; the rare inputs that don't
+    fall back to JUCE's correctly rounded conversion.
+*/
+class NumberConversion final
+{
+public:
+    //==============================================================================
+    /** The size of the buffer that formatDouble() needs. */
+    enum { maximumFormattedLength = 32 };
+
+    /** Writes a double the way Number.prototype.toString() does.
+
+        @returns the number of characters written, which aren't null-terminated.
+    */
+    static int formatDouble (double value, char* buffer) noexcept
+    {
+        auto* out = buffer;
+
+        if (std::isnan (value))
+            return writeText (out, "NaN");
+
+        if (value == 0.0)
+            return writeText (out, "0");
+
+        if (value < 0.0)
+        {
+            *out++ = '-';
+            value = -value;
+        }
+
+        if (std::isinf (value))
+            return (int) (out - buffer) + writeText (out, "Infinity");
+
+        char digits[20];
+        int numDigits = 0, decimalExponent = 0;
+        grisu2 (value, digits, numDigits, decimalExponent);
+
+        // The value is 0.digits * 10^pointPosition
+        const auto pointPosition = numDigits + decimalExponent;
+
+        if (numDigits <= pointPosition && pointPosition <= 21)
+        {
+            out = copyDigits (out, digits, numDigits);
+            out = fill (out, '0', pointPosition - numDigits);
+        }
+        else if (0 < pointPosition && pointPosition <= 21)
+        {
+            out = copyDigits (out, digits, pointPosition);
+            *out++ = '.';
+            out = copyDigits (out, digits + pointPosition, numDigits - pointPosition);
+        }
+        else if (-6 < pointPosition && pointPosition <= 0)
+        {
+            *out++ = '0';
+            *out++ = '.';
+            out = fill (out, '0', -pointPosition);
+            out = copyDigits (out, digits, numDigits);
+        }
+        else
+        {
+            *out++ = digits[0];
+
+            if (numDigits > 1)
+            {
+                *out++ = '.';
+                out = copyDigits (out, digits + 1, numDigits - 1);
+            }
+
+            auto exponent = pointPosition - 1;
+            *out++ = 'e';
+            *out++ = exponent < 0 ? '-' : '+';
+            exponent = std::abs (exponent);
+
+            if (exponent >= 100)    *out++ = (char) ('0' + exponent / 100);
+            if (exponent >= 10)     *out++ = (char) ('0' + (exponent / 10) % 10);
+
+            *out++ = (char) ('0' + exponent % 10);
+        }
+
+        return (int) (out - buffer);
+    }
+
+    /** Returns a double as a string, the way Number.prototype.toString() does. */
+    static String toString (double value)
+    {
+        char buffer[maximumFormattedLength];
+        const auto length = formatDouble (value, buffer);
+        return String (buffer, (size_t) length);
+    }
+
+    /** Returns a double as a string in a radix between 2 and 36. */
+    static String toString (double value, int radix)
+    {
+        if (radix == 10 || ! std::isfinite (value))
+            return toString (value);
+
+        const auto isNegative = value < 0.0;
+        value = std::abs (value);
+
+        auto integerPart = std::floor (value);
+        auto fractionPart = value - integerPart;
+        std::string text;
+
+        do
+        {
+            text += getDigitCharacter ((int) std::fmod (integerPart, (double) radix));
+            integerPart = std::floor (integerPart / radix);
+        }
+        while (integerPart >= 1.0);
+
+        if (isNegative)
+            text += '-';
+
+        std::reverse (text.begin(), text.end());
+
+        // Fraction digits stop once they're finer than the precision of the value itself.
+        auto delta = jmax (0.5 * (std::nextafter (value, std::numeric_limits<double>::max()) - value),
+                           std::numeric_limits<double>::denorm_min());
+
+        if (fractionPart >= delta)
+        {
+            text += '.';
+
+            do
+            {
+                fractionPart *= radix;
+                delta *= radix;
+                const auto digit = (int) fractionPart;
+                text += getDigitCharacter (digit);
+                fractionPart -= digit;
+            }
+            while (fractionPart >= delta);
+        }
+
+        return String (text.c_str(), text.size());
+    }
+
+    /** Converts a value to a string the way scripts expect, so that doubles are
+        written like JS numbers (eg: "3" rather than the "3.0" of var::toString()).
+    */
+    static String toScriptString (const var& value)
+    {
+        if (value.isDouble())
+            return toString (static_cast<double> (value));
+
+        return value.toString();
+    }
+
+    /** Returns a number with a fixed number of decimal places, the way Number.prototype.toFixed() does.
+
+        Like JS, this rounds the exact binary value of the number, with ties going
+        away from zero, so it doesn't suffer from the errors that come from scaling
+        the number up by a power of ten first.
+    */
+    static String toFixed (double value, int numDecimalPlaces)
+    {
+        if (! isPositiveAndNotGreaterThan (numDecimalPlaces, 100))
+            throw String ("toFixed() digits argument must be between 0 and 100");
+
+        if (! std::isfinite (value) || std::abs (value) >= 1.0e21)
+            return toString (value);
+
+        const auto isNegative = value < 0.0;
+        value = std::abs (value);
+
+        std::string digits;
+
+        if (value == std::floor (value) && value < 9007199254740992.0)
+        {
+            digits = std::to_string ((uint64) value);
+            digits.append ((size_t) numDecimalPlaces, '0');
+        }
+        else
+        {
+            // value = mantissa * 2^exponent, exactly.
+            uint64 bits;
+            memcpy (&bits, &value, sizeof (bits));
+
+            const auto biasedExponent = (int) (bits >> 52);
+            auto mantissa = bits & (((uint64) 1 << 52) - 1);
+            auto exponent = biasedExponent == 0 ? -1074 : biasedExponent - 1075;
+
+            if (biasedExponent != 0)
+                mantissa |= (uint64) 1 << 52;
+
+            BigInteger scaled ((int64) mantissa);
+            const BigInteger ten (10);
+
+            for (int i = 0; i < numDecimalPlaces; ++i)
+                scaled *= ten;
+
+            if (exponent >= 0)
+            {
+                scaled <<= exponent;
+            }
+            else
+            {
+                BigInteger half;
+                half.setBit (-exponent - 1);
+                scaled += half;
+                scaled >>= -exponent;
+            }
+
+            digits = scaled.toString (10).toStdString();
+        }
+
+        if (numDecimalPlaces > 0)
+        {
+            if ((int) digits.size() <= numDecimalPlaces)
+                digits.insert (0, (size_t) (numDecimalPlaces + 1) - digits.size(), '0');
+
+            digits.insert (digits.size() - (size_t) numDecimalPlaces, 1, '.');
+        }
+
+        if (isNegative)
+            digits.insert (0, 1, '-');
+
+        return String (digits.c_str(), digits.size());
+    }
+
+    //==============================================================================
+    /** Reads the decimal number at the start of some text: an optional sign, then
+        either "Infinity" or digits with an optional fraction and exponent.
+
+        @returns a pointer to the end of the number, or the start of the text if there wasn't one.
+    */
+    static const char* parseDecimal (const char* text, const char* end, double& result) noexcept
+    {
+        auto* p = text;
+        auto isNegative = false;
+
+        if (p < end && (*p == '+' || *p == '-'))
+            isNegative = *p++ == '-';
+
+        if (end - p >= 8 && memcmp (p, "Infinity", 8) == 0)
+        {
+            result = isNegative ? -std::numeric_limits<double>::infinity()
+                                :  std::numeric_limits<double>::infinity();
+            return p + 8;
+        }
+
+        auto* digitsStart = p;
+        uint64 mantissa = 0;
+        int numSignificantDigits = 0, exponent = 0;
+        bool hasDigits = false, isTruncated = false;
+
+        for (; p < end && isDigit (*p); ++p)
+        {
+            hasDigits = true;
+
+            if (numSignificantDigits < 19)
+            {
+                mantissa = mantissa * 10 + (uint64) (*p - '0');
+
+                if (mantissa != 0)
+                    ++numSignificantDigits;
+            }
+            else
+            {
+                ++exponent;
+                isTruncated = isTruncated || *p != '0';
+            }
+        }
+
+        if (p < end && *p == '.')
+        {
+            for (++p; p < end && isDigit (*p); ++p)
+            {
+                hasDigits = true;
+
+                if (numSignificantDigits < 19)
+                {
+                    mantissa = mantissa * 10 + (uint64) (*p - '0');
+                    --exponent;
+
+                    if (mantissa != 0)
+                        ++numSignificantDigits;
+                }
+                else
+                {
+                    isTruncated = isTruncated || *p != '0';
+                }
+            }
+        }
+
+        if (! hasDigits)
+            return text;
+
+        if (p < end && (*p == 'e' || *p == 'E'))
+        {
+            auto* q = p + 1;
+            auto isExponentNegative = false;
+
+            if (q < end && (*q == '+' || *q == '-'))
+                isExponentNegative = *q++ == '-';
+
+            if (q < end && isDigit (*q))
+            {
+                int explicitExponent = 0;
+
+                for (; q < end && isDigit (*q); ++q)
+                    if (explicitExponent < 100000)
+                        explicitExponent = explicitExponent * 10 + (*q - '0');
+
+                exponent += isExponentNegative ? -explicitExponent : explicitExponent;
+                p = q;
+            }
+        }
+
+        if (mantissa == 0)
+            result = 0.0;
+        else if (isTruncated || ! fastPathToDouble (mantissa, exponent, result))
+            result = slowPathToDouble (digitsStart, p);
+
+        if (isNegative)
+            result = -result;
+
+        return p;
+    }
+
+    /** Converts a string to a number the way Number() does: surrounding whitespace is
+        ignored, an empty string is zero, and anything that isn't entirely a decimal
+        number or a 0x, 0o or 0b literal is NaN.
+    */
+    static double stringToNumber (const String& s)
+    {
+        auto* p = s.toRawUTF8();
+        auto* end = p + s.getNumBytesAsUTF8();
+
+        while (p < end && isWhitespace (*p))        ++p;
+        while (end > p && isWhitespace (end[-1]))   --end;
+
+        if (p == end)
+            return 0.0;
+
+        if (end - p > 2 && p[0] == '0')
+        {
+            const auto prefix = p[1] | 0x20;
+            const auto radix = prefix == 'x' ? 16 : (prefix == 'o' ? 8 : (prefix == 'b' ? 2 : 0));
+
+            if (radix != 0)
+            {
+                double result = 0.0;
+
+                if (parseDigits (p + 2, end, radix, result) != end)
+                    return std::numeric_limits<double>::quiet_NaN();
+
+                return result;
+            }
+        }
+
+        double result = 0.0;
+
+        if (parseDecimal (p, end, result) != end)
+            return std::numeric_limits<double>::quiet_NaN();
+
+        return result;
+    }
+
+    /** Reads the decimal number at the start of a string, the way parseFloat() does. */
+    static double parseFloat (const String& s)
+    {
+        auto* p = s.toRawUTF8();
+        auto* const end = p + s.getNumBytesAsUTF8();
+
+        while (p < end && isWhitespace (*p))
+            ++p;
+
+        double result = 0.0;
+
+        if (parseDecimal (p, end, result) == p)
+            return std::numeric_limits<double>::quiet_NaN();
+
+        return result;
+    }
+
+    /** Reads the integer at the start of a string, the way parseInt() does.
+
+        @param s        The text to read.
+        @param radix    The radix, from 2 to 36, or 0 to pick 16 when the number starts
+                        with 0x and 10 otherwise.
+    */
+    static double parseInt (const String& s, int radix)
+    {
+        auto* p = s.toRawUTF8();
+        auto* const end = p + s.getNumBytesAsUTF8();
+
+        while (p < end && isWhitespace (*p))
+            ++p;
+
+        auto isNegative = false;
+
+        if (p < end && (*p == '+' || *p == '-'))
+            isNegative = *p++ == '-';
+
+        if (radix != 0 && (radix < 2 || radix > 36))
+            return std::numeric_limits<double>::quiet_NaN();
+
+        if ((radix == 0 || radix == 16) && end - p >= 2 && p[0] == '0' && (p[1] | 0x20) == 'x')
+        {
+            p += 2;
+            radix = 16;
+        }
+
+        if (radix == 0)
+            radix = 10;
+
+        double result = 0.0;
+        auto* digitsEnd = parseDigits (p, end, radix, result);
+
+        if (digitsEnd == p)
+            return std::numeric_limits<double>::quiet_NaN();
+
+        // Long decimal numbers are read again properly, so that they get rounded correctly.
+        if (radix == 10 && result >= 9007199254740992.0)
+            parseDecimal (p, digitsEnd, result);
+
+        return isNegative ? -result : result;
+    }
+
+    /** Returns a number as a var, using an int if it's a whole number that fits in one. */
+    static var toVar (double value)
+    {
+        if (value >= (double) std::numeric_limits<int>::min()
+            && value <= (double) std::numeric_limits<int>::max()
+            && value == std::floor (value)
+            && ! (value == 0.0 && std::signbit (value)))
+            return (int) value;
+
+        return value;
+    }
+
+private:
+    //==============================================================================
+    NumberConversion() = delete;
+
+    static bool isDigit (char c) noexcept       { return c >= '0' && c <= '9'; }
+    static bool isWhitespace (char c) noexcept  { return c == ' ' || (c >= '\t' && c <= '\r'); }
+    static char getDigitCharacter (int digit) noexcept { return "0123456789abcdefghijklmnopqrstuvwxyz"[digit]; }
+
+    static int writeText (char* dest, const char* text) noexcept
+    {
+        const auto length = (int) strlen (text);
+        memcpy (dest, text, (size_t) length);
+        return length;
+    }
+
+    static char* copyDigits (char* dest, const char* digits, int numDigits) noexcept
+    {
+        memcpy (dest, digits, (size_t) numDigits);
+        return dest + numDigits;
+    }
+
+    static char* fill (char* dest, char c, int num) noexcept
+    {
+        memset (dest, c, (size_t) num);
+        return dest + num;
+    }
+
+    /** Reads digits in a radix, returning a pointer to the end of them. */
+    static const char* parseDigits (const char* p, const char* end, int radix, double& result) noexcept
+    {
+        uint64 value = 0;
+        auto approximation = 0.0;
+        auto hasOverflowed = false;
+
+        for (; p < end; ++p)
+        {
+            const auto c = (char) (*p | 0x20);
+            const auto digit = isDigit (*p) ? *p - '0'
+                                            : ((c >= 'a' && c <= 'z') ? c - 'a' + 10 : 99);
+
+            if (digit >= radix)
+                break;
+
+            if (! hasOverflowed && value > (std::numeric_limits<uint64>::max() - (uint64) digit) / (uint64) radix)
+            {
+                hasOverflowed = true;
+                approximation = (double) value;
+            }
+
+            if (hasOverflowed)
+                approximation = approximation * radix + digit;
+            else
+                value = value * (uint64) radix + (uint64) digit;
+        }
+
+        result = hasOverflowed ? approximation : (double) value;
+        return p;
+    }
+
+    //==============================================================================
+    /** Clinger's fast path: if the mantissa and the power of ten are both exactly
+        representable, a single multiplication or division gives the correctly rounded result.
+    */
+    static bool fastPathToDouble (uint64 mantissa, int exponent, double& result) noexcept
+    {
+        static const double powersOfTen[] =
+        {
+            1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+            1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+        };
+
+        constexpr uint64 maximumExactMantissa = (uint64) 1 << 53;
+
+        if (mantissa > maximumExactMantissa || exponent < -22 || exponent > 22 + 15)
+            return false;
+
+        // Something like 123e25 can have some of its exponent moved over to the mantissa.
+        for (; exponent > 22; --exponent)
+        {
+            mantissa *= 10;
+
+            if (mantissa > maximumExactMantissa)
+                return false;
+        }
+
+        result = exponent < 0 ? (double) mantissa / powersOfTen[-exponent]
+                              : (double) mantissa * powersOfTen[exponent];
+        return true;
+    }
+
+    static double slowPathToDouble (const char* start, const char* end)
+    {
+        const std::string text (start, end);
+        auto t = CharPointer_UTF8 (text.c_str());
+        return CharacterFunctions::readDoubleValue (t);
+    }
+
+    //==============================================================================
+    /** A floating point number with a 64-bit significand: f * 2^e */
+    struct DiyFp
+    {
+        uint64 f;
+        int e;
+
+        DiyFp operator- (const DiyFp& other) const noexcept { return { f - other.f, e }; }
+
+        /** Returns the product, rounded to 64 bits. */
+        DiyFp operator* (const DiyFp& other) const noexcept
+        {
+            const auto aLow = f & 0xffffffffu, aHigh = f >> 32;
+            const auto bLow = other.f & 0xffffffffu, bHigh = other.f >> 32;
+
+            const auto lowLow = aLow * bLow, lowHigh = aLow * bHigh;
+            const auto highLow = aHigh * bLow, highHigh = aHigh * bHigh;
+
+            auto middle = (lowLow >> 32) + (lowHigh & 0xffffffffu) + (highLow & 0xffffffffu);
+            middle += (uint64) 1 << 31;
+
+            return { highHigh + (highLow >> 32) + (lowHigh >> 32) + (middle >> 32), e + other.e + 64 };
+        }
+
+        DiyFp normalised() const noexcept
+        {
+            auto result = *this;
+
+            while ((result.f >> 63) == 0)
+            {
+                result.f <<= 1;
+                --result.e;
+            }
+
+            return result;
+        }
+
+        DiyFp normalisedTo (int targetExponent) const noexcept
+        {
+            return { f << (e - targetExponent), targetExponent };
+        }
+    };
+
+    struct CachedPower
+    {
+        uint64 f;
+        int e, k;
+    };
+
+    /** Returns a power of ten, c = f * 2^e = 10^k, that brings a number with
+        the given binary exponent into the range the digit generation needs.
+    */
+    static CachedPower getCachedPower (int binaryExponent) noexcept
+    {
+        // These are 10^k for every eighth k from -300 to 324, rounded to 64 bits.
+        static const CachedPower cachedPowers[] =
+        {
+            { 0xAB70FE17C79AC6CAull, -1060, -300 },
+            { 0xFF77B1FCBEBCDC4Full, -1034, -292 },
+            { 0xBE5691EF416BD60Cull, -1007, -284 },
+            { 0x8DD01FAD907FFC3Cull,  -980, -276 },
+            { 0xD3515C2831559A83ull,  -954, -268 },
+            { 0x9D71AC8FADA6C9B5ull,  -927, -260 },
+            { 0xEA9C227723EE8BCBull,  -901, -252 },
+            { 0xAECC49914078536Dull,  -874, -244 },
+            { 0x823C12795DB6CE57ull,  -847, -236 },
+            { 0xC21094364DFB5637ull,  -821, -228 },
+            { 0x9096EA6F3848984Full,  -794, -220 },
+            { 0xD77485CB25823AC7ull,  -768, -212 },
+            { 0xA086CFCD97BF97F4ull,  -741, -204 },
+            { 0xEF340A98172AACE5ull,  -715, -196 },
+            { 0xB23867FB2A35B28Eull,  -688, -188 },
+            { 0x84C8D4DFD2C63F3Bull,  -661, -180 },
+            { 0xC5DD44271AD3CDBAull,  -635, -172 },
+            { 0x936B9FCEBB25C996ull,  -608, -164 },
+            { 0xDBAC6C247D62A584ull,  -582, -156 },
+            { 0xA3AB66580D5FDAF6ull,  -555, -148 },
+            { 0xF3E2F893DEC3F126ull,  -529, -140 },
+            { 0xB5B5ADA8AAFF80B8ull,  -502, -132 },
+            { 0x87625F056C7C4A8Bull,  -475, -124 },
+            { 0xC9BCFF6034C13053ull,  -449, -116 },
+            { 0x964E858C91BA2655ull,  -422, -108 },
+            { 0xDFF9772470297EBDull,  -396, -100 },
+            { 0xA6DFBD9FB8E5B88Full,  -369,  -92 },
+            { 0xF8A95FCF88747D94ull,  -343,  -84 },
+            { 0xB94470938FA89BCFull,  -316,  -76 },
+            { 0x8A08F0F8BF0F156Bull,  -289,  -68 },
+            { 0xCDB02555653131B6ull,  -263,  -60 },
+            { 0x993FE2C6D07B7FACull,  -236,  -52 },
+            { 0xE45C10C42A2B3B06ull,  -210,  -44 },
+            { 0xAA242499697392D3ull,  -183,  -36 },
+            { 0xFD87B5F28300CA0Eull,  -157,  -28 },
+            { 0xBCE5086492111AEBull,  -130,  -20 },
+            { 0x8CBCCC096F5088CCull,  -103,  -12 },
+            { 0xD1B71758E219652Cull,   -77,   -4 },
+            { 0x9C40000000000000ull,   -50,    4 },
+            { 0xE8D4A51000000000ull,   -24,   12 },
+            { 0xAD78EBC5AC620000ull,     3,   20 },
+            { 0x813F3978F8940984ull,    30,   28 },
+            { 0xC097CE7BC90715B3ull,    56,   36 },
+            { 0x8F7E32CE7BEA5C70ull,    83,   44 },
+            { 0xD5D238A4ABE98068ull,   109,   52 },
+            { 0x9F4F2726179A2245ull,   136,   60 },
+            { 0xED63A231D4C4FB27ull,   162,   68 },
+            { 0xB0DE65388CC8ADA8ull,   189,   76 },
+            { 0x83C7088E1AAB65DBull,   216,   84 },
+            { 0xC45D1DF942711D9Aull,   242,   92 },
+            { 0x924D692CA61BE758ull,   269,  100 },
+            { 0xDA01EE641A708DEAull,   295,  108 },
+            { 0xA26DA3999AEF774Aull,   322,  116 },
+            { 0xF209787BB47D6B85ull,   348,  124 },
+            { 0xB454E4A179DD1877ull,   375,  132 },
+            { 0x865B86925B9BC5C2ull,   402,  140 },
+            { 0xC83553C5C8965D3Dull,   428,  148 },
+            { 0x952AB45CFA97A0B3ull,   455,  156 },
+            { 0xDE469FBD99A05FE3ull,   481,  164 },
+            { 0xA59BC234DB398C25ull,   508,  172 },
+            { 0xF6C69A72A3989F5Cull,   534,  180 },
+            { 0xB7DCBF5354E9BECEull,   561,  188 },
+            { 0x88FCF317F22241E2ull,   588,  196 },
+            { 0xCC20CE9BD35C78A5ull,   614,  204 },
+            { 0x98165AF37B2153DFull,   641,  212 },
+            { 0xE2A0B5DC971F303Aull,   667,  220 },
+            { 0xA8D9D1535CE3B396ull,   694,  228 },
+            { 0xFB9B7CD9A4A7443Cull,   720,  236 },
+            { 0xBB764C4CA7A44410ull,   747,  244 },
+            { 0x8BAB8EEFB6409C1Aull,   774,  252 },
+            { 0xD01FEF10A657842Cull,   800,  260 },
+            { 0x9B10A4E5E9913129ull,   827,  268 },
+            { 0xE7109BFBA19C0C9Dull,   853,  276 },
+            { 0xAC2820D9623BF429ull,   880,  284 },
+            { 0x80444B5E7AA7CF85ull,   907,  292 },
+            { 0xBF21E44003ACDD2Dull,   933,  300 },
+            { 0x8E679C2F5E44FF8Full,   960,  308 },
+            { 0xD433179D9C8CB841ull,   986,  316 },
+            { 0x9E19DB92B4E31BA9ull,  1013,  324 }
+        };
+
+        enum { alpha = -60, minimumDecimalExponent = -300, decimalExponentStep = 8 };
+
+        const auto f = alpha - binaryExponent - 1;
+        const auto k = (f * 78913) / (1 << 18) + (f > 0 ? 1 : 0);
+        const auto index = (-minimumDecimalExponent + k + (decimalExponentStep - 1)) / decimalExponentStep;
+
+        jassert (isPositiveAndBelow (index, (int) numElementsInArray (cachedPowers)));
+        return cachedPowers[index];
+    }
+
+    static int findLargestPowerOfTen (uint32 n, uint32& powerOfTen) noexcept
+    {
+        static const uint32 powers[] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000 };
+
+        for (int i = 9; i > 0; --i)
+        {
+            if (n >= powers[i])
+            {
+                powerOfTen = powers[i];
+                return i + 1;
+            }
+        }
+
+        powerOfTen = 1;
+        return 1;
+    }
+
+    static void roundWeed (char* digits, int numDigits, uint64 distance, uint64 delta, uint64 rest, uint64 tenToTheK) noexcept
+    {
+        while (rest < distance
+               && delta - rest >= tenToTheK
+               && (rest + tenToTheK < distance || distance - rest > rest + tenToTheK - distance))
+        {
+            --digits[numDigits - 1];
+            rest += tenToTheK;
+        }
+    }
+
+    /** Generates digits that lie between the boundaries of a positive, finite double,
+        which read back as the same value, and are the shortest such digits in nearly all cases.
+
+        See Florian Loitsch's "Printing Floating-Point Numbers Quickly and Accurately with Integers".
+    */
+    static void grisu2 (double value, char* digits, int& numDigits, int& decimalExponent) noexcept
+    {
+        uint64 bits;
+        memcpy (&bits, &value, sizeof (bits));
+
+        const auto hiddenBit = (uint64) 1 << 52;
+        const auto biasedExponent = (int) (bits >> 52);
+        const auto fraction = bits & (hiddenBit - 1);
+
+        const DiyFp v = biasedExponent == 0 ? DiyFp { fraction, -1074 }
+                                            : DiyFp { fraction + hiddenBit, biasedExponent - 1075 };
+
+        // The boundaries are halfway to the neighbouring doubles, the lower one being
+        // closer when the value is a power of two.
+        const auto lowerBoundaryIsCloser = fraction == 0 && biasedExponent > 1;
+        const auto upper = DiyFp { 2 * v.f + 1, v.e - 1 }.normalised();
+        const auto lower = (lowerBoundaryIsCloser ? DiyFp { 4 * v.f - 1, v.e - 2 }
+                                                  : DiyFp { 2 * v.f - 1, v.e - 1 }).normalisedTo (upper.e);
+
+        const auto cached = getCachedPower (upper.e);
+        const DiyFp c { cached.f, cached.e };
+
+        const auto w = v.normalised() * c;
+        auto wLower = lower * c;
+        auto wUpper = upper * c;
+
+        // Allow for the errors in the multiplications by staying one unit inside the boundaries.
+        ++wLower.f;
+        --wUpper.f;
+
+        decimalExponent = -cached.k;
+        numDigits = 0;
+
+        auto delta = (wUpper - wLower).f;
+        auto distance = (wUpper - w).f;
+
+        const DiyFp one { (uint64) 1 << -wUpper.e, wUpper.e };
+        auto integral = (uint32) (wUpper.f >> -one.e);
+        auto fractional = wUpper.f & (one.f - 1);
+
+        uint32 powerOfTen = 1;
+        auto n = findLargestPowerOfTen (integral, powerOfTen);
+
+        while (n > 0)
+        {
+            digits[numDigits++] = (char) ('0' + integral / powerOfTen);
+            integral %= powerOfTen;
+            --n;
+
+            const auto rest = ((uint64) integral << -one.e) + fractional;
+
+            if (rest <= delta)
+            {
+                decimalExponent += n;
+                roundWeed (digits, numDigits, distance, delta, rest, (uint64) powerOfTen << -one.e);
+                return;
+            }
+
+            powerOfTen /= 10;
+        }
+
+        int m = 0;
+
+        for (;;)
+        {
+            fractional *= 10;
+            digits[numDigits++] = (char) ('0' + (fractional >> -one.e));
+            fractional &= one.f - 1;
+            ++m;
+            delta *= 10;
+            distance *= 10;
+
+            if (fractional <= delta)
+                break;
+        }
+
+        decimalExponent -= m;
+        roundWeed (digits, numDigits, distance, delta, fractional, one.f);
+    }
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (NumberConversion)
+};
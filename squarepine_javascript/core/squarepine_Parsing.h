@@ -50,9 +50,43 @@ using TokenType = const char*;
 static String getTokenName (TokenType t)                                        { return t[0] == '$' ? String (t + 1) : ("'" + String (t) + "'"); }
 static bool isNumeric (const var& v) noexcept                                   { return v.isInt() || v.isDouble() || v.isInt64() || v.isBool(); }
 static bool isNumericOrUndefined (const var& v) noexcept                        { return isNumeric (v) || v.isUndefined(); }
-static int64 getOctalValue (const String& s)                                    { BigInteger b; b.parseString (s.initialSectionContainingOnly ("01234567"), 8); return b.toInt64(); }
 static Identifier getPrototypeIdentifier()                                      { static const Identifier i ("prototype"); return i; }
-static var* getPropertyPointer (DynamicObject& o, const Identifier& i) noexcept { return o.getProperties().getVarPointer (i); }
+
+//==============================================================================
+#if SP_JAVASCRIPT_ENABLE_INSTRUMENTATION
+ /** Bumps one of the InstrumentationCounters of the engine running on this thread. */
+ #define SP_JS_COUNT(counter) \
+    do { if (auto* countingRoot = RootObject::getCurrent()) ++countingRoot->counters.counter; } while (false)
+#else
+ #define SP_JS_COUNT(counter) \
+    do {} while (false)
+#endif
+
+/** Counts an evaluation of one of the InstrumentationCounters::NodeType kinds of statement or expression. */
+#define SP_JS_COUNT_NODE(nodeType) \
+    SP_JS_COUNT (nodeEvaluations[InstrumentationCounters::nodeType])
+
+//==============================================================================
+static var* getPropertyPointer (DynamicObject& o, const Identifier& i) noexcept
+{
+    SP_JS_COUNT (propertyLookups);
+    return o.getProperties().getVarPointer (i);
+}
+
+/** Accounts for memory that a script is about to allocate, throwing if that takes the running engine over its heap limit. */
+static void allocateScriptMemory (int64 numBytes)
+{
+    if (auto* root = RootObject::getCurrent())
+        root->heap.allocate (numBytes);
+}
+
+static int64 getAllocationSize (const String& s) noexcept                       { return (int64) (sizeof (String) * 2 + s.getNumBytesAsUTF8() + 1); }
+static int64 getAllocationSize (const Array<var>& a) noexcept                   { return (int64) (sizeof (Array<var>) + sizeof (var) * (size_t) a.size()); }
+
+/** Accounts for a newly built string that a script is about to be handed. */
+static void allocateScriptMemory (const String& s)                              { SP_JS_COUNT (stringAllocations); allocateScriptMemory (getAllocationSize (s)); }
+/** Accounts for a newly built array that a script is about to be handed. */
+static void allocateScriptMemory (const Array<var>& a)                          { SP_JS_COUNT (arrayAllocations); allocateScriptMemory (getAllocationSize (a)); }
 
 bool isFunction (const var& v) noexcept;
 
@@ -75,7 +109,7 @@ static bool isInt (Args a, int index) noexcept              { return get (a, ind
 static int getInt (Args a, int index) noexcept              { return static_cast<int> (get (a, index)); }
 static double getDouble (Args a, int index) noexcept        { return static_cast<double> (get (a, index)); }
 static bool isString (Args a, int index) noexcept           { return get (a, index).isString(); }
-static String getString (Args a, int index) noexcept        { return get (a, index).toString(); }
+static String getString (Args a, int index)                 { return NumberConversion::toScriptString (get (a, index)); }
 static var trace (Args a)                                   { Logger::outputDebugString (JSON::toString (a.thisObject)); return var::undefined(); }
 static var charToInt (Args a)                               { return (int) getString (a, 0)[0]; }
 
@@ -153,10 +187,46 @@ static var eval (Args a)
     return exec (a);
 }
 
-static var setTimeout (Args a)
+//==============================================================================
+static var addTimer (Args a, bool repeats)
 {
-    if (auto* root = dynamic_cast<RootObject*> (a.thisObject.getObject()))
-        root->setTimeoutInternal (getString (a, 0));
+    auto* root = RootObject::getCurrent();
+
+    if (root == nullptr)
+        return var::undefined();
+
+    EventLoop::Task task { get (a, 0), {} };
+
+    if (! (isFunction (task.function) || task.function.isMethod() || task.function.isString()))
+        throw String ("The callback given to a timer must be a function");
+
+    for (int i = 2; i < a.numArguments; ++i)
+        task.arguments.add (a.arguments[i]);
+
+    return NumberConversion::toVar ((double) root->eventLoop.addTimer (std::move (task), getDouble (a, 1), repeats));
+}
+
+static var setTimeout (Args a)      { return addTimer (a, false); }
+static var setInterval (Args a)     { return addTimer (a, true); }
+
+static var clearTimer (Args a)
+{
+    if (auto* root = RootObject::getCurrent())
+        if (isNumeric (get (a, 0)))
+            root->eventLoop.cancelTimer (static_cast<int64> (get (a, 0)));
+
+    return var::undefined();
+}
+
+static var queueMicrotask (Args a)
+{
+    const auto function = get (a, 0);
+
+    if (! (isFunction (function) || function.isMethod()))
+        throw String ("queueMicrotask needs a function");
+
+    if (auto* root = RootObject::getCurrent())
+        root->eventLoop.queueMicrotask ({ function, {} });
 
     return var::undefined();
 }
@@ -229,12 +299,15 @@ struct CodeLocation final
 };
 
 //==============================================================================
+struct ResumableFrame;
+
 struct Scope final
 {
-    Scope (const Scope* p, ReferenceCountedObjectPtr<RootObject> rt, DynamicObject::Ptr scp) noexcept :
+    Scope (const Scope* p, ReferenceCountedObjectPtr<RootObject> rt, DynamicObject::Ptr scp, ResumableFrame* f = nullptr) noexcept :
         parent (p),
         root (std::move (rt)),
-        scope (std::move (scp))
+        scope (std::move (scp)),
+        frame (f)
     {
     }
 
@@ -242,6 +315,9 @@ struct Scope final
     ReferenceCountedObjectPtr<RootObject> root;
     DynamicObject::Ptr scope;
 
+    /** The async function or generator call this is the scope of, if it's one that can be suspended. */
+    ResumableFrame* const frame;
+
     var findFunctionCall (const CodeLocation& location, const var& targetObject, const Identifier& functionName) const;
     var* findRootClassProperty (const Identifier& className, const Identifier& propName) const;
     var findSymbolInParentScopes (const Identifier& name) const;
@@ -249,6 +325,14 @@ struct Scope final
     bool invokeMethod (const var& m, const var::NativeFunctionArgs& args, var& result) const;
     void checkTimeOut (const CodeLocation& location) const;
 
+    /** A safepoint for the profiler, which records a sample here if one is due. */
+    void sampleIfDue (const CodeLocation& location) const
+    {
+        if (auto* profiler = root->profiler.get())
+            if (profiler->isSampleDue())
+                profiler->takeSample (location.program, location.location);
+    }
+
 private:
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (Scope)
 };
@@ -269,7 +353,11 @@ struct Statement
 
     virtual ResultCode perform (const Scope&, var*) const  { return ResultCode::ok; }
 
+    /** Counts a run of this statement, if coverage is being collected for it. */
+    void markCovered() const noexcept                       { ScriptCoverage::hit (coverageSlot); }
+
     CodeLocation location;
+    ScriptCoverage::Slot* coverageSlot = nullptr;
 
 private:
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (Statement)
@@ -283,10 +371,252 @@ struct Expression : public Statement
     virtual var getResult (const Scope&) const                  { return var::undefined(); }
     virtual void assign (const Scope&, const var&) const        { location.throwError ("Cannot assign to this expression!"); }
     ResultCode perform (const Scope& s, var*) const override    { getResult (s); return ResultCode::ok; }
+
+    /** Compound assignments read their target and then write back to it, so a target evaluates the parts
+        that say where it is (eg: the object and the key of a[i++]) once, and is then read and written with them.
+    */
+    virtual void evaluateReference (const Scope&, var& /*object*/, var& /*key*/) const                  {}
+    /** */
+    virtual var getReferencedValue (const Scope& s, const var&, const var&) const                       { return getResult (s); }
+    /** */
+    virtual void assignReferenced (const Scope& s, const var&, const var&, const var& newValue) const   { assign (s, newValue); }
+    /** @returns the var that a target is stored in, if it's one that can be written to directly. */
+    virtual var* getReferencedPointer (const Scope&, const var&, const var&) const                      { return nullptr; }
 };
 
 using ExpPtr = std::unique_ptr<Expression>;
 
+//==============================================================================
+/** Thrown by an await or a yield to unwind the interpreter back out to its function,
+    once each of the nodes on the way has saved its progress in the function's frame.
+*/
+struct SuspendExecution final {};
+
+//==============================================================================
+/** A call to an async function or a generator, which can be suspended at an await
+    or a yield, and carried on with later.
+
+    The interpreter walks the syntax tree recursively, so there's no stack frame to
+    capture when a function gets suspended. Instead, each node between the function's
+    body and the await or yield records the step it was in the middle of, along with the
+    values it had already evaluated (see ResumePoint). Resuming the call runs the body again,
+    with each of those nodes skipping straight to where it left off, until the await or
+    yield hands back the value that the function was resumed with.
+
+    Since the caller's scopes are gone by the time the function is resumed,
+    the frame holds on to their objects and rebuilds the chain from them.
+*/
+struct ResumableFrame final : public ScriptObject
+{
+    ResumableFrame (const var& fn, const Scope& caller, const var& scopeObject) :
+        function (fn),
+        functionRoot (scopeObject),
+        root (*caller.root)
+    {
+        for (auto* s = &caller; s != nullptr; s = s->parent)
+            if (s->scope.get() != &root)
+                callerScopes.insert (0, var (s->scope.get()));
+    }
+
+    //==============================================================================
+    /** Runs the function until it either returns or gets suspended.
+
+        Errors get thrown as usual, and leave the function finished.
+
+        @returns true if the function returned, in which case returnValue is set to what it returned.
+    */
+    bool run (var& returnValue);
+
+    /** Runs an async function until it gets suspended, or until it finishes, in which case its promise gets settled. */
+    void runAsync();
+
+    /** Carries on with an async function, once the promise it was awaiting has been settled. */
+    void resume (const var& value, bool wasRejected)
+    {
+        setResumeValue (value, wasRejected);
+        runAsync();
+    }
+
+    /** Sets what the await or yield that suspended the function will give back, or throw if it's a rejection. */
+    void setResumeValue (const var& value, bool isRejection)
+    {
+        resumeValue = value;
+        resumeWithRejection = isRejection;
+    }
+
+    /** Called by the await or yield that suspended the function, to pick up the value it was resumed with. */
+    var takeResumeValue()
+    {
+        auto value = std::move (resumeValue);
+        resumeValue = var();
+
+        if (resumeWithRejection)
+            throw NumberConversion::toScriptString (value);
+
+        return value;
+    }
+
+    /** Picks up the value the function was resumed with, leaving it to the caller to deal with a rejection. */
+    var takeResumeValue (bool& isRejection)
+    {
+        isRejection = resumeWithRejection;
+        auto value = std::move (resumeValue);
+        resumeValue = var();
+        return value;
+    }
+
+    /** Called by a yield, to hand a value back to whatever resumed the generator. */
+    void setYieldedValue (const var& value)     { yieldedValue = value; }
+
+    /** */
+    var takeYieldedValue()
+    {
+        auto value = std::move (yieldedValue);
+        yieldedValue = var();
+        return value;
+    }
+
+    //==============================================================================
+    void save (const Statement& node, int step, Array<var>&& values)
+    {
+        savedStates.push_back ({ &node, step, std::move (values) });
+    }
+
+    bool restore (const Statement& node, int& step, Array<var>& values)
+    {
+        if (savedStates.empty())
+            return false;
+
+        auto& state = savedStates.back();
+        jassert (state.node == &node); // The function is taking a different path from the one it was suspended on!
+
+        step = state.step;
+        values = std::move (state.values);
+        savedStates.pop_back();
+        return true;
+    }
+
+    //==============================================================================
+    void visitReferences (ReferenceVisitor& visitor) override
+    {
+        ScriptObject::visitReferences (visitor);
+
+        visitor.visit (function);
+        visitor.visit (functionRoot);
+        visitor.visit (promise);
+        visitor.visit (resumeValue);
+        visitor.visit (yieldedValue);
+        visitor.visit (delegate);
+
+        for (const auto& s : callerScopes)
+            visitor.visit (s);
+
+        for (const auto& state : savedStates)
+            for (const auto& v : state.values)
+                visitor.visit (v);
+    }
+
+    void clearReferences() override
+    {
+        ScriptObject::clearReferences();
+        function = functionRoot = promise = resumeValue = yieldedValue = delegate = var();
+        callerScopes.clear();
+        savedStates.clear();
+    }
+
+    var function, functionRoot, promise;
+    var delegate; // What a yield* that the generator is suspended at is iterating over, so that a return() can be passed on to it
+    Array<var> callerScopes;
+    RootObject& root;
+
+private:
+    struct SavedState
+    {
+        const Statement* node;
+        int step;
+        Array<var> values;
+    };
+
+    std::vector<SavedState> savedStates;
+    var resumeValue, yieldedValue;
+    bool resumeWithRejection = false;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ResumableFrame)
+};
+
+//==============================================================================
+/** Lets a node pick up from where it left off, when the async function it's part of gets resumed.
+
+    Each of a node's sub-expressions and sub-statements is evaluated as one of its steps,
+    via run() or evaluate(). If an await suspends the function part-way through a step,
+    the node saves that step and the values of the ones before it in the frame, and
+    when the function is resumed, the node is handed them back here.
+
+    Outside of async functions, none of this costs more than checking a null pointer.
+*/
+struct ResumePoint final
+{
+    ResumePoint (const Scope& s, const Statement& n) :
+        scope (s),
+        node (n)
+    {
+        if (s.frame != nullptr)
+            resuming = s.frame->restore (n, resumedStep, values);
+    }
+
+    /** @returns true if the node is carrying on from where it was suspended. */
+    bool isResuming() const noexcept                { return resuming; }
+
+    /** @returns the step the node was suspended in, or 0 if it's starting afresh. */
+    int getResumedStep() const noexcept             { return resumedStep; }
+
+    /** Runs one of the node's steps, saving it as the one to resume from if the function gets suspended. */
+    template<typename Function>
+    auto run (int step, Function&& function) -> decltype (function())
+    {
+        if (scope.frame == nullptr)
+            return function();
+
+        try
+        {
+            return function();
+        }
+        catch (const SuspendExecution&)
+        {
+            scope.frame->save (node, step, std::move (values));
+            throw;
+        }
+    }
+
+    /** Evaluates a sub-expression, or gives back the value it had if this happened before the node got suspended.
+
+        This is for nodes that evaluate each of their sub-expressions at most once, in order.
+    */
+    var evaluate (int step, const Expression& e)
+    {
+        if (scope.frame == nullptr)
+            return e.getResult (scope);
+
+        if (step < resumedStep)
+            return values[step];
+
+        auto result = run (step, [&] { return e.getResult (scope); });
+        values.resize (jmax (values.size(), step + 1));
+        values.setUnchecked (step, result);
+        return result;
+    }
+
+    const Scope& scope;
+    const Statement& node;
+    Array<var> values;
+
+private:
+    int resumedStep = 0;
+    bool resuming = false;
+
+    JUCE_DECLARE_NON_COPYABLE (ResumePoint)
+};
+
 //==============================================================================
 struct BlockStatement final : public Statement
 {
@@ -294,9 +624,19 @@ struct BlockStatement final : public Statement
 
     ResultCode perform (const Scope& s, var* returnedValue) const override
     {
-        for (auto* statement : statements)
+        SP_JS_COUNT_NODE (BlockStatement);
+
+        ResumePoint resume (s, *this);
+
+        for (int i = resume.getResumedStep(); i < statements.size(); ++i)
         {
-            const auto r = statement->perform (s, returnedValue);
+            auto* statement = statements.getUnchecked (i);
+            s.sampleIfDue (statement->location);
+
+            if (! resume.isResuming() || i > resume.getResumedStep())
+                statement->markCovered();
+
+            const auto r = resume.run (i, [&] { return statement->perform (s, returnedValue); });
             if (r != ResultCode::ok)
                 return r;
         }
@@ -313,11 +653,24 @@ struct IfStatement final : public Statement
 
     ResultCode perform (const Scope& s, var* returnedValue) const override
     {
-        return (condition->getResult(s) ? trueBranch : falseBranch)->perform (s, returnedValue);
+        SP_JS_COUNT_NODE (IfStatement);
+
+        ResumePoint resume (s, *this);
+        auto branch = resume.getResumedStep();
+
+        if (branch == 0)
+        {
+            branch = resume.run (0, [&] { return condition->getResult (s) ? 1 : 2; });
+            ScriptCoverage::hit (branchSlot, branch - 1);
+            (branch == 1 ? trueBranch : falseBranch)->markCovered();
+        }
+
+        return resume.run (branch, [&] { return (branch == 1 ? trueBranch : falseBranch)->perform (s, returnedValue); });
     }
 
     ExpPtr condition;
     std::unique_ptr<Statement> trueBranch, falseBranch;
+    ScriptCoverage::Slot* branchSlot = nullptr;
 };
 
 struct VarStatement final : public Statement
@@ -326,6 +679,8 @@ struct VarStatement final : public Statement
 
     ResultCode perform (const Scope& s, var*) const override
     {
+        SP_JS_COUNT_NODE (VarStatement);
+
         s.scope->setProperty (name, initialiser->getResult (s));
         return ResultCode::ok;
     }
@@ -340,20 +695,76 @@ struct LoopStatement final : public Statement
 
     ResultCode perform (const Scope& s, var* returnedValue) const override
     {
-        initialiser->perform (s, nullptr);
+        SP_JS_COUNT_NODE (LoopStatement);
 
-        while (isDoLoop || condition->getResult (s))
+        // The loop is written out as the phases it goes through, so that it can be resumed part-way through one.
+        enum
         {
-            s.checkTimeOut (location);
-            auto r = body->perform (s, returnedValue);
+            initialising = 0,
+            testing,
+            running,
+            iterating,
+            iteratingAfterContinue,
+            testingAfterBody
+        };
 
-            if (r == ResultCode::returnWasHit)      return r;
-            else if (r == ResultCode::breakWasHit)  break;
+        ResumePoint resume (s, *this);
+        auto phase = resume.getResumedStep();
 
-            iterator->perform (s, nullptr);
+        // When carrying on part-way through the body, its run has already been counted.
+        auto resumingBody = phase == running;
 
-            if (isDoLoop && r != ResultCode::continueWasHit && ! condition->getResult (s))
-                break;
+        if (phase == initialising)
+        {
+            if (! resume.isResuming())
+                initialiser->markCovered();
+
+            resume.run (initialising, [&] { return initialiser->perform (s, nullptr); });
+            phase = isDoLoop ? running : testing;
+        }
+
+        for (;;)
+        {
+            if (phase == testing)
+            {
+                if (! resume.run (testing, [&] { return (bool) condition->getResult (s); }))
+                    break;
+
+                phase = running;
+            }
+
+            if (phase == running)
+            {
+                s.checkTimeOut (location);
+
+                if (! resumingBody)
+                    body->markCovered();
+
+                resumingBody = false;
+                auto r = resume.run (running, [&] { return body->perform (s, returnedValue); });
+
+                if (r == ResultCode::returnWasHit)      return r;
+                else if (r == ResultCode::breakWasHit)  break;
+
+                phase = r == ResultCode::continueWasHit ? iteratingAfterContinue : iterating;
+            }
+
+            if (phase == iterating || phase == iteratingAfterContinue)
+            {
+                resume.run (phase, [&] { return iterator->perform (s, nullptr); });
+
+                if (! isDoLoop)                         phase = testing;
+                else if (phase == iterating)            phase = testingAfterBody;
+                else                                    phase = running;
+            }
+
+            if (phase == testingAfterBody)
+            {
+                if (! resume.run (testingAfterBody, [&] { return (bool) condition->getResult (s); }))
+                    break;
+
+                phase = running;
+            }
         }
 
         return ResultCode::ok;
@@ -370,6 +781,8 @@ struct ReturnStatement final : public Statement
 
     ResultCode perform (const Scope& s, var* ret) const override
     {
+        SP_JS_COUNT_NODE (ReturnStatement);
+
         if (ret != nullptr)  *ret = returnValue->getResult (s);
         return ResultCode::returnWasHit;
     }
@@ -380,27 +793,35 @@ struct ReturnStatement final : public Statement
 struct BreakStatement final : public Statement
 {
     BreakStatement (const CodeLocation& l) noexcept : Statement (l) {}
-    ResultCode perform (const Scope&, var*) const override  { return ResultCode::breakWasHit; }
+    ResultCode perform (const Scope&, var*) const override  { SP_JS_COUNT_NODE (BreakStatement); return ResultCode::breakWasHit; }
 };
 
 struct ContinueStatement final : public Statement
 {
     ContinueStatement (const CodeLocation& l) noexcept : Statement (l) {}
-    ResultCode perform (const Scope&, var*) const override  { return ResultCode::continueWasHit; }
+    ResultCode perform (const Scope&, var*) const override  { SP_JS_COUNT_NODE (ContinueStatement); return ResultCode::continueWasHit; }
 };
 
 struct LiteralValue final : public Expression
 {
     LiteralValue (const CodeLocation& l, const var& v) noexcept : Expression (l), value (v) {}
-    var getResult (const Scope&) const override   { return value; }
+    var getResult (const Scope&) const override   { SP_JS_COUNT_NODE (LiteralValue); return value; }
     var value;
 };
 
+/** A regular expression literal, like /ab+c/g. The pattern is compiled once when the code is parsed. */
+struct RegexLiteral final : public Expression
+{
+    RegexLiteral (const CodeLocation& l, RegexProgram::Ptr p) noexcept : Expression (l), program (std::move (p)) {}
+    var getResult (const Scope&) const override;
+    RegexProgram::Ptr program;
+};
+
 struct UnqualifiedName final : public Expression
 {
     UnqualifiedName (const CodeLocation& l, const Identifier& n) noexcept : Expression (l), name (n) {}
 
-    var getResult (const Scope& s) const override  { return s.findSymbolInParentScopes (name); }
+    var getResult (const Scope& s) const override  { SP_JS_COUNT_NODE (UnqualifiedName); return s.findSymbolInParentScopes (name); }
 
     void assign (const Scope& s, const var& newValue) const override
     {
@@ -410,42 +831,152 @@ struct UnqualifiedName final : public Expression
             s.root->setProperty (name, newValue);
     }
 
+    /** Finds the var the same way assign() does: in the local scope, or failing that in the root,
+        so that appending to a global from inside a function can also be done in place.
+    */
+    var* getReferencedPointer (const Scope& s, const var&, const var&) const override
+    {
+        if (auto* v = getPropertyPointer (*s.scope, name))
+            return v;
+
+        return getPropertyPointer (*s.root, name);
+    }
+
     Identifier name;
 };
 
+/** A for...of or for...in loop.
+
+    Arrays, strings and binary data are walked through by index, without creating
+    any iterator objects, and generators are resumed directly rather than through
+    their next() method. Anything else with a next() method is iterated over by
+    calling it, since there's no Symbol.iterator for objects to supply an iterator with.
+*/
+struct ForEachLoop final : public Statement
+{
+    ForEachLoop (const CodeLocation& l, bool keys) noexcept : Statement (l), iteratesKeys (keys) {}
+
+    ResultCode perform (const Scope&, var*) const override;
+
+    /** @returns true if a for...of loop (or a for...in loop, if keys is set) can go over the value. */
+    static bool canIterate (const var& iterable, bool keys);
+
+    /** Where an iteration has got to. */
+    struct Position
+    {
+        int index = 0;          /**< The number of items fetched so far. */
+        int byteOffset = 0;     /**< For a string, where its next character starts, so that carrying on doesn't mean counting characters from the start. */
+    };
+
+    /** Fetches the next item from something being iterated over.
+
+        @param iterable     What's being iterated over.
+        @param keys         If true, this gives back the keys rather than the values.
+        @param position     Where the iteration has got to, which starts off at zero
+                            and gets moved along by each call.
+        @param item         Set to the next item.
+        @returns false once there aren't any more items.
+    */
+    static bool getNextItem (const var& iterable, bool keys, Position& position, var& item);
+
+    /** Lets an iterator know that the loop has finished with it early. */
+    static void closeIterator (const var& iterable);
+
+    std::unique_ptr<UnqualifiedName> variable;
+    ExpPtr source;
+    std::unique_ptr<Statement> body;
+    bool declaresVariable = false;
+    const bool iteratesKeys;
+};
+
 //==============================================================================
 struct DotOperator final : public Expression
 {
-    DotOperator (const CodeLocation& l, ExpPtr& p, const Identifier& c) noexcept : Expression (l), parent (p.release()), child (c) {}
+    DotOperator (const CodeLocation& l, ExpPtr& p, const Identifier& c) noexcept :
+        Expression (l),
+        parent (p.release()),
+        child (c),
+        isLength (c.toString() == "length")
+    {
+    }
 
     var getResult (const Scope& s) const override
     {
-        auto p = parent->getResult (s);
-        static const Identifier lengthID ("length");
+        SP_JS_COUNT_NODE (DotOperator);
+        return getReferencedValue (s, parent->getResult (s), {});
+    }
 
-        if (child == lengthID)
+    void assign (const Scope& s, const var& newValue) const override
+    {
+        assignReferenced (s, parent->getResult (s), {}, newValue);
+    }
+
+    void evaluateReference (const Scope& s, var& object, var&) const override
+    {
+        object = parent->getResult (s);
+    }
+
+    var getReferencedValue (const Scope& s, const var& p, const var&) const override
+    {
+        if (isLength)
         {
             if (auto* array = p.getArray())   return array->size();
             if (p.isString())                 return p.toString().length();
         }
 
+        if (p.getArray() != nullptr)
+        {
+            if (auto* v = s.root->findArrayProperty (p, child))
+                return *v;
+
+            return var::undefined();
+        }
+
         if (auto* o = p.getDynamicObject())
+        {
             if (auto* v = getPropertyPointer (*o, child))
                 return *v;
 
+            // Only looked for once an object's own properties have missed, so that plain objects don't pay for it.
+            if (auto* bound = dynamic_cast<BoundObject*> (o))
+                return bound->getBoundProperty (child);
+        }
+
         return var::undefined();
     }
 
-    void assign (const Scope& s, const var& newValue) const override
+    void assignReferenced (const Scope& s, const var& p, const var&, const var& newValue) const override
     {
-        if (auto* o = parent->getResult (s).getDynamicObject())
+        if (auto* o = p.getDynamicObject())
+        {
+            if (getPropertyPointer (*o, child) == nullptr)
+            {
+                if (auto* bound = dynamic_cast<BoundObject*> (o))
+                    if (bound->setBoundProperty (child, newValue))
+                        return;
+
+                s.root->heap.allocate ((int64) sizeof (NamedValueSet::NamedValue));
+            }
+
             o->setProperty (child, newValue);
+        }
         else
+        {
             Expression::assign (s, newValue);
+        }
+    }
+
+    var* getReferencedPointer (const Scope&, const var& p, const var&) const override
+    {
+        if (auto* o = p.getDynamicObject())
+            return getPropertyPointer (*o, child);
+
+        return nullptr;
     }
 
     ExpPtr parent;
     Identifier child;
+    const bool isLength; // Worked out up front, since arrays and strings have a length without it being a property.
 };
 
 //==============================================================================
@@ -455,33 +986,86 @@ struct ArraySubscript final : public Expression
 
     var getResult (const Scope& s) const override
     {
-        auto arrayVar = object->getResult (s); // must stay alive for the scope of this method
-        auto key = index->getResult (s);
+        SP_JS_COUNT_NODE (ArraySubscript);
 
+        var arrayVar, key; // must stay alive for the scope of this method
+        evaluateReference (s, arrayVar, key);
+        return getReferencedValue (s, arrayVar, key);
+    }
+
+    void assign (const Scope& s, const var& newValue) const override
+    {
+        var arrayVar, key;
+        evaluateReference (s, arrayVar, key);
+        assignReferenced (s, arrayVar, key, newValue);
+    }
+
+    void evaluateReference (const Scope& s, var& arrayVar, var& key) const override
+    {
+        ResumePoint resume (s, *this);
+        arrayVar = resume.evaluate (0, *object);
+        key = resume.evaluate (1, *index);
+    }
+
+    var getReferencedValue (const Scope& s, const var& arrayVar, const var& key) const override
+    {
         if (const auto* array = arrayVar.getArray())
-            if (key.isInt() || key.isInt64() || key.isDouble())
-                return (*array) [static_cast<int> (key)];
+        {
+            if (isNumericKey (key))
+            {
+                int64 i = 0;
+
+                if (getArrayIndex (key, i) && i < static_cast<int64> (array->size()))
+                    return array->getReference (static_cast<int> (i));
 
+                return var::undefined();
+            }
+
+            if (key.isString() && key.toString().isNotEmpty())
+                if (auto* v = s.root->findArrayProperty (arrayVar, key.toString()))
+                    return *v;
+        }
+
+        // Objects take numeric keys too, which makes them usable as sparse tables.
         if (auto* o = arrayVar.getDynamicObject())
-            if (key.isString())
-                if (auto* v = getPropertyPointer (*o, Identifier (key)))
+        {
+            if (key.isString() || isNumericKey (key))
+            {
+                const Identifier name (getPropertyName (key));
+
+                if (auto* v = getPropertyPointer (*o, name))
                     return *v;
 
+                if (auto* bound = dynamic_cast<BoundObject*> (o))
+                    return bound->getBoundProperty (name);
+            }
+        }
+
         return var::undefined();
     }
 
-    void assign (const Scope& s, const var& newValue) const override
+    void assignReferenced (const Scope& s, const var& arrayVar, const var& key, const var& newValue) const override
     {
-        auto arrayVar = object->getResult (s); // must stay alive for the scope of this method
-        auto key = index->getResult (s);
-
         if (auto* array = arrayVar.getArray())
         {
-            if (key.isInt() || key.isInt64() || key.isDouble())
+            if (isNumericKey (key))
             {
-                const auto i = static_cast<int64> (key);
-                while (static_cast<int64> (array->size()) < i)
-                    array->add (var::undefined());
+                int64 i = 0;
+
+                if (! getArrayIndex (key, i) || i >= static_cast<int64> (std::numeric_limits<int>::max()))
+                    location.throwError ("Array index out of range: " + NumberConversion::toScriptString (key));
+
+                const auto size = static_cast<int64> (array->size());
+
+                if (i >= size)
+                {
+                    s.root->heap.allocate ((int64) sizeof (var) * (i + 1 - size));
+
+                    // Fill the gap in one go, rather than reallocating for every element
+                    array->insertMultiple (-1, var::undefined(), static_cast<int> (i - size));
+                    array->add (newValue);
+                    return;
+                }
 
                 array->set (static_cast<int> (i), newValue);
                 return;
@@ -490,9 +1074,20 @@ struct ArraySubscript final : public Expression
 
         if (auto* o = arrayVar.getDynamicObject())
         {
-            if (key.isString())
+            if (key.isString() || isNumericKey (key))
             {
-                o->setProperty (key.toString(), newValue);
+                const Identifier name (getPropertyName (key));
+
+                if (getPropertyPointer (*o, name) == nullptr)
+                {
+                    if (auto* bound = dynamic_cast<BoundObject*> (o))
+                        if (bound->setBoundProperty (name, newValue))
+                            return;
+
+                    s.root->heap.allocate ((int64) sizeof (NamedValueSet::NamedValue));
+                }
+
+                o->setProperty (name, newValue);
                 return;
             }
         }
@@ -500,6 +1095,55 @@ struct ArraySubscript final : public Expression
         Expression::assign (s, newValue);
     }
 
+    var* getReferencedPointer (const Scope&, const var& arrayVar, const var& key) const override
+    {
+        if (auto* array = arrayVar.getArray())
+        {
+            int64 i = 0;
+
+            if (isNumericKey (key) && getArrayIndex (key, i) && i < static_cast<int64> (array->size()))
+                return &array->getReference (static_cast<int> (i));
+
+            return nullptr;
+        }
+
+        if (auto* o = arrayVar.getDynamicObject())
+            if (key.isString() || isNumericKey (key))
+                return getPropertyPointer (*o, getPropertyName (key));
+
+        return nullptr;
+    }
+
+    static bool isNumericKey (const var& key) noexcept { return key.isInt() || key.isInt64() || key.isDouble(); }
+
+    /** Checks that a numeric key is a whole number from zero up, which is all that an array can be indexed with.
+
+        This is checked while the key is still a double, since casting a NaN, an infinity or
+        anything out of range to an integer is undefined.
+    */
+    static bool getArrayIndex (const var& key, int64& index) noexcept
+    {
+        if (key.isDouble())
+        {
+            const auto d = static_cast<double> (key);
+
+            if (! std::isfinite (d) || d < 0.0 || d >= 9007199254740992.0 || d != std::floor (d))
+                return false;
+
+            index = static_cast<int64> (d);
+            return true;
+        }
+
+        index = static_cast<int64> (key);
+        return index >= 0;
+    }
+
+    /** Numeric keys name a property the way that JS would write the number, so that obj[1.5] and obj["1.5"] are the same property. */
+    static String getPropertyName (const var& key)
+    {
+        return isNumericKey (key) ? NumberConversion::toScriptString (key) : key.toString();
+    }
+
     ExpPtr object, index;
 };
 
@@ -526,8 +1170,16 @@ struct BinaryOperator : public BinaryOperatorBase
 
     var getResult (const Scope& s) const override
     {
-        var a (lhs->getResult (s)), b (rhs->getResult (s));
+        SP_JS_COUNT_NODE (BinaryOperator);
+
+        ResumePoint resume (s, *this);
+        var a (resume.evaluate (0, *lhs)), b (resume.evaluate (1, *rhs));
+        return getResultWithValues (a, b);
+    }
 
+    /** Applies the operator to a pair of values that have already been evaluated. */
+    var getResultWithValues (const var& a, const var& b) const
+    {
         if ((a.isUndefined() || a.isVoid()) && (b.isUndefined() || b.isVoid()))
             return getWithUndefinedArg();
 
@@ -537,7 +1189,7 @@ struct BinaryOperator : public BinaryOperatorBase
         if (a.isArray() || a.isObject())
             return getWithArrayOrObject (a, b);
 
-        return getWithStrings (a.toString(), b.toString());
+        return getWithStrings (NumberConversion::toScriptString (a), NumberConversion::toScriptString (b));
     }
 
     var throwError (const char* typeName) const
@@ -582,10 +1234,23 @@ JUCE_JAVASCRIPT_DEFINE_OP (LessThanOp, <, lessThan)
 JUCE_JAVASCRIPT_DEFINE_OP (LessThanOrEqualOp, <=, lessThanOrEqual)
 JUCE_JAVASCRIPT_DEFINE_OP (GreaterThanOp, >, greaterThan)
 JUCE_JAVASCRIPT_DEFINE_OP (GreaterThanOrEqualOp, >=, greaterThanOrEqual)
-JUCE_JAVASCRIPT_DEFINE_OP (AdditionOp, +, plus)
 
 #undef JUCE_JAVASCRIPT_DEFINE_OP
 
+struct AdditionOp final : public BinaryOperator
+{
+    AdditionOp (const CodeLocation& l, ExpPtr& a, ExpPtr& b) noexcept : BinaryOperator (l, a, b, TokenTypes::plus) {}
+    var getWithDoubles (double a, double b) const override { return a + b; }
+    var getWithInts (int64 a, int64 b) const override      { return a + b; }
+
+    var getWithStrings (const String& a, const String& b) const override
+    {
+        auto result = a + b;
+        allocateScriptMemory (result);
+        return result;
+    }
+};
+
 struct SubtractionOp final : public BinaryOperator
 {
     SubtractionOp (const CodeLocation& l, ExpPtr& a, ExpPtr& b) noexcept : BinaryOperator (l, a, b, TokenTypes::minus) {}
@@ -653,26 +1318,62 @@ struct RightShiftUnsignedOp final : public BinaryOperator
 struct LogicalAndOp final : public BinaryOperatorBase
 {
     LogicalAndOp (const CodeLocation& l, ExpPtr& a, ExpPtr& b) noexcept : BinaryOperatorBase (l, a, b, TokenTypes::logicalAnd) {}
-    var getResult (const Scope& s) const override       { return lhs->getResult (s) && rhs->getResult (s); }
+
+    var getResult (const Scope& s) const override
+    {
+        SP_JS_COUNT_NODE (LogicalAndOp);
+
+        ResumePoint resume (s, *this);
+        const bool isLeftTrue = resume.evaluate (0, *lhs);
+
+        if (resume.getResumedStep() == 0)
+            ScriptCoverage::hit (branchSlot, isLeftTrue ? 0 : 1);
+
+        return isLeftTrue && resume.evaluate (1, *rhs);
+    }
+
+    ScriptCoverage::Slot* branchSlot = nullptr;
 };
 
 struct LogicalOrOp final : public BinaryOperatorBase
 {
     LogicalOrOp (const CodeLocation& l, ExpPtr& a, ExpPtr& b) noexcept : BinaryOperatorBase (l, a, b, TokenTypes::logicalOr) {}
-    var getResult (const Scope& s) const override       { return lhs->getResult (s) || rhs->getResult (s); }
+
+    var getResult (const Scope& s) const override
+    {
+        SP_JS_COUNT_NODE (LogicalOrOp);
+
+        ResumePoint resume (s, *this);
+        const bool isLeftTrue = resume.evaluate (0, *lhs);
+
+        if (resume.getResumedStep() == 0)
+            ScriptCoverage::hit (branchSlot, isLeftTrue ? 0 : 1);
+
+        return isLeftTrue || resume.evaluate (1, *rhs);
+    }
+
+    ScriptCoverage::Slot* branchSlot = nullptr;
 };
 
 //==============================================================================
+static bool areOperandsTypeEqual (const BinaryOperatorBase& op, const Scope& s)
+{
+    ResumePoint resume (s, op);
+    const auto a = resume.evaluate (0, *op.lhs); // The operands have to be evaluated in order, for the sake of resuming
+    const auto b = resume.evaluate (1, *op.rhs);
+    return areTypeEqual (a, b);
+}
+
 struct TypeEqualsOp final : public BinaryOperatorBase
 {
     TypeEqualsOp (const CodeLocation& l, ExpPtr& a, ExpPtr& b) noexcept : BinaryOperatorBase (l, a, b, TokenTypes::typeEquals) {}
-    var getResult (const Scope& s) const override       { return areTypeEqual (lhs->getResult (s), rhs->getResult (s)); }
+    var getResult (const Scope& s) const override       { SP_JS_COUNT_NODE (TypeEqualsOp); return areOperandsTypeEqual (*this, s); }
 };
 
 struct TypeNotEqualsOp final : public BinaryOperatorBase
 {
     TypeNotEqualsOp (const CodeLocation& l, ExpPtr& a, ExpPtr& b) noexcept : BinaryOperatorBase (l, a, b, TokenTypes::typeNotEquals) {}
-    var getResult (const Scope& s) const override       { return ! areTypeEqual (lhs->getResult (s), rhs->getResult (s)); }
+    var getResult (const Scope& s) const override       { SP_JS_COUNT_NODE (TypeNotEqualsOp); return ! areOperandsTypeEqual (*this, s); }
 };
 
 //==============================================================================
@@ -680,10 +1381,34 @@ struct ConditionalOp final : public Expression
 {
     ConditionalOp (const CodeLocation& l) noexcept : Expression (l) {}
 
-    var getResult (const Scope& s) const override              { return (condition->getResult (s) ? trueBranch : falseBranch)->getResult (s); }
-    void assign (const Scope& s, const var& v) const override  { (condition->getResult (s) ? trueBranch : falseBranch)->assign (s, v); }
+    var getResult (const Scope& s) const override
+    {
+        SP_JS_COUNT_NODE (ConditionalOp);
+
+        ResumePoint resume (s, *this);
+        const auto branch = chooseBranch (s, resume);
+        return resume.run (branch, [&] { return (branch == 1 ? trueBranch : falseBranch)->getResult (s); });
+    }
+
+    void assign (const Scope& s, const var& v) const override
+    {
+        ResumePoint resume (s, *this);
+        const auto branch = chooseBranch (s, resume);
+        resume.run (branch, [&] { (branch == 1 ? trueBranch : falseBranch)->assign (s, v); });
+    }
+
+    int chooseBranch (const Scope& s, ResumePoint& resume) const
+    {
+        if (resume.getResumedStep() > 0)
+            return resume.getResumedStep();
+
+        const auto branch = resume.run (0, [&] { return condition->getResult (s) ? 1 : 2; });
+        ScriptCoverage::hit (branchSlot, branch - 1);
+        return branch;
+    }
 
     ExpPtr condition, trueBranch, falseBranch;
+    ScriptCoverage::Slot* branchSlot = nullptr;
 };
 
 //==============================================================================
@@ -693,8 +1418,11 @@ struct Assignment final : public Expression
 
     var getResult (const Scope& s) const override
     {
-        const auto value = newValue->getResult (s);
-        target->assign (s, value);
+        SP_JS_COUNT_NODE (Assignment);
+
+        ResumePoint resume (s, *this);
+        const auto value = resume.evaluate (0, *newValue);
+        resume.run (1, [&] { target->assign (s, value); });
         return value;
     }
 
@@ -709,8 +1437,11 @@ struct SelfAssignment : public Expression
 
     var getResult (const Scope& s) const override
     {
-        auto value = newValue->getResult (s);
-        target->assign (s, value);
+        SP_JS_COUNT_NODE (SelfAssignment);
+
+        ResumePoint resume (s, *this);
+        const auto value = resume.evaluate (0, *newValue);
+        resume.run (1, [&] { target->assign (s, value); });
         return value;
     }
 
@@ -719,40 +1450,269 @@ struct SelfAssignment : public Expression
     TokenType op;
 };
 
+//==============================================================================
+/** Handles `+=`, which scripts tend to use to build up long strings in loops.
+
+    Rather than creating a new string for every step, the text gets appended to the
+    end of the existing string's buffer whenever nothing else is sharing it. The buffer
+    grows in powers of two and the root remembers the length of the string it last
+    appended to, so a loop of appends costs time proportional to the number of bytes
+    being appended.
+
+    The target's object and key are evaluated once, and used both to read it and to
+    write the result back, so something like a[i++] += x only moves i along once.
+*/
+struct AppendAssignment final : public SelfAssignment
+{
+    AppendAssignment (const CodeLocation& l, Expression* dest, AdditionOp* source) noexcept
+        : SelfAssignment (l, dest, source), addition (*source) {}
+
+    var getResult (const Scope& s) const override
+    {
+        SP_JS_COUNT_NODE (AppendAssignment);
+
+        ResumePoint resume (s, *this);
+        var object, key, current;
+
+        if (resume.getResumedStep() == 0)
+        {
+            resume.run (0, [&] { target->evaluateReference (s, object, key); });
+            current = target->getReferencedValue (s, object, key);
+
+            if (s.frame != nullptr)
+                resume.values = Array<var> (object, key, current);
+        }
+        else
+        {
+            object = resume.values[0];
+            key = resume.values[1];
+            current = resume.values[2];
+        }
+
+        const auto extra = resume.run (1, [&] { return addition.rhs->getResult (s); });
+        resume.values.clear(); // Nothing after this can be suspended, and the saved copy would stop the text being appended to in place
+
+        if (! current.isString())
+        {
+            const auto value = addition.getResultWithValues (current, extra);
+            target->assignReferenced (s, object, key, value);
+            return value;
+        }
+
+        auto text = current.toString();
+        current = var();
+
+        // Only written to directly if it still holds the text, rather than something the right-hand side put there.
+        auto* slot = target->getReferencedPointer (s, object, key);
+
+        if (slot != nullptr && ! (slot->isString() && slot->toString().getCharPointer() == text.getCharPointer()))
+            slot = nullptr;
+
+        append (text, NumberConversion::toScriptString (extra), slot);
+
+        var value (text);
+
+        if (slot != nullptr)
+            *slot = value;
+        else
+            target->assignReferenced (s, object, key, value);
+
+        return value;
+    }
+
+    /** Appends to the text, in place if nothing else is sharing it.
+
+        The slot's reference to the text is let go of while this happens, which nothing
+        can see, since the only thing that can throw is done before it.
+    */
+    static void append (String& text, const String& extra, var* slot)
+    {
+        // toRawUTF8() only points into the string's own buffer when strings are stored as UTF-8.
+        // With any other encoding it gives back a converted copy, so the text is just concatenated.
+       #if JUCE_STRING_UTF_TYPE == 8
+        static_assert (sizeof (*text.getCharPointer().getAddress()) == 1, "The in-place append needs strings to be stored as UTF-8");
+
+        const auto numExtraBytes = extra.getNumBytesAsUTF8();
+
+        SP_JS_COUNT (stringAllocations);
+        allocateScriptMemory ((int64) numExtraBytes);
+
+        auto* root = RootObject::getCurrent();
+        size_t numBytes = 0;
+
+        if (root != nullptr && text.getCharPointer() == root->lastAppend.text.getCharPointer())
+        {
+            numBytes = root->lastAppend.numBytes;
+            root->lastAppend = {};
+        }
+        else
+        {
+            numBytes = text.getNumBytesAsUTF8();
+        }
+
+        if (slot != nullptr)
+            *slot = var();
+
+        const auto numBytesNeeded = numBytes + numExtraBytes + 1;
+
+        text.preallocateBytes (numBytesNeeded < (size_t) (1 << 30) ? (size_t) nextPowerOfTwo ((int) numBytesNeeded)
+                                                                    : numBytesNeeded);
+
+        auto* dest = const_cast<char*> (text.toRawUTF8()) + numBytes;
+        memcpy (dest, extra.toRawUTF8(), numExtraBytes);
+        dest[numExtraBytes] = 0;
+
+        if (root != nullptr)
+            root->lastAppend = { text, numBytes + numExtraBytes };
+       #else
+        SP_JS_COUNT (stringAllocations);
+        allocateScriptMemory (getAllocationSize (extra));
+
+        if (slot != nullptr)
+            *slot = var();
+
+        text += extra;
+       #endif
+    }
+
+    const AdditionOp& addition;
+};
+
 //==============================================================================
 struct PostAssignment final : public SelfAssignment
 {
     PostAssignment (const CodeLocation& l, Expression* dest, Expression* source) noexcept : SelfAssignment (l, dest, source) {}
 
-    var getResult (const Scope& s) const override
+    var getResult (const Scope& s) const override
+    {
+        SP_JS_COUNT_NODE (PostAssignment);
+
+        ResumePoint resume (s, *this);
+        auto oldValue = resume.evaluate (0, *target);
+        const auto value = resume.evaluate (1, *newValue);
+        resume.run (2, [&] { target->assign (s, value); });
+        return oldValue;
+    }
+};
+
+//==============================================================================
+struct FunctionCall : public Expression
+{
+    FunctionCall (const CodeLocation& l) noexcept : Expression (l) {}
+
+    var getResult (const Scope& s) const override
+    {
+        SP_JS_COUNT_NODE (FunctionCall);
+
+        ResumePoint resume (s, *this);
+
+        if (auto* dot = dynamic_cast<DotOperator*> (object.get()))
+        {
+            const auto thisObject = resume.evaluate (0, *dot->parent);
+            return invokeFunction (s, resume, s.findFunctionCall (location, thisObject, dot->child), thisObject);
+        }
+
+        const auto function = resume.evaluate (0, *object);
+        return invokeFunction (s, resume, function, var (s.scope.get()));
+    }
+
+    /** Evaluates the arguments, as steps 1 onwards of the call, and then calls the function with them. */
+    var invokeFunction (const Scope& s, ResumePoint& resume, const var& function, const var& thisObject) const;
+
+    /** @returns the name the function is being called by, for the profiler. */
+    Identifier getCalleeName() const
+    {
+        if (auto* dot = dynamic_cast<DotOperator*> (object.get()))
+            return dot->child;
+
+        if (auto* name = dynamic_cast<UnqualifiedName*> (object.get()))
+            return name->name;
+
+        return getAnonymousName();
+    }
+
+    /** The name that a function gets in the profiler and the tracer when nothing gives it one. */
+    static const Identifier& getAnonymousName()
+    {
+        static const Identifier anonymous ("(anonymous)");
+        return anonymous;
+    }
+
+    ExpPtr object;
+    OwnedArray<Expression> arguments;
+
+private:
+    /** The last bound native function that this call was found to pass enough arguments to. */
+    mutable NativeBinding::Function::Ptr checkedBoundFunction;
+};
+
+/** Lets the profiler and the tracer see the calls being made, while either of them is switched on.
+
+    The profiler's shadow call stack is kept in step, and the tracer gets
+    a begin and an end event for each call.
+*/
+struct CallHooks final
+{
+    /** For a call made by a script, which only works out the name of the function if something's going to use it. */
+    CallHooks (const Scope& s, const FunctionCall& call, const CodeLocation& functionLocation, bool isNative) :
+        CallHooks (s, isNative)
+    {
+        if (profiler != nullptr || tracer != nullptr)
+            begin (call.getCalleeName(), functionLocation, isNative);
+    }
+
+    /** For a call made by the host, or by a native function calling back into a script. */
+    CallHooks (const Scope& s, const Identifier& calleeName, const CodeLocation& functionLocation, bool isNative) :
+        CallHooks (s, isNative)
+    {
+        if (profiler != nullptr || tracer != nullptr)
+            begin (calleeName, functionLocation, isNative);
+    }
+
+    ~CallHooks()
     {
-        auto oldValue = target->getResult (s);
-        target->assign (s, newValue->getResult (s));
-        return oldValue;
+        if (tracer != nullptr)
+            tracer->end (category, name);
+
+        if (profiler != nullptr)
+        {
+            // A sample that fell due during the call belongs to this function, not to whatever its caller does next.
+            if (profiler->isSampleDue())
+                profiler->takeSample (functionLocation.program, functionLocation.location);
+
+            profiler->exitFunction();
+        }
     }
-};
 
-//==============================================================================
-struct FunctionCall : public Expression
-{
-    FunctionCall (const CodeLocation& l) noexcept : Expression (l) {}
+private:
+    CallHooks (const Scope& s, bool isNative) :
+        profiler (s.root->profiler.get()),
+        tracer (s.root->tracer.get()),
+        category (isNative ? ScriptTracer::Category::native : ScriptTracer::Category::script)
+    {
+    }
 
-    var getResult (const Scope& s) const override
+    void begin (const Identifier& calleeName, const CodeLocation& location, bool isNative)
     {
-        if (auto* dot = dynamic_cast<DotOperator*> (object.get()))
+        name = calleeName;
+
+        if (profiler != nullptr)
         {
-            const auto thisObject = dot->parent->getResult (s);
-            return invokeFunction (s, s.findFunctionCall (location, thisObject, dot->child), thisObject);
+            functionLocation = location;
+            profiler->enterFunction (location.program, location.location, name, isNative);
         }
 
-        const auto function = object->getResult (s);
-        return invokeFunction (s, function, var (s.scope.get()));
+        if (tracer != nullptr)
+            tracer->begin (category, name);
     }
 
-    var invokeFunction (const Scope& s, const var& function, const var& thisObject) const;
+    ScriptProfiler* const profiler;
+    ScriptTracer* const tracer;
+    const ScriptTracer::Category category;
+    Identifier name;
+    CodeLocation functionLocation;
 
-    ExpPtr object;
-    OwnedArray<Expression> arguments;
+    JUCE_DECLARE_NON_COPYABLE (CallHooks)
 };
 
 //==============================================================================
@@ -772,10 +1732,17 @@ struct ObjectDeclaration final : public Expression
 
     var getResult (const Scope& s) const override
     {
-        DynamicObject::Ptr newObject (new DynamicObject());
+        SP_JS_COUNT_NODE (ObjectDeclaration);
+
+        ResumePoint resume (s, *this);
+
+        if (! resume.isResuming())
+            s.root->heap.allocate ((int64) sizeof (NamedValueSet::NamedValue) * names.size());
+
+        DynamicObject::Ptr newObject (new ScriptObject());
 
         for (int i = 0; i < names.size(); ++i)
-            newObject->setProperty (names.getUnchecked (i), initialisers.getUnchecked (i)->getResult (s));
+            newObject->setProperty (names.getUnchecked (i), resume.evaluate (i, *initialisers.getUnchecked (i)));
 
         return newObject.get();
     }
@@ -791,10 +1758,20 @@ struct ArrayDeclaration final : public Expression
 
     var getResult (const Scope& s) const override
     {
+        SP_JS_COUNT_NODE (ArrayDeclaration);
+
+        ResumePoint resume (s, *this);
+
+        if (! resume.isResuming())
+        {
+            SP_JS_COUNT (arrayAllocations);
+            s.root->heap.allocate ((int64) (sizeof (Array<var>) + sizeof (var) * (size_t) values.size()));
+        }
+
         Array<var> a;
 
         for (int i = 0; i < values.size(); ++i)
-            a.add (values.getUnchecked(i)->getResult (s));
+            a.add (resume.evaluate (i, *values.getUnchecked (i)));
 
         // std::move() needed here for older compilers
         JUCE_BEGIN_IGNORE_WARNINGS_GCC_LIKE ("-Wredundant-move")
@@ -806,7 +1783,44 @@ struct ArrayDeclaration final : public Expression
 };
 
 //==============================================================================
-struct FunctionObject final : public DynamicObject
+/** Suspends the async function it's in until a promise is settled, and then gives back its result. */
+struct AwaitExpression final : public Expression
+{
+    AwaitExpression (const CodeLocation& l, Expression* v) noexcept : Expression (l), operand (v) {}
+
+    var getResult (const Scope& s) const override;
+
+    ExpPtr operand;
+};
+
+/** Suspends the generator it's in, handing a value back to whatever resumed it,
+    and then gives back the value the generator gets resumed with next.
+
+    A yield* hands back each of the items of what it's given in turn. Whatever the
+    generator gets resumed with, including a throw() or a return(), is passed on to
+    the generator or iterator being delegated to, and the value that finishes it is
+    the value of the yield*.
+*/
+struct YieldExpression final : public Expression
+{
+    YieldExpression (const CodeLocation& l, Expression* v, bool delegates) noexcept : Expression (l), operand (v), isDelegating (delegates) {}
+
+    var getResult (const Scope& s) const override;
+
+    /** Passes what the generator was resumed with on to what a yield* is delegating to.
+
+        @returns true if that gave back another item, or false if it finished,
+                 in which case the item is set to the value it finished with.
+    */
+    static bool resumeDelegate (const var& source, ForEachLoop::Position& position,
+                                const var& value, bool isThrow, var& item);
+
+    ExpPtr operand;
+    const bool isDelegating;
+};
+
+//==============================================================================
+struct FunctionObject final : public ScriptObject
 {
     FunctionObject() noexcept {}
     FunctionObject (const FunctionObject& other);
@@ -815,28 +1829,82 @@ struct FunctionObject final : public DynamicObject
 
     void writeAsJSON (OutputStream& out, int /*indentLevel*/, bool /*allOnOneLine*/, int /*maximumDecimalPlaces*/) override
     {
-        out << "function " << functionCode;
+        out << (isAsync ? "async function " : (isGenerator ? "function* " : "function ")) << functionCode;
     }
 
     var invoke (const Scope& s, const var::NativeFunctionArgs& args) const
     {
-        DynamicObject::Ptr functionRoot (new DynamicObject());
+        if (isAsync)
+            return invokeAsync (s, args);
 
-        static const Identifier thisIdent ("this");
-        functionRoot->setProperty (thisIdent, args.thisObject);
+        if (isGenerator)
+            return invokeGenerator (s, args);
 
-        for (int i = 0; i < parameters.size(); ++i)
-            functionRoot->setProperty (parameters.getReference(i),
-                                        i < args.numArguments ? args.arguments[i] : var::undefined());
+        return invokeWithRoot (s, createFunctionRoot (args));
+    }
 
+    /** Runs the body of an ordinary function in a function root that's already been set up for the call. */
+    var invokeWithRoot (const Scope& s, DynamicObject::Ptr functionRoot) const
+    {
         var result;
-        body->perform (Scope (&s, s.root, functionRoot), &result);
+        body->perform (Scope (&s, s.root, std::move (functionRoot)), &result);
         return result;
     }
 
+    /** Starts running an async function, returning the promise of its result.
+        The function runs until its first await, and carries on from there in a microtask once the awaited promise is settled.
+    */
+    var invokeAsync (const Scope& s, const var::NativeFunctionArgs& args) const;
+
+    /** Creates the generator object for a call to a generator function, without running any of the function yet. */
+    var invokeGenerator (const Scope& s, const var::NativeFunctionArgs& args) const;
+
+    DynamicObject::Ptr createFunctionRoot (const var::NativeFunctionArgs& args) const
+    {
+        DynamicObject::Ptr functionRoot (new ScriptObject());
+        bindArguments (*functionRoot, args);
+        return functionRoot;
+    }
+
+    /** Sets up a function root for another call, reusing the one that the previous call ran in if nothing kept hold of it.
+
+        Anything that the previous call declared is removed first, so the new call starts from
+        the same scope it would get in a new function root. A root that a closure or anything
+        else still refers to is left alone, and the call gets a new one.
+    */
+    void rebindFunctionRoot (DynamicObject::Ptr& functionRoot, const var::NativeFunctionArgs& args) const
+    {
+        if (functionRoot == nullptr || functionRoot->getReferenceCount() > 1)
+        {
+            functionRoot = createFunctionRoot (args);
+            return;
+        }
+
+        auto& properties = functionRoot->getProperties();
+
+        while (properties.size() > parameters.size() + 1)
+            properties.remove (properties.getName (properties.size() - 1));
+
+        bindArguments (*functionRoot, args);
+    }
+
+    void bindArguments (DynamicObject& functionRoot, const var::NativeFunctionArgs& args) const
+    {
+        static const Identifier thisIdent ("this");
+        functionRoot.setProperty (thisIdent, args.thisObject);
+
+        for (int i = 0; i < parameters.size(); ++i)
+            functionRoot.setProperty (parameters.getReference(i),
+                                      i < args.numArguments ? args.arguments[i] : var::undefined());
+    }
+
     String functionCode;
     Array<Identifier> parameters;
     std::unique_ptr<Statement> body;
+    bool isAsync = false, isGenerator = false;
+
+    /** Keeps the coverage counters that the body points to around for as long as it is. */
+    ScriptCoverage::Source::Ptr coverageSource;
 };
 
 bool isFunction (const var& v) noexcept
@@ -844,6 +1912,45 @@ bool isFunction (const var& v) noexcept
     return dynamic_cast<FunctionObject*> (v.getObject()) != nullptr;
 }
 
+//==============================================================================
+/** Calls a native or script function from somewhere other than a call in a script,
+    ie: for the host, or for a native method that takes a callback, so that the
+    profiler and the tracer see these calls just as they see the script's own.
+
+    A native function has no code of its own to be told apart by, so the
+    profiler keys it on its name instead.
+*/
+static var invokeWithHooks (const Scope& s, const var& function, const var::NativeFunctionArgs& args, const Identifier& name)
+{
+    if (auto nativeFunction = function.getNativeFunction())
+    {
+        SP_JS_COUNT (nativeCalls);
+        const CallHooks hooks (s, name, CodeLocation (name.toString()), true);
+        return nativeFunction (args);
+    }
+
+    if (auto* fo = dynamic_cast<FunctionObject*> (function.getObject()))
+    {
+        SP_JS_COUNT (scriptCalls);
+        const CallHooks hooks (s, name, fo->body->location, false);
+        return fo->invoke (s, args);
+    }
+
+    return var::undefined();
+}
+
+/** Calls a native or script function from inside a native method, using the running engine's root namespace. */
+static var callScriptFunction (const var& function, const var::NativeFunctionArgs& args)
+{
+    if (auto* root = RootObject::getCurrent())
+        return invokeWithHooks (Scope ({}, *root, *root), function, args, FunctionCall::getAnonymousName());
+
+    if (auto nativeFunction = function.getNativeFunction())
+        return nativeFunction (args);
+
+    return var::undefined();
+}
+
 //==============================================================================
 struct TokenIterator
 {
@@ -866,6 +1973,113 @@ struct TokenIterator
     }
 
     bool matchIf (TokenType expected)                                 { if (currentType == expected) { skip(); return true; } return false; }
+
+    /** Matches the "async function" that an async function's definition starts with.
+
+        Since "async" isn't a reserved word, it's only taken to mean this when it's
+        followed by "function" on the same line, and is an identifier anywhere else.
+    */
+    bool matchIfAsyncFunction()
+    {
+        if (currentType != TokenTypes::identifier || currentValue.toString() != "async")
+            return false;
+
+        auto t = p;
+
+        while (t.isWhitespace() && *t != '\n')
+            ++t;
+
+        const auto length = (int) strlen (TokenTypes::function);
+
+        if (t.compareUpTo (CharPointer_ASCII (TokenTypes::function), length) != 0 || isIdentifierBody (t[length]))
+            return false;
+
+        skip();
+        match (TokenTypes::function);
+        return true;
+    }
+
+    /** Looks ahead from the start of a for loop's header to see if it's a for...in or for...of loop,
+        which is when the variable (along with any var, let or const) is followed by "in" or "of".
+    */
+    bool isForEachLoop() const
+    {
+        const auto declaresVariable = matchesAny (TokenTypes::var, TokenTypes::let_, TokenTypes::const_);
+
+        if (! declaresVariable && currentType != TokenTypes::identifier)
+            return false;
+
+        auto t = p;
+        t.incrementToEndOfWhitespace();
+
+        if (declaresVariable)
+        {
+            if (! isIdentifierStart (*t))
+                return false;
+
+            while (isIdentifierBody (*t))
+                ++t;
+
+            t.incrementToEndOfWhitespace();
+        }
+
+        return (t.compareUpTo (CharPointer_ASCII ("in"), 2) == 0 || t.compareUpTo (CharPointer_ASCII ("of"), 2) == 0)
+                 && ! isIdentifierBody (t[2]);
+    }
+
+    /** Re-reads the current '/' or '/=' token as the start of a regular expression literal,
+        which can only be told apart from a division by where it appears.
+    */
+    void readRegexLiteral (String& pattern, String& flags)
+    {
+        auto t = location.location;
+        jassert (*t == '/');
+        ++t;
+
+        const auto start = t;
+        bool isInClass = false;
+
+        for (;;)
+        {
+            const auto c = *t;
+
+            if (c == 0 || c == '\n' || c == '\r')
+                location.throwError ("Unterminated regular expression literal");
+
+            if (c == '\\')
+            {
+                ++t;
+
+                if (*t == 0 || *t == '\n')
+                    location.throwError ("Unterminated regular expression literal");
+            }
+            else if (c == '[')
+            {
+                isInClass = true;
+            }
+            else if (c == ']')
+            {
+                isInClass = false;
+            }
+            else if (c == '/' && ! isInClass)
+            {
+                break;
+            }
+
+            ++t;
+        }
+
+        pattern = String (start, t);
+
+        const auto flagsStart = ++t;
+
+        while (isIdentifierBody (*t))
+            ++t;
+
+        flags = String (flagsStart, t);
+        p = t;
+        skip();
+    }
     bool matchesAny (TokenType t1, TokenType t2) const                { return currentType == t1 || currentType == t2; }
     bool matchesAny (TokenType t1, TokenType t2, TokenType t3) const  { return matchesAny (t1, t2) || currentType == t3; }
 
@@ -1088,7 +2302,11 @@ private:
 //==============================================================================
 struct ExpressionTreeBuilder final : private TokenIterator
 {
-    ExpressionTreeBuilder (const String code) : TokenIterator (code) {}
+    ExpressionTreeBuilder (const String code) :
+        TokenIterator (code),
+        coverage (getCoverageSource (code))
+    {
+    }
 
     BlockStatement* parseStatementList()
     {
@@ -1102,6 +2320,8 @@ struct ExpressionTreeBuilder final : private TokenIterator
 
     void parseFunctionParamsAndBody (FunctionObject& fo)
     {
+        const ScopedValueSetter<bool> asyncSetter (isInsideAsyncFunction, fo.isAsync);
+        const ScopedValueSetter<bool> generatorSetter (isInsideGenerator, fo.isGenerator);
         match (TokenTypes::openParen);
 
         while (currentType != TokenTypes::closeParen)
@@ -1116,15 +2336,19 @@ struct ExpressionTreeBuilder final : private TokenIterator
 
         match (TokenTypes::closeParen);
         fo.body.reset (parseBlock());
+        fo.coverageSource = coverage;
     }
 
     Expression* parseExpression()
     {
+        if (matchIf (TokenTypes::yield_))
+            return parseYield();
+
         ExpPtr lhs (parseLogicOperator());
 
         if (matchIf (TokenTypes::question))          return parseTernaryOperator (lhs);
         if (matchIf (TokenTypes::assign))            { ExpPtr rhs (parseExpression()); return new Assignment (location, lhs, rhs); }
-        if (matchIf (TokenTypes::plusEquals))        return parseInPlaceOpExpression<AdditionOp> (lhs);
+        if (matchIf (TokenTypes::plusEquals))        return parseAppendExpression (lhs);
         if (matchIf (TokenTypes::minusEquals))       return parseInPlaceOpExpression<SubtractionOp> (lhs);
         if (matchIf (TokenTypes::timesEquals))       return parseInPlaceOpExpression<MultiplyOp> (lhs);
         if (matchIf (TokenTypes::divideEquals))      return parseInPlaceOpExpression<DivideOp> (lhs);
@@ -1136,8 +2360,37 @@ struct ExpressionTreeBuilder final : private TokenIterator
     }
 
 private:
+    bool isInsideAsyncFunction = false, isInsideGenerator = false;
+
+    /** The counters to give the statements and branches, if the engine is collecting coverage. */
+    ScriptCoverage::Source::Ptr coverage;
+
     void throwError (const String& err) const { location.throwError (err); }
 
+    static ScriptCoverage::Source::Ptr getCoverageSource (const String& code)
+    {
+        if (auto* root = RootObject::getCurrent())
+            if (root->coverage != nullptr)
+                return root->coverage->getSource (code);
+
+        return {};
+    }
+
+    static int getOffsetInCode (const CodeLocation& l) noexcept
+    {
+        return (int) (l.location.getAddress() - l.program.getCharPointer().getAddress());
+    }
+
+    /** Gives a branch node the counters for the ways it can go, if coverage is being collected. */
+    template<typename NodeType>
+    NodeType* withBranchCoverage (NodeType* node, const CodeLocation& branchLocation)
+    {
+        if (coverage != nullptr)
+            node->branchSlot = &coverage->getBranchSlot (getOffsetInCode (branchLocation));
+
+        return node;
+    }
+
     template<typename OpType>
     Expression* parseInPlaceOpExpression (ExpPtr& lhs)
     {
@@ -1146,6 +2399,31 @@ private:
         return new SelfAssignment (location, bareLHS, new OpType (location, lhs, rhs));
     }
 
+    Expression* parseAppendExpression (ExpPtr& lhs)
+    {
+        ExpPtr rhs (parseExpression());
+        auto* bareLHS = lhs.get(); // careful - bare pointer is deliberately aliased
+        return new AppendAssignment (location, bareLHS, new AdditionOp (location, lhs, rhs));
+    }
+
+    Expression* parseRegexLiteral()
+    {
+        const auto literalLocation = location;
+        String pattern, flags;
+        readRegexLiteral (pattern, flags);
+
+        try
+        {
+            return new RegexLiteral (literalLocation, getCachedRegex (pattern, flags));
+        }
+        catch (String& error)
+        {
+            literalLocation.throwError (error);
+        }
+
+        return nullptr;
+    }
+
     BlockStatement* parseBlock()
     {
         match (TokenTypes::openBrace);
@@ -1155,6 +2433,17 @@ private:
     }
 
     Statement* parseStatement()
+    {
+        const auto offset = coverage != nullptr ? getOffsetInCode (location) : 0;
+        auto* s = parseUncountedStatement();
+
+        if (coverage != nullptr)
+            s->coverageSlot = &coverage->getStatementSlot (offset);
+
+        return s;
+    }
+
+    Statement* parseUncountedStatement()
     {
         if (currentType == TokenTypes::openBrace)                       return parseBlock();
         if (matchIf (TokenTypes::var) || matchIf (TokenTypes::let_))    return parseVar();
@@ -1165,7 +2454,8 @@ private:
         if (matchIf (TokenTypes::return_))                              return parseReturn();
         if (matchIf (TokenTypes::break_))                               return new BreakStatement (location);
         if (matchIf (TokenTypes::continue_))                            return new ContinueStatement (location);
-        if (matchIf (TokenTypes::function))                             return parseFunction();
+        if (matchIf (TokenTypes::function))                             return parseFunction (false);
+        if (matchIfAsyncFunction())                                     return parseFunction (true);
         if (matchIf (TokenTypes::semicolon))                            return new Statement (location);
         if (matchIf (TokenTypes::plusplus))                             return parsePreIncDec<AdditionOp>();
         if (matchIf (TokenTypes::minusminus))                           return parsePreIncDec<SubtractionOp>();
@@ -1173,7 +2463,8 @@ private:
         if (matchesAny (TokenTypes::openParen, TokenTypes::openBracket))
             return matchEndOfStatement (parseFactor());
 
-        if (matchesAny (TokenTypes::identifier, TokenTypes::literal, TokenTypes::minus))
+        if (matchesAny (TokenTypes::identifier, TokenTypes::literal, TokenTypes::minus)
+            || matchesAny (TokenTypes::await_, TokenTypes::yield_))
             return matchEndOfStatement (parseExpression());
 
         throwError ("Found " + getTokenName (currentType) + " when expecting a statement");
@@ -1201,7 +2492,7 @@ private:
 
     Statement* parseIf()
     {
-        auto* s = new IfStatement (location);
+        auto* s = withBranchCoverage (new IfStatement (location), location);
         match (TokenTypes::openParen);
         s->condition.reset (parseExpression());
         match (TokenTypes::closeParen);
@@ -1238,10 +2529,10 @@ private:
         return s;
     }
 
-    Statement* parseFunction()
+    Statement* parseFunction (bool isAsync)
     {
         Identifier name;
-        auto fn = parseFunctionDefinition (name);
+        auto fn = parseFunctionDefinition (name, isAsync);
 
         if (name.isNull())
             throwError ("Functions defined at statement-level must have a name");
@@ -1252,8 +2543,12 @@ private:
 
     Statement* parseForLoop()
     {
-        auto* s = new LoopStatement (location, false);
         match (TokenTypes::openParen);
+
+        if (isForEachLoop())
+            return parseForEachLoop();
+
+        auto* s = new LoopStatement (location, false);
         s->initialiser.reset (parseStatement());
 
         if (matchIf (TokenTypes::semicolon))
@@ -1280,6 +2575,30 @@ private:
         return s;
     }
 
+    Statement* parseForEachLoop()
+    {
+        const auto declaresVariable = matchIf (TokenTypes::var) || matchIf (TokenTypes::let_) || matchIf (TokenTypes::const_);
+        const auto variableLocation = location;
+        const auto name = parseIdentifier();
+        const auto iteratesKeys = matchIf (TokenTypes::in_);
+
+        if (! iteratesKeys)
+        {
+            if (currentType != TokenTypes::identifier || currentValue.toString() != "of")
+                throwError ("Found " + getTokenName (currentType) + " when expecting in or of");
+
+            skip();
+        }
+
+        auto* s = new ForEachLoop (location, iteratesKeys);
+        s->declaresVariable = declaresVariable;
+        s->variable.reset (new UnqualifiedName (variableLocation, name));
+        s->source.reset (parseExpression());
+        match (TokenTypes::closeParen);
+        s->body.reset (parseStatement());
+        return s;
+    }
+
     Statement* parseDoOrWhileLoop (bool isDoLoop)
     {
         auto* s = new LoopStatement (location, isDoLoop);
@@ -1312,14 +2631,19 @@ private:
         return i;
     }
 
-    var parseFunctionDefinition (Identifier& functionName)
+    var parseFunctionDefinition (Identifier& functionName, bool isAsync)
     {
+        auto fo = std::make_unique<FunctionObject>();
+        fo->isAsync = isAsync;
+        fo->isGenerator = matchIf (TokenTypes::times);
+
+        if (fo->isAsync && fo->isGenerator)
+            throwError ("Async generators aren't supported");
+
         auto functionStart = location.location;
 
         if (currentType == TokenTypes::identifier)
             functionName = parseIdentifier();
-
-        auto fo = std::make_unique<FunctionObject>();
         parseFunctionParamsAndBody (*fo);
         fo->functionCode = String (functionStart, location.location);
         return var (fo.release());
@@ -1382,6 +2706,9 @@ private:
             return parseSuffixes (new LiteralValue (location, v));
         }
 
+        if (matchesAny (TokenTypes::divide, TokenTypes::divideEquals))
+            return parseSuffixes (parseRegexLiteral());
+
         if (matchIf (TokenTypes::openBrace))
         {
             auto e = std::make_unique<ObjectDeclaration> (location);
@@ -1420,10 +2747,12 @@ private:
             return parseSuffixes (e.release());
         }
 
-        if (matchIf (TokenTypes::function))
+        const auto isAsyncFunction = matchIfAsyncFunction();
+
+        if (isAsyncFunction || matchIf (TokenTypes::function))
         {
             Identifier name;
-            auto fn = parseFunctionDefinition (name);
+            auto fn = parseFunctionDefinition (name, isAsyncFunction);
 
             if (name.isValid())
                 throwError ("Inline functions definitions cannot have a name");
@@ -1477,10 +2806,34 @@ private:
         if (matchIf (TokenTypes::plusplus))    return parsePreIncDec<AdditionOp>();
         if (matchIf (TokenTypes::minusminus))  return parsePreIncDec<SubtractionOp>();
         if (matchIf (TokenTypes::typeof_))     return parseTypeof();
+        if (matchIf (TokenTypes::await_))      return parseAwait();
 
         return parseFactor();
     }
 
+    Expression* parseAwait()
+    {
+        if (! isInsideAsyncFunction)
+            throwError ("await is only valid inside async functions");
+
+        return new AwaitExpression (location, parseUnary());
+    }
+
+    Expression* parseYield()
+    {
+        if (! isInsideGenerator)
+            throwError ("yield is only valid inside generator functions");
+
+        const auto isDelegating = matchIf (TokenTypes::times);
+
+        // A bare yield hands back undefined.
+        if (! isDelegating && (matchesAny (TokenTypes::semicolon, TokenTypes::closeParen, TokenTypes::closeBracket)
+                                || matchesAny (TokenTypes::closeBrace, TokenTypes::comma, TokenTypes::eof)))
+            return new YieldExpression (location, new Expression (location), false);
+
+        return new YieldExpression (location, parseExpression(), isDelegating);
+    }
+
     Expression* parseMultiplyDivide()
     {
         ExpPtr a (parseUnary());
@@ -1551,8 +2904,10 @@ private:
 
         for (;;)
         {
-            if (matchIf (TokenTypes::logicalAnd))       { ExpPtr b (parseComparator()); a.reset (new LogicalAndOp (location, a, b)); }
-            else if (matchIf (TokenTypes::logicalOr))   { ExpPtr b (parseComparator()); a.reset (new LogicalOrOp  (location, a, b)); }
+            const auto operatorLocation = location;
+
+            if (matchIf (TokenTypes::logicalAnd))       { ExpPtr b (parseComparator()); a.reset (withBranchCoverage (new LogicalAndOp (location, a, b), operatorLocation)); }
+            else if (matchIf (TokenTypes::logicalOr))   { ExpPtr b (parseComparator()); a.reset (withBranchCoverage (new LogicalOrOp  (location, a, b), operatorLocation)); }
             else if (matchIf (TokenTypes::bitwiseAnd))  { ExpPtr b (parseComparator()); a.reset (new BitwiseAndOp (location, a, b)); }
             else if (matchIf (TokenTypes::bitwiseOr))   { ExpPtr b (parseComparator()); a.reset (new BitwiseOrOp  (location, a, b)); }
             else if (matchIf (TokenTypes::bitwiseXor))  { ExpPtr b (parseComparator()); a.reset (new BitwiseXorOp (location, a, b)); }
@@ -1565,6 +2920,7 @@ private:
     Expression* parseTernaryOperator (ExpPtr& condition)
     {
         auto e = std::make_unique<ConditionalOp> (location);
+        withBranchCoverage (e.get(), location);
         e->condition.reset (condition.release());
         e->trueBranch.reset (parseExpression());
         match (TokenTypes::colon);
@@ -1577,33 +2933,74 @@ private:
 
 //==============================================================================
 FunctionObject::FunctionObject (const FunctionObject& other) :
-    functionCode (other.functionCode)
+    functionCode (other.functionCode),
+    isAsync (other.isAsync),
+    isGenerator (other.isGenerator)
 {
     ExpressionTreeBuilder tb (functionCode);
     tb.parseFunctionParamsAndBody (*this);
 }
 
 //==============================================================================
-var FunctionCall::invokeFunction (const Scope& s, const var& function, const var& thisObject) const
+var FunctionCall::invokeFunction (const Scope& s, ResumePoint& resume, const var& function, const var& thisObject) const
 {
     s.checkTimeOut (location);
-    Array<var> argVars;
 
-    for (auto* a : arguments)
-        argVars.add (a->getResult (s));
+    // Most calls only have a few arguments, which can be kept on the stack rather than allocated for each call.
+    constexpr int numArgumentsOnStack = 8;
+    var argumentsOnStack[numArgumentsOnStack];
+    Array<var> allocatedArguments;
+    auto* argVars = argumentsOnStack;
 
-    const var::NativeFunctionArgs args (thisObject, argVars.begin(), argVars.size());
+    if (arguments.size() > numArgumentsOnStack)
+    {
+        allocatedArguments.resize (arguments.size());
+        argVars = allocatedArguments.getRawDataPointer();
+    }
+
+    for (int i = 0; i < arguments.size(); ++i)
+        argVars[i] = resume.evaluate (i + 1, *arguments.getUnchecked (i));
 
     if (auto nativeFunction = function.getNativeFunction())
-        return nativeFunction (args);
+    {
+        SP_JS_COUNT (nativeCalls);
+        const CallHooks hooks (s, *this, location, true);
+
+        if (auto* bound = NativeBinding::getFunction (nativeFunction))
+        {
+            // This call always passes the same number of arguments, so it only needs checking against a function once.
+            if (bound != checkedBoundFunction.get())
+            {
+                bound->checkArgumentCount (arguments.size());
+                checkedBoundFunction = bound;
+            }
+
+            return bound->call (argVars);
+        }
+
+        return nativeFunction (var::NativeFunctionArgs (thisObject, argVars, arguments.size()));
+    }
+
+    const var::NativeFunctionArgs args (thisObject, argVars, arguments.size());
 
     if (auto* fo = dynamic_cast<FunctionObject*> (function.getObject()))
+    {
+        SP_JS_COUNT (scriptCalls);
+        const CallHooks hooks (s, *this, fo->body->location, false);
         return fo->invoke (s, args);
+    }
 
     if (auto* dot = dynamic_cast<DotOperator*> (object.get()))
+    {
         if (auto* o = thisObject.getDynamicObject())
+        {
             if (o->hasMethod (dot->child)) // allow an overridden DynamicObject::invokeMethod to accept a method call.
+            {
+                SP_JS_COUNT (nativeCalls);
                 return o->invokeMethod (dot->child, args);
+            }
+        }
+    }
 
     location.throwError ("This expression is not a function!");
     return var::undefined();
@@ -1637,6 +3034,8 @@ bool Scope::findAndInvokeMethod (const Identifier& function, const var::NativeFu
         {
             if (auto fo = dynamic_cast<FunctionObject*> (m->getObject()))
             {
+                SP_JS_COUNT (scriptCalls);
+                const CallHooks hooks (*this, function, fo->body->location, false);
                 result = fo->invoke (*this, args);
                 return true;
             }
@@ -1663,6 +3062,8 @@ bool Scope::invokeMethod (const var& m, const var::NativeFunctionArgs& args, var
         {
             if (auto fo = dynamic_cast<FunctionObject*> (m.getObject()))
             {
+                SP_JS_COUNT (scriptCalls);
+                const CallHooks hooks (*this, FunctionCall::getAnonymousName(), fo->body->location, false);
                 result = fo->invoke (*this, args);
                 return true;
             }
@@ -1674,8 +3075,12 @@ bool Scope::invokeMethod (const var& m, const var::NativeFunctionArgs& args, var
 
 void Scope::checkTimeOut (const CodeLocation& location) const
 {
+    sampleIfDue (location);
+
     if (Time::getCurrentTime() > root->timeout)
         location.throwError (root->timeout == Time() ? "Interrupted" : "Execution timed-out");
+
+    root->heap.collectIfNeeded();
 }
 
 //==============================================================================
@@ -1,115 +1,906 @@
 //==============================================================================
-static int parseFixedSizeIntAndSkip (String::CharPointerType& t, int numChars, char charToSkip) noexcept
+/** Calendar arithmetic in the proleptic Gregorian calendar, working on days since 1970-01-01.
+
+    These avoid juce::Time's trips through the OS, and work for any year.
+    See Howard Hinnant's "chrono-Compatible Low-Level Date Algorithms".
+*/
+static int64 floorDivide (int64 a, int64 b) noexcept
 {
-    int n = 0;
+    const auto q = a / b;
+    return (a % b != 0 && ((a < 0) != (b < 0))) ? q - 1 : q;
+}
 
-    for (int i = numChars; --i >= 0;)
-    {
-        const auto digit = (int) (*t - '0');
+/** @returns the number of days since the epoch of a date, whose month is from 1 to 12. */
+static int64 daysFromCivil (int64 year, int month, int day) noexcept
+{
+    year -= month <= 2 ? 1 : 0;
+    const auto era = floorDivide (year, 400);
+    const auto yearOfEra = year - era * 400;
+    const auto dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    const auto dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + dayOfEra - 719468;
+}
 
-        if (! isPositiveAndBelow (digit, 10))
-            return -1;
+/** Finds the date of a number of days since the epoch, with the month going from 1 to 12. */
+static void civilFromDays (int64 days, int& year, int& month, int& day) noexcept
+{
+    days += 719468;
+    const auto era = floorDivide (days, 146097);
+    const auto dayOfEra = days - era * 146097;
+    const auto yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    const auto dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    const auto shiftedMonth = (5 * dayOfYear + 2) / 153;
+
+    day = (int) (dayOfYear - (153 * shiftedMonth + 2) / 5 + 1);
+    month = (int) (shiftedMonth < 10 ? shiftedMonth + 3 : shiftedMonth - 9);
+    year = (int) (yearOfEra + era * 400 + (month <= 2 ? 1 : 0));
+}
 
-        ++t;
-        n = n * 10 + digit;
+/** Writes a number padded with zeros to a number of digits, returning the end of what was written. */
+static char* writePaddedNumber (char* dest, int64 value, int numDigits) noexcept
+{
+    char digits[24];
+    int numWritten = 0;
+
+    do
+    {
+        digits[numWritten++] = (char) ('0' + value % 10);
+        value /= 10;
     }
+    while (value > 0);
 
-    if (charToSkip != 0 && *t == (juce_wchar) charToSkip)
-        ++t;
+    for (int i = numWritten; i < numDigits; ++i)
+        *dest++ = '0';
 
-    return n;
+    while (numWritten > 0)
+        *dest++ = digits[--numWritten];
+
+    return dest;
 }
 
 //==============================================================================
-Result RFC2422TimeParser::parseString (Time& result, StringRef timeString)
+static const char* const shortDayNames[]    = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
+static const char* const shortMonthNames[]  = { "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                                "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+
+/** The furthest a time can be from the epoch, according to ECMAScript. */
+static constexpr int64 maximumTimeValue = 8640000000000000LL;
+
+static bool isLeapYear (int64 year) noexcept
 {
-    ignoreUnused (timeString);
-    result = Time();
-    return Result::ok();
+    return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
 }
 
-String RFC2422TimeParser::toString (const Time&)
+/** @returns the number of days in a month, which goes from 1 to 12. */
+static int getDaysInMonth (int64 year, int month) noexcept
 {
-    return {};
+    static const int days[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    return month == 2 && isLeapYear (year) ? 29 : days[month - 1];
 }
 
 //==============================================================================
-Result ISO8601TimeParser::parseString (Time& result, StringRef timeString)
+/** Caches the offset of local time from UTC, so that converting dates doesn't
+    need to ask the OS about the time zone every time.
+
+    The offset is stored for the start of each UTC day. When a day starts and ends
+    with the same offset, that's the offset for all of it; otherwise, the moment
+    that daylight saving changes is searched for once, and kept with the day.
+    Days are direct-mapped, so the dates a script works with can be years apart
+    without pushing each other out, and a miss costs a single call to the OS.
+*/
+class LocalTimeOffsetCache final
 {
-    const auto failResult = Result::fail (String());
+public:
+    /** @returns the cache for the calling thread. */
+    static LocalTimeOffsetCache& getInstance()
+    {
+        static thread_local LocalTimeOffsetCache cache;
+        return cache;
+    }
 
-    auto t = timeString.text;
-    auto year = parseFixedSizeIntAndSkip (t, 4, '-');
+    /** @returns the number of milliseconds that local time is ahead of UTC, at a moment in UTC. */
+    int64 getOffset (int64 utcMilliseconds)
+    {
+        const auto day = floorDivide (utcMilliseconds, millisecondsPerDay);
+        auto& entry = getEntry (day);
+        const auto offsetAtEnd = getEntry (day + 1).offsetAtStart; // Never the same entry, as neighbouring days map to neighbouring entries
 
-    if (year < 0)
-        return failResult;
+        if (entry.offsetAtStart == offsetAtEnd)
+            return offsetAtEnd;
+
+        if (! entry.hasTransition)
+        {
+            entry.transition = findTransition (day * millisecondsPerDay, entry.offsetAtStart);
+            entry.hasTransition = true;
+        }
 
-    auto month = parseFixedSizeIntAndSkip (t, 2, '-');
+        return utcMilliseconds < entry.transition ? entry.offsetAtStart : offsetAtEnd;
+    }
 
-    if (month < 0)
-        return failResult;
+    /** Converts a moment in local time to UTC. */
+    int64 toUTC (int64 localMilliseconds)
+    {
+        return localMilliseconds - getOffset (localMilliseconds - getOffset (localMilliseconds));
+    }
 
-    auto day = parseFixedSizeIntAndSkip (t, 2, 0);
+    /** Forgets all the offsets, in case the system's time zone has changed. */
+    void clear() noexcept
+    {
+        for (auto& e : entries)
+            e.isValid = false;
+    }
 
-    if (day < 0)
-        return failResult;
+private:
+    //==============================================================================
+    enum
+    {
+        numEntries = 1024,
+        spanMilliseconds = 15 * 60 * 1000 // The finest granularity that time zones and their transitions use
+    };
 
-    int hours = 0, minutes = 0, milliseconds = 0;
+    static constexpr int64 millisecondsPerDay = 86400000;
 
-    if (*t == 'T')
+    struct Entry
     {
-        ++t;
-        hours = parseFixedSizeIntAndSkip (t, 2, ':');
+        int64 day = 0, offsetAtStart = 0, transition = 0;
+        bool isValid = false, hasTransition = false;
+    };
 
-        if (hours < 0)
-            return failResult;
+    Entry entries[numEntries];
 
-        minutes = parseFixedSizeIntAndSkip (t, 2, ':');
+    LocalTimeOffsetCache() = default;
+
+    Entry& getEntry (int64 day)
+    {
+        auto& entry = entries[day & (numEntries - 1)];
 
-        if (minutes < 0)
-            return failResult;
+        if (! entry.isValid || entry.day != day)
+        {
+            entry.day = day;
+            entry.offsetAtStart = findOffset (day * millisecondsPerDay);
+            entry.hasTransition = false;
+            entry.isValid = true;
+        }
 
-        const auto seconds = parseFixedSizeIntAndSkip (t, 2, 0);
+        return entry;
+    }
 
-        if (seconds < 0)
-            return failResult;
+    /** Finds the first 15 minute span of a day that has a different offset to the start of it. */
+    static int64 findTransition (int64 dayStart, int64 offsetAtStart)
+    {
+        auto low = dayStart, high = dayStart + millisecondsPerDay;
 
-        if (*t == '.' || *t == ',')
+        while (high - low > spanMilliseconds)
         {
-            ++t;
-            milliseconds = parseFixedSizeIntAndSkip (t, 3, 0);
+            const auto middle = low + ((high - low) / spanMilliseconds / 2) * spanMilliseconds;
 
-            if (milliseconds < 0)
-                return failResult;
+            if (findOffset (middle) == offsetAtStart)
+                low = middle;
+            else
+                high = middle;
         }
 
-        milliseconds += 1000 * seconds;
+        return high;
+    }
+
+    static int64 findOffset (int64 utcMilliseconds)
+    {
+        const auto seconds = (time_t) floorDivide (utcMilliseconds, 1000);
+        std::tm local {};
+
+       #if JUCE_WINDOWS
+        if (localtime_s (&local, &seconds) != 0)
+            return 0;
+       #else
+        if (localtime_r (&seconds, &local) == nullptr)
+            return 0;
+       #endif
+
+        const auto localSeconds = daysFromCivil (local.tm_year + 1900, local.tm_mon + 1, local.tm_mday) * 86400
+                                + local.tm_hour * 3600
+                                + local.tm_min * 60
+                                + local.tm_sec;
+
+        return (localSeconds - (int64) seconds) * 1000;
     }
 
-    const auto nextChar = t.getAndAdvance();
+    JUCE_DECLARE_NON_COPYABLE (LocalTimeOffsetCache)
+};
+
+//==============================================================================
+/** The fields of a parsed timestamp, before they've been turned into a moment in time. */
+struct ParsedTime final
+{
+    int64 year = 0;
+    int month = 1, day = 1, hours = 0, minutes = 0, seconds = 0, milliseconds = 0;
 
-    if (nextChar == '-' || nextChar == '+')
+    /** How far ahead of UTC the time was given, if it had a time zone at all. */
+    int offsetMinutes = 0;
+    bool hasTimeZone = false;
+
+    /** Checks the fields are in range, and works out the moment in time they refer to.
+        Times without a time zone are taken to be in local time.
+    */
+    bool toMilliseconds (int64& result) const
+    {
+        if (! isPositiveAndNotGreaterThan (month - 1, 11)
+            || ! isPositiveAndNotGreaterThan (day - 1, getDaysInMonth (year, month) - 1)
+            || ! isPositiveAndNotGreaterThan (hours, 24)
+            || ! isPositiveAndNotGreaterThan (minutes, 59)
+            || ! isPositiveAndNotGreaterThan (seconds, 59)
+            || (hours == 24 && (minutes != 0 || seconds != 0 || milliseconds != 0))
+            || std::abs (year) > 300000)
+            return false;
+
+        auto ms = daysFromCivil (year, month, day) * 86400000
+                + hours * 3600000
+                + minutes * 60000
+                + seconds * 1000
+                + milliseconds;
+
+        ms = hasTimeZone ? ms - offsetMinutes * (int64) 60000
+                         : LocalTimeOffsetCache::getInstance().toUTC (ms);
+
+        if (std::abs (ms) > maximumTimeValue)
+            return false;
+
+        result = ms;
+        return true;
+    }
+};
+
+//==============================================================================
+/** A little cursor over the bytes of a timestamp. */
+struct TimeText final
+{
+    TimeText (const char* start, const char* endOfText) noexcept : p (start), end (endOfText) {}
+
+    bool isEmpty() const noexcept                       { return p >= end; }
+    char peek() const noexcept                          { return p < end ? *p : 0; }
+    size_t getNumRemaining() const noexcept             { return (size_t) (end - p); }
+    static bool isDigit (char c) noexcept               { return c >= '0' && c <= '9'; }
+    static bool isLetter (char c) noexcept              { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); }
+
+    bool skipIf (char c) noexcept
+    {
+        if (peek() != c)
+            return false;
+
+        ++p;
+        return true;
+    }
+
+    /** Reads exactly the given number of digits. */
+    bool readDigits (int numDigits, int& result) noexcept
     {
-        const auto offsetHours = parseFixedSizeIntAndSkip (t, 2, ':');
+        if (getNumRemaining() < (size_t) numDigits)
+            return false;
 
-        if (offsetHours < 0)
-            return failResult;
+        int n = 0;
 
-        const auto offsetMinutes = parseFixedSizeIntAndSkip (t, 2, 0);
+        for (int i = 0; i < numDigits; ++i)
+        {
+            if (! isDigit (p[i]))
+                return false;
 
-        if (offsetMinutes < 0)
-            return failResult;
+            n = n * 10 + (p[i] - '0');
+        }
 
-        const auto offsetMs = (offsetHours * 60 + offsetMinutes) * 60 * 1000;
-        milliseconds += nextChar == '-' ? offsetMs : -offsetMs; // NB: this seems backwards but is correct!
+        p += numDigits;
+        result = n;
+        return true;
     }
-    else if (nextChar != 0 && nextChar != 'Z')
+
+    /** Reads a run of digits, returning how many there were. */
+    int readNumber (int64& result) noexcept
     {
-        return failResult;
+        int numDigits = 0;
+        int64 n = 0;
+
+        while (isDigit (peek()) && numDigits < 9)
+        {
+            n = n * 10 + (*p++ - '0');
+            ++numDigits;
+        }
+
+        result = n;
+        return numDigits;
     }
 
-    result = Time (year, month - 1, day, hours, minutes, 0, milliseconds, false);
-    return Result::ok();
+    /** Reads a run of letters. */
+    bool readWord (const char*& wordStart, size_t& wordLength) noexcept
+    {
+        wordStart = p;
+
+        while (isLetter (peek()))
+            ++p;
+
+        wordLength = (size_t) (p - wordStart);
+        return wordLength > 0;
+    }
+
+    /** Skips white space, along with the parenthesised comments that RFC 2822 allows anywhere. */
+    void skipWhitespaceAndComments() noexcept
+    {
+        for (int commentDepth = 0; p < end; ++p)
+        {
+            if (*p == '(')                          ++commentDepth;
+            else if (*p == ')' && commentDepth > 0) --commentDepth;
+            else if (commentDepth == 0 && ! CharacterFunctions::isWhitespace (*p)) break;
+        }
+    }
+
+    const char* p;
+    const char* const end;
+};
+
+//==============================================================================
+/** Checks a fixed layout of timestamp eight bytes at a time, instead of a character at a time. */
+struct TimeWords final
+{
+    static constexpr uint64 ones = 0x0101010101010101ULL;
+    static constexpr uint64 highBits = 0x8080808080808080ULL;
+
+    /** Eight characters of a layout: the positions that must hold digits, and the exact bytes everywhere else. */
+    struct Layout final
+    {
+        explicit Layout (const char* layout) noexcept
+        {
+            char digitBytes[8], otherBytes[8];
+
+            for (int i = 0; i < 8; ++i)
+            {
+                const auto isDigitPosition = layout[i] == '#';
+                digitBytes[i] = isDigitPosition ? (char) 0xff : 0;
+                otherBytes[i] = isDigitPosition ? 0 : layout[i];
+            }
+
+            digitMask = load (digitBytes);
+            others = load (otherBytes);
+        }
+
+        uint64 digitMask = 0, others = 0;
+    };
+
+    static uint64 load (const char* source) noexcept
+    {
+        uint64 word;
+        memcpy (&word, source, sizeof (word));
+        return word;
+    }
+
+    /** Any carries or borrows between the bytes only ever come out of bytes that have failed already,
+        so a single set of additions is enough to check all eight at once.
+    */
+    static bool matches (const char* text, const Layout& layout) noexcept
+    {
+        const auto word = load (text);
+
+        if ((word & ~layout.digitMask) != layout.others)
+            return false;
+
+        const auto digits = (word & layout.digitMask) | ((ones * '0') & ~layout.digitMask);
+        return (((digits + ones * 0x46) | (digits - ones * '0') | digits) & highBits) == 0;
+    }
+
+    /** Turns two digits that have already been checked into their value. */
+    static int getTwoDigits (const char* text) noexcept
+    {
+        return (text[0] - '0') * 10 + (text[1] - '0');
+    }
+};
+
+//==============================================================================
+/** Parses the fixed layouts that nearly every machine-written timestamp uses:
+    YYYY-MM-DD, or YYYY-MM-DDTHH:mm:ss with optional milliseconds and time zone.
+
+    Anything else is left to the general parser, which is also what reports errors.
+*/
+static bool parseISO8601Layout (const char* text, size_t numBytes, ParsedTime& result) noexcept
+{
+    static const TimeWords::Layout dateLayout ("####-##-");
+    static const TimeWords::Layout timeLayout ("##T##:##");
+
+    if (numBytes < 10 || (numBytes > 10 && numBytes < 19)
+        || ! TimeWords::matches (text, dateLayout)
+        || ! TimeText::isDigit (text[8]) || ! TimeText::isDigit (text[9]))
+        return false;
+
+    result.year = TimeWords::getTwoDigits (text) * 100 + TimeWords::getTwoDigits (text + 2);
+    result.month = TimeWords::getTwoDigits (text + 5);
+    result.day = TimeWords::getTwoDigits (text + 8);
+
+    if (numBytes == 10)
+    {
+        // Dates without a time are in UTC.
+        result.hasTimeZone = true;
+        return true;
+    }
+
+    if (! TimeWords::matches (text + 8, timeLayout)
+        || text[16] != ':' || ! TimeText::isDigit (text[17]) || ! TimeText::isDigit (text[18]))
+        return false;
+
+    result.hours = TimeWords::getTwoDigits (text + 11);
+    result.minutes = TimeWords::getTwoDigits (text + 14);
+    result.seconds = TimeWords::getTwoDigits (text + 17);
+
+    auto* p = text + 19;
+    auto remaining = numBytes - 19;
+
+    if (remaining >= 4 && p[0] == '.'
+        && TimeText::isDigit (p[1]) && TimeText::isDigit (p[2]) && TimeText::isDigit (p[3]))
+    {
+        result.milliseconds = (p[1] - '0') * 100 + TimeWords::getTwoDigits (p + 2);
+        p += 4;
+        remaining -= 4;
+    }
+
+    if (remaining == 0)
+        return true;
+
+    if (remaining == 1 && p[0] == 'Z')
+    {
+        result.hasTimeZone = true;
+        return true;
+    }
+
+    if (remaining == 6 && (p[0] == '+' || p[0] == '-') && p[3] == ':'
+        && TimeText::isDigit (p[1]) && TimeText::isDigit (p[2])
+        && TimeText::isDigit (p[4]) && TimeText::isDigit (p[5]))
+    {
+        const auto hoursOffset = TimeWords::getTwoDigits (p + 1);
+        const auto minutesOffset = TimeWords::getTwoDigits (p + 4);
+
+        if (hoursOffset > 23 || minutesOffset > 59)
+            return false;
+
+        result.offsetMinutes = (p[0] == '-' ? -1 : 1) * (hoursOffset * 60 + minutesOffset);
+        result.hasTimeZone = true;
+        return true;
+    }
+
+    return false;
+}
+
+/** Parses the ECMAScript date time string format, which is a subset of ISO 8601,
+    along with the basic format that leaves out the dividers, a space instead of the T,
+    and any number of fractional second digits.
+*/
+static bool parseISO8601 (TimeText text, ParsedTime& result) noexcept
+{
+    if (text.peek() == '+' || text.peek() == '-')
+    {
+        const auto isNegative = text.peek() == '-';
+        int year = 0;
+        ++text.p;
+
+        if (! text.readDigits (6, year) || (isNegative && year == 0))
+            return false;
+
+        result.year = isNegative ? -year : year;
+    }
+    else
+    {
+        int year = 0;
+
+        if (! text.readDigits (4, year))
+            return false;
+
+        result.year = year;
+    }
+
+    const auto hasDividers = text.skipIf ('-');
+
+    if (hasDividers || TimeText::isDigit (text.peek()))
+    {
+        if (! text.readDigits (2, result.month))
+            return false;
+
+        if (hasDividers ? text.skipIf ('-') : TimeText::isDigit (text.peek()))
+            if (! text.readDigits (2, result.day))
+                return false;
+    }
+
+    if (text.isEmpty())
+    {
+        // Dates without a time are in UTC.
+        result.hasTimeZone = true;
+        return true;
+    }
+
+    if (! (text.skipIf ('T') || text.skipIf ('t') || text.skipIf (' ')))
+        return false;
+
+    if (! text.readDigits (2, result.hours))
+        return false;
+
+    text.skipIf (':');
+
+    if (! text.readDigits (2, result.minutes))
+        return false;
+
+    if (text.skipIf (':') || TimeText::isDigit (text.peek()))
+    {
+        if (! text.readDigits (2, result.seconds))
+            return false;
+
+        if (text.skipIf ('.') || text.skipIf (','))
+        {
+            if (! TimeText::isDigit (text.peek()))
+                return false;
+
+            for (int scale = 100; TimeText::isDigit (text.peek()); scale /= 10)
+                result.milliseconds += (*text.p++ - '0') * scale;
+        }
+    }
+
+    if (text.skipIf ('Z') || text.skipIf ('z'))
+    {
+        result.hasTimeZone = true;
+    }
+    else if (text.peek() == '+' || text.peek() == '-')
+    {
+        const auto sign = *text.p++ == '-' ? -1 : 1;
+        int hoursOffset = 0, minutesOffset = 0;
+
+        if (! text.readDigits (2, hoursOffset))
+            return false;
+
+        if (text.skipIf (':') || ! text.isEmpty())
+            if (! text.readDigits (2, minutesOffset))
+                return false;
+
+        if (hoursOffset > 23 || minutesOffset > 59)
+            return false;
+
+        result.offsetMinutes = sign * (hoursOffset * 60 + minutesOffset);
+        result.hasTimeZone = true;
+    }
+
+    return text.isEmpty();
+}
+
+//==============================================================================
+static bool matchesWord (const char* word, size_t wordLength, const char* name) noexcept
+{
+    for (size_t i = 0; i < wordLength; ++i)
+        if (name[i] == 0 || CharacterFunctions::toLowerCase ((juce_wchar) word[i]) != CharacterFunctions::toLowerCase ((juce_wchar) name[i]))
+            return false;
+
+    return name[wordLength] == 0;
+}
+
+/** @returns the month from 1 to 12, or 0 if the word isn't the name of one. */
+static int findMonth (const char* word, size_t wordLength) noexcept
+{
+    if (wordLength < 3)
+        return 0;
+
+    for (int i = 0; i < 12; ++i)
+        if (matchesWord (word, 3, shortMonthNames[i]))
+            return i + 1;
+
+    return 0;
+}
+
+/** Reads the named zones that RFC 2822 still allows for, in minutes ahead of UTC. */
+static bool findZoneOffset (const char* word, size_t wordLength, int& offsetMinutes) noexcept
+{
+    struct NamedZone { const char* name; int offsetHours; };
+
+    static const NamedZone zones[] =
+    {
+        { "UT", 0 }, { "UTC", 0 }, { "GMT", 0 }, { "Z", 0 },
+        { "EST", -5 }, { "EDT", -4 }, { "CST", -6 }, { "CDT", -5 },
+        { "MST", -7 }, { "MDT", -6 }, { "PST", -8 }, { "PDT", -7 }
+    };
+
+    for (const auto& zone : zones)
+    {
+        if (matchesWord (word, wordLength, zone.name))
+        {
+            offsetMinutes = zone.offsetHours * 60;
+            return true;
+        }
+    }
+
+    // The single letter military zones were defined inconsistently, so RFC 2822 says to treat them as UTC.
+    if (wordLength == 1 && TimeText::isLetter (word[0]) && word[0] != 'j' && word[0] != 'J')
+    {
+        offsetMinutes = 0;
+        return true;
+    }
+
+    return false;
+}
+
+/** Parses an RFC 2822 date-time, eg: Tue, 20 Oct 2026 14:03:00 +0200
+
+    This also accepts the month coming before the day and the "GMT+hhmm" zones
+    that Date.prototype.toString() writes, and takes a missing zone to mean local time,
+    the way browsers do.
+*/
+static bool parseRFC2822 (TimeText text, ParsedTime& result) noexcept
+{
+    const char* word = nullptr;
+    size_t wordLength = 0;
+
+    text.skipWhitespaceAndComments();
+
+    // The day of the week is only there for show, but has to be a real one if it's given.
+    if (TimeText::isLetter (text.peek()))
+    {
+        const auto* const start = text.p;
+        text.readWord (word, wordLength);
+
+        bool isDayName = false;
+
+        for (auto* name : shortDayNames)
+            isDayName = isDayName || (wordLength >= 3 && matchesWord (word, 3, name));
+
+        if (isDayName)
+        {
+            text.skipWhitespaceAndComments();
+            text.skipIf (',');
+            text.skipWhitespaceAndComments();
+        }
+        else
+        {
+            text.p = start;
+        }
+    }
+
+    int64 number = 0;
+
+    if (TimeText::isLetter (text.peek()))
+    {
+        text.readWord (word, wordLength);
+        result.month = findMonth (word, wordLength);
+        text.skipWhitespaceAndComments();
+
+        const auto numDigits = text.readNumber (number);
+
+        if (numDigits == 0 || numDigits > 2)
+            return false;
+
+        result.day = (int) number;
+    }
+    else
+    {
+        const auto numDigits = text.readNumber (number);
+
+        if (numDigits == 0 || numDigits > 2)
+            return false;
+
+        result.day = (int) number;
+        text.skipWhitespaceAndComments();
+
+        if (! text.readWord (word, wordLength))
+            return false;
+
+        result.month = findMonth (word, wordLength);
+    }
+
+    if (result.month == 0)
+        return false;
+
+    text.skipWhitespaceAndComments();
+
+    const auto numYearDigits = text.readNumber (number);
+
+    if (numYearDigits < 2)
+        return false;
+
+    // Two and three digit years are obsolete, but still turn up in old mail headers.
+    if (numYearDigits == 2)         result.year = number < 50 ? 2000 + number : 1900 + number;
+    else if (numYearDigits == 3)    result.year = 1900 + number;
+    else                            result.year = number;
+
+    text.skipWhitespaceAndComments();
+
+    if (! text.isEmpty())
+    {
+        if (! text.readDigits (2, result.hours) && ! text.readDigits (1, result.hours))
+            return false;
+
+        text.skipWhitespaceAndComments();
+
+        if (! text.skipIf (':'))
+            return false;
+
+        text.skipWhitespaceAndComments();
+
+        if (! text.readDigits (2, result.minutes))
+            return false;
+
+        text.skipWhitespaceAndComments();
+
+        if (text.skipIf (':'))
+        {
+            text.skipWhitespaceAndComments();
+
+            if (! text.readDigits (2, result.seconds))
+                return false;
+
+            // RFC 2822 allows for leap seconds, which ECMAScript times can't represent.
+            result.seconds = jmin (result.seconds, 59);
+        }
+
+        text.skipWhitespaceAndComments();
+
+        if (TimeText::isLetter (text.peek()))
+        {
+            text.readWord (word, wordLength);
+
+            if (! findZoneOffset (word, wordLength, result.offsetMinutes))
+                return false;
+
+            result.hasTimeZone = true;
+        }
+
+        if (text.peek() == '+' || text.peek() == '-')
+        {
+            const auto sign = *text.p++ == '-' ? -1 : 1;
+            int hoursOffset = 0, minutesOffset = 0;
+
+            if (! text.readDigits (2, hoursOffset) || ! text.readDigits (2, minutesOffset) || minutesOffset > 59)
+                return false;
+
+            result.offsetMinutes += sign * (hoursOffset * 60 + minutesOffset);
+            result.hasTimeZone = true;
+        }
+
+        text.skipWhitespaceAndComments();
+    }
+
+    return text.isEmpty();
+}
+
+//==============================================================================
+/** Gives back the raw bytes of a string, when its characters are already stored as UTF-8. */
+static const char* getUTF8Bytes (CharPointer_UTF8 text) noexcept                { return text.getAddress(); }
+
+template<typename CharPointerType>
+static const char* getUTF8Bytes (CharPointerType) noexcept                      { return nullptr; }
+
+template<typename ParserFunction>
+static Result parseToMilliseconds (int64& result, StringRef timeString, ParserFunction&& parser)
+{
+    String copy;
+    auto* text = getUTF8Bytes (timeString.text);
+
+    if (text == nullptr)
+    {
+        copy = String (timeString);
+        text = copy.toRawUTF8();
+    }
+
+    ParsedTime fields;
+
+    if (parser (text, std::strlen (text), fields) && fields.toMilliseconds (result))
+        return Result::ok();
+
+    return Result::fail ("Invalid date: " + String (timeString));
+}
+
+static bool parseAnyISO8601 (const char* text, size_t numBytes, ParsedTime& fields) noexcept
+{
+    if (parseISO8601Layout (text, numBytes, fields))
+        return true;
+
+    fields = {};
+    return parseISO8601 (TimeText (text, text + numBytes), fields);
+}
+
+static bool parseAnyRFC2822 (const char* text, size_t numBytes, ParsedTime& fields) noexcept
+{
+    return parseRFC2822 (TimeText (text, text + numBytes), fields);
+}
+
+//==============================================================================
+Result RFC2422TimeParser::parseString (Time& result, StringRef timeString)
+{
+    int64 ms = 0;
+    const auto r = parseString (ms, timeString);
+
+    if (r.wasOk())
+        result = Time (ms);
+
+    return r;
+}
+
+Result RFC2422TimeParser::parseString (int64& millisecondsSinceEpoch, StringRef timeString)
+{
+    return parseToMilliseconds (millisecondsSinceEpoch, timeString, parseAnyRFC2822);
+}
+
+String RFC2422TimeParser::toString (const Time& t)
+{
+    const auto offset = LocalTimeOffsetCache::getInstance().getOffset (t.toMilliseconds());
+    const auto local = t.toMilliseconds() + offset;
+    const auto days = floorDivide (local, 86400000);
+    const auto msInDay = local - days * 86400000;
+    const auto offsetMinutes = offset / 60000;
+
+    int year = 0, month = 0, day = 0;
+    civilFromDays (days, year, month, day);
+
+    char buffer[64];
+    auto* p = buffer;
+
+    auto writeText = [&p] (const char* text)
+    {
+        while (*text != 0)
+            *p++ = *text++;
+    };
+
+    writeText (shortDayNames[(days + 4) - floorDivide (days + 4, 7) * 7]);
+    writeText (", ");
+    p = writePaddedNumber (p, day, 2);
+    *p++ = ' ';
+    writeText (shortMonthNames[month - 1]);
+    *p++ = ' ';
+
+    if (year < 0)
+        *p++ = '-';
+
+    p = writePaddedNumber (p, std::abs (year), 4);
+    *p++ = ' ';     p = writePaddedNumber (p, msInDay / 3600000, 2);
+    *p++ = ':';     p = writePaddedNumber (p, (msInDay / 60000) % 60, 2);
+    *p++ = ':';     p = writePaddedNumber (p, (msInDay / 1000) % 60, 2);
+    *p++ = ' ';
+    *p++ = offsetMinutes < 0 ? '-' : '+';
+    p = writePaddedNumber (p, std::abs (offsetMinutes) / 60, 2);
+    p = writePaddedNumber (p, std::abs (offsetMinutes) % 60, 2);
+
+    return String (buffer, (size_t) (p - buffer));
+}
+
+//==============================================================================
+Result ISO8601TimeParser::parseString (Time& result, StringRef timeString)
+{
+    int64 ms = 0;
+    const auto r = parseString (ms, timeString);
+
+    if (r.wasOk())
+        result = Time (ms);
+
+    return r;
+}
+
+Result ISO8601TimeParser::parseString (int64& millisecondsSinceEpoch, StringRef timeString)
+{
+    return parseToMilliseconds (millisecondsSinceEpoch, timeString, parseAnyISO8601);
+}
+
+int ISO8601TimeParser::parseStrings (const StringArray& timeStrings, Array<double>& results)
+{
+    results.resize (timeStrings.size());
+
+    auto* dest = results.getRawDataPointer();
+    int numParsed = 0;
+
+    for (const auto& s : timeStrings)
+    {
+        const auto* text = s.toRawUTF8();
+        const auto numBytes = s.getNumBytesAsUTF8();
+        ParsedTime fields, rfcFields;
+        int64 ms = 0;
+
+        if ((parseAnyISO8601 (text, numBytes, fields) && fields.toMilliseconds (ms))
+            || (parseAnyRFC2822 (text, numBytes, rfcFields) && rfcFields.toMilliseconds (ms)))
+        {
+            *dest++ = (double) ms;
+            ++numParsed;
+        }
+        else
+        {
+            *dest++ = std::numeric_limits<double>::quiet_NaN();
+        }
+    }
+
+    return numParsed;
 }
 
 String ISO8601TimeParser::toString (const Time& t, bool includeDividerCharacters)
@@ -124,3 +915,35 @@ String ISO8601TimeParser::toString (const Time& t, bool includeDividerCharacters
                               t.getSeconds() + t.getMilliseconds() / 1000.0)
             + t.getUTCOffsetString (includeDividerCharacters);
 }
+
+String ISO8601TimeParser::toString (int64 millisecondsSinceEpoch)
+{
+    const auto days = floorDivide (millisecondsSinceEpoch, 86400000);
+    const auto msInDay = millisecondsSinceEpoch - days * 86400000;
+
+    int year = 0, month = 0, day = 0;
+    civilFromDays (days, year, month, day);
+
+    char buffer[32];
+    auto* p = buffer;
+
+    if (year < 0 || year > 9999)
+    {
+        *p++ = year < 0 ? '-' : '+';
+        p = writePaddedNumber (p, std::abs (year), 6);
+    }
+    else
+    {
+        p = writePaddedNumber (p, year, 4);
+    }
+
+    *p++ = '-';     p = writePaddedNumber (p, month, 2);
+    *p++ = '-';     p = writePaddedNumber (p, day, 2);
+    *p++ = 'T';     p = writePaddedNumber (p, msInDay / 3600000, 2);
+    *p++ = ':';     p = writePaddedNumber (p, (msInDay / 60000) % 60, 2);
+    *p++ = ':';     p = writePaddedNumber (p, (msInDay / 1000) % 60, 2);
+    *p++ = '.';     p = writePaddedNumber (p, msInDay % 1000, 3);
+    *p++ = 'Z';
+
+    return String (buffer, (size_t) (p - buffer));
+}
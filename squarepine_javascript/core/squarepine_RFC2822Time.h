@@ -3,10 +3,17 @@
 class RFC2422TimeParser final
 {
 public:
-    /** */
+    /** Parses an RFC 2822 date-time, eg: Tue, 20 Oct 2026 14:03:00 +0200
+
+        The month may also come before the day, as it does in the text written by
+        Date.prototype.toString(). A time without a zone is taken to be local time.
+    */
     static Result parseString (Time& result, StringRef timeString);
 
-    /** */
+    /** Parses an RFC 2822 date-time straight to milliseconds since the epoch, skipping juce::Time. */
+    static Result parseString (int64& millisecondsSinceEpoch, StringRef timeString);
+
+    /** Writes a time out as an RFC 2822 date-time, in local time. */
     static String toString (const Time& t);
 
 private:
@@ -20,12 +27,37 @@ private:
 class ISO8601TimeParser final
 {
 public:
-    /** */
+    /** Parses an ISO 8601 timestamp, in the forms that ECMAScript's Date uses.
+
+        Dates without a time are taken to be in UTC, and times without
+        a time zone in local time, the same as Date.parse() does.
+    */
     static Result parseString (Time& result, StringRef timeString);
 
+    /** Parses an ISO 8601 timestamp straight to milliseconds since the epoch, skipping juce::Time.
+
+        The common fixed layouts (eg: 2026-10-20T14:03:00.000Z) are checked eight
+        bytes at a time, before falling back to a general parser for anything else.
+    */
+    static Result parseString (int64& millisecondsSinceEpoch, StringRef timeString);
+
+    /** Parses a batch of timestamps to milliseconds since the epoch, trying ISO 8601 and then RFC 2822.
+
+        The results are resized to match the number of strings, and any
+        strings that couldn't be parsed get a NaN in their place.
+
+        @returns the number of strings that were parsed successfully.
+    */
+    static int parseStrings (const StringArray& timeStrings, Array<double>& results);
+
     /** */
     static String toString (const Time& t, bool includeDividerCharacters = true);
 
+    /** Returns a moment in time in the format used by Date.prototype.toISOString(),
+        in UTC and with milliseconds (eg: 2011-10-05T14:48:00.000Z).
+    */
+    static String toString (int64 millisecondsSinceEpoch);
+
 private:
     //==============================================================================
     ISO8601TimeParser() = delete;
@@ -0,0 +1,1181 @@
+//==============================================================================
+/** The text that a regular expression gets matched against.
+
+    Matching works on whole code points, so the indices are the same as
+    the ones used by the rest of the engine's string methods.
+*/
+struct RegexSubject final
+{
+    explicit RegexSubject (const String& s) :
+        text (s)
+    {
+        chars.reserve (s.getNumBytesAsUTF8());
+
+        for (auto p = s.getCharPointer(); ! p.isEmpty();)
+            chars.push_back (p.getAndAdvance());
+    }
+
+    int length() const noexcept                 { return (int) chars.size(); }
+    const juce_wchar* data() const noexcept     { return chars.data(); }
+
+    String substring (int start, int end) const
+    {
+        if (start >= end)
+            return {};
+
+        return String (CharPointer_UTF32 (data() + start), CharPointer_UTF32 (data() + end));
+    }
+
+    const String text;
+    std::vector<juce_wchar> chars;
+};
+
+//==============================================================================
+/** A compiled regular expression, following the ECMAScript syntax.
+
+    Patterns get parsed into a tree, which is then compiled to a small instruction
+    set that's run by a backtracking matcher. The matcher keeps its own stack rather
+    than recursing, so nested quantifiers can't overflow the native stack, and it
+    checks the engine's timeout now and again so a catastrophic pattern can't hang it.
+
+    Programs are immutable once compiled, so any number of RegExp objects can share one.
+*/
+class RegexProgram final : public ReferenceCountedObject
+{
+public:
+    using Ptr = ReferenceCountedObjectPtr<RegexProgram>;
+
+    /** Compiles a pattern, throwing an error message if it or the flags are invalid. */
+    RegexProgram (const String& pattern, const String& flagsToUse) :
+        source (pattern)
+    {
+        for (auto p = flagsToUse.getCharPointer(); ! p.isEmpty();)
+        {
+            const auto c = p.getAndAdvance();
+            bool* flag = nullptr;
+
+            switch (c)
+            {
+                case 'g': flag = &global; break;
+                case 'i': flag = &ignoreCase; break;
+                case 'm': flag = &multiline; break;
+                case 's': flag = &dotAll; break;
+                case 'u': flag = &unicode; break;
+                case 'y': flag = &sticky; break;
+                default: break;
+            }
+
+            if (flag == nullptr || *flag)
+                throw "Invalid regular expression flags '" + flagsToUse + "'";
+
+            *flag = true;
+        }
+
+        if (global)     flags << "g";
+        if (ignoreCase) flags << "i";
+        if (multiline)  flags << "m";
+        if (dotAll)     flags << "s";
+        if (unicode)    flags << "u";
+        if (sticky)     flags << "y";
+
+        hash = source.hash() * 31 + flags.hash();
+
+        Parser parser (*this);
+        Compiler (*this).compile (*parser.parse());
+    }
+
+    //==============================================================================
+    String source, flags;
+    size_t hash = 0;
+    bool global = false, ignoreCase = false, multiline = false,
+         dotAll = false, unicode = false, sticky = false;
+
+    /** @returns the number of capture groups, including the whole match. */
+    int getNumGroups() const noexcept                   { return numGroups; }
+    /** @returns the name of each capture group, or an empty string for unnamed ones. */
+    const StringArray& getGroupNames() const noexcept   { return groupNames; }
+
+    //==============================================================================
+    /** Looks for the leftmost match that starts at or after the given index.
+
+        If anchored is true, only a match that starts exactly at the index will do.
+
+        On success, the captures array gets a start and end index for each group,
+        or -1 for groups that didn't take part in the match.
+    */
+    bool match (const RegexSubject& subject, int startIndex, bool anchored, int* captures) const
+    {
+        const auto* text = subject.data();
+        const auto length = subject.length();
+
+        if (! isPositiveAndNotGreaterThan (startIndex, length))
+            return false;
+
+        std::vector<int> slots ((size_t) numSlots);
+        std::vector<Backtrack> stack;
+        int steps = 0;
+
+        for (auto start = startIndex; start <= length; ++start)
+        {
+            if (hasFirstCharacter && ! anchored)
+            {
+                while (start < length && text[start] != firstCharacter)
+                    ++start;
+
+                if (start >= length)
+                    return false;
+            }
+
+            std::fill (slots.begin(), slots.end(), -1);
+
+            if (run (text, length, 0, start, slots.data(), steps, stack))
+            {
+                std::copy (slots.begin(), slots.begin() + numGroups * 2, captures);
+                return true;
+            }
+
+            if (anchored || anchoredAtStart)
+                break;
+        }
+
+        return false;
+    }
+
+private:
+    //==============================================================================
+    enum class Op
+    {
+        character, any, anyButNewline, characterClass,
+        split, jump, save, checkProgress,
+        lineStart, lineEnd, inputStart, inputEnd, wordBoundary, notWordBoundary,
+        backReference, lookahead, negativeLookahead, lookEnd, match
+    };
+
+    struct Instruction
+    {
+        Op op;
+        int a, b;
+    };
+
+    struct Range
+    {
+        juce_wchar start, end;
+    };
+
+    struct CharacterClass
+    {
+        std::vector<Range> ranges;
+        bool negated = false;
+        uint32 asciiBits[4] = {};
+
+        void normalise (bool ignoreCase)
+        {
+            std::sort (ranges.begin(), ranges.end(), [] (const Range& x, const Range& y) { return x.start < y.start; });
+
+            std::vector<Range> merged;
+
+            for (const auto& r : ranges)
+            {
+                if (! merged.empty() && r.start <= merged.back().end + 1)
+                    merged.back().end = jmax (merged.back().end, r.end);
+                else
+                    merged.push_back (r);
+            }
+
+            ranges = std::move (merged);
+
+            for (juce_wchar c = 0; c < 128; ++c)
+                if (lookUp (c, ignoreCase))
+                    asciiBits[c >> 5] |= (uint32) 1 << (c & 31);
+        }
+
+        bool contains (juce_wchar c, bool ignoreCase) const noexcept
+        {
+            if (c < 128)
+                return (asciiBits[c >> 5] & ((uint32) 1 << (c & 31))) != 0;
+
+            return lookUp (c, ignoreCase);
+        }
+
+        bool lookUp (juce_wchar c, bool ignoreCase) const noexcept
+        {
+            auto found = containsRaw (c);
+
+            if (! found && ignoreCase)
+                found = containsRaw (CharacterFunctions::toLowerCase (c))
+                     || containsRaw (CharacterFunctions::toUpperCase (c));
+
+            return found != negated;
+        }
+
+        bool containsRaw (juce_wchar c) const noexcept
+        {
+            const auto iter = std::upper_bound (ranges.begin(), ranges.end(), c,
+                                                [] (juce_wchar value, const Range& r) { return value < r.start; });
+
+            return iter != ranges.begin() && c <= (iter - 1)->end;
+        }
+    };
+
+    struct Backtrack
+    {
+        int pc, pos, slot, value;
+    };
+
+    //==============================================================================
+    struct Node
+    {
+        enum class Type { empty, character, any, characterClass, sequence, alternation, group, repeat, assertion, backReference, lookahead };
+
+        Node (Type t) noexcept : type (t) {}
+
+        Type type;
+        int value = 0, min = 0, max = 0;
+        bool greedy = true, negated = false;
+        String name;
+        std::vector<std::unique_ptr<Node>> children;
+    };
+
+    using NodePtr = std::unique_ptr<Node>;
+
+    //==============================================================================
+    struct Parser
+    {
+        Parser (RegexProgram& o) :
+            owner (o)
+        {
+            for (auto p = owner.source.getCharPointer(); ! p.isEmpty();)
+                chars.push_back (p.getAndAdvance());
+        }
+
+        NodePtr parse()
+        {
+            owner.groupNames.add ({});
+
+            auto root = parseDisjunction();
+
+            if (! atEnd())
+                fail ("Unmatched ')'");
+
+            return root;
+        }
+
+    private:
+        RegexProgram& owner;
+        std::vector<juce_wchar> chars;
+        size_t pos = 0;
+
+        bool atEnd() const noexcept                     { return pos >= chars.size(); }
+        juce_wchar peek (size_t offset = 0) const noexcept { return pos + offset < chars.size() ? chars[pos + offset] : 0; }
+        bool matchIf (juce_wchar c) noexcept            { if (! atEnd() && chars[pos] == c) { ++pos; return true; } return false; }
+
+        juce_wchar next()
+        {
+            if (atEnd())
+                fail ("\\ at end of pattern");
+
+            return chars[pos++];
+        }
+
+        void fail (const String& message) const
+        {
+            throw "Invalid regular expression /" + owner.source + "/: " + message;
+        }
+
+        static NodePtr makeNode (Node::Type type, int value = 0)
+        {
+            NodePtr node (new Node (type));
+            node->value = value;
+            return node;
+        }
+
+        //==============================================================================
+        NodePtr parseDisjunction()
+        {
+            auto first = parseAlternative();
+
+            if (atEnd() || peek() != '|')
+                return first;
+
+            auto node = makeNode (Node::Type::alternation);
+            node->children.push_back (std::move (first));
+
+            while (matchIf ('|'))
+                node->children.push_back (parseAlternative());
+
+            return node;
+        }
+
+        NodePtr parseAlternative()
+        {
+            auto node = makeNode (Node::Type::sequence);
+
+            while (! atEnd() && peek() != '|' && peek() != ')')
+                node->children.push_back (parseTerm());
+
+            return node;
+        }
+
+        NodePtr parseTerm()
+        {
+            const auto c = peek();
+
+            if (c == '^')
+            {
+                ++pos;
+                return makeNode (Node::Type::assertion, (int) (owner.multiline ? Op::lineStart : Op::inputStart));
+            }
+
+            if (c == '$')
+            {
+                ++pos;
+                return makeNode (Node::Type::assertion, (int) (owner.multiline ? Op::lineEnd : Op::inputEnd));
+            }
+
+            if (c == '\\' && (peek (1) == 'b' || peek (1) == 'B'))
+            {
+                pos += 2;
+                return makeNode (Node::Type::assertion, (int) (chars[pos - 1] == 'b' ? Op::wordBoundary : Op::notWordBoundary));
+            }
+
+            if (c == '(' && peek (1) == '?' && (peek (2) == '=' || peek (2) == '!'))
+            {
+                pos += 3;
+
+                auto node = makeNode (Node::Type::lookahead);
+                node->negated = chars[pos - 1] == '!';
+                node->children.push_back (parseDisjunction());
+
+                if (! matchIf (')'))
+                    fail ("Unterminated group");
+
+                return node;
+            }
+
+            return parseQuantifier (parseAtom());
+        }
+
+        NodePtr parseQuantifier (NodePtr atom)
+        {
+            int min = 0, max = 0;
+
+            if (matchIf ('*'))                          { min = 0; max = -1; }
+            else if (matchIf ('+'))                     { min = 1; max = -1; }
+            else if (matchIf ('?'))                     { min = 0; max = 1; }
+            else if (peek() == '{' && parseBraces (min, max)) {}
+            else                                        return atom;
+
+            if (max >= 0 && max < min)
+                fail ("numbers out of order in {} quantifier");
+
+            auto node = makeNode (Node::Type::repeat);
+            node->min = min;
+            node->max = max;
+            node->greedy = ! matchIf ('?');
+            node->children.push_back (std::move (atom));
+            return node;
+        }
+
+        bool parseBraces (int& min, int& max)
+        {
+            auto p = pos + 1;
+
+            auto readNumber = [&] (int& result)
+            {
+                if (p >= chars.size() || ! CharacterFunctions::isDigit (chars[p]))
+                    return false;
+
+                result = 0;
+
+                while (p < chars.size() && CharacterFunctions::isDigit (chars[p]))
+                    result = jmin (result * 10 + (int) (chars[p++] - '0'), (int) maximumRepeatCount);
+
+                return true;
+            };
+
+            if (! readNumber (min))
+                return false;
+
+            max = min;
+
+            if (p < chars.size() && chars[p] == ',')
+            {
+                ++p;
+
+                if (! readNumber (max))
+                    max = -1;
+            }
+
+            if (p >= chars.size() || chars[p] != '}')
+                return false;
+
+            pos = p + 1;
+            return true;
+        }
+
+        //==============================================================================
+        NodePtr parseAtom()
+        {
+            const auto c = next();
+
+            switch (c)
+            {
+                case '.':   return makeNode (Node::Type::any);
+                case '(':   return parseGroup();
+                case '[':   return parseClass();
+                case '\\':  return parseAtomEscape();
+
+                case '*':
+                case '+':
+                case '?':
+                    fail ("Nothing to repeat");
+                    break;
+
+                default:
+                    break;
+            }
+
+            return makeNode (Node::Type::character, (int) c);
+        }
+
+        NodePtr parseGroup()
+        {
+            int groupIndex = -1;
+
+            if (matchIf ('?'))
+            {
+                if (peek() == '<' && (peek (1) == '=' || peek (1) == '!'))
+                    fail ("Lookbehind assertions are unsupported");
+
+                if (matchIf ('<'))
+                {
+                    groupIndex = owner.numGroups++;
+                    owner.groupNames.add (parseGroupName());
+                }
+                else if (! matchIf (':'))
+                {
+                    fail ("Invalid group");
+                }
+            }
+            else
+            {
+                groupIndex = owner.numGroups++;
+                owner.groupNames.add ({});
+            }
+
+            auto node = makeNode (Node::Type::group, groupIndex);
+            node->children.push_back (parseDisjunction());
+
+            if (! matchIf (')'))
+                fail ("Unterminated group");
+
+            return node;
+        }
+
+        String parseGroupName()
+        {
+            const auto start = pos;
+
+            while (! atEnd() && peek() != '>')
+                ++pos;
+
+            if (! matchIf ('>') || pos - 1 == start)
+                fail ("Invalid capture group name");
+
+            return String (CharPointer_UTF32 (chars.data() + start), CharPointer_UTF32 (chars.data() + pos - 1));
+        }
+
+        NodePtr parseAtomEscape()
+        {
+            const auto c = next();
+
+            if (c >= '1' && c <= '9')
+            {
+                auto group = (int) (c - '0');
+
+                while (CharacterFunctions::isDigit (peek()) && group < 1000)
+                    group = group * 10 + (int) (next() - '0');
+
+                return makeNode (Node::Type::backReference, group);
+            }
+
+            if (c == 'k' && peek() == '<')
+            {
+                ++pos;
+                auto node = makeNode (Node::Type::backReference, -1);
+                node->name = parseGroupName();
+                return node;
+            }
+
+            CharacterClass cls;
+
+            if (addBuiltInClass (cls.ranges, c))
+                return addClass (cls);
+
+            return makeNode (Node::Type::character, (int) parseCharacterEscape (c));
+        }
+
+        juce_wchar parseCharacterEscape (juce_wchar c)
+        {
+            switch (c)
+            {
+                case 'n': return '\n';
+                case 'r': return '\r';
+                case 't': return '\t';
+                case 'v': return 0x0b;
+                case 'f': return 0x0c;
+                case '0': return 0;
+
+                case 'c':
+                    if (CharacterFunctions::isLetter (peek()))
+                        return next() % 32;
+
+                    return c;
+
+                case 'x':
+                {
+                    juce_wchar result = 0;
+                    return readHex (2, result) ? result : c;
+                }
+
+                case 'u':
+                {
+                    juce_wchar result = 0;
+
+                    if (owner.unicode && peek() == '{')
+                    {
+                        const auto start = pos++;
+
+                        while (CharacterFunctions::getHexDigitValue (peek()) >= 0 && result <= 0x10ffff)
+                            result = (result << 4) | (juce_wchar) CharacterFunctions::getHexDigitValue (next());
+
+                        if (matchIf ('}') && result <= 0x10ffff)
+                            return result;
+
+                        pos = start;
+                        return c;
+                    }
+
+                    return readHex (4, result) ? result : c;
+                }
+
+                default:
+                    break;
+            }
+
+            return c;
+        }
+
+        bool readHex (int numDigits, juce_wchar& result)
+        {
+            for (int i = 0; i < numDigits; ++i)
+                if (CharacterFunctions::getHexDigitValue (peek ((size_t) i)) < 0)
+                    return false;
+
+            result = 0;
+
+            for (int i = 0; i < numDigits; ++i)
+                result = (result << 4) | (juce_wchar) CharacterFunctions::getHexDigitValue (next());
+
+            return true;
+        }
+
+        //==============================================================================
+        NodePtr parseClass()
+        {
+            CharacterClass cls;
+            cls.negated = matchIf ('^');
+
+            for (;;)
+            {
+                if (atEnd())
+                    fail ("Unterminated character class");
+
+                if (matchIf (']'))
+                    break;
+
+                juce_wchar low = 0;
+
+                if (! parseClassAtom (cls, low))
+                    continue;
+
+                if (peek() == '-' && peek (1) != ']' && pos + 1 < chars.size())
+                {
+                    ++pos;
+                    juce_wchar high = 0;
+
+                    if (! parseClassAtom (cls, high))
+                    {
+                        cls.ranges.push_back ({ low, low });
+                        cls.ranges.push_back ({ '-', '-' });
+                        continue;
+                    }
+
+                    if (high < low)
+                        fail ("Range out of order in character class");
+
+                    cls.ranges.push_back ({ low, high });
+                }
+                else
+                {
+                    cls.ranges.push_back ({ low, low });
+                }
+            }
+
+            return addClass (cls);
+        }
+
+        /** @returns false if the atom was a class escape like \d, which gets added to the class directly. */
+        bool parseClassAtom (CharacterClass& cls, juce_wchar& result)
+        {
+            auto c = next();
+
+            if (c != '\\')
+            {
+                result = c;
+                return true;
+            }
+
+            c = next();
+
+            if (addBuiltInClass (cls.ranges, c))
+                return false;
+
+            result = c == 'b' ? (juce_wchar) 8 : parseCharacterEscape (c);
+            return true;
+        }
+
+        NodePtr addClass (CharacterClass& cls)
+        {
+            cls.normalise (owner.ignoreCase);
+            owner.classes.push_back (std::move (cls));
+            return makeNode (Node::Type::characterClass, (int) owner.classes.size() - 1);
+        }
+
+        static bool addBuiltInClass (std::vector<Range>& target, juce_wchar c)
+        {
+            static const Range digits[] = { { '0', '9' } };
+            static const Range word[]   = { { '0', '9' }, { 'A', 'Z' }, { '_', '_' }, { 'a', 'z' } };
+            static const Range space[]  = { { 0x09, 0x0d }, { 0x20, 0x20 }, { 0xa0, 0xa0 }, { 0x1680, 0x1680 },
+                                            { 0x2000, 0x200a }, { 0x2028, 0x2029 }, { 0x202f, 0x202f },
+                                            { 0x205f, 0x205f }, { 0x3000, 0x3000 }, { 0xfeff, 0xfeff } };
+
+            switch (c)
+            {
+                case 'd': addRanges (target, std::begin (digits), std::end (digits), false); return true;
+                case 'D': addRanges (target, std::begin (digits), std::end (digits), true); return true;
+                case 'w': addRanges (target, std::begin (word), std::end (word), false); return true;
+                case 'W': addRanges (target, std::begin (word), std::end (word), true); return true;
+                case 's': addRanges (target, std::begin (space), std::end (space), false); return true;
+                case 'S': addRanges (target, std::begin (space), std::end (space), true); return true;
+                default: break;
+            }
+
+            return false;
+        }
+
+        /** Adds a sorted set of ranges, or everything outside of them. */
+        static void addRanges (std::vector<Range>& target, const Range* start, const Range* end, bool invert)
+        {
+            if (! invert)
+            {
+                target.insert (target.end(), start, end);
+                return;
+            }
+
+            juce_wchar next = 0;
+
+            for (auto* r = start; r != end; ++r)
+            {
+                if (r->start > next)
+                    target.push_back ({ next, r->start - 1 });
+
+                next = r->end + 1;
+            }
+
+            target.push_back ({ next, 0x10ffff });
+        }
+    };
+
+    //==============================================================================
+    struct Compiler
+    {
+        Compiler (RegexProgram& o) noexcept : owner (o) {}
+
+        void compile (const Node& root)
+        {
+            emit (Op::save, 0);
+            compileNode (root);
+            emit (Op::save, 1);
+            emit (Op::match);
+
+            owner.numSlots = owner.numGroups * 2 + numRegisters;
+
+            auto first = owner.code.begin();
+
+            while (first->op == Op::save)
+                ++first;
+
+            owner.anchoredAtStart = first->op == Op::inputStart;
+            owner.hasFirstCharacter = first->op == Op::character && ! owner.ignoreCase;
+            owner.firstCharacter = (juce_wchar) first->a;
+        }
+
+    private:
+        RegexProgram& owner;
+        int numRegisters = 0;
+
+        size_t emit (Op op, int a = 0, int b = 0)
+        {
+            if (owner.code.size() >= (size_t) maximumProgramSize)
+                throw "Invalid regular expression /" + owner.source + "/: Regular expression too large";
+
+            owner.code.push_back ({ op, a, b });
+            return owner.code.size() - 1;
+        }
+
+        int here() const noexcept { return (int) owner.code.size(); }
+
+        void setSplit (size_t index, int body, int exit, bool greedy) noexcept
+        {
+            owner.code[index].a = greedy ? body : exit;
+            owner.code[index].b = greedy ? exit : body;
+        }
+
+        static bool canBeEmpty (const Node& n)
+        {
+            switch (n.type)
+            {
+                case Node::Type::character:
+                case Node::Type::any:
+                case Node::Type::characterClass:
+                    return false;
+
+                case Node::Type::sequence:
+                    for (const auto& c : n.children)
+                        if (! canBeEmpty (*c))
+                            return false;
+
+                    return true;
+
+                case Node::Type::alternation:
+                    for (const auto& c : n.children)
+                        if (canBeEmpty (*c))
+                            return true;
+
+                    return false;
+
+                case Node::Type::group:     return canBeEmpty (*n.children.front());
+                case Node::Type::repeat:    return n.min == 0 || canBeEmpty (*n.children.front());
+
+                default:
+                    break;
+            }
+
+            return true;
+        }
+
+        void compileNode (const Node& n)
+        {
+            switch (n.type)
+            {
+                case Node::Type::empty:
+                    break;
+
+                case Node::Type::character:
+                    emit (Op::character, owner.ignoreCase ? (int) CharacterFunctions::toLowerCase ((juce_wchar) n.value) : n.value);
+                    break;
+
+                case Node::Type::any:
+                    emit (owner.dotAll ? Op::any : Op::anyButNewline);
+                    break;
+
+                case Node::Type::characterClass:
+                    emit (Op::characterClass, n.value);
+                    break;
+
+                case Node::Type::sequence:
+                    for (const auto& c : n.children)
+                        compileNode (*c);
+
+                    break;
+
+                case Node::Type::alternation:
+                {
+                    std::vector<size_t> jumpsToEnd;
+
+                    for (size_t i = 0; i < n.children.size(); ++i)
+                    {
+                        if (i + 1 < n.children.size())
+                        {
+                            const auto split = emit (Op::split);
+                            owner.code[split].a = here();
+                            compileNode (*n.children[i]);
+                            jumpsToEnd.push_back (emit (Op::jump));
+                            owner.code[split].b = here();
+                        }
+                        else
+                        {
+                            compileNode (*n.children[i]);
+                        }
+                    }
+
+                    for (auto j : jumpsToEnd)
+                        owner.code[j].a = here();
+
+                    break;
+                }
+
+                case Node::Type::group:
+                    if (n.value >= 0)
+                    {
+                        emit (Op::save, n.value * 2);
+                        compileNode (*n.children.front());
+                        emit (Op::save, n.value * 2 + 1);
+                    }
+                    else
+                    {
+                        compileNode (*n.children.front());
+                    }
+
+                    break;
+
+                case Node::Type::repeat:
+                    compileRepeat (n);
+                    break;
+
+                case Node::Type::assertion:
+                    emit ((Op) n.value);
+                    break;
+
+                case Node::Type::backReference:
+                {
+                    auto group = n.value;
+
+                    if (group < 0)
+                    {
+                        group = owner.groupNames.indexOf (n.name);
+
+                        if (group <= 0)
+                            throw "Invalid regular expression /" + owner.source + "/: Invalid named reference";
+                    }
+
+                    emit (Op::backReference, group);
+                    break;
+                }
+
+                case Node::Type::lookahead:
+                {
+                    const auto start = emit (n.negated ? Op::negativeLookahead : Op::lookahead);
+                    compileNode (*n.children.front());
+                    emit (Op::lookEnd);
+                    owner.code[start].a = here();
+                    break;
+                }
+
+                default:
+                    jassertfalse;
+                    break;
+            }
+        }
+
+        void compileRepeat (const Node& n)
+        {
+            const auto& child = *n.children.front();
+
+            for (int i = 0; i < n.min; ++i)
+                compileNode (child);
+
+            if (n.max < 0)
+            {
+                // A loop whose body can match nothing gets stopped as soon as an iteration doesn't make progress.
+                const auto checksProgress = canBeEmpty (child);
+                const auto slot = owner.numGroups * 2 + numRegisters;
+
+                if (checksProgress)
+                    ++numRegisters;
+
+                const auto loopStart = here();
+                const auto split = emit (Op::split);
+                const auto body = here();
+
+                if (checksProgress)
+                    emit (Op::save, slot);
+
+                compileNode (child);
+
+                if (checksProgress)
+                    emit (Op::checkProgress, slot);
+
+                emit (Op::jump, loopStart);
+                setSplit (split, body, here(), n.greedy);
+                return;
+            }
+
+            std::vector<std::pair<size_t, int>> splits;
+
+            for (int i = n.min; i < n.max; ++i)
+            {
+                const auto split = emit (Op::split);
+                splits.emplace_back (split, here());
+                compileNode (child);
+            }
+
+            for (const auto& s : splits)
+                setSplit (s.first, s.second, here(), n.greedy);
+        }
+    };
+
+    //==============================================================================
+    enum
+    {
+        maximumProgramSize = 100000,
+        maximumRepeatCount = 100000,
+        stepsBetweenTimeoutChecks = 1 << 16
+    };
+
+    std::vector<Instruction> code;
+    std::vector<CharacterClass> classes;
+    StringArray groupNames;
+    int numGroups = 1, numSlots = 0;
+    juce_wchar firstCharacter = 0;
+    bool hasFirstCharacter = false, anchoredAtStart = false;
+
+    //==============================================================================
+    static bool isNewline (juce_wchar c) noexcept   { return c == '\n' || c == '\r' || c == 0x2028 || c == 0x2029; }
+    static bool isWordCharacter (juce_wchar c) noexcept { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_'; }
+    juce_wchar fold (juce_wchar c) const noexcept   { return ignoreCase ? CharacterFunctions::toLowerCase (c) : c; }
+
+    static void checkTimeOut()
+    {
+        if (auto* root = RootObject::getCurrent())
+            if (Time::getCurrentTime() > root->timeout)
+                throw String (root->timeout == Time() ? "Interrupted" : "Execution timed-out");
+    }
+
+    /** Runs the program from the given instruction, returning true if it reaches a match (or the end of a lookahead). */
+    bool run (const juce_wchar* text, int length, int pc, int pos, int* slots, int& steps, std::vector<Backtrack>& stack) const
+    {
+        const auto base = stack.size();
+
+        for (;;)
+        {
+            if (++steps >= stepsBetweenTimeoutChecks)
+            {
+                steps = 0;
+                checkTimeOut();
+            }
+
+            const auto& ins = code[(size_t) pc];
+            bool ok = true;
+
+            switch (ins.op)
+            {
+                case Op::character:
+                    ok = pos < length && fold (text[pos]) == (juce_wchar) ins.a;
+                    ++pos; ++pc;
+                    break;
+
+                case Op::any:
+                    ok = pos < length;
+                    ++pos; ++pc;
+                    break;
+
+                case Op::anyButNewline:
+                    ok = pos < length && ! isNewline (text[pos]);
+                    ++pos; ++pc;
+                    break;
+
+                case Op::characterClass:
+                    ok = pos < length && classes[(size_t) ins.a].contains (text[pos], ignoreCase);
+                    ++pos; ++pc;
+                    break;
+
+                case Op::split:
+                    stack.push_back ({ ins.b, pos, -1, 0 });
+                    pc = ins.a;
+                    break;
+
+                case Op::jump:
+                    pc = ins.a;
+                    break;
+
+                case Op::save:
+                    stack.push_back ({ -1, 0, ins.a, slots[ins.a] });
+                    slots[ins.a] = pos;
+                    ++pc;
+                    break;
+
+                case Op::checkProgress:
+                    ok = slots[ins.a] != pos;
+                    ++pc;
+                    break;
+
+                case Op::lineStart:         ok = pos == 0 || isNewline (text[pos - 1]); ++pc; break;
+                case Op::lineEnd:           ok = pos == length || isNewline (text[pos]); ++pc; break;
+                case Op::inputStart:        ok = pos == 0; ++pc; break;
+                case Op::inputEnd:          ok = pos == length; ++pc; break;
+
+                case Op::wordBoundary:
+                case Op::notWordBoundary:
+                {
+                    const auto before = pos > 0 && isWordCharacter (text[pos - 1]);
+                    const auto after = pos < length && isWordCharacter (text[pos]);
+                    ok = (before != after) == (ins.op == Op::wordBoundary);
+                    ++pc;
+                    break;
+                }
+
+                case Op::backReference:
+                {
+                    // References to groups that didn't take part in the match always succeed, matching nothing.
+                    if (ins.a < numGroups && slots[ins.a * 2] >= 0 && slots[ins.a * 2 + 1] >= 0)
+                    {
+                        const auto start = slots[ins.a * 2];
+                        const auto num = slots[ins.a * 2 + 1] - start;
+
+                        ok = pos + num <= length;
+
+                        for (int i = 0; ok && i < num; ++i)
+                            ok = fold (text[pos + i]) == fold (text[start + i]);
+
+                        pos += num;
+                    }
+
+                    ++pc;
+                    break;
+                }
+
+                case Op::lookahead:
+                case Op::negativeLookahead:
+                {
+                    const std::vector<int> saved (slots, slots + numSlots);
+                    const auto matched = run (text, length, pc + 1, pos, slots, steps, stack);
+
+                    if (ins.op == Op::lookahead)
+                    {
+                        ok = matched;
+
+                        // Lookaheads can't be backtracked into, but the captures they made still need undoing if the match backtracks past them.
+                        if (matched)
+                            for (int i = 0; i < numSlots; ++i)
+                                if (saved[(size_t) i] != slots[i])
+                                    stack.push_back ({ -1, 0, i, saved[(size_t) i] });
+                    }
+                    else
+                    {
+                        ok = ! matched;
+
+                        if (matched)
+                            std::copy (saved.begin(), saved.end(), slots);
+                    }
+
+                    pc = ins.a;
+                    break;
+                }
+
+                case Op::lookEnd:
+                case Op::match:
+                    stack.resize (base);
+                    return true;
+
+                default:
+                    jassertfalse;
+                    return false;
+            }
+
+            if (! ok)
+            {
+                for (;;)
+                {
+                    if (stack.size() == base)
+                        return false;
+
+                    const auto entry = stack.back();
+                    stack.pop_back();
+
+                    if (entry.pc >= 0)
+                    {
+                        pc = entry.pc;
+                        pos = entry.pos;
+                        break;
+                    }
+
+                    slots[entry.slot] = entry.value;
+                }
+            }
+        }
+    }
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (RegexProgram)
+};
+
+//==============================================================================
+/** Keeps the most recently used compiled expressions around, so that scripts
+    which build the same patterns over and over only pay for compiling them once.
+*/
+class RegexCache final
+{
+public:
+    RegexCache() = default;
+
+    /** @returns the compiled pattern, compiling it if it isn't in the cache. */
+    RegexProgram::Ptr get (const String& pattern, const String& flags)
+    {
+        const auto hash = pattern.hash() * 31 + flags.hash();
+
+        for (int i = 0; i < programs.size(); ++i)
+        {
+            auto* p = programs.getObjectPointerUnchecked (i);
+
+            if (p->hash == hash && p->source == pattern && p->flags == flags)
+            {
+                programs.move (i, 0);
+                return p;
+            }
+        }
+
+        RegexProgram::Ptr program;
+
+        {
+            static const Identifier traceName ("RegExp");
+            const ScriptTracer::ScopedEvent event (getCurrentTracer(), ScriptTracer::Category::compile, traceName);
+            program = new RegexProgram (pattern, flags);
+        }
+
+        // The flags get normalised, so this might be a different spelling of one we've already got.
+        if (program->flags == flags)
+        {
+            programs.insert (0, program);
+
+            if (programs.size() > maximumSize)
+                programs.removeLast();
+        }
+
+        return program;
+    }
+
+private:
+    enum { maximumSize = 64 };
+
+    static ScriptTracer* getCurrentTracer() noexcept
+    {
+        if (auto* root = RootObject::getCurrent())
+            return root->tracer.get();
+
+        return nullptr;
+    }
+
+    ReferenceCountedArray<RegexProgram> programs; // Most recently used first
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (RegexCache)
+};
+
+/** @returns a compiled pattern from the running engine's cache. */
+static RegexProgram::Ptr getCachedRegex (const String& pattern, const String& flags)
+{
+    if (auto* root = RootObject::getCurrent())
+        return root->getRegexCache().get (pattern, flags);
+
+    return new RegexProgram (pattern, flags);
+}
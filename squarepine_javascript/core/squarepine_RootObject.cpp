@@ -1,3 +1,57 @@
+ScriptObject::ScriptObject()
+{
+    if (auto* root = RootObject::getCurrent())
+    {
+        root->heap.add (*this);
+        SP_JS_COUNT (objectAllocations);
+    }
+}
+
+ScriptObject::~ScriptObject()
+{
+    if (heap != nullptr)
+        heap->remove (*this);
+}
+
+void ScriptObject::visitReferences (ReferenceVisitor& visitor)
+{
+    for (const auto& property : getProperties())
+        visitor.visit (property.value);
+}
+
+void ScriptObject::clearReferences()
+{
+    clear();
+}
+
+DynamicObject::Ptr ScriptObject::clone()
+{
+    DynamicObject::Ptr newObject (new ScriptObject());
+    newObject->getProperties() = getProperties();
+    newObject->cloneAllProperties();
+    return newObject;
+}
+
+//==============================================================================
+static thread_local RootObject* currentRoot = nullptr;
+
+RootObject* RootObject::getCurrent() noexcept
+{
+    return currentRoot;
+}
+
+RootObject::ScopedActivation::ScopedActivation (RootObject& root) noexcept :
+    previous (currentRoot)
+{
+    currentRoot = &root;
+}
+
+RootObject::ScopedActivation::~ScopedActivation() noexcept
+{
+    currentRoot = previous;
+}
+
+//==============================================================================
 RootObject::RootObject()
 {
     setMethod ("exec",                  exec);
@@ -17,6 +71,10 @@ RootObject::RootObject()
     setMethod ("escape",                encodeURIComponent);
     setMethod ("unescape",              decodeURIComponent);
     setMethod ("setTimeout",            setTimeout);
+    setMethod ("setInterval",           setInterval);
+    setMethod ("clearTimeout",          clearTimer);
+    setMethod ("clearInterval",         clearTimer);
+    setMethod ("queueMicrotask",        queueMicrotask);
 
     setProperty ("Infinity",            std::numeric_limits<double>::infinity());
     setProperty ("NaN",                 std::numeric_limits<double>::quiet_NaN());
@@ -35,11 +93,13 @@ RootObject::RootObject()
     registerNativeObject<BigIntClass>();
     registerNativeObject<DataViewClass>();
     registerNativeObject<DateClass>();
+    registerNativeObject<GeneratorClass>();
     registerNativeObject<JSONClass>();
     registerNativeObject<MapClass>();
     registerNativeObject<MathClass>();
     registerNativeObject<NumberClass>();
     registerNativeObject<ObjectClass>();
+    registerNativeObject<PromiseClass>();
     registerNativeObject<ProxyClass>();
     registerNativeObject<ReflectClass>();
     registerNativeObject<RegExpClass>();
@@ -51,21 +111,96 @@ RootObject::RootObject()
     registerNativeObject<XMLHttpRequestClass>();
 }
 
+RootObject::~RootObject()
+{
+}
+
+void RootObject::setArrayProperty (const var& array, const Identifier& name, const var& value)
+{
+    // Only JUCE versions whose var::getObject() hands back an array's container can tell arrays apart.
+    auto* container = array.getObject();
+
+    if (array.getArray() == nullptr || container == nullptr)
+        return;
+
+    auto& entry = arrayProperties[container];
+    entry.array = array;
+    entry.properties.set (name, value);
+
+    if (arrayProperties.size() >= arrayPropertiesSweepThreshold)
+    {
+        for (auto iter = arrayProperties.begin(); iter != arrayProperties.end();)
+        {
+            if (iter->first->getReferenceCount() <= 1)
+                iter = arrayProperties.erase (iter);
+            else
+                ++iter;
+        }
+
+        arrayPropertiesSweepThreshold = jmax ((size_t) 16, arrayProperties.size() * 2);
+    }
+}
+
+const var* RootObject::findArrayProperty (const var& array, const Identifier& name) const
+{
+    if (arrayProperties.empty())
+        return nullptr;
+
+    const auto iter = arrayProperties.find (array.getObject());
+
+    if (iter == arrayProperties.end())
+        return nullptr;
+
+    return iter->second.properties.getVarPointer (name);
+}
+
+RegexCache& RootObject::getRegexCache()
+{
+    if (regexCache == nullptr)
+        regexCache.reset (new RegexCache());
+
+    return *regexCache;
+}
+
+ConsoleLog& RootObject::getConsoleLog()
+{
+    if (consoleLog == nullptr)
+        consoleLog = new ConsoleLog();
+
+    return *consoleLog;
+}
+
 //==============================================================================
-void RootObject::execute (const String& code)
+static const Identifier& getProgramTraceName()
 {
-    ExpressionTreeBuilder tb (code);
-    std::unique_ptr<BlockStatement> (tb.parseStatementList())
-        ->perform (Scope ({}, *this, *this), nullptr);
+    static const Identifier name ("(program)");
+    return name;
 }
 
-var RootObject::evaluate (const String& code)
+void RootObject::execute (const String& code)
 {
-    ExpressionTreeBuilder tb (code);
-    return ExpPtr (tb.parseExpression())->getResult (Scope ({}, *this, *this));
+    std::unique_ptr<BlockStatement> statements;
+
+    {
+        const ScriptTracer::ScopedEvent event (tracer.get(), ScriptTracer::Category::parse, getProgramTraceName());
+        ExpressionTreeBuilder tb (code);
+        statements.reset (tb.parseStatementList());
+    }
+
+    const ScriptTracer::ScopedEvent event (tracer.get(), ScriptTracer::Category::script, getProgramTraceName());
+    statements->perform (Scope ({}, *this, *this), nullptr);
 }
 
-void RootObject::setTimeoutInternal (const String&)
+var RootObject::evaluate (const String& code)
 {
-    //timeout = a;
+    ExpPtr expression;
+
+    {
+        const ScriptTracer::ScopedEvent event (tracer.get(), ScriptTracer::Category::parse, getProgramTraceName());
+        ExpressionTreeBuilder tb (code);
+        expression.reset (tb.parseExpression());
+    }
+
+    const ScriptTracer::ScopedEvent event (tracer.get(), ScriptTracer::Category::script, getProgramTraceName());
+    return expression->getResult (Scope ({}, *this, *this));
 }
@@ -1,6 +1,82 @@
+//==============================================================================
+/** The base class of every object a script creates or is handed by the engine.
+
+    Unlike plain DynamicObjects, script objects can be referred to weakly, which
+    is what allows the likes of WeakMap and WeakSet to hold on to them without
+    keeping them alive.
+
+    Script objects created while an engine is running are tracked by that engine's
+    ScriptHeap, so that any reference cycles between them can be collected.
+*/
+class ScriptObject : public DynamicObject
+{
+public:
+    /** Creates an object, tracked by the heap of the engine running on this thread if there is one. */
+    ScriptObject();
+    /** */
+    ~ScriptObject() override;
+
+    //==============================================================================
+    /** Gets handed every value a script object holds on to. */
+    struct ReferenceVisitor
+    {
+        virtual ~ReferenceVisitor() = default;
+        virtual void visit (const var&) = 0;
+
+        /** @returns true if a value that's held against a weakly-held key, like a WeakMap's,
+            should be visited.
+
+            That's always the case apart from when the collector is marking what's reachable,
+            as an entry's value is only reachable through its key.
+        */
+        virtual bool shouldVisitValueOf (const ScriptObject& /*weakKey*/) { return true; }
+    };
+
+    /** Passes every value this object refers to over to the visitor.
+
+        Subclasses that keep values outside of their properties must override this,
+        otherwise the cycle collector won't be able to see them.
+    */
+    virtual void visitReferences (ReferenceVisitor&);
+
+    /** Drops every value this object refers to.
+
+        The cycle collector calls this to break the cycles of objects it has found
+        to be garbage, so subclasses that override visitReferences() should release
+        those same values here.
+    */
+    virtual void clearReferences();
+
+    /** Lets go of whatever this object holds against other objects that have since been deleted.
+
+        The cycle collector calls this at the start of each collection, for classes that hold
+        objects weakly, like WeakMap. Any values that get dropped must be moved into the array
+        rather than released, since releasing them could delete objects while the heap is being walked.
+    */
+    virtual void removeDeadWeakReferences (Array<var>& /*releasedValues*/) {}
+
+    //==============================================================================
+    /** @internal */
+    DynamicObject::Ptr clone() override;
+
+private:
+    //==============================================================================
+    friend class ScriptHeap;
+
+    ScriptHeap* heap = nullptr;
+    ScriptObject* previousInHeap = nullptr;
+    ScriptObject* nextInHeap = nullptr;
+    int collectorRefs = 0;
+    bool collectorReachable = false;
+
+    //==============================================================================
+    JUCE_DECLARE_WEAK_REFERENCEABLE (ScriptObject)
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ScriptObject)
+};
+
 //==============================================================================
 /** */
-class JavascriptClass : public DynamicObject
+class JavascriptClass : public ScriptObject
 {
 public:
     /** */
@@ -9,10 +85,18 @@ public:
     /** Basically operator===() for JS. */
     virtual bool areSameValue (const var&) { return false; }
 
+    /** Writes the object as an empty one, as JSON.stringify() does for the likes of a RegExp or a Map,
+        rather than giving away the properties and methods that it's implemented with.
+        Classes that have a JSON form of their own, like Date, override this.
+    */
+    void writeAsJSON (OutputStream& out, int, bool, int) override { out << "{}"; }
+
 private:
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (JavascriptClass)
 };
 
+class RegexCache;
+
 //==============================================================================
 /** */
 class RootObject final : public DynamicObject
@@ -20,6 +104,24 @@ class RootObject final : public DynamicObject
 public:
     /** */
     RootObject();
+    /** */
+    ~RootObject() override;
+
+    //==============================================================================
+    /** @returns the root of the engine that is running on the calling thread, if any. */
+    static RootObject* getCurrent() noexcept;
+
+    /** Makes a root the current one for the calling thread, for as long as this object lives. */
+    struct ScopedActivation final
+    {
+        ScopedActivation (RootObject&) noexcept;
+        ~ScopedActivation() noexcept;
+
+    private:
+        RootObject* const previous;
+
+        JUCE_DECLARE_NON_COPYABLE (ScopedActivation)
+    };
 
     //==============================================================================
     /** */
@@ -28,12 +130,59 @@ public:
     var evaluate (const String& code);
 
     //==============================================================================
-    // @todo timers and stuff
-    // https://www.w3schools.com/jsref/met_win_settimeout.asp
-    // https://www.w3schools.com/jsref/met_win_cleartimeout.asp
-    // https://www.w3schools.com/jsref/met_win_clearinterval.asp
-    OwnedArray<Timer> timers;
     Time timeout;
+    ScriptHeap heap { *this };
+    EventLoop eventLoop;
+    std::unique_ptr<ScriptProfiler> profiler;
+    ScriptTracer::Ptr tracer;
+    ScriptCoverage::Ptr coverage;
+    InstrumentationCounters counters;
+
+    /** The string that a `+=` last appended to, and its length in bytes, so that
+        appending to it again doesn't mean measuring it. Whatever appends to it lets
+        go of this first, so it never stops the string being appended to in place.
+    */
+    struct LastAppend
+    {
+        String text;
+        size_t numBytes = 0;
+    };
+
+    LastAppend lastAppend;
+
+    /** This engine's own copy of the prototype of a class exposed with a ClassBinding.
+
+        A ClassBinding can be shared by several engines, so each of them gets a copy of
+        its methods to hand to scripts, rather than the class's own object, which
+        would let a script in one engine change the methods that another one sees.
+    */
+    struct BoundPrototype
+    {
+        ReferenceCountedObjectPtr<ReferenceCountedObject> boundClass; // Keeps the class alive, so that its address can't be reused by another one.
+        var prototype;
+    };
+
+    std::map<const ReferenceCountedObject*, BoundPrototype> boundPrototypes;
+
+    /** Gives an array a named property, like the index and input of a RegExp match.
+
+        An array is a plain Array<var>, with nowhere to keep any properties of its own, so
+        these are kept here instead, keyed on the array. Each entry holds on to its array,
+        and the entries whose arrays nothing else is using are swept out whenever the table
+        has doubled in size since it was last swept.
+    */
+    void setArrayProperty (const var& array, const Identifier& name, const var& value);
+
+    /** @returns a property given to an array by setArrayProperty(), or nullptr if it doesn't have one by that name. */
+    const var* findArrayProperty (const var& array, const Identifier& name) const;
+
+    /** @returns the cache of compiled regular expressions used by this engine. */
+    RegexCache& getRegexCache();
+
+    /** @returns the log that the console writes to, creating one if the host hasn't set it. */
+    ConsoleLog& getConsoleLog();
+    /** */
+    void setConsoleLog (ConsoleLog::Ptr newLog) noexcept    { consoleLog = std::move (newLog); }
 
     //==============================================================================
     template<typename RootClass>
@@ -42,9 +191,20 @@ public:
         setProperty (RootClass::getClassName(), new RootClass());
     }
 
-    void setTimeoutInternal (const String&);
-
 private:
+    //==============================================================================
+    std::unique_ptr<RegexCache> regexCache;
+    ConsoleLog::Ptr consoleLog;
+
+    struct ArrayProperties
+    {
+        var array;
+        NamedValueSet properties;
+    };
+
+    std::unordered_map<const ReferenceCountedObject*, ArrayProperties> arrayProperties;
+    size_t arrayPropertiesSweepThreshold = 16;
+
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (RootObject)
 };
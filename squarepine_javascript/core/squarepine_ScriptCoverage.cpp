@@ -0,0 +1,241 @@
+//==============================================================================
+ScriptCoverage::Source::Source (const String& c, const String& n) :
+    code (c),
+    name (n)
+{
+}
+
+ScriptCoverage::Slot& ScriptCoverage::Source::getSlot (std::map<int, Slot*>& slotsByOffset, int offset, bool isBranch)
+{
+    const ScopedLock sl (lock);
+    const auto iter = slotsByOffset.find (offset);
+
+    if (iter != slotsByOffset.end())
+        return *iter->second;
+
+    slots.emplace_back (offset, isBranch);
+    slotsByOffset[offset] = &slots.back();
+    return slots.back();
+}
+
+ScriptCoverage::Slot& ScriptCoverage::Source::getStatementSlot (int offset)
+{
+    return getSlot (statementSlots, offset, false);
+}
+
+ScriptCoverage::Slot& ScriptCoverage::Source::getBranchSlot (int offset)
+{
+    return getSlot (branchSlots, offset, true);
+}
+
+//==============================================================================
+ScriptCoverage::Source::Ptr ScriptCoverage::getSource (const String& code)
+{
+    const ScopedLock sl (lock);
+    auto& source = sources[code];
+
+    if (source == nullptr)
+        source = new Source (code, "script-" + String::toHexString (code.hashCode64()));
+
+    return source;
+}
+
+void ScriptCoverage::setSourceName (const String& code, const String& name)
+{
+    auto source = getSource (code);
+    const ScopedLock sl (source->lock);
+    source->name = name;
+}
+
+void ScriptCoverage::reset()
+{
+    const ScopedLock sl (lock);
+
+    for (auto& iter : sources)
+    {
+        const ScopedLock sourceLock (iter.second->lock);
+
+        for (auto& slot : iter.second->slots)
+            for (auto& count : slot.counts)
+                count.store (0, std::memory_order_relaxed);
+    }
+}
+
+//==============================================================================
+ScriptCoverage::Snapshot ScriptCoverage::createSnapshot() const
+{
+    Snapshot snapshot;
+    const ScopedLock sl (lock);
+
+    for (const auto& iter : sources)
+    {
+        const auto& source = *iter.second;
+        const ScopedLock sourceLock (source.lock);
+
+        std::vector<const Slot*> sortedSlots;
+
+        for (const auto& slot : source.slots)
+            sortedSlots.push_back (&slot);
+
+        std::sort (sortedSlots.begin(), sortedSlots.end(),
+                   [] (const Slot* a, const Slot* b) { return a->offset < b->offset; });
+
+        SourceSnapshot sourceSnapshot;
+        sourceSnapshot.name = source.name;
+
+        // The slots are in order, so the lines and columns can all be found in one pass over the code.
+        auto* const start = source.code.toRawUTF8();
+        int position = 0, line = 1, column = 1;
+
+        for (const auto* slot : sortedSlots)
+        {
+            for (; position < slot->offset && start[position] != 0; ++position)
+            {
+                if (start[position] == '\n')
+                {
+                    ++line;
+                    column = 1;
+                }
+                else if ((start[position] & 0xc0) != 0x80)
+                {
+                    ++column;
+                }
+            }
+
+            if (slot->isBranch)
+                sourceSnapshot.branches.push_back ({ line, column,
+                                                     (int64) slot->counts[0].load (std::memory_order_relaxed),
+                                                     (int64) slot->counts[1].load (std::memory_order_relaxed) });
+            else
+                sourceSnapshot.statements.push_back ({ line, column, (int64) slot->counts[0].load (std::memory_order_relaxed) });
+        }
+
+        snapshot.sources.push_back (std::move (sourceSnapshot));
+    }
+
+    return snapshot;
+}
+
+//==============================================================================
+namespace CoverageHelpers
+{
+    /** @returns the count of each line that has a statement on it, which is the highest count of those statements. */
+    static std::map<int, int64> getLineCounts (const ScriptCoverage::SourceSnapshot& source)
+    {
+        std::map<int, int64> lineCounts;
+
+        for (const auto& statement : source.statements)
+        {
+            auto& count = lineCounts[statement.line];
+            count = jmax (count, statement.count);
+        }
+
+        return lineCounts;
+    }
+
+    static int getNumLinesHit (const std::map<int, int64>& lineCounts)
+    {
+        int numHit = 0;
+
+        for (const auto& iter : lineCounts)
+            if (iter.second > 0)
+                ++numHit;
+
+        return numHit;
+    }
+
+    static int getNumBranchesHit (const ScriptCoverage::SourceSnapshot& source)
+    {
+        int numHit = 0;
+
+        for (const auto& branch : source.branches)
+            numHit += (branch.taken > 0 ? 1 : 0) + (branch.notTaken > 0 ? 1 : 0);
+
+        return numHit;
+    }
+}
+
+String ScriptCoverage::Snapshot::toLCOV() const
+{
+    using namespace CoverageHelpers;
+
+    MemoryOutputStream mo;
+
+    for (const auto& source : sources)
+    {
+        mo << "TN:" << exportLineEnd << "SF:" << source.name << exportLineEnd;
+
+        for (size_t i = 0; i < source.branches.size(); ++i)
+        {
+            const auto& branch = source.branches[i];
+
+            // A branch that was never reached at all gets a '-' rather than a count.
+            const auto wasReached = branch.taken > 0 || branch.notTaken > 0;
+            const auto prefix = "BRDA:" + String (branch.line) + "," + String ((int) i) + ",";
+
+            mo << prefix << "0," << (wasReached ? String (branch.taken) : String ("-")) << exportLineEnd
+               << prefix << "1," << (wasReached ? String (branch.notTaken) : String ("-")) << exportLineEnd;
+        }
+
+        mo << "BRF:" << String ((int) source.branches.size() * 2) << exportLineEnd
+           << "BRH:" << String (getNumBranchesHit (source)) << exportLineEnd;
+
+        const auto lineCounts = getLineCounts (source);
+
+        for (const auto& iter : lineCounts)
+            mo << "DA:" << String (iter.first) << "," << String (iter.second) << exportLineEnd;
+
+        mo << "LF:" << String ((int) lineCounts.size()) << exportLineEnd
+           << "LH:" << String (getNumLinesHit (lineCounts)) << exportLineEnd
+           << "end_of_record" << exportLineEnd;
+    }
+
+    return mo.toString();
+}
+
+var ScriptCoverage::Snapshot::toVar() const
+{
+    using namespace CoverageHelpers;
+
+    Array<var> sourceList;
+
+    for (const auto& source : sources)
+    {
+        Array<var> statementList, branchList;
+
+        for (const auto& statement : source.statements)
+        {
+            DynamicObject::Ptr o (new DynamicObject());
+            o->setProperty ("line", statement.line);
+            o->setProperty ("column", statement.column);
+            o->setProperty ("count", statement.count);
+            statementList.add (o.get());
+        }
+
+        for (const auto& branch : source.branches)
+        {
+            DynamicObject::Ptr o (new DynamicObject());
+            o->setProperty ("line", branch.line);
+            o->setProperty ("column", branch.column);
+            o->setProperty ("taken", branch.taken);
+            o->setProperty ("notTaken", branch.notTaken);
+            branchList.add (o.get());
+        }
+
+        const auto lineCounts = getLineCounts (source);
+
+        DynamicObject::Ptr o (new DynamicObject());
+        o->setProperty ("name", source.name);
+        o->setProperty ("statements", statementList);
+        o->setProperty ("branches", branchList);
+        o->setProperty ("linesFound", (int) lineCounts.size());
+        o->setProperty ("linesHit", getNumLinesHit (lineCounts));
+        o->setProperty ("branchesFound", (int) source.branches.size() * 2);
+        o->setProperty ("branchesHit", getNumBranchesHit (source));
+        sourceList.add (o.get());
+    }
+
+    DynamicObject::Ptr result (new DynamicObject());
+    result->setProperty ("sources", sourceList);
+    return result.get();
+}
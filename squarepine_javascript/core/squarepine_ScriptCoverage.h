@@ -0,0 +1,154 @@
+//==============================================================================
+/** Counts how many times each statement of a script runs, and which way each of
+    its branches goes, so that code that never runs can be found.
+
+    When an engine is collecting coverage, the parser gives each statement, and
+    each if, ?:, && and || it comes across, a slot of counters here. The syntax tree
+    keeps a pointer to its node's slot, so counting a run is a null check and an
+    increment, with no lookups. Code that was parsed before coverage was switched
+    on doesn't get any slots, and isn't counted.
+
+    Scripts are told apart by their code, so running the same code again counts into
+    the same slots rather than adding new ones. Since a script's slots are kept for
+    as long as the coverage is, a host that evaluates lots of one-off expressions
+    will keep growing its coverage.
+
+    The engine counts on its own thread, while any other thread can take a snapshot
+    at the same time, eg: to export the coverage of a long-running process.
+
+    @see JavascriptEngine::setCoverageEnabled
+*/
+class ScriptCoverage final : public ReferenceCountedObject
+{
+public:
+    //==============================================================================
+    /** */
+    using Ptr = ReferenceCountedObjectPtr<ScriptCoverage>;
+
+    /** */
+    ScriptCoverage() = default;
+
+    //==============================================================================
+    /** The counts of one statement, or of the two ways that one branch can go. */
+    struct Slot final
+    {
+        /** */
+        Slot (int offsetInCode, bool branch) noexcept : offset (offsetInCode), isBranch (branch) {}
+
+        const int offset;                       /**< Where the statement or branch is in its code, in bytes. */
+        const bool isBranch;                    /**< True for a branch, false for a statement. */
+        std::atomic<uint32> counts[2] = {};     /**< A statement's runs, or the times a branch was taken and not taken. */
+    };
+
+    /** Bumps one of a slot's counts, if there is a slot.
+
+        Only the engine's thread ever writes to the counts, so this is a plain
+        increment rather than a locked one.
+    */
+    static void hit (Slot* slot, int index = 0) noexcept
+    {
+        if (slot != nullptr)
+        {
+            auto& count = slot->counts[index];
+            count.store (count.load (std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+    }
+
+    //==============================================================================
+    /** The code of a script, and the slots of its statements and branches. */
+    class Source final : public ReferenceCountedObject
+    {
+    public:
+        /** */
+        using Ptr = ReferenceCountedObjectPtr<Source>;
+
+        /** */
+        Source (const String& code, const String& name);
+
+        /** @returns the slot of the statement at an offset in the code, adding one if it's new. */
+        Slot& getStatementSlot (int offset);
+        /** @returns the slot of the branch at an offset in the code, adding one if it's new. */
+        Slot& getBranchSlot (int offset);
+
+        /** */
+        const String code;
+
+    private:
+        friend class ScriptCoverage;
+
+        String name;
+        mutable CriticalSection lock;
+        // The slots never move once they've been added, as the syntax tree points to them.
+        std::deque<Slot> slots;
+        std::map<int, Slot*> statementSlots, branchSlots;
+
+        Slot& getSlot (std::map<int, Slot*>&, int offset, bool isBranch);
+
+        JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (Source)
+    };
+
+    /** @returns the counters of a script's code, adding them if they're new.
+
+        This is called by the parser, on the engine's thread.
+    */
+    Source::Ptr getSource (const String& code);
+
+    /** Names a script's code, so that it shows up as a file with that name in
+        the exported coverage, rather than as a hash of its code.
+    */
+    void setSourceName (const String& code, const String& name);
+
+    /** Sets all of the counts back to zero, leaving the slots where they are. */
+    void reset();
+
+    //==============================================================================
+    /** How many times the statement at some line and column ran. */
+    struct StatementCount
+    {
+        int line = 0, column = 0;
+        int64 count = 0;
+    };
+
+    /** How many times the branch at some line and column went each way. */
+    struct BranchCount
+    {
+        int line = 0, column = 0;
+        int64 taken = 0, notTaken = 0;
+    };
+
+    /** A copy of the counts of one script, sorted by where they are in its code. */
+    struct SourceSnapshot
+    {
+        String name;
+        std::vector<StatementCount> statements;
+        std::vector<BranchCount> branches;
+    };
+
+    /** A copy of all of the counts, taken at some point in time. */
+    struct Snapshot
+    {
+        std::vector<SourceSnapshot> sources;
+
+        /** @returns the line and branch coverage in the LCOV tracefile format,
+            which genhtml and most coverage services can read.
+
+            Where a line has more than one statement on it, the line's count is
+            that of the one that ran the most.
+        */
+        String toLCOV() const;
+
+        /** @returns the statement and branch counts as an object, ready to be written out as JSON. */
+        var toVar() const;
+    };
+
+    /** Copies out all of the counts. This can be called from any thread. */
+    Snapshot createSnapshot() const;
+
+private:
+    //==============================================================================
+    mutable CriticalSection lock;
+    std::map<String, Source::Ptr> sources;
+
+    //==============================================================================
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ScriptCoverage)
+};
@@ -0,0 +1,380 @@
+ScriptHeap::ScriptHeap (DynamicObject& o) noexcept :
+    owner (o)
+{
+}
+
+ScriptHeap::~ScriptHeap()
+{
+    for (auto* o = first; o != nullptr;)
+    {
+        auto* next = o->nextInHeap;
+        o->heap = nullptr;
+        o->previousInHeap = nullptr;
+        o->nextInHeap = nullptr;
+        o = next;
+    }
+}
+
+//==============================================================================
+void ScriptHeap::add (ScriptObject& o) noexcept
+{
+    jassert (o.heap == nullptr);
+
+    o.heap = this;
+    o.previousInHeap = nullptr;
+    o.nextInHeap = first;
+
+    if (first != nullptr)
+        first->previousInHeap = &o;
+
+    first = &o;
+    ++numObjects;
+    ++numAllocationsSinceCollection;
+    numBytesInUse += (int64) sizeof (ScriptObject);
+    peakNumBytes = jmax (peakNumBytes, numBytesInUse);
+}
+
+void ScriptHeap::remove (ScriptObject& o) noexcept
+{
+    jassert (o.heap == this);
+
+    if (o.previousInHeap != nullptr)
+        o.previousInHeap->nextInHeap = o.nextInHeap;
+    else
+        first = o.nextInHeap;
+
+    if (o.nextInHeap != nullptr)
+        o.nextInHeap->previousInHeap = o.previousInHeap;
+
+    o.heap = nullptr;
+    o.previousInHeap = nullptr;
+    o.nextInHeap = nullptr;
+    --numObjects;
+    numBytesInUse -= (int64) sizeof (ScriptObject);
+}
+
+//==============================================================================
+bool ScriptHeap::isTracking (const ScriptObject& o) const noexcept  { return o.heap == this; }
+int& ScriptHeap::getCollectorRefs (ScriptObject& o) noexcept        { return o.collectorRefs; }
+bool& ScriptHeap::getReachableFlag (ScriptObject& o) noexcept       { return o.collectorReachable; }
+bool ScriptHeap::isMarkedReachable (const ScriptObject& o) noexcept { return o.collectorReachable; }
+
+/** Arrays are shared by reference, so they can be part of a cycle too.
+
+    Their reference counts are only visible if var::getObject() exposes the
+    container (which depends on the JUCE version). If it doesn't, the values
+    inside an array are treated as being held from outside of the heap,
+    which is safe but means cycles that go through arrays won't be collected.
+*/
+struct ScriptHeap::ArrayNode
+{
+    Array<var>* array = nullptr;
+    int refs = 0;
+    bool reachable = false;
+};
+
+/** Subtracts the references held by tracked objects from the things they refer to. */
+struct ScriptHeap::SubtractionVisitor final : public ScriptObject::ReferenceVisitor
+{
+    SubtractionVisitor (const ScriptHeap& h, ArrayNodes& a) noexcept : heap (h), arrays (a) {}
+
+    void visit (const var& v) override
+    {
+        if (auto* array = v.getArray())
+        {
+            if (auto* container = v.getObject())
+            {
+                const auto result = arrays.emplace (container, ArrayNode { array, container->getReferenceCount(), false });
+                --result.first->second.refs;
+
+                if (result.second)
+                    for (const auto& element : *array)
+                        visit (element);
+            }
+
+            return;
+        }
+
+        if (auto* o = dynamic_cast<ScriptObject*> (v.getObject()))
+            if (heap.isTracking (*o))
+                --getCollectorRefs (*o);
+    }
+
+    const ScriptHeap& heap;
+    ArrayNodes& arrays;
+};
+
+/** Marks everything that can be reached from the objects that are held from outside of the heap.
+
+    A value held against a weak key, like a WeakMap's, is only followed once its key has been
+    marked, so a key that's only reachable through its own value doesn't keep itself alive.
+    The objects that had values skipped like this are remembered, so that they can be visited
+    again once more of the heap has been marked.
+*/
+struct ScriptHeap::MarkingVisitor final : public ScriptObject::ReferenceVisitor
+{
+    MarkingVisitor (const ScriptHeap& h, ArrayNodes& a) noexcept : heap (h), arrays (a) {}
+
+    void visit (const var& v) override
+    {
+        if (v.getArray() != nullptr)
+        {
+            if (auto* container = v.getObject())
+            {
+                const auto iter = arrays.find (container);
+
+                if (iter != arrays.end())
+                    markArray (iter->second);
+            }
+
+            return;
+        }
+
+        if (auto* o = dynamic_cast<ScriptObject*> (v.getObject()))
+            if (heap.isTracking (*o))
+                markObject (*o);
+    }
+
+    bool shouldVisitValueOf (const ScriptObject& key) override
+    {
+        if (! heap.isTracking (key) || isMarkedReachable (key))
+            return true;
+
+        if (! visitingHasSkippedValues)
+        {
+            visitingHasSkippedValues = true;
+            objectsWithSkippedValues.push_back (visiting);
+        }
+
+        return false;
+    }
+
+    void markObject (ScriptObject& o)
+    {
+        auto& reachable = getReachableFlag (o);
+
+        if (! reachable)
+        {
+            reachable = true;
+            pending.push_back (&o);
+        }
+    }
+
+    void markArray (ArrayNode& node)
+    {
+        if (! node.reachable)
+        {
+            node.reachable = true;
+
+            for (const auto& element : *node.array)
+                visit (element);
+        }
+    }
+
+    void propagate()
+    {
+        while (! pending.empty())
+        {
+            auto* o = pending.back();
+            pending.pop_back();
+            visitReferencesOf (*o);
+        }
+    }
+
+    /** Marks everything reachable, including the values of weak keys that turn out to be reachable.
+
+        Marking a value can make the keys of other entries reachable, so the objects with skipped
+        values keep being visited again until a pass over them doesn't mark anything new.
+    */
+    void propagateToFixedPoint()
+    {
+        propagate();
+
+        while (! objectsWithSkippedValues.empty())
+        {
+            auto objects = std::move (objectsWithSkippedValues);
+            objectsWithSkippedValues.clear();
+
+            for (auto* o : objects)
+                visitReferencesOf (*o);
+
+            if (pending.empty())
+                break;
+
+            propagate();
+        }
+    }
+
+    void visitReferencesOf (ScriptObject& o)
+    {
+        visiting = &o;
+        visitingHasSkippedValues = false;
+        o.visitReferences (*this);
+    }
+
+    const ScriptHeap& heap;
+    ArrayNodes& arrays;
+    std::vector<ScriptObject*> pending, objectsWithSkippedValues;
+    ScriptObject* visiting = nullptr;
+    bool visitingHasSkippedValues = false;
+};
+
+void ScriptHeap::removeDeadWeakReferences()
+{
+    Array<var> releasedValues;
+
+    for (auto* o = first; o != nullptr; o = o->nextInHeap)
+        o->removeDeadWeakReferences (releasedValues);
+}
+
+int ScriptHeap::collect()
+{
+    const auto startTimeMs = Time::getMillisecondCounterHiRes();
+
+    // Done first, so that anything that was only being kept alive by an entry of a dead key can be collected now.
+    removeDeadWeakReferences();
+
+    std::vector<ScriptObject*> objects;
+    objects.reserve ((size_t) numObjects);
+
+    for (auto* o = first; o != nullptr; o = o->nextInHeap)
+    {
+        o->collectorRefs = o->getReferenceCount();
+        o->collectorReachable = false;
+        objects.push_back (o);
+    }
+
+    ArrayNodes arrays;
+
+    {
+        SubtractionVisitor subtractor (*this, arrays);
+
+        for (auto* o : objects)
+            o->visitReferences (subtractor);
+    }
+
+    {
+        MarkingVisitor marker (*this, arrays);
+
+        // Anything with no references at all is still being constructed,
+        // so it has to be left alone too.
+        for (auto* o : objects)
+            if (getCollectorRefs (*o) > 0 || o->getReferenceCount() == 0)
+                marker.markObject (*o);
+
+        for (auto& a : arrays)
+            if (a.second.refs > 0)
+                marker.markArray (a.second);
+
+        marker.propagateToFixedPoint();
+    }
+
+    // Everything left unmarked is garbage. It all gets held onto until every cycle
+    // has been broken, so that nothing gets deleted out from under us along the way.
+    ReferenceCountedArray<ScriptObject> garbage;
+    std::vector<ReferenceCountedObjectPtr<ReferenceCountedObject>> garbageContainers;
+    std::vector<Array<var>*> garbageArrays;
+
+    for (auto* o : objects)
+        if (! getReachableFlag (*o))
+            garbage.add (o);
+
+    for (auto& a : arrays)
+    {
+        if (! a.second.reachable)
+        {
+            garbageContainers.emplace_back (const_cast<ReferenceCountedObject*> (a.first));
+            garbageArrays.push_back (a.second.array);
+        }
+    }
+
+    for (auto* array : garbageArrays)
+        array->clear();
+
+    for (auto* o : garbage)
+        o->clearReferences();
+
+    const auto numReclaimed = garbage.size();
+    garbage.clear();
+    garbageContainers.clear();
+
+    // The keys that were garbage have gone now, so their entries can go too.
+    removeDeadWeakReferences();
+
+    numSurvivors = numObjects;
+    numAllocationsSinceCollection = 0;
+    measure();
+
+    const auto pauseMs = Time::getMillisecondCounterHiRes() - startTimeMs;
+
+    statistics.numTrackedObjects = numObjects;
+    statistics.lastNumObjectsReclaimed = numReclaimed;
+    statistics.numObjectsReclaimed += numReclaimed;
+    statistics.numCollections++;
+    statistics.lastPauseMs = pauseMs;
+    statistics.maximumPauseMs = jmax (statistics.maximumPauseMs, pauseMs);
+    statistics.totalPauseMs += pauseMs;
+
+    return numReclaimed;
+}
+
+//==============================================================================
+/** Adds up the memory used by strings and arrays, counting any shared ones only once. */
+struct ScriptHeap::MeasuringVisitor final : public ScriptObject::ReferenceVisitor
+{
+    void visit (const var& v) override
+    {
+        if (v.isString())
+        {
+            const auto s = v.toString();
+
+            if (seen.insert (s.getCharPointer().getAddress()).second)
+                numBytes += (int64) (sizeof (String) * 2 + s.getNumBytesAsUTF8() + 1);
+        }
+        else if (auto* array = v.getArray())
+        {
+            if (seen.insert (array).second)
+            {
+                numBytes += (int64) (sizeof (Array<var>) + sizeof (var) * (size_t) array->size());
+
+                for (const auto& element : *array)
+                    visit (element);
+            }
+        }
+    }
+
+    std::unordered_set<const void*> seen;
+    int64 numBytes = 0;
+};
+
+int64 ScriptHeap::measure()
+{
+    MeasuringVisitor measurer;
+
+    const auto propertySize = (int64) sizeof (NamedValueSet::NamedValue);
+
+    for (auto* o = first; o != nullptr; o = o->nextInHeap)
+    {
+        measurer.numBytes += (int64) sizeof (ScriptObject) + propertySize * o->getProperties().size();
+        o->visitReferences (measurer);
+    }
+
+    for (const auto& property : owner.getProperties())
+        measurer.visit (property.value);
+
+    numBytesInUse = measurer.numBytes;
+    return numBytesInUse;
+}
+
+void ScriptHeap::reclaimOrThrow (int64 numBytesRequested)
+{
+    collect();
+
+    numBytesInUse += numBytesRequested;
+
+    if (numBytesInUse > maximumNumBytes)
+    {
+        numBytesInUse -= numBytesRequested;
+        throw String ("Out of memory: the heap limit of ") + String (maximumNumBytes) + " bytes was exceeded";
+    }
+}
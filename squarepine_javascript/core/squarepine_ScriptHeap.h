@@ -0,0 +1,142 @@
+class ScriptObject;
+
+//==============================================================================
+/** Keeps track of the script objects an engine has allocated, and reclaims the
+    ones that are only being kept alive by reference cycles.
+
+    Script values are reference-counted, so anything caught in a cycle
+    (eg: `obj.self = obj`, or parent/child links) would otherwise never be freed.
+
+    The collector is a synchronous trial-deletion one: for every tracked object,
+    the references held by other tracked objects are subtracted from its reference count.
+    Whatever still has references left over is being held from outside of the heap
+    (ie: the root namespace, the native stack, or the host application), and anything
+    that can't be reached from those objects is garbage. Garbage has its properties
+    cleared, which breaks the cycles and lets reference counting take care of the rest.
+
+    The entries of a WeakMap are treated as ephemerons: a value is only marked as
+    reachable once its key has been, so a key that's only referred to by its own value
+    (or by anything else that the value holds) gets collected along with its entry.
+
+    The heap also keeps an estimate of how many bytes the scripts are using, so
+    that an upper limit can be enforced. Allocations are accounted for as they happen,
+    which is cheap but can't see memory being released; whenever the estimate goes over
+    the limit, the heap is collected and measured to find out the real figure.
+
+    Like the rest of the engine, this isn't thread-safe: script objects are expected
+    to be created and released on the thread that runs the engine.
+*/
+class ScriptHeap final
+{
+public:
+    /** Creates a heap for the objects of an engine.
+
+        @param owner    The engine's root namespace. Its properties are
+                        included in the heap's measurements.
+    */
+    ScriptHeap (DynamicObject& owner) noexcept;
+    /** Detaches any objects that outlive the heap. */
+    ~ScriptHeap();
+
+    //==============================================================================
+    /** */
+    struct Statistics
+    {
+        int numTrackedObjects = 0;
+        int lastNumObjectsReclaimed = 0;
+        int64 numCollections = 0;
+        int64 numObjectsReclaimed = 0;
+        double lastPauseMs = 0.0;
+        double maximumPauseMs = 0.0;
+        double totalPauseMs = 0.0;
+    };
+
+    /** */
+    const Statistics& getStatistics() const noexcept { return statistics; }
+
+    //==============================================================================
+    /** Runs a full collection, returning the number of objects that were reclaimed. */
+    int collect();
+
+    /** Runs a collection if enough objects have been allocated since the last one.
+
+        To keep the cost linear, the number of allocations needed is the threshold
+        or the number of objects that survived the last collection, whichever is larger.
+    */
+    void collectIfNeeded()
+    {
+        if (collectionThreshold > 0
+            && numAllocationsSinceCollection >= jmax (collectionThreshold, numSurvivors))
+            collect();
+    }
+
+    /** Sets the number of allocations between automatic collections.
+        Zero or less turns automatic collection off.
+    */
+    void setCollectionThreshold (int newThreshold) noexcept { collectionThreshold = newThreshold; }
+
+    //==============================================================================
+    /** Accounts for some memory that a script is about to allocate.
+
+        If this takes the heap over its limit, a collection is run and the heap
+        is measured again. If it's still over the limit after that, the allocation
+        is refused by throwing an error message.
+    */
+    void allocate (int64 numBytes)
+    {
+        numBytesInUse += numBytes;
+
+        if (maximumNumBytes > 0 && numBytesInUse > maximumNumBytes)
+            reclaimOrThrow (numBytes);
+
+        peakNumBytes = jmax (peakNumBytes, numBytesInUse);
+    }
+
+    /** Sets the maximum number of bytes the scripts can use.
+        Zero or less means there's no limit.
+    */
+    void setMaximumNumBytes (int64 newMaximum) noexcept { maximumNumBytes = newMaximum; }
+
+    /** @returns the current estimate of the number of bytes the scripts are using. */
+    int64 getNumBytesInUse() const noexcept { return numBytesInUse; }
+
+    /** @returns the highest number of bytes the scripts have been estimated to use. */
+    int64 getPeakNumBytes() const noexcept { return peakNumBytes; }
+
+    /** Walks the heap to find out how many bytes the scripts are using, and resets the estimate to that. */
+    int64 measure();
+
+    //==============================================================================
+    /** @internal */
+    void add (ScriptObject&) noexcept;
+    /** @internal */
+    void remove (ScriptObject&) noexcept;
+
+private:
+    //==============================================================================
+    DynamicObject& owner;
+    ScriptObject* first = nullptr;
+    int numObjects = 0, numSurvivors = 0;
+    int collectionThreshold = 10000, numAllocationsSinceCollection = 0;
+    int64 numBytesInUse = 0, peakNumBytes = 0, maximumNumBytes = 0;
+    Statistics statistics;
+
+    //==============================================================================
+    struct ArrayNode;
+    using ArrayNodes = std::unordered_map<const ReferenceCountedObject*, ArrayNode>;
+    struct SubtractionVisitor;
+    struct MarkingVisitor;
+    struct MeasuringVisitor;
+
+    void removeDeadWeakReferences();
+
+    void reclaimOrThrow (int64 numBytesRequested);
+
+    bool isTracking (const ScriptObject&) const noexcept;
+    static int& getCollectorRefs (ScriptObject&) noexcept;
+    static bool& getReachableFlag (ScriptObject&) noexcept;
+    static bool isMarkedReachable (const ScriptObject&) noexcept;
+
+    //==============================================================================
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ScriptHeap)
+};
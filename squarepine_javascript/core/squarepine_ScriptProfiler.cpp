@@ -0,0 +1,152 @@
+//==============================================================================
+ScriptProfiler::ScriptProfiler (int interval) :
+    intervalMs (jmax (1, interval))
+{
+    startTimer (intervalMs);
+}
+
+ScriptProfiler::~ScriptProfiler()
+{
+    stopTimer();
+}
+
+//==============================================================================
+int ScriptProfiler::getLineNumber (const String& program, String::CharPointerType position)
+{
+    const auto key = static_cast<const void*> (position.getAddress());
+    const auto iter = lineNumbers.find (key);
+
+    if (iter != lineNumbers.end())
+        return iter->second;
+
+    // The position is only a safe key for as long as its code is around, so that gets held on to.
+    programs.emplace (static_cast<const void*> (program.getCharPointer().getAddress()), program);
+
+    int line = 1;
+
+    for (auto p = program.getCharPointer(); p < position && ! p.isEmpty(); ++p)
+        if (*p == '\n')
+            ++line;
+
+    lineNumbers.emplace (key, line);
+    return line;
+}
+
+void ScriptProfiler::enterFunction (const String& program, String::CharPointerType position, const Identifier& name, bool isNative)
+{
+    const auto key = static_cast<const void*> (position.getAddress());
+    auto iter = frameIndexes.find (key);
+
+    if (iter == frameIndexes.end())
+    {
+        const auto frameName = isNative ? name.toString() + " [native]"
+                                        : name.toString() + " (line " + String (getLineNumber (program, position)) + ")";
+
+        iter = frameIndexes.emplace (key, (int) frames.size()).first;
+        frames.push_back ({ frameName, program });
+    }
+
+    callStack.push_back (iter->second);
+}
+
+void ScriptProfiler::exitFunction() noexcept
+{
+    jassert (! callStack.empty());
+
+    if (! callStack.empty())
+        callStack.pop_back();
+}
+
+void ScriptProfiler::takeSample (const String& program, String::CharPointerType position)
+{
+    const auto numTicks = (int64) pendingTicks.exchange (0, std::memory_order_relaxed);
+
+    if (numTicks <= 0)
+        return;
+
+    numSamples += numTicks;
+    stackCounts[callStack] += numTicks;
+
+    const auto function = callStack.empty() ? -1 : callStack.back();
+    lineCounts[{ function, getLineNumber (program, position) }] += numTicks;
+}
+
+//==============================================================================
+String ScriptProfiler::getFrameName (int frameIndex) const
+{
+    return isPositiveAndBelow (frameIndex, (int) frames.size()) ? frames[(size_t) frameIndex].name : String ("(program)");
+}
+
+ScriptProfile ScriptProfiler::createProfile() const
+{
+    ScriptProfile profile;
+    profile.numSamples = numSamples;
+    profile.intervalMs = (double) intervalMs;
+
+    // The same function can turn up under several keys (eg: a native called from different places), so they're merged by name.
+    std::map<String, ScriptProfile::FunctionEntry> functions;
+    MemoryOutputStream folded;
+
+    for (const auto& stack : stackCounts)
+    {
+        const auto count = stack.second;
+        StringArray names;
+        names.add ("(program)");
+
+        for (auto index : stack.first)
+            names.add (getFrameName (index));
+
+        folded << names.joinIntoString (";") << " " << String (count) << exportLineEnd;
+
+        // Recursive functions only count once towards their own total.
+        StringArray distinctNames (names);
+        distinctNames.removeDuplicates (false);
+
+        for (const auto& name : distinctNames)
+            functions[name].totalSamples += count;
+
+        functions[names[names.size() - 1]].selfSamples += count;
+    }
+
+    for (auto& f : functions)
+    {
+        auto entry = f.second;
+        entry.name = f.first;
+        entry.selfMs = (double) entry.selfSamples * profile.intervalMs;
+        entry.totalMs = (double) entry.totalSamples * profile.intervalMs;
+        profile.functions.add (entry);
+    }
+
+    for (const auto& l : lineCounts)
+        profile.lines.add ({ getFrameName (l.first.first), l.first.second, l.second, (double) l.second * profile.intervalMs });
+
+    std::stable_sort (profile.functions.begin(), profile.functions.end(),
+                      [] (const ScriptProfile::FunctionEntry& a, const ScriptProfile::FunctionEntry& b) { return a.selfSamples > b.selfSamples; });
+
+    std::stable_sort (profile.lines.begin(), profile.lines.end(),
+                      [] (const ScriptProfile::LineEntry& a, const ScriptProfile::LineEntry& b) { return a.samples > b.samples; });
+
+    profile.foldedStacks = folded.toString();
+    return profile;
+}
+
+//==============================================================================
+String ScriptProfile::toTable() const
+{
+    MemoryOutputStream mo;
+
+    mo << "Samples: " << String (numSamples) << ", every " << String (intervalMs) << " ms" << newLine << newLine
+       << "   Self ms   Total ms  Function" << newLine;
+
+    for (const auto& f : functions)
+        mo << String (f.selfMs, 1).paddedLeft (' ', 10) << String (f.totalMs, 1).paddedLeft (' ', 11)
+           << "  " << f.name << newLine;
+
+    mo << newLine << "        ms  Line  Function" << newLine;
+
+    for (const auto& l : lines)
+        mo << String (l.ms, 1).paddedLeft (' ', 10) << String (l.line).paddedLeft (' ', 6)
+           << "  " << l.function << newLine;
+
+    return mo.toString();
+}
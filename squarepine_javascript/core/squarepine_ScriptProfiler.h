@@ -0,0 +1,119 @@
+//==============================================================================
+/** What a ScriptProfiler found out about where a script spends its time. */
+struct ScriptProfile final
+{
+    /** The time spent in one function. */
+    struct FunctionEntry
+    {
+        String name;
+        int64 selfSamples = 0, totalSamples = 0;
+        double selfMs = 0.0, totalMs = 0.0;
+    };
+
+    /** The time spent on one line of a function. */
+    struct LineEntry
+    {
+        String function;
+        int line = 0;
+        int64 samples = 0;
+        double ms = 0.0;
+    };
+
+    /** Sorted by self time, the busiest function first. */
+    Array<FunctionEntry> functions;
+    /** Sorted by the number of samples, the busiest line first. */
+    Array<LineEntry> lines;
+
+    /** The call stacks that were sampled, in the "folded" format that flame graph tools
+        take: one line per distinct stack, with the frames separated by semicolons from
+        the outermost inwards, followed by the number of samples, eg: "(program);main (line 1);fib (line 8) 123"
+    */
+    String foldedStacks;
+
+    int64 numSamples = 0;
+    double intervalMs = 0.0;
+
+    /** @returns the functions and lines as a plain text table. */
+    String toTable() const;
+};
+
+//==============================================================================
+/** Samples the call stack of a running script at regular intervals.
+
+    A timer thread counts the ticks of the sampling interval as they go by, and the
+    interpreter checks the count at its safepoints (the start of each statement, loop
+    iteration and function call, and the end of each call), recording the stack there.
+    So sampling happens on the script's own thread without it ever having to be stopped,
+    and the cost when no sample is due is a single load of an atomic counter.
+
+    Each sample counts for every tick that went by since the one before, so that a
+    long stretch without a safepoint, like a slow native function, gets all of the
+    time it took rather than a single interval's worth. Taking a sample as a call
+    returns means that time goes to the function that used it, rather than to
+    whatever the caller reaches next.
+
+    The call stack is shadowed by the interpreter only while profiling is switched on;
+    the rest of the time, the only cost is checking for a null profiler.
+
+    @see JavascriptEngine::startProfiling
+*/
+class ScriptProfiler final : private HighResolutionTimer
+{
+public:
+    /** Creates a profiler, which starts sampling straight away. */
+    explicit ScriptProfiler (int intervalMs);
+    /** */
+    ~ScriptProfiler() override;
+
+    //==============================================================================
+    /** @returns true if the interpreter should call takeSample() at its next safepoint. */
+    bool isSampleDue() const noexcept { return pendingTicks.load (std::memory_order_relaxed) > 0; }
+
+    /** Records the call stack, along with the position that the script has got to,
+        weighted by the number of ticks that have gone by since the last sample.
+    */
+    void takeSample (const String& program, String::CharPointerType position);
+
+    /** Pushes a function call onto the shadow call stack.
+
+        @param program      The code that the function was defined in.
+        @param position     Where the function starts, which tells apart different functions of the same name.
+        @param name         The name the function was called by.
+        @param isNative     True for native functions, which get marked as such.
+    */
+    void enterFunction (const String& program, String::CharPointerType position, const Identifier& name, bool isNative);
+
+    /** Pops the innermost function call off the shadow call stack. */
+    void exitFunction() noexcept;
+
+    //==============================================================================
+    /** Puts together everything that has been sampled so far. */
+    ScriptProfile createProfile() const;
+
+private:
+    //==============================================================================
+    struct Frame
+    {
+        String name;
+        String program; // Keeps the code alive, so that the position this frame was keyed on can't be reused.
+    };
+
+    const int intervalMs;
+    std::atomic<int> pendingTicks { 0 };
+    std::vector<Frame> frames;
+    std::unordered_map<const void*, int> frameIndexes;
+    std::unordered_map<const void*, int> lineNumbers;
+    std::unordered_map<const void*, String> programs;
+    std::vector<int> callStack, sampleStack;
+    std::map<std::vector<int>, int64> stackCounts;
+    std::map<std::pair<int, int>, int64> lineCounts;
+    int64 numSamples = 0;
+
+    void hiResTimerCallback() override { pendingTicks.fetch_add (1, std::memory_order_relaxed); }
+
+    int getLineNumber (const String& program, String::CharPointerType position);
+    String getFrameName (int frameIndex) const;
+
+    //==============================================================================
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ScriptProfiler)
+};
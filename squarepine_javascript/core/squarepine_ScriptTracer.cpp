@@ -0,0 +1,164 @@
+//==============================================================================
+ScriptTracer::ThreadBuffer::ThreadBuffer (int capacity, Thread::ThreadID t, int i) :
+    events ((size_t) capacity),
+    threadId (t),
+    index (i)
+{
+    if (auto* thread = Thread::getCurrentThread())
+        threadName = thread->getThreadName();
+    else
+        threadName = "Thread " + String (index);
+}
+
+//==============================================================================
+static uint32 getNextTracerId() noexcept
+{
+    static std::atomic<uint32> nextId { 1 };
+    return nextId++;
+}
+
+ScriptTracer::ScriptTracer (int numEvents) :
+    id (getNextTracerId()),
+    eventsPerThread (nextPowerOfTwo (jmax (2, numEvents))),
+    startTicks (Time::getHighResolutionTicks())
+{
+}
+
+//==============================================================================
+ScriptTracer::ThreadBuffer& ScriptTracer::getBufferForThisThread()
+{
+    // Each thread remembers the last tracer it recorded into, so the lock is only taken the first time round.
+    // The tracers are told apart by ID rather than by address, since a new one could turn up where an old one was.
+    struct Cache
+    {
+        uint32 tracerId = 0;
+        ThreadBuffer* buffer = nullptr;
+    };
+
+    static thread_local Cache cache;
+
+    if (cache.tracerId == id)
+        return *cache.buffer;
+
+    const ScopedLock sl (lock);
+    const auto threadId = Thread::getCurrentThreadId();
+    ThreadBuffer* buffer = nullptr;
+
+    for (auto& b : buffers)
+        if (b->threadId == threadId)
+            buffer = b.get();
+
+    if (buffer == nullptr)
+    {
+        buffers.emplace_back (new ThreadBuffer (eventsPerThread, threadId, (int) buffers.size() + 1));
+        buffer = buffers.back().get();
+    }
+
+    cache = { id, buffer };
+    return *buffer;
+}
+
+void ScriptTracer::record (Category category, const Identifier& name, bool isBegin)
+{
+    const auto ticks = Time::getHighResolutionTicks();
+    auto& buffer = getBufferForThisThread();
+
+    const auto position = buffer.numWritten.load (std::memory_order_relaxed);
+    auto& event = buffer.events[(size_t) (position & (uint64) (eventsPerThread - 1))];
+    event.name = name;
+    event.ticks = ticks;
+    event.category = category;
+    event.isBegin = isBegin;
+
+    buffer.numWritten.store (position + 1, std::memory_order_release);
+}
+
+void ScriptTracer::begin (Category category, const Identifier& name)
+{
+    record (category, name, true);
+}
+
+void ScriptTracer::end (Category category, const Identifier& name)
+{
+    record (category, name, false);
+}
+
+//==============================================================================
+void ScriptTracer::writeChromeTrace (OutputStream& output) const
+{
+    static const char* const categoryNames[] = { "parse", "compile", "script", "native" };
+
+    const ScopedLock sl (lock);
+    bool isFirst = true;
+
+    const auto writeSeparator = [&]
+    {
+        output << (isFirst ? "\n" : ",\n");
+        isFirst = false;
+    };
+
+    output << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+
+    for (const auto& buffer : buffers)
+    {
+        const auto tid = String (buffer->index);
+
+        writeSeparator();
+        output << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid
+               << ",\"args\":{\"name\":" << JSON::toString (buffer->threadName) << "}}";
+
+        const auto numWritten = buffer->numWritten.load (std::memory_order_acquire);
+        const auto numKept = jmin (numWritten, (uint64) eventsPerThread);
+
+        for (auto position = numWritten - numKept; position < numWritten; ++position)
+        {
+            const auto& event = buffer->events[(size_t) (position & (uint64) (eventsPerThread - 1))];
+            const auto microseconds = Time::highResolutionTicksToSeconds (event.ticks - startTicks) * 1.0e6;
+
+            writeSeparator();
+            output << "{\"name\":" << JSON::toString (event.name.toString())
+                   << ",\"cat\":\"" << categoryNames[(int) event.category]
+                   << "\",\"ph\":\"" << (event.isBegin ? "B" : "E")
+                   << "\",\"ts\":" << String (microseconds, 3)
+                   << ",\"pid\":1,\"tid\":" << tid << "}";
+        }
+    }
+
+    output << "\n]}\n";
+}
+
+String ScriptTracer::toChromeTraceJSON() const
+{
+    MemoryOutputStream mo;
+    writeChromeTrace (mo);
+    return mo.toString();
+}
+
+int64 ScriptTracer::getNumOverwritten() const
+{
+    const ScopedLock sl (lock);
+    int64 total = 0;
+
+    for (const auto& buffer : buffers)
+    {
+        const auto numWritten = buffer->numWritten.load();
+
+        if (numWritten > (uint64) eventsPerThread)
+            total += (int64) (numWritten - (uint64) eventsPerThread);
+    }
+
+    return total;
+}
+
+void ScriptTracer::clear()
+{
+    const ScopedLock sl (lock);
+
+    for (auto& buffer : buffers)
+    {
+        buffer->numWritten = 0;
+
+        for (auto& event : buffer->events)
+            event = {};
+    }
+}
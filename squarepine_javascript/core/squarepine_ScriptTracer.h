@@ -0,0 +1,123 @@
+//==============================================================================
+/** Records when an engine starts and finishes parsing code, compiling regular
+    expressions, and calling script and native functions, so that the time spent
+    in each can be looked at in a trace viewer.
+
+    Each thread that records events gets a ring buffer of its own, which only it
+    writes to, so recording an event takes no locks: just a timestamp and a store.
+    Once a buffer fills up, the oldest events get overwritten.
+
+    The events can be written out in the JSON format of Chrome's trace_event, which
+    chrome://tracing, Perfetto and the like can open. As the buffers aren't locked,
+    this should be done while none of the engines using the tracer are running.
+
+    A tracer can be shared by any number of engines, on any number of threads.
+
+    @see JavascriptEngine::setTracer
+*/
+class ScriptTracer final : public ReferenceCountedObject
+{
+public:
+    //==============================================================================
+    /** */
+    using Ptr = ReferenceCountedObjectPtr<ScriptTracer>;
+
+    /** The kinds of things that get traced. */
+    enum class Category
+    {
+        parse,      /**< Turning some code into a syntax tree. */
+        compile,    /**< Compiling a regular expression. */
+        script,     /**< Running a script, or calling one of its functions. */
+        native      /**< Calling a native function. */
+    };
+
+    //==============================================================================
+    /** Creates a tracer.
+
+        @param eventsPerThread  The size of each thread's ring buffer,
+                                which gets rounded up to a power of two.
+    */
+    explicit ScriptTracer (int eventsPerThread = 65536);
+
+    //==============================================================================
+    /** Records the start of something on the calling thread. */
+    void begin (Category category, const Identifier& name);
+    /** Records the end of something on the calling thread. */
+    void end (Category category, const Identifier& name);
+
+    /** Records the start of something when it's created, and its end when it's deleted.
+        The name is only copied if there's a tracer, so this costs next to nothing when there isn't.
+    */
+    struct ScopedEvent final
+    {
+        /** */
+        ScopedEvent (ScriptTracer* t, Category c, const Identifier& n) :
+            tracer (t),
+            category (c),
+            name (t != nullptr ? n : Identifier())
+        {
+            if (tracer != nullptr)
+                tracer->begin (category, name);
+        }
+
+        /** */
+        ~ScopedEvent()
+        {
+            if (tracer != nullptr)
+                tracer->end (category, name);
+        }
+
+    private:
+        ScriptTracer* const tracer;
+        const Category category;
+        const Identifier name;
+
+        JUCE_DECLARE_NON_COPYABLE (ScopedEvent)
+    };
+
+    //==============================================================================
+    /** Writes out every event that's still in the buffers, in Chrome's trace_event JSON format. */
+    void writeChromeTrace (OutputStream& output) const;
+
+    /** @returns the events in Chrome's trace_event JSON format. */
+    String toChromeTraceJSON() const;
+
+    /** @returns the number of events that have been overwritten before they could be written out. */
+    int64 getNumOverwritten() const;
+
+    /** Throws away all of the recorded events. */
+    void clear();
+
+private:
+    //==============================================================================
+    struct Event
+    {
+        Identifier name;
+        int64 ticks = 0;
+        Category category = Category::script;
+        bool isBegin = false;
+    };
+
+    struct ThreadBuffer
+    {
+        ThreadBuffer (int capacity, Thread::ThreadID threadId, int index);
+
+        std::vector<Event> events;
+        std::atomic<uint64> numWritten { 0 };
+        const Thread::ThreadID threadId;
+        const int index;
+        String threadName;
+    };
+
+    const uint32 id;
+    const int eventsPerThread;
+    const int64 startTicks;
+    CriticalSection lock;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+
+    ThreadBuffer& getBufferForThisThread();
+    void record (Category, const Identifier&, bool isBegin);
+
+    //==============================================================================
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ScriptTracer)
+};
@@ -4,13 +4,45 @@ namespace sp
 {
     using namespace juce;
 
+    /** The line ending of the text formats that the engine exports, like Prometheus, LCOV and folded stacks,
+        which all want plain line feeds whatever the platform, unlike JUCE's newLine.
+    */
+    static const char* const exportLineEnd = "\n";
+
     #include "core/squarepine_RFC2822Time.cpp"
+    #include "core/squarepine_ConsoleLog.cpp"
+    #include "core/squarepine_ScriptProfiler.cpp"
+    #include "core/squarepine_EngineMetrics.cpp"
+    #include "core/squarepine_ScriptTracer.cpp"
+    #include "core/squarepine_ScriptCoverage.cpp"
+    #include "core/squarepine_NumberConversion.h"
+    #include "core/squarepine_RegExp.h"
     #include "core/squarepine_Parsing.h"
+    #include "core/squarepine_JSON.h"
     #include "core/squarepine_Classes.h"
+    #include "core/squarepine_NativeBinding.cpp"
+    #include "core/squarepine_ClassBinding.cpp"
+    #include "core/squarepine_ScriptHeap.cpp"
+    #include "core/squarepine_EventLoop.cpp"
     #include "core/squarepine_RootObject.cpp"
     #include "core/squarepine_JavascriptEngine.cpp"
 
+   #if SP_JAVASCRIPT_ENABLE_BENCHMARKS
+    #include "benchmarks/squarepine_JavascriptBenchmarks.cpp"
+   #endif
+
+   #if SP_JAVASCRIPT_ENABLE_PARSER_FUZZER
+    #include "benchmarks/squarepine_ParserFuzzer.cpp"
+   #endif
+
    #if JUCE_MODULE_AVAILABLE_juce_gui_extra
     #include "graphics/squarepine_JavascriptCodeTokeniser.cpp"
    #endif
 }
+
+#if SP_JAVASCRIPT_ENABLE_PARSER_FUZZER
+extern "C" int LLVMFuzzerTestOneInput (const uint8_t* data, size_t size)
+{
+    return sp::ParserFuzzer::testOneInput (data, size);
+}
+#endif
@@ -17,11 +17,16 @@
 */
 
 //==============================================================================
-#include <regex>
+#include <atomic>
+#include <deque>
 #include <random>
 #include <sstream>
 #include <locale>
+#include <map>
 #include <iomanip>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include <juce_data_structures/juce_data_structures.h>
 
@@ -29,6 +34,42 @@
     #include <juce_gui_extra/juce_gui_extra.h>
 #endif
 
+//==============================================================================
+/** Config: SP_JAVASCRIPT_ENABLE_INSTRUMENTATION
+
+    Enable this to have the interpreter count the statements and expressions it
+    evaluates, the calls it makes, and the objects, arrays and strings it allocates.
+
+    When this is disabled, the counting isn't compiled in at all.
+
+    @see sp::JavascriptEngine::getInstrumentationCounters
+*/
+#ifndef SP_JAVASCRIPT_ENABLE_INSTRUMENTATION
+    #define SP_JAVASCRIPT_ENABLE_INSTRUMENTATION 0
+#endif
+
+/** Config: SP_JAVASCRIPT_ENABLE_BENCHMARKS
+
+    Enable this to compile in the JavascriptBenchmarks suite, which a host
+    can run to time the interpreter over a set of standard workloads.
+*/
+#ifndef SP_JAVASCRIPT_ENABLE_BENCHMARKS
+    #define SP_JAVASCRIPT_ENABLE_BENCHMARKS 0
+#endif
+
+/** Config: SP_JAVASCRIPT_ENABLE_PARSER_FUZZER
+
+    Enable this to compile in a libFuzzer target for the parser, by way of
+    LLVMFuzzerTestOneInput(). Besides crashes, it fails on any input whose
+    parse time grows much faster than its length.
+
+    Only enable this in a build made with -fsanitize=fuzzer, which provides main().
+    JavascriptBenchmarks::writeParserCorpus() can write out some scripts to seed its corpus.
+*/
+#ifndef SP_JAVASCRIPT_ENABLE_PARSER_FUZZER
+    #define SP_JAVASCRIPT_ENABLE_PARSER_FUZZER 0
+#endif
+
 //==============================================================================
 namespace sp
 {
@@ -38,9 +79,23 @@ namespace sp
     //#include "core/squarepine_AST.h"
     //#include "core/squarepine_Lexer.h"
 
+    #include "core/squarepine_ScriptHeap.h"
+    #include "core/squarepine_EventLoop.h"
+    #include "core/squarepine_ConsoleLog.h"
+    #include "core/squarepine_ScriptProfiler.h"
+    #include "core/squarepine_InstrumentationCounters.h"
+    #include "core/squarepine_EngineMetrics.h"
+    #include "core/squarepine_ScriptTracer.h"
+    #include "core/squarepine_ScriptCoverage.h"
+    #include "core/squarepine_NativeBinding.h"
     #include "core/squarepine_RootObject.h"
+    #include "core/squarepine_ClassBinding.h"
     #include "core/squarepine_JavascriptEngine.h"
 
+   #if SP_JAVASCRIPT_ENABLE_BENCHMARKS
+    #include "benchmarks/squarepine_JavascriptBenchmarks.h"
+   #endif
+
    #if JUCE_MODULE_AVAILABLE_juce_gui_extra
     #include "graphics/squarepine_JavascriptCodeTokeniser.h"
    #endif